@@ -164,7 +164,7 @@ private:
     // REST处理器
     std::shared_ptr<RestHandler> rest_handler_;
     // Web服务器
-    std::unique_ptr<CrowServer> web_server_;
+    std::shared_ptr<CrowServer> web_server_;
     // 服务器线程
     std::thread server_thread_;
     // 停止标志
@@ -11,7 +11,10 @@
 
 #include "api/rest_handler.h"
 #include "camera/camera_device.h"
+#include "camera/frame_bus.h"
+#include "camera/capability_cache.h"
 #include "video/i_video_recorder.h"
+#include "video/i_video_splitter.h"
 #include "api/mjpeg_streamer.h"
 
 namespace cam_server {
@@ -118,10 +121,10 @@ public:
     /**
      * @brief 开始录制
      * @param output_path 输出路径
-     * @param format 格式
-     * @param encoder 编码器
+     * @param format 格式，fmp4表示分片MP4
+     * @param encoder 编码器，copy表示MJPEG直通录制（不解码、不重编码）
      * @param bitrate 比特率
-     * @param max_duration 最大时长
+     * @param max_duration 分段时长（秒），0表示不分段
      * @return 是否成功
      */
     bool startRecording(const std::string& output_path = "",
@@ -142,6 +145,19 @@ public:
      */
     std::string getRecordingStatus();
 
+    /**
+     * @brief 设置预录：不在录制时也持续编码并在内存中保留最近的画面，开始录制的文件包含触发前的这段时间
+     * @param seconds 预录时长（秒），0表示关闭预录
+     * @param format 格式
+     * @param encoder 编码器，copy表示MJPEG直通录制
+     * @param bitrate 比特率
+     * @return 是否成功，录制中设置时在录制结束后生效
+     */
+    bool setPreRoll(int seconds,
+                    const std::string& format = "mp4",
+                    const std::string& encoder = "h264_rkmpp",
+                    int bitrate = 4000000);
+
 private:
     CameraApi();
     ~CameraApi();
@@ -152,10 +168,26 @@ private:
 
     // 查询设备信息
     bool queryDevice(const std::string& device_path, CameraDeviceInfo& info);
+    // 将缓存的设备能力转换为设备信息
+    static void fillDeviceInfo(const camera::DeviceCapabilities& capabilities, CameraDeviceInfo& info);
 
     // 确保目录存在
     bool ensureDirectoryExists(const std::string& path);
 
+    // 按当前时间生成录像文件路径
+    std::string makeVideoPath(const std::string& container) const;
+    // 创建录制器并订阅帧，调用方持有recording_mutex_
+    bool createRecorderLocked(const std::string& output_path, const std::string& format, const std::string& encoder,
+                              int bitrate, int max_duration, int pre_roll_seconds);
+    // 取消帧订阅并释放录制器，调用方持有recording_mutex_
+    void releaseRecorderLocked();
+    // 按预录设置开始预录，调用方持有recording_mutex_
+    bool armPreRollLocked();
+    // 解析录像和文件内时间：file_key指定的文件加seconds_key（秒），或wall_key指定的系统时间按关键帧索引查找录像。
+    // 失败时status_code为400（参数缺失或格式错误）或404（录像不存在）
+    bool resolveVideoTime(const HttpRequest& request, const std::string& seconds_key, const std::string& wall_key,
+                          std::string& video_path, double& seconds, int& status_code, std::string& error) const;
+
     // 处理HTTP请求
     HttpResponse handleGetCameraStatus(const HttpRequest& request);
     HttpResponse handleGetAllCameras(const HttpRequest& request);
@@ -167,14 +199,29 @@ private:
     HttpResponse handleStartRecording(const HttpRequest& request);
     HttpResponse handleStopRecording(const HttpRequest& request);
     HttpResponse handleGetRecordingStatus(const HttpRequest& request);
+    HttpResponse handleSetPreRoll(const HttpRequest& request);
     HttpResponse handleMjpegStream(const HttpRequest& request);
+    HttpResponse handleGetStreamTiers(const HttpRequest& request);
+    HttpResponse handleSetStreamTier(const HttpRequest& request);
+    HttpResponse handleStreamFeedback(const HttpRequest& request);
+    HttpResponse handleGetPipelineStats(const HttpRequest& request);
+    HttpResponse handleGetVideoFrame(const HttpRequest& request);
+    HttpResponse handleExportVideoClip(const HttpRequest& request);
 
     // 成员变量
     bool is_initialized_;
     std::string images_dir_;
     std::string videos_dir_;
     std::shared_ptr<video::IVideoRecorder> video_recorder_;
+    camera::FrameBus::SubscriptionId recording_subscription_;
     std::mutex recording_mutex_;
+    // 预录设置，受recording_mutex_保护
+    int pre_roll_seconds_;
+    std::string pre_roll_format_;
+    std::string pre_roll_encoder_;
+    int pre_roll_bitrate_;
+    // 录像取帧和导出片段
+    std::shared_ptr<video::IVideoSplitter> video_splitter_;
     MjpegStreamer& mjpeg_streamer_;
 };
 
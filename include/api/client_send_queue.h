@@ -0,0 +1,147 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cam_server {
+namespace api {
+
+/**
+ * @brief 发给客户端的不可变数据，由所有客户端共享
+ */
+using SendPayload = std::shared_ptr<const std::vector<uint8_t>>;
+
+/**
+ * @brief 单个流客户端的发送统计
+ */
+struct ClientSendStats {
+    std::string client_id;          // 客户端ID
+    std::string transport;          // 传输方式（websocket/mjpeg）
+    std::string tier;               // 分辨率档位
+    uint64_t queued_frames = 0;     // 进入发送队列的帧数
+    uint64_t sent_frames = 0;       // 已发送的帧数
+    uint64_t dropped_frames = 0;    // 因客户端太慢被新帧替换或发送失败的帧数
+    size_t depth = 0;               // 当前队列深度
+    size_t capacity = 0;            // 队列容量
+    double fps = 0.0;               // 实际发送帧率
+    double latency_ms = 0.0;        // 从入队到写出的平均延迟
+    double target_fps = 0.0;        // 自适应控制的目标帧率，0表示不限制
+};
+
+/**
+ * @brief 客户端发送计数器
+ *
+ * 用于自带发送队列的传输（如WebSocket连接的写队列）：入队、发送完成和丢弃时分别计数，
+ * 并按秒统计实际发送帧率。线程安全。
+ */
+class ClientSendMeter {
+public:
+    /**
+     * @brief 构造函数
+     * @param capacity 传输层队列容量，仅用于统计展示
+     */
+    explicit ClientSendMeter(size_t capacity);
+
+    /**
+     * @brief 记录一帧进入发送队列
+     */
+    void onQueued();
+
+    /**
+     * @brief 记录一帧发送结束
+     * @param sent true表示已写出，false表示被丢弃或写失败
+     * @param latency_us 从入队到写出的时间，小于0表示未知
+     */
+    void onCompleted(bool sent, int64_t latency_us = -1);
+
+    /**
+     * @brief 获取统计信息
+     * @return 统计信息（不含客户端ID和传输方式）
+     */
+    ClientSendStats getStats() const;
+
+private:
+    void updateFps(std::chrono::steady_clock::time_point now);
+
+    mutable std::mutex mutex_;
+    ClientSendStats stats_;
+    uint64_t window_frames_;
+    std::chrono::steady_clock::time_point window_start_;
+};
+
+/**
+ * @brief 单个客户端的有界发送队列
+ *
+ * 帧回调只把共享数据放入队列，由客户端自己的发送线程取出写到网络，
+ * 慢客户端不会阻塞采集和编码线程，也不会拖慢其他客户端。
+ * 队列满时丢弃最旧的帧，客户端总是拿到最新画面。
+ */
+class ClientSendQueue {
+public:
+    /**
+     * @brief 构造函数
+     * @param capacity 队列容量，至少为1
+     */
+    explicit ClientSendQueue(size_t capacity);
+
+    /**
+     * @brief 放入一帧，队列满时丢弃最旧的帧
+     * @param payload 帧数据
+     * @return 队列已关闭时返回false
+     */
+    bool push(SendPayload payload);
+
+    /**
+     * @brief 取出最旧的帧，队列为空时等待
+     * @param payload 输出帧数据
+     * @param timeout 最长等待时间
+     * @return 取到帧时返回true，超时或队列已关闭时返回false
+     */
+    bool pop(SendPayload& payload, std::chrono::milliseconds timeout);
+
+    /**
+     * @brief 记录pop取出的帧已发送结束
+     * @param sent 是否写出成功
+     */
+    void markSent(bool sent);
+
+    /**
+     * @brief 关闭队列，唤醒等待的发送线程并丢弃未发送的帧
+     */
+    void close();
+
+    /**
+     * @brief 队列是否已关闭
+     * @return 是否已关闭
+     */
+    bool isClosed() const;
+
+    /**
+     * @brief 获取统计信息
+     * @return 统计信息（不含客户端ID和传输方式）
+     */
+    ClientSendStats getStats() const;
+
+private:
+    struct PendingPayload {
+        SendPayload payload;
+        std::chrono::steady_clock::time_point queued_time;
+    };
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<PendingPayload> queue_;
+    std::chrono::steady_clock::time_point sending_since_;  // 正在发送的帧的入队时间
+    size_t capacity_;
+    bool closed_;
+    ClientSendMeter meter_;
+};
+
+} // namespace api
+} // namespace cam_server
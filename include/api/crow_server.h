@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <functional>
@@ -7,8 +8,10 @@
 #include <thread>
 #include <unordered_map>
 #include <mutex>
+#include <vector>
 
 #include "rest_handler.h"
+#include "client_send_queue.h"
 
 namespace cam_server {
 namespace api {
@@ -110,6 +113,31 @@ public:
      */
     void broadcastWebSocketMessage(const std::string& path, const std::string& message, bool is_binary = false);
 
+    /**
+     * @brief 将同一份负载广播给多个WebSocket客户端
+     *
+     * WebSocket帧头只构造一次，各连接的发送队列引用同一份负载而不复制，
+     * 负载在最后一个连接写完后释放。发送时不持有全局连接表锁。
+     * 默认按JPEG视频帧处理：连接写队列中尚未开始写的上一帧会被新帧替换，慢客户端只丢自己的帧。
+     * H.264等帧间依赖的数据不能被替换，需关闭latest_only，由调用方根据队列深度决定何时停发。
+     * 前缀（如帧信封）与WebSocket帧头放在一起发送，负载本身仍不复制。
+     * @param client_ids 客户端ID列表
+     * @param payload 引用计数的负载
+     * @param is_binary 是否为二进制消息
+     * @param latest_only 是否只保留最新一帧
+     * @param prefix 写在负载之前的数据，与负载组成同一条消息
+     * @return 成功投递的客户端数
+     */
+    size_t broadcastWebSocketPayload(const std::vector<std::string>& client_ids,
+                                     std::shared_ptr<const std::vector<uint8_t>> payload, bool is_binary = true,
+                                     bool latest_only = true, const std::string& prefix = "");
+
+    /**
+     * @brief 获取各WebSocket客户端的视频帧发送统计
+     * @return 发送统计列表
+     */
+    std::vector<ClientSendStats> getWebSocketClientStats() const;
+
     /**
      * @brief 发送WebSocket消息给特定客户端
      * @param client_id 客户端ID
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "video/encoded_frame_cache.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cam_server {
+namespace api {
+
+// 最新帧保存配置
+struct LatestFrameStoreConfig {
+    int grace_period_ms = 30000;     // 档位最后一个观看者离开后继续保持编码的时间，0表示不保持
+    int refresh_interval_ms = 500;   // 没有观看者的档位在保持期内的刷新间隔
+};
+
+/**
+ * @brief 各摄像头各档位最新编码的一帧
+ *
+ * 新观看者连接或切换档位时不必等下一帧采集和编码，先发出这里保存的最新一帧。
+ * 档位的最后一个观看者离开后，各流在保持期内按较低的频率继续编码该档位，
+ * 保持编码器常驻、保存的帧也不会过时；超过保持期后丢弃。
+ * 档位按名称区分，各流使用同一份阶梯配置（stream.ladder）时可以互相复用。
+ */
+class LatestFrameStore {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 获取LatestFrameStore单例
+     * @return LatestFrameStore单例的引用
+     */
+    static LatestFrameStore& getInstance();
+
+    /**
+     * @brief 设置配置
+     * @param config 配置
+     */
+    void setConfig(const LatestFrameStoreConfig& config);
+
+    /**
+     * @brief 获取配置
+     */
+    LatestFrameStoreConfig getConfig() const;
+
+    /**
+     * @brief 保存档位最新编码的一帧
+     * @param camera_id 摄像头ID
+     * @param tier 档位名
+     * @param jpeg JPEG数据
+     * @param capture_time_us 采集时间（微秒）
+     * @param viewed 该档位当前是否有观看者，有观看者时重新开始计算保持期
+     */
+    void put(const std::string& camera_id, const std::string& tier, video::JpegBuffer jpeg,
+             uint64_t capture_time_us, bool viewed);
+
+    /**
+     * @brief 获取档位最新的一帧
+     * @param camera_id 摄像头ID，为空表示任意摄像头中最新的一帧
+     * @param tier 档位名
+     * @param capture_time_us 输出该帧的采集时间（微秒），可为空
+     * @return JPEG数据，没有或已过时返回空指针
+     */
+    video::JpegBuffer get(const std::string& camera_id, const std::string& tier,
+                          uint64_t* capture_time_us = nullptr) const;
+
+    /**
+     * @brief 获取需要刷新的保持期内档位：保存的帧已超过刷新间隔（观看者被限帧率或已离开）
+     * @param camera_id 摄像头ID
+     * @return 档位名列表，同时丢弃已超过保持期且已过时的帧
+     */
+    std::vector<std::string> getTiersToRefresh(const std::string& camera_id);
+
+    /**
+     * @brief 档位是否还在保持期内（最近有观看者）
+     * @param camera_id 摄像头ID
+     * @param tier 档位名
+     */
+    bool isWarm(const std::string& camera_id, const std::string& tier) const;
+
+    /**
+     * @brief 丢弃摄像头保存的帧
+     * @param camera_id 摄像头ID，为空表示全部
+     */
+    void clear(const std::string& camera_id = "");
+
+private:
+    LatestFrameStore() = default;
+    LatestFrameStore(const LatestFrameStore&) = delete;
+    LatestFrameStore& operator=(const LatestFrameStore&) = delete;
+
+    struct Entry {
+        video::JpegBuffer jpeg;
+        uint64_t capture_time_us = 0;
+        Clock::time_point stored_time;
+        Clock::time_point viewed_time;
+    };
+
+    // 保存的帧超过该时间视为过时（摄像头已停止），不再发给新观看者
+    Clock::duration maxFrameAge() const;
+
+    LatestFrameStoreConfig config_;
+    // 摄像头ID -> 档位名 -> 最新帧
+    std::map<std::string, std::map<std::string, Entry>> cameras_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace api
+} // namespace cam_server
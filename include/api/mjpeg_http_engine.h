@@ -0,0 +1,175 @@
+#pragma once
+
+#include "camera/frame.h"
+#include "camera/frame_bus.h"
+#include "api/client_send_queue.h"
+#include "api/stream_ladder.h"
+#include "api/stream_rate_controller.h"
+#include "video/encoded_frame_cache.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cam_server {
+namespace api {
+
+// epoll MJPEG HTTP引擎配置
+struct MjpegHttpEngineConfig {
+    std::string address = "0.0.0.0";  // 监听地址
+    int port = 8082;                   // 监听端口
+    int num_threads = 2;               // 网络线程数，每个线程一个epoll实例
+    int max_connections = 512;         // 最大连接数
+    int request_timeout_ms = 5000;     // 连接建立后等待请求头的最长时间
+    int jpeg_quality = 80;             // 未配置阶梯时的JPEG质量
+    int max_fps = 30;                  // 最大帧率
+    std::vector<StreamTier> ladder;    // 分辨率阶梯，与MJPEG流和WebSocket流共用配置
+    StreamRateConfig adaptive;         // 自适应档位和帧率控制，最高帧率取max_fps
+};
+
+/**
+ * @brief 基于epoll的MJPEG HTTP推流引擎
+ *
+ * 在独立端口上直接处理 GET /mjpeg?camera_id=&client_id=&tier= 请求，不占用HTTP服务器的处理线程。
+ * 少量网络线程各自用一个epoll实例管理非阻塞连接，几百个观看者不需要几百个线程。
+ * 每帧每个档位只编码一次并预先生成multipart分段头，所有连接共享同一份分段头和JPEG数据，
+ * 用sendmsg把分段头、JPEG和结尾一次写出。每个连接最多一帧在写、一帧待写，
+ * 写不完时新帧替换待写帧，慢连接只丢自己的帧。
+ * 新连接和切换档位时先发出LatestFrameStore中保存的该档位最新一帧，不等下一帧采集和编码。
+ */
+class MjpegHttpEngine {
+public:
+    using Clock = StreamRateController::Clock;
+
+    /**
+     * @brief 获取MjpegHttpEngine单例
+     * @return MjpegHttpEngine单例的引用
+     */
+    static MjpegHttpEngine& getInstance();
+
+    /**
+     * @brief 初始化引擎
+     * @param config 配置
+     * @return 是否初始化成功
+     */
+    bool initialize(const MjpegHttpEngineConfig& config);
+
+    /**
+     * @brief 监听端口并启动网络线程
+     * @return 是否成功启动
+     */
+    bool start();
+
+    /**
+     * @brief 关闭所有连接并停止网络线程
+     * @return 是否成功停止
+     */
+    bool stop();
+
+    /**
+     * @brief 获取运行状态
+     * @return 是否正在运行
+     */
+    bool isRunning() const { return is_running_.load(); }
+
+    /**
+     * @brief 获取监听端口
+     */
+    int getPort() const { return config_.port; }
+
+    /**
+     * @brief 获取当前连接数（包括还在发送请求头的连接）
+     */
+    int getConnectionCount() const { return connection_count_.load(); }
+
+    /**
+     * @brief 获取分辨率阶梯
+     */
+    const StreamLadder& getLadder() const { return ladder_; }
+
+    /**
+     * @brief 切换客户端的分辨率档位，从下一帧开始生效
+     * @param client_id 客户端ID
+     * @param tier 档位名
+     * @return 客户端和档位都存在时返回true
+     */
+    bool setClientTier(const std::string& client_id, const std::string& tier);
+
+    /**
+     * @brief 记录客户端上报的播放状态，供自适应控制使用
+     * @param client_id 客户端ID
+     * @param feedback 客户端反馈
+     * @return 客户端存在时返回true
+     */
+    bool onClientFeedback(const std::string& client_id, const ClientFeedback& feedback);
+
+    /**
+     * @brief 获取各客户端的发送统计
+     * @return 发送统计列表
+     */
+    std::vector<ClientSendStats> getClientSendStats() const;
+
+private:
+    // 一个multipart分段：预先生成的分段头和共享的JPEG数据
+    struct Part {
+        std::shared_ptr<const std::string> header;
+        video::JpegBuffer jpeg;
+        Clock::time_point queued_time;
+    };
+    struct Connection;
+    class Worker;
+
+    MjpegHttpEngine();
+    MjpegHttpEngine(const MjpegHttpEngine&) = delete;
+    MjpegHttpEngine& operator=(const MjpegHttpEngine&) = delete;
+    ~MjpegHttpEngine();
+
+    // 处理帧数据：按档位编码一次，投递给所有网络线程
+    void handleFrame(const camera::Frame& frame);
+    // 生成JPEG对应的multipart分段
+    static Part makePart(video::JpegBuffer jpeg);
+    // 接受新连接，轮流分配给网络线程
+    void acceptConnections();
+    // 摄像头最近是否有帧，摄像头ID为空时检查任意摄像头
+    bool isCameraStreaming(const std::string& camera_id) const;
+    // 登记和注销各摄像头各档位的观看者数量，没有观看者的档位不编码
+    void addDemand(const std::string& camera_id, const std::string& tier);
+    void removeDemand(const std::string& camera_id, const std::string& tier);
+    // 登记客户端所在的网络线程，客户端ID已被占用时加随机后缀，返回实际使用的ID
+    std::string registerClient(const std::string& client_id, Worker* worker);
+    void unregisterClient(const std::string& client_id);
+
+    // 配置
+    MjpegHttpEngineConfig config_;
+    // 分辨率阶梯
+    StreamLadder ladder_;
+    // 是否已初始化
+    bool is_initialized_;
+    // 是否正在运行
+    std::atomic<bool> is_running_;
+    // 监听套接字
+    int listen_fd_;
+    // 网络线程，第一个线程同时负责接受连接
+    std::vector<std::unique_ptr<Worker>> workers_;
+    // 下一个连接分配到的网络线程
+    size_t next_worker_;
+    // 当前连接数
+    std::atomic<int> connection_count_;
+    // 各摄像头各档位的观看者数量（摄像头ID为空表示任意摄像头）
+    std::map<std::string, std::map<std::string, int>> demand_;
+    mutable std::mutex demand_mutex_;
+    // 客户端ID -> 所在网络线程，同时保护workers_的读取
+    std::unordered_map<std::string, Worker*> client_workers_;
+    mutable std::mutex clients_mutex_;
+    // 各摄像头最近一次收到帧的时间，网络线程据此判断摄像头是否在预览
+    std::unordered_map<std::string, Clock::time_point> last_frame_times_;
+    mutable std::mutex frame_times_mutex_;
+    // 帧订阅ID
+    camera::FrameBus::SubscriptionId frame_subscription_;
+};
+
+} // namespace api
+} // namespace cam_server
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "camera/frame.h"
+#include "camera/frame_bus.h"
+#include "api/client_send_queue.h"
+#include "api/stream_ladder.h"
+#include "api/stream_rate_controller.h"
 #include <string>
 #include <vector>
 #include <functional>
@@ -9,6 +13,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <atomic>
+#include <thread>
 
 namespace cam_server {
 namespace api {
@@ -20,17 +25,24 @@ struct MjpegStreamerConfig {
     int max_clients = 2;         // 最大客户端数量
     int output_width = 0;        // 输出宽度 (0表示使用原始尺寸)
     int output_height = 0;       // 输出高度 (0表示使用原始尺寸)
+    int send_queue_depth = 2;    // 每个客户端的发送队列深度，满时丢弃最旧的帧
+    std::vector<StreamTier> ladder;  // 分辨率阶梯，为空时按上面的输出尺寸和质量生成单一档位
+    StreamRateConfig adaptive;   // 自适应档位和帧率控制，最高帧率取max_fps
 };
 
 // MJPEG客户端信息
 struct MjpegClient {
     std::string id;                                                    // 客户端ID
     std::string camera_id;                                            // 关联的摄像头ID
+    std::string tier;                                                 // 当前发送的分辨率档位
     std::function<void(const std::vector<uint8_t>&)> frame_callback;  // 帧回调函数
     std::function<void(const std::string&)> error_callback;           // 错误回调函数
     std::function<void()> close_callback;                             // 关闭回调函数
     int64_t last_frame_time;                                          // 最后一帧时间
     int64_t last_activity_time;                                       // 最后活动时间
+    std::shared_ptr<ClientSendQueue> send_queue;                      // 发送队列
+    std::thread sender;                                               // 发送线程，调用frame_callback
+    StreamRateController rate;                                        // 自适应控制，受clients_mutex_保护
 };
 
 class MjpegStreamer {
@@ -67,13 +79,38 @@ public:
      * @param frame_callback 帧回调函数
      * @param error_callback 错误回调函数
      * @param close_callback 关闭回调函数
+     * @param tier 分辨率档位，为空或不存在时使用默认档位
      * @return 是否成功添加
      */
     bool addClient(const std::string& client_id,
                   const std::string& camera_id,
                   std::function<void(const std::vector<uint8_t>&)> frame_callback,
                   std::function<void(const std::string&)> error_callback = nullptr,
-                  std::function<void()> close_callback = nullptr);
+                  std::function<void()> close_callback = nullptr,
+                  const std::string& tier = "");
+
+    /**
+     * @brief 切换客户端的分辨率档位，从下一帧开始生效
+     *
+     * 启用自适应时该档位作为上限，链路拥塞时仍会自动降档。
+     * @param client_id 客户端ID
+     * @param tier 档位名
+     * @return 客户端和档位都存在时返回true
+     */
+    bool setClientTier(const std::string& client_id, const std::string& tier);
+
+    /**
+     * @brief 记录客户端上报的播放状态，供自适应控制使用
+     * @param client_id 客户端ID
+     * @param feedback 客户端反馈
+     * @return 客户端存在时返回true
+     */
+    bool onClientFeedback(const std::string& client_id, const ClientFeedback& feedback);
+
+    /**
+     * @brief 获取分辨率阶梯
+     */
+    const StreamLadder& getLadder() const { return ladder_; }
 
     /**
      * @brief 移除客户端
@@ -126,6 +163,12 @@ public:
         return active_clients;
     }
 
+    /**
+     * @brief 获取各客户端的发送统计
+     * @return 发送统计列表
+     */
+    std::vector<ClientSendStats> getClientSendStats() const;
+
     /**
      * @brief 将帧编码为JPEG
      * @param frame 输入帧
@@ -146,11 +189,18 @@ private:
     // 析构函数
     ~MjpegStreamer();
 
+    // 客户端发送线程：从发送队列取帧并调用帧回调
+    void runClientSender(std::shared_ptr<MjpegClient> client);
+    // 关闭客户端的发送队列并回收发送线程，不能在持有clients_mutex_时调用
+    void stopClientSender(const std::shared_ptr<MjpegClient>& client);
+
     // 调整帧大小
     bool resizeFrame(const camera::Frame& frame, camera::Frame& resized_frame);
 
     // 配置
     MjpegStreamerConfig config_;
+    // 分辨率阶梯
+    StreamLadder ladder_;
     // 是否已初始化
     bool is_initialized_;
     // 是否正在运行
@@ -167,6 +217,8 @@ private:
     std::atomic<int> frame_count_;
     // 上次计算帧率的时间
     std::chrono::steady_clock::time_point last_fps_time_;
+    // 帧订阅ID
+    camera::FrameBus::SubscriptionId frame_subscription_;
 };
 
 } // namespace api
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cam_server {
+namespace api {
+
+/**
+ * @brief 媒体消息的编码类型
+ */
+enum class StreamCodec : uint8_t {
+    UNKNOWN = 0,
+    JPEG = 1,    // 负载为一帧JPEG
+    H264 = 2,    // 负载为H.264消息（12字节消息头加Annex-B访问单元）
+    TILES = 3    // 负载为瓦片增量消息（"TD"消息头加瓦片）
+};
+
+/**
+ * @brief 媒体消息的帧信封
+ *
+ * 在/ws/camera的每条二进制媒体消息前加上固定格式的信封，客户端据此计算端到端延迟、
+ * 按序号发现丢帧，并在同一连接上区分多个摄像头。所有整数大端：
+ *   0  2字节魔数"CS"
+ *   2  1字节版本（1）
+ *   3  1字节编码（StreamCodec）
+ *   4  2字节信封长度，负载从该偏移开始，新版本只在末尾追加字段
+ *   6  1字节标志，bit0为关键帧/全帧，bit1为缓存重发（最新帧或GOP缓存）
+ *   7  1字节摄像头ID长度，8 1字节档位名长度，9 3字节保留
+ *   12 4字节序号，JPEG按连接和摄像头递增（切换档位不重新计数），H.264和瓦片按摄像头和编码递增
+ *   16 8字节采集时间（微秒），24 8字节服务器发送时间（微秒），二者同为服务器单调时钟
+ *   32 4字节负载长度
+ *   36 摄像头ID，随后为档位名（UTF-8），之后为负载
+ * 见static/js/stream_envelope.js。
+ */
+struct StreamEnvelope {
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t FIXED_SIZE = 36;
+    static constexpr uint8_t FLAG_KEYFRAME = 0x01;
+    static constexpr uint8_t FLAG_CACHED = 0x02;
+
+    StreamCodec codec = StreamCodec::UNKNOWN;
+    uint8_t flags = 0;
+    uint32_t sequence = 0;
+    uint64_t capture_time_us = 0;
+    uint64_t send_time_us = 0;
+    uint32_t payload_size = 0;
+    std::string camera_id;   // 超过255字节时截断
+    std::string tier;        // 档位名，H.264和瓦片流为空
+
+    /**
+     * @brief 信封编码后的长度
+     */
+    size_t size() const;
+
+    /**
+     * @brief 把信封追加到输出末尾，负载由调用方另行发送
+     * @param out 输出缓冲
+     */
+    void appendTo(std::string& out) const;
+
+    /**
+     * @brief 解析信封
+     * @param data 消息数据
+     * @param size 消息长度
+     * @param envelope 输出信封
+     * @param header_size 输出信封长度，即负载的偏移
+     * @return 是否为完整有效的信封，负载长度与消息剩余长度不一致时返回false
+     */
+    static bool parse(const uint8_t* data, size_t size, StreamEnvelope& envelope, size_t& header_size);
+
+    /**
+     * @brief 编码名转换为编码类型
+     * @param codec 编码名：jpeg、h264或tiles
+     */
+    static StreamCodec codecFromString(const std::string& codec);
+};
+
+} // namespace api
+} // namespace cam_server
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace cam_server {
+namespace api {
+
+/**
+ * @brief 流分辨率档位
+ */
+struct StreamTier {
+    std::string name;       // 档位名，客户端按名选择
+    double scale = 1.0;     // 相对源分辨率的缩放比例
+    int width = 0;          // 固定输出宽度，非0时优先于scale
+    int height = 0;         // 固定输出高度
+    int quality = 80;       // JPEG质量 (1-100)
+};
+
+/**
+ * @brief 流分辨率阶梯
+ *
+ * 同一摄像头按多个档位（如原始、1/2、1/4分辨率）提供JPEG流，缩略图客户端不必拉取全分辨率数据。
+ * 第一个档位为默认档位。
+ */
+class StreamLadder {
+public:
+    StreamLadder() = default;
+
+    /**
+     * @brief 构造函数
+     * @param tiers 档位列表，名称重复或缩放比例无效的档位被忽略
+     */
+    explicit StreamLadder(const std::vector<StreamTier>& tiers);
+
+    /**
+     * @brief 解析阶梯配置
+     *
+     * 格式为逗号分隔的"名称:缩放:质量"或"名称:宽x高:质量"，质量可省略，
+     * 例如"full:1:80,half:0.5:70,quarter:0.25:60"或"full:1,thumb:320x180:60"。
+     * @param spec 配置字符串
+     * @param default_quality 未指定质量时使用的质量
+     * @return 档位列表，格式错误的项被忽略
+     */
+    static std::vector<StreamTier> parse(const std::string& spec, int default_quality);
+
+    /**
+     * @brief 计算档位在给定源分辨率下的输出尺寸
+     * @param tier 档位
+     * @param src_width 源宽度
+     * @param src_height 源高度
+     * @param width 输出宽度，与源相同时为0
+     * @param height 输出高度，与源相同时为0
+     */
+    static void getOutputSize(const StreamTier& tier, int src_width, int src_height, int& width, int& height);
+
+    /**
+     * @brief 是否没有任何档位
+     */
+    bool empty() const { return tiers_.empty(); }
+
+    /**
+     * @brief 获取所有档位
+     */
+    const std::vector<StreamTier>& getTiers() const { return tiers_; }
+
+    /**
+     * @brief 按名称查找档位
+     * @param name 档位名
+     * @return 档位，不存在时返回nullptr
+     */
+    const StreamTier* find(const std::string& name) const;
+
+    /**
+     * @brief 将客户端请求的档位名解析为有效档位名
+     * @param name 请求的档位名，为空或不存在时使用默认档位
+     * @return 有效档位名
+     */
+    std::string resolve(const std::string& name) const;
+
+    /**
+     * @brief 生成档位列表的JSON数组
+     */
+    std::string toJson() const;
+
+private:
+    std::vector<StreamTier> tiers_;
+};
+
+} // namespace api
+} // namespace cam_server
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "api/client_send_queue.h"
+#include "api/stream_ladder.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace cam_server {
+namespace api {
+
+/**
+ * @brief 自适应码率控制配置
+ */
+struct StreamRateConfig {
+    bool enabled = true;                  // 是否启用自适应
+    double max_fps = 30.0;                // 最高发送帧率
+    double min_fps = 2.0;                 // 最低发送帧率
+    int evaluate_interval_ms = 500;       // 评估周期
+    int hold_ms = 2000;                   // 降级后至少保持的时间，等待积压排空
+    int probe_interval_ms = 5000;         // 持续畅通多久后尝试升档
+    int max_probe_interval_ms = 60000;    // 升档失败后退避的上限
+    double high_latency_ms = 250.0;       // 写出延迟或客户端延迟超过此值视为拥塞
+    double low_latency_ms = 80.0;         // 低于此值才允许升档和提高帧率
+};
+
+/**
+ * @brief 客户端上报的播放状态
+ */
+struct ClientFeedback {
+    double lag_ms = -1.0;         // 客户端观测的画面延迟，小于0表示未上报
+    int buffered_frames = -1;     // 客户端已收到但未显示的帧数，小于0表示未上报
+};
+
+/**
+ * @brief 单个流客户端的拥塞控制器
+ *
+ * 按发送队列深度、丢帧数、写出延迟和客户端反馈判断链路是否拥塞：
+ * 拥塞时先把帧率降到一半，再逐级降低分辨率档位，最低档仍拥塞时继续降帧率；
+ * 链路持续畅通时按相反顺序恢复，升档后很快又拥塞则加倍下次升档的等待时间。
+ * 客户端手动选择的档位作为上限，控制器不会超过它。
+ *
+ * 不是线程安全的，由所属流处理器在自己的客户端锁内调用。
+ */
+class StreamRateController {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief 默认构造，不做任何控制
+     */
+    StreamRateController();
+
+    /**
+     * @brief 构造函数
+     * @param ladder 分辨率阶梯，档位按画质从高到低排列
+     * @param config 控制配置
+     * @param tier 客户端选择的档位，作为档位上限
+     */
+    StreamRateController(const StreamLadder& ladder, const StreamRateConfig& config, const std::string& tier);
+
+    /**
+     * @brief 客户端手动切换档位，新档位作为上限并恢复最高帧率
+     * @param tier 档位名
+     */
+    void setCeiling(const std::string& tier);
+
+    /**
+     * @brief 判断当前帧是否发送，按目标帧率均匀抽帧
+     * @param now 当前时间
+     * @return 是否发送
+     */
+    bool admitFrame(Clock::time_point now);
+
+    /**
+     * @brief 是否到了评估周期
+     * @param now 当前时间
+     */
+    bool needsUpdate(Clock::time_point now) const;
+
+    /**
+     * @brief 根据发送统计调整档位和帧率
+     * @param stats 客户端发送统计
+     * @param now 当前时间
+     * @return 档位是否变化
+     */
+    bool update(const ClientSendStats& stats, Clock::time_point now);
+
+    /**
+     * @brief 记录客户端反馈，在下次评估时使用
+     * @param feedback 客户端反馈
+     * @param now 当前时间
+     */
+    void onFeedback(const ClientFeedback& feedback, Clock::time_point now);
+
+    /**
+     * @brief 当前发送的档位
+     */
+    const std::string& getTier() const;
+
+    /**
+     * @brief 档位上限
+     */
+    const std::string& getCeiling() const;
+
+    /**
+     * @brief 当前目标帧率，未启用时为0
+     */
+    double getTargetFps() const { return enabled() ? target_fps_ : 0.0; }
+
+    /**
+     * @brief 当前状态：steady、congested或recovering
+     */
+    const char* getStateName() const;
+
+private:
+    enum class State { STEADY, CONGESTED, RECOVERING };
+
+    bool enabled() const { return config_.enabled && !tiers_.empty(); }
+    bool hasFreshFeedback(Clock::time_point now) const;
+    bool isCongested(const ClientSendStats& stats, uint64_t dropped, uint64_t sent, Clock::time_point now) const;
+    bool isClear(const ClientSendStats& stats, uint64_t dropped, Clock::time_point now) const;
+    bool stepDown();
+    bool stepUp(Clock::time_point now);
+
+    StreamRateConfig config_;
+    std::vector<std::string> tiers_;
+    std::string empty_tier_;
+    size_t ceiling_;
+    size_t current_;
+    double target_fps_;
+    State state_;
+
+    uint64_t last_dropped_;
+    uint64_t last_sent_;
+    Clock::time_point next_frame_;
+    Clock::time_point last_update_;
+    Clock::time_point hold_until_;
+    Clock::time_point clear_since_;
+    Clock::time_point last_tier_up_;
+    std::chrono::milliseconds probe_interval_;
+
+    ClientFeedback feedback_;
+    Clock::time_point feedback_time_;
+};
+
+} // namespace api
+} // namespace cam_server
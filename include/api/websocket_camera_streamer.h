@@ -1,7 +1,13 @@
 #pragma once
 
 #include "camera/frame.h"
+#include "camera/frame_bus.h"
 #include "api/crow_server.h"
+#include "api/stream_envelope.h"
+#include "api/stream_ladder.h"
+#include "api/stream_rate_controller.h"
+#include "video/h264_stream_encoder.h"
+#include "video/tile_delta_encoder.h"
 #include <string>
 #include <vector>
 #include <functional>
@@ -24,12 +30,29 @@ struct WebSocketCameraStreamerConfig {
     int output_width = 0;        // 输出宽度 (0表示使用原始尺寸)
     int output_height = 0;       // 输出高度 (0表示使用原始尺寸)
     bool enable_frame_skip = true; // 启用帧跳过以保持实时性
+    std::vector<StreamTier> ladder;  // 分辨率阶梯，为空时按上面的输出尺寸和质量生成单一档位
+    StreamRateConfig adaptive;   // 自适应档位和帧率控制，最高帧率取max_fps
+    bool enable_h264 = true;     // 允许客户端订阅H.264流
+    video::H264StreamConfig h264;  // H.264编码配置，每个摄像头一路编码，所有H.264客户端共用
+    int h264_join_burst = 30;    // 新客户端加入时最多补发的缓存帧数，缓存更长时强制输出关键帧
+    int h264_max_backlog = 30;   // 客户端写队列积压超过该帧数时停发，等下一个关键帧重新同步
+    bool enable_tiles = true;    // 允许客户端订阅瓦片增量流
+    video::TileDeltaConfig tiles;  // 瓦片增量编码配置，每个摄像头一路，所有瓦片客户端共用
+    int tiles_max_backlog = 10;  // 客户端写队列积压超过该消息数时停发，积压消化后用全帧重新同步
 };
 
 // WebSocket客户端信息
 struct WebSocketCameraClient {
     std::string client_id;
     std::string camera_id;
+    std::string tier;                  // 当前发送的分辨率档位
+    std::string codec;                 // 流编码：jpeg、h264或tiles
+    StreamRateController rate;         // 自适应控制，受clients_mutex_保护，只用于JPEG流
+    bool h264_joined = false;          // 是否已收到过H.264数据，受clients_mutex_保护
+    bool h264_synced = false;          // 是否正在接收从关键帧开始的连续H.264数据，受clients_mutex_保护
+    bool tiles_synced = false;         // 是否已收到全帧并连续接收瓦片更新，受clients_mutex_保护
+    bool envelope = false;             // 媒体消息前是否加帧信封，受clients_mutex_保护
+    uint32_t jpeg_sequence = 0;        // 最近一次发给该客户端的JPEG信封序号，受clients_mutex_保护
     std::chrono::steady_clock::time_point last_frame_time;
     std::atomic<bool> is_active;
     std::atomic<int> frame_count;
@@ -41,7 +64,22 @@ struct WebSocketCameraClient {
 /**
  * @brief WebSocket摄像头流处理器
  * 
- * 负责将摄像头视频流通过WebSocket发送给客户端
+ * 负责将摄像头视频流通过WebSocket发送给客户端。客户端订阅时选择编码：
+ * - jpeg：每条二进制消息是一帧JPEG，按分辨率阶梯和自适应控制发送；
+ * - h264：每个摄像头只编码一路H.264，所有H.264客户端共享。每条二进制消息是一个访问单元，
+ *   前12字节为消息头：1字节标志（bit0为关键帧），3字节保留，8字节大端采集时间（微秒），
+ *   之后为Annex-B数据，可直接交给WebCodecs（annexb格式）解码。开始发送前先发一条
+ *   {"action":"stream_info","codec":"h264","codec_string":"avc1.42e01f",...}文本消息。
+ *   新客户端先收到最近一个GOP的缓存，可立即从关键帧开始解码；缓存过长时强制编码器输出关键帧。
+ * - tiles：适合大部分时间静止的画面。每个摄像头一路瓦片增量编码，只发送亮度有变化的瓦片，
+ *   画面静止时不发送任何数据，并定期发送全帧。每条二进制消息为一次更新，所有字段大端：
+ *   2字节魔数"TD"，1字节版本（1），1字节标志（bit0为全帧），2字节宽，2字节高，2字节瓦片数，
+ *   2字节保留，8字节采集时间（微秒）；之后每个瓦片为2字节x、2字节y、2字节宽、2字节高、
+ *   4字节JPEG长度和JPEG数据。新客户端从下一条全帧开始，消息必须按顺序叠加到画面上，
+ *   见static/js/tile_compositor.js。
+ * 订阅时带"envelope":1的客户端，每条二进制媒体消息前加帧信封（StreamEnvelope），包含摄像头ID、
+ * 序号、采集和发送时间、编码和档位，信封之后为上述原有格式的消息。订阅回复和time命令返回
+ * 服务器时钟clock_us，客户端据此把信封中的时间换算到本地时钟。
  */
 class WebSocketCameraStreamer {
 public:
@@ -80,9 +118,47 @@ public:
      * @brief 添加摄像头客户端
      * @param client_id 客户端ID
      * @param camera_id 摄像头ID
+     * @param tier 分辨率档位，为空或不存在时使用默认档位，只用于JPEG流
+     * @param codec 流编码，jpeg、h264或tiles
+     * @param envelope 媒体消息前是否加帧信封
      * @return 是否添加成功
      */
-    bool addClient(const std::string& client_id, const std::string& camera_id);
+    bool addClient(const std::string& client_id, const std::string& camera_id, const std::string& tier = "",
+                   const std::string& codec = "jpeg", bool envelope = false);
+
+    /**
+     * @brief 切换客户端的分辨率档位，从下一帧开始生效
+     *
+     * 启用自适应时该档位作为上限，链路拥塞时仍会自动降档。
+     * @param client_id 客户端ID
+     * @param tier 档位名
+     * @return 客户端和档位都存在时返回true
+     */
+    bool setClientTier(const std::string& client_id, const std::string& tier);
+
+    /**
+     * @brief 记录客户端上报的播放状态，供自适应控制使用
+     * @param client_id 客户端ID
+     * @param feedback 客户端反馈
+     * @return 客户端存在时返回true
+     */
+    bool onClientFeedback(const std::string& client_id, const ClientFeedback& feedback);
+
+    /**
+     * @brief 处理/ws/camera上的客户端命令
+     *
+     * 支持的命令（JSON）：
+     * {"action":"subscribe","camera_id":"...","tier":"half","codec":"h264"}、{"action":"set_tier","tier":"quarter"}、
+     * {"action":"feedback","lag_ms":120,"buffered":1}、{"action":"unsubscribe"}、{"action":"get_tiers"}
+     * @param client_id 客户端ID
+     * @param message 命令内容
+     */
+    void handleClientMessage(const std::string& client_id, const std::string& message);
+
+    /**
+     * @brief 获取分辨率阶梯
+     */
+    const StreamLadder& getLadder() const { return ladder_; }
 
     /**
      * @brief 移除摄像头客户端
@@ -107,19 +183,16 @@ public:
     double getCurrentFPS() const;
 
     /**
-     * @brief 广播帧数据到所有客户端
-     * @param camera_id 摄像头ID
-     * @param frame_data JPEG帧数据
+     * @brief 获取各摄像头客户端的发送统计
+     * @return 发送统计列表
      */
-    void broadcastFrame(const std::string& camera_id, const std::vector<uint8_t>& frame_data);
+    std::vector<ClientSendStats> getClientSendStats() const;
 
     /**
-     * @brief 发送帧数据到指定客户端
-     * @param client_id 客户端ID
-     * @param frame_data JPEG帧数据
-     * @return 是否发送成功
+     * @brief 获取各摄像头瓦片增量编码的统计，用于和整帧MJPEG比较带宽和CPU开销
+     * @return 摄像头ID -> 统计
      */
-    bool sendFrameToClient(const std::string& client_id, const std::vector<uint8_t>& frame_data);
+    std::unordered_map<std::string, video::TileDeltaStats> getTileStats() const;
 
 private:
     // 私有构造函数，单例模式
@@ -136,6 +209,65 @@ private:
      */
     void handleFrame(const camera::Frame& frame);
 
+    /**
+     * @brief 将摄像头帧编码为H.264并发送给H.264客户端，在独立的订阅线程中运行
+     * @param frame 摄像头帧
+     */
+    void handleH264Frame(const camera::Frame& frame);
+
+    /**
+     * @brief 计算变化瓦片并发送给瓦片客户端，在独立的订阅线程中运行
+     * @param frame 摄像头帧
+     */
+    void handleTileFrame(const camera::Frame& frame);
+
+    /**
+     * @brief 有H.264或瓦片客户端时订阅对应的帧，没有时取消订阅并释放编码器，不能在持有clients_mutex_时调用
+     *
+     * 最后一个H.264客户端离开后，在保持期（LatestFrameStore的grace_period_ms）内保留订阅和编码器。
+     */
+    void updateEncoderSubscriptions();
+
+    /**
+     * @brief 把客户端当前档位保存的最新一帧立即发给它，只用于JPEG流
+     */
+    void sendLatestFrame(const std::string& client_id);
+
+    /**
+     * @brief 向客户端回复命令结果
+     */
+    void reply(const std::string& client_id, const std::string& message);
+
+    /**
+     * @brief 发送媒体消息，订阅了帧信封的客户端在负载前加信封，负载不复制
+     * @param client_ids 客户端ID列表
+     * @param payload 负载
+     * @param envelope 信封，发送时间和负载长度在这里填写
+     * @param latest_only 是否只保留最新一帧
+     */
+    void sendMedia(const std::vector<std::string>& client_ids, std::shared_ptr<const std::vector<uint8_t>> payload,
+                   StreamEnvelope envelope, bool latest_only);
+
+    /**
+     * @brief 发送JPEG帧，信封序号按客户端递增
+     *
+     * JPEG客户端按各自的目标帧率抽帧，序号只在真正投递给该客户端时递增，
+     * 客户端看到的序号跳变只来自写队列中被新帧替换的帧。信封按客户端构造，JPEG数据仍共享。
+     * @param client_ids 客户端ID列表
+     * @param jpeg JPEG数据
+     * @param envelope 信封，序号、发送时间和负载长度在这里填写
+     * @param cached 是否为缓存重发，为true时不递增序号
+     */
+    void sendJpeg(const std::vector<std::string>& client_ids, std::shared_ptr<const std::vector<uint8_t>> jpeg,
+                  StreamEnvelope envelope, bool cached);
+
+    /**
+     * @brief 取H.264或瓦片流的下一个信封序号，同一摄像头同一编码的所有客户端共用
+     * @param camera_id 摄像头ID
+     * @param codec 流编码
+     */
+    uint32_t nextSequence(const std::string& camera_id, const std::string& codec);
+
     /**
      * @brief 编码帧为JPEG
      * @param frame 原始帧
@@ -156,6 +288,8 @@ private:
 
     // 配置
     WebSocketCameraStreamerConfig config_;
+    // 分辨率阶梯
+    StreamLadder ladder_;
     // 是否已初始化
     bool is_initialized_;
     // 是否正在运行
@@ -168,14 +302,50 @@ private:
     std::unordered_map<std::string, std::shared_ptr<WebSocketCameraClient>> clients_;
     std::unordered_map<std::string, std::unordered_set<std::string>> camera_clients_;
     
-    // 帧率统计
+    // 下次从Crow取连接发送统计的时间，只在帧处理线程中访问
+    std::chrono::steady_clock::time_point next_rate_update_;
+
+    // H.264和瓦片流（摄像头、编码）的信封序号，JPEG序号在各客户端中
+    std::unordered_map<std::string, uint32_t> sequences_;
+    std::mutex sequences_mutex_;
+
+    // 帧率统计，frame_count_和last_fps_time_由fps_mutex_保护
     std::atomic<double> current_fps_;
     std::atomic<int> frame_count_;
     std::chrono::steady_clock::time_point last_fps_time_;
+    std::mutex fps_mutex_;
     
     // 清理线程
     std::thread cleanup_thread_;
     std::atomic<bool> cleanup_running_;
+
+    // 帧订阅ID
+    camera::FrameBus::SubscriptionId frame_subscription_;
+
+    // 每个摄像头的H.264编码器和GOP缓存，只在H.264订阅线程中访问
+    struct H264CameraStream {
+        video::H264StreamEncoder encoder;
+        video::H264GopCache gop;
+        int width = 0;
+        int height = 0;
+        std::chrono::steady_clock::time_point last_forced_keyframe;
+        std::chrono::steady_clock::time_point last_viewed;  // 最后有H.264客户端的时间
+    };
+    std::unordered_map<std::string, std::unique_ptr<H264CameraStream>> h264_streams_;
+    // 保护H.264和瓦片帧订阅的建立和取消
+    std::mutex encoder_subscription_mutex_;
+    // H.264帧订阅，有H.264客户端或在保持期内时才存在
+    camera::FrameBus::SubscriptionId h264_subscription_;
+    // 最后有H.264客户端的时间，受encoder_subscription_mutex_保护
+    std::chrono::steady_clock::time_point h264_last_client_time_;
+
+    // 每个摄像头的瓦片增量编码器，只在瓦片订阅线程中访问
+    std::unordered_map<std::string, std::unique_ptr<video::TileDeltaEncoder>> tile_streams_;
+    // 瓦片编码统计的副本，供统计接口读取
+    std::unordered_map<std::string, video::TileDeltaStats> tile_stats_;
+    mutable std::mutex tile_stats_mutex_;
+    // 瓦片帧订阅，有瓦片客户端时才存在
+    camera::FrameBus::SubscriptionId tile_subscription_;
 };
 
 } // namespace api
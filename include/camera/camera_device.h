@@ -6,6 +6,7 @@
 #include <memory>
 #include <functional>
 #include "camera/frame.h"
+#include "camera/frame_mailbox.h"
 
 namespace cam_server {
 namespace camera {
@@ -50,6 +51,22 @@ struct CameraDeviceInfo {
     std::vector<PixelFormat> supported_formats;
 };
 
+/**
+ * @brief 驱动缓冲区统计信息
+ */
+struct CaptureBufferStats {
+    // 当前分配的缓冲区数量
+    size_t buffer_count = 0;
+    // 根据测量建议的缓冲区数量，0表示样本不足
+    size_t recommended_count = 0;
+    // 驱动中缓冲区不足而复制帧数据的次数
+    uint64_t starved_frames = 0;
+    // 消费者持有缓冲区时间的p99（微秒）
+    uint64_t hold_p99_us = 0;
+    // 出队间隔相对驱动时间戳间隔的抖动p99（微秒）
+    uint64_t dequeue_jitter_p99_us = 0;
+};
+
 /**
  * @brief 摄像头设备接口类
  */
@@ -102,17 +119,57 @@ public:
 
     /**
      * @brief 获取一帧图像
+     *
+     * 返回的帧可能共享设备缓冲区，应尽快释放以便缓冲区归还给设备。
      * @param timeout_ms 超时时间（毫秒）
      * @return 帧数据
      */
     virtual Frame getFrame(int timeout_ms = 1000) = 0;
 
+    /**
+     * @brief 获取最新捕获的一帧，不消耗帧队列
+     *
+     * 已捕获过帧时立即返回；尚未捕获任何帧时最多等待timeout_ms。
+     * @param timeout_ms 超时时间（毫秒）
+     * @return 帧数据
+     */
+    virtual Frame getLatestFrame(int timeout_ms = 1000) = 0;
+
+    /**
+     * @brief 设置帧队列的深度和丢帧策略
+     * @param depth 队列深度
+     * @param policy 丢帧策略
+     */
+    virtual void setFrameQueueConfig(size_t depth, FrameDropPolicy policy) = 0;
+
+    /**
+     * @brief 获取帧队列统计信息
+     * @return 统计信息
+     */
+    virtual FrameMailboxStats getFrameQueueStats() const = 0;
+
+    /**
+     * @brief 获取驱动缓冲区统计信息
+     * @return 统计信息，不使用驱动缓冲区的设备返回空统计
+     */
+    virtual CaptureBufferStats getBufferStats() const { return CaptureBufferStats(); }
+
     /**
      * @brief 设置帧回调函数
+     *
+     * 回调中复制Frame对象只增加引用计数，不复制图像数据。
      * @param callback 帧回调函数
      */
     virtual void setFrameCallback(std::function<void(const Frame&)> callback) = 0;
 
+    /**
+     * @brief 设置摄像头ID，之后捕获的帧都带有该ID
+     *
+     * 应在开始捕获前调用。
+     * @param camera_id 摄像头ID
+     */
+    virtual void setCameraId(const std::string& camera_id) = 0;
+
     /**
      * @brief 获取设备信息
      * @return 设备信息
@@ -139,6 +196,28 @@ public:
  */
 std::shared_ptr<CameraDevice> createV4L2CameraDevice();
 
+/**
+ * @brief 创建合成测试图案的模拟摄像头设备
+ * @return 模拟摄像头设备指针
+ */
+std::shared_ptr<CameraDevice> createSyntheticCameraDevice();
+
+/**
+ * @brief 创建回放录制文件的模拟摄像头设备
+ * @return 模拟摄像头设备指针
+ */
+std::shared_ptr<CameraDevice> createReplayCameraDevice();
+
+/**
+ * @brief 根据设备路径创建对应类型的摄像头设备
+ *
+ * "synthetic"或"synthetic:<格式>"创建合成摄像头，"replay:<文件路径>"创建回放摄像头，
+ * 其他路径创建V4L2摄像头。
+ * @param device_path 设备路径
+ * @return 摄像头设备指针
+ */
+std::shared_ptr<CameraDevice> createCameraDevice(const std::string& device_path);
+
 /**
  * @brief 扫描系统中可用的摄像头设备
  * @return 可用摄像头设备列表
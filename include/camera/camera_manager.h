@@ -3,17 +3,22 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <functional>
 
 #include "camera_device.h"
+#include "camera/frame_bus.h"
+#include "camera/format_negotiator.h"
 
 namespace cam_server {
 namespace camera {
 
 /**
- * @brief 摄像头管理器类，负责管理摄像头设备
+ * @brief 摄像头管理器类，负责管理按摄像头ID索引的多个摄像头设备
+ *
+ * 所有V4L2设备由CaptureReactor的少量线程统一等待，帧带有摄像头ID后发布到同一条帧总线。
  */
 class CameraManager {
 public:
@@ -37,81 +42,217 @@ public:
     std::vector<CameraDeviceInfo> scanDevices();
 
     /**
-     * @brief 打开摄像头设备
+     * @brief 打开摄像头并以指定ID注册，可同时打开多个摄像头
+     *
+     * 如果该ID已有打开的摄像头，会先将其关闭。
+     * @param camera_id 摄像头ID
      * @param device_path 设备路径
      * @param width 图像宽度
      * @param height 图像高度
      * @param fps 帧率
+     * @return 是否成功打开
+     */
+    bool openCamera(const std::string& camera_id, const std::string& device_path,
+                    int width, int height, int fps);
+
+    /**
+     * @brief 关闭指定ID的摄像头
+     * @param camera_id 摄像头ID
+     * @return 是否成功关闭
+     */
+    bool closeCamera(const std::string& camera_id);
+
+    /**
+     * @brief 关闭所有摄像头
+     */
+    void closeAllCameras();
+
+    /**
+     * @brief 获取所有已打开摄像头的ID
+     * @return 摄像头ID列表
+     */
+    std::vector<std::string> getCameraIds() const;
+
+    /**
+     * @brief 获取指定ID的摄像头设备
+     * @param camera_id 摄像头ID
+     * @return 摄像头设备指针，不存在时返回nullptr
+     */
+    std::shared_ptr<CameraDevice> getDevice(const std::string& camera_id) const;
+
+    /**
+     * @brief 开始指定摄像头的捕获
+     * @param camera_id 摄像头ID
+     * @return 是否成功开始捕获
+     */
+    bool startCapture(const std::string& camera_id);
+
+    /**
+     * @brief 停止指定摄像头的捕获
+     * @param camera_id 摄像头ID
+     * @return 是否成功停止捕获
+     */
+    bool stopCapture(const std::string& camera_id);
+
+    /**
+     * @brief 检查指定摄像头是否正在捕获
+     * @param camera_id 摄像头ID
+     * @return 是否正在捕获
+     */
+    bool isCapturing(const std::string& camera_id) const;
+
+    /**
+     * @brief 从指定摄像头获取一帧图像
+     * @param camera_id 摄像头ID
+     * @param timeout_ms 超时时间（毫秒）
+     * @return 帧数据
+     */
+    Frame getFrame(const std::string& camera_id, int timeout_ms = 1000);
+
+    /**
+     * @brief 获取指定摄像头最新捕获的一帧
+     * @param camera_id 摄像头ID
+     * @param timeout_ms 尚未捕获任何帧时的最长等待时间（毫秒）
+     * @return 帧数据
+     */
+    Frame getLatestFrame(const std::string& camera_id, int timeout_ms = 1000);
+
+    /**
+     * @brief 获取指定摄像头帧队列的统计信息
+     * @param camera_id 摄像头ID
+     * @return 统计信息
+     */
+    FrameMailboxStats getFrameQueueStats(const std::string& camera_id) const;
+
+    /**
+     * @brief 获取默认摄像头ID
+     *
+     * 以下不带摄像头ID的接口都作用于默认摄像头。通过openDevice()打开的摄像头
+     * 以设备路径作为ID并成为默认摄像头。
+     * @return 默认摄像头ID，没有时返回空字符串
+     */
+    std::string getDefaultCameraId() const;
+
+    /**
+     * @brief 打开摄像头设备作为默认摄像头，替换之前的默认摄像头
+     * @param device_path 设备路径（同时作为摄像头ID）
+     * @param width 图像宽度
+     * @param height 图像高度
+     * @param fps 帧率
      * @return 是否成功打开设备
      */
     bool openDevice(const std::string& device_path, int width, int height, int fps);
 
     /**
-     * @brief 关闭当前打开的摄像头设备
+     * @brief 关闭默认摄像头
      * @return 是否成功关闭设备
      */
     bool closeDevice();
 
     /**
-     * @brief 检查摄像头是否已打开
+     * @brief 检查默认摄像头是否已打开
      * @return 摄像头是否已打开
      */
     bool isDeviceOpen() const;
 
     /**
-     * @brief 获取当前打开的摄像头设备
+     * @brief 获取默认摄像头设备
      * @return 摄像头设备指针
      */
     std::shared_ptr<CameraDevice> getCurrentDevice();
 
     /**
-     * @brief 设置帧回调函数
+     * @brief 订阅摄像头帧
+     *
+     * 每个订阅者拥有独立的有界队列和工作线程，回调不会在捕获线程中执行。
+     * 订阅在设备重新打开后仍然有效。options.camera_id为空时接收所有摄像头的帧，
+     * 可通过Frame::getCameraId()区分来源。
+     * @param name 订阅者名称
      * @param callback 帧回调函数
+     * @param options 队列深度、丢帧策略和摄像头过滤
+     * @return 订阅ID，失败时返回0
      */
-    void setFrameCallback(std::function<void(const Frame&)> callback);
+    FrameBus::SubscriptionId subscribeFrames(const std::string& name,
+                                             FrameBus::FrameCallback callback,
+                                             const FrameSubscriberOptions& options = FrameSubscriberOptions());
 
     /**
-     * @brief 开始捕获视频帧
+     * @brief 取消帧订阅
+     * @param id 订阅ID
+     * @return 是否成功取消
+     */
+    bool unsubscribeFrames(FrameBus::SubscriptionId id);
+
+    /**
+     * @brief 获取所有帧订阅者的统计信息
+     * @return 统计信息列表
+     */
+    std::vector<FrameSubscriberStats> getFrameSubscriberStats() const;
+
+    /**
+     * @brief 获取指定摄像头当前的格式协商结果
+     *
+     * 打开摄像头和订阅者变化时，根据订阅者需要的输入类型（FrameSubscriberOptions::consumer）
+     * 重新选择像素格式和分辨率。配置项camera.format为"auto"时自动选择，否则强制使用指定格式。
+     * 捕获中有要求固定格式的订阅者（FrameSubscriberOptions::fixed_format）时只记录方案
+     * （pending为true），下次开始捕获前再切换。
+     * @param camera_id 摄像头ID
+     * @return 协商结果，模拟摄像头或未协商时valid为false
+     */
+    FormatPlan getFormatPlan(const std::string& camera_id) const;
+
+    /**
+     * @brief 开始默认摄像头的捕获
      * @return 是否成功开始捕获
      */
     bool startCapture();
 
     /**
-     * @brief 停止捕获视频帧
+     * @brief 停止默认摄像头的捕获
      * @return 是否成功停止捕获
      */
     bool stopCapture();
 
     /**
-     * @brief 检查是否正在捕获
+     * @brief 检查默认摄像头是否正在捕获
      * @return 是否正在捕获
      */
     bool isCapturing() const;
 
     /**
-     * @brief 获取当前摄像头的参数
+     * @brief 获取默认摄像头的参数
      * @return 摄像头参数
      */
     CameraParams getCurrentParams() const;
 
     /**
-     * @brief 设置摄像头参数
+     * @brief 设置默认摄像头的参数
+     *
+     * 捕获中有要求固定格式的订阅者时，改变格式或分辨率的参数推迟到下次开始捕获前应用。
      * @param params 摄像头参数
-     * @return 是否成功设置参数
+     * @return 是否成功设置参数（推迟应用时返回true）
      */
     bool setParams(const CameraParams& params);
 
     /**
-     * @brief 获取一帧图像
+     * @brief 从默认摄像头获取一帧图像
      * @param timeout_ms 超时时间（毫秒）
      * @return 帧数据
      */
-    Frame getFrame(int timeout_ms = 1000) {
-        if (!current_device_ || !isCapturing()) {
-            return Frame();
-        }
-        return current_device_->getFrame(timeout_ms);
-    }
+    Frame getFrame(int timeout_ms = 1000);
+
+    /**
+     * @brief 获取默认摄像头最新捕获的一帧，用于快照等只关心最新画面的场景
+     * @param timeout_ms 尚未捕获任何帧时的最长等待时间（毫秒）
+     * @return 帧数据
+     */
+    Frame getLatestFrame(int timeout_ms = 1000);
+
+    /**
+     * @brief 获取默认摄像头帧队列的统计信息（包括丢帧计数）
+     * @return 统计信息
+     */
+    FrameMailboxStats getFrameQueueStats() const;
 
 private:
     // 私有构造函数，防止外部创建实例
@@ -120,14 +261,35 @@ private:
     CameraManager(const CameraManager&) = delete;
     CameraManager& operator=(const CameraManager&) = delete;
 
-    // 当前打开的摄像头设备
-    std::shared_ptr<CameraDevice> current_device_;
-    // 互斥锁，保护对摄像头设备的访问
+    // 查找摄像头，调用者须持有锁
+    std::shared_ptr<CameraDevice> findDeviceLocked(const std::string& camera_id) const;
+    // 按订阅者需求为摄像头选择格式；force为false时需求未变化或代价降低不明显则不切换
+    void negotiateFormat(const std::string& camera_id, bool force);
+    // 同negotiateFormat，调用者须持有control_mutex_
+    void negotiateFormatLocked(const std::string& camera_id, bool force);
+    // 摄像头是否有要求固定格式的订阅者
+    bool hasFixedFormatConsumer(const std::string& camera_id) const;
+    // 订阅者变化后重新协商所有摄像头的格式
+    void renegotiateFormats();
+
+    // 互斥锁，保护摄像头表和默认摄像头ID
     mutable std::mutex device_mutex_;
-    // 是否正在捕获
-    bool is_capturing_;
-    // 帧回调函数
-    std::function<void(const Frame&)> frame_callback_;
+    // 串行化对设备的格式协商、参数设置、开始/停止捕获和关闭，调用设备时不持有device_mutex_
+    std::mutex control_mutex_;
+    // 帧发布/订阅总线，需在摄像头之后析构
+    FrameBus frame_bus_;
+    // 已打开的摄像头，按摄像头ID索引
+    std::map<std::string, std::shared_ptr<CameraDevice>> cameras_;
+    // 默认摄像头ID
+    std::string default_camera_id_;
+    // 打开摄像头时请求的分辨率和帧率
+    std::map<std::string, CameraParams> requested_params_;
+    // 格式协商结果
+    std::map<std::string, FormatPlan> format_plans_;
+    // 上次协商时的订阅者需求，用于跳过无变化的重新协商
+    std::map<std::string, std::string> demand_signatures_;
+    // 捕获中推迟应用的参数，下次开始捕获前应用
+    std::map<std::string, CameraParams> pending_params_;
 };
 
 } // namespace camera
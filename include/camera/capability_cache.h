@@ -0,0 +1,137 @@
+#ifndef CAMERA_CAPABILITY_CACHE_H
+#define CAMERA_CAPABILITY_CACHE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "camera/frame.h"
+
+namespace cam_server {
+namespace camera {
+
+/**
+ * @brief 步进或连续分辨率范围，保持符号形式而不展开
+ */
+struct FrameSizeRange {
+    uint32_t min_width = 0;
+    uint32_t max_width = 0;
+    uint32_t step_width = 1;
+    uint32_t min_height = 0;
+    uint32_t max_height = 0;
+    uint32_t step_height = 1;
+
+    /**
+     * @brief 判断分辨率是否在范围内且与步长对齐
+     */
+    bool contains(uint32_t width, uint32_t height) const;
+};
+
+/**
+ * @brief 一个分辨率及其支持的帧率
+ */
+struct FrameSizeCapability {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<int> fps;  // 从高到低
+};
+
+/**
+ * @brief 一种像素格式的能力
+ */
+struct FormatCapability {
+    uint32_t fourcc = 0;
+    PixelFormat format = PixelFormat::UNKNOWN;
+    std::string name;
+    // 离散分辨率，或从范围中探测到的标准分辨率
+    std::vector<FrameSizeCapability> sizes;
+    // 驱动报告步进/连续分辨率时的范围
+    bool has_range = false;
+    FrameSizeRange range;
+};
+
+/**
+ * @brief 设备能力
+ */
+struct DeviceCapabilities {
+    std::string device_path;
+    std::string card;
+    std::string driver;
+    std::string bus_info;
+    std::vector<FormatCapability> formats;
+
+    /**
+     * @brief 判断是否支持指定格式和分辨率（包括范围内未探测的分辨率）
+     */
+    bool supports(uint32_t fourcc, uint32_t width, uint32_t height) const;
+};
+
+/**
+ * @brief 摄像头能力缓存
+ *
+ * 枚举有上限：步进/连续分辨率只探测标准分辨率，每种格式、分辨率和帧率的条目数都有上限。
+ * 结果按bus_info缓存。/dev下video设备节点的增删（热插拔）会使对应缓存失效，
+ * 事件在下一次查询时通过非阻塞inotify读取，不需要额外线程。
+ */
+class CapabilityCache {
+public:
+    /**
+     * @brief 获取CapabilityCache单例
+     * @return CapabilityCache单例的引用
+     */
+    static CapabilityCache& getInstance();
+
+    /**
+     * @brief 获取设备能力
+     * @param device_path 设备路径
+     * @param fd 已打开的设备文件描述符，为-1时自行打开
+     * @return 设备能力，不是视频捕获设备或无法打开时返回nullptr
+     */
+    std::shared_ptr<const DeviceCapabilities> get(const std::string& device_path, int fd = -1);
+
+    /**
+     * @brief 获取系统中所有视频捕获设备的能力
+     * @return 按设备路径排序的设备能力列表
+     */
+    std::vector<std::shared_ptr<const DeviceCapabilities>> scan();
+
+    /**
+     * @brief 使指定设备的缓存失效
+     * @param device_path 设备路径
+     */
+    void invalidate(const std::string& device_path);
+
+    /**
+     * @brief 清空缓存
+     */
+    void invalidateAll();
+
+private:
+    CapabilityCache();
+    ~CapabilityCache();
+    CapabilityCache(const CapabilityCache&) = delete;
+    CapabilityCache& operator=(const CapabilityCache&) = delete;
+
+    // 读取热插拔事件并使对应缓存失效，调用者须持有锁
+    void processHotplugEventsLocked();
+    // 使设备路径对应的缓存失效，调用者须持有锁
+    void invalidateLocked(const std::string& device_path);
+    // 枚举设备能力
+    static std::shared_ptr<DeviceCapabilities> enumerate(int fd);
+
+    std::mutex mutex_;
+    int inotify_fd_;
+    // bus_info -> 设备能力
+    std::map<std::string, std::shared_ptr<const DeviceCapabilities>> by_bus_;
+    // 设备路径 -> bus_info，只在热插拔监视可用时使用
+    std::map<std::string, std::string> path_index_;
+};
+
+} // namespace camera
+} // namespace cam_server
+
+#endif // CAMERA_CAPABILITY_CACHE_H
@@ -0,0 +1,119 @@
+#ifndef CAMERA_CAPTURE_REACTOR_H
+#define CAMERA_CAPTURE_REACTOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cam_server {
+namespace camera {
+
+/**
+ * @brief 捕获线程调度参数
+ */
+struct CaptureThreadScheduling {
+    bool realtime = false;   // 使用SCHED_FIFO，需要CAP_SYS_NICE或足够的RLIMIT_RTPRIO
+    int priority = 10;       // SCHED_FIFO优先级（1-99）
+    int nice = 0;            // 非实时调度或实时调度失败时的nice值（-20到19）
+    std::vector<int> cpus;   // CPU亲和性，为空时不限制
+};
+
+/**
+ * @brief 基于epoll的捕获反应器
+ *
+ * 由一个（或少量固定数量的）线程通过epoll服务所有摄像头文件描述符，
+ * 线程数和唤醒次数不再随摄像头数量增长。每个文件描述符固定分配给注册数最少的线程，
+ * 因此同一设备的处理函数总是在同一线程中串行执行。
+ */
+class CaptureReactor {
+public:
+    /**
+     * @brief 可读事件处理函数
+     * @return false表示出现不可恢复的错误，反应器将自动注销该文件描述符
+     */
+    using ReadyHandler = std::function<bool()>;
+    using RegistrationId = uint64_t;
+
+    /**
+     * @brief 获取CaptureReactor单例
+     * @return CaptureReactor单例的引用
+     */
+    static CaptureReactor& getInstance();
+
+    /**
+     * @brief 设置反应器线程数，只在线程启动前生效
+     * @param count 线程数（至少为1）
+     */
+    void setThreadCount(size_t count);
+
+    /**
+     * @brief 获取反应器线程数
+     * @return 线程数
+     */
+    size_t getThreadCount() const;
+
+    /**
+     * @brief 设置反应器线程的调度策略和CPU亲和性，只在线程启动前生效
+     *
+     * 在big.LITTLE等异构处理器上，可将捕获线程固定到大核，避免负载高时在小核上丢帧。
+     * @param scheduling 调度参数
+     */
+    void setScheduling(const CaptureThreadScheduling& scheduling);
+
+    /**
+     * @brief 解析CPU列表
+     * @param list 如"4-7"或"0,2,4-5"
+     * @return CPU编号列表，格式错误的部分被忽略
+     */
+    static std::vector<int> parseCpuList(const std::string& list);
+
+    /**
+     * @brief 注册文件描述符，可读时在反应器线程中调用处理函数
+     * @param fd 文件描述符（应为非阻塞模式）
+     * @param name 名称（用于日志）
+     * @param handler 处理函数
+     * @return 注册ID，失败时返回0
+     */
+    RegistrationId add(int fd, const std::string& name, ReadyHandler handler);
+
+    /**
+     * @brief 注销文件描述符
+     *
+     * 返回后保证处理函数不会再被调用；在其他线程中调用时会等待正在执行的处理函数结束。
+     * @param id 注册ID
+     * @return 是否找到该注册
+     */
+    bool remove(RegistrationId id);
+
+    /**
+     * @brief 停止所有反应器线程
+     */
+    void shutdown();
+
+private:
+    CaptureReactor();
+    ~CaptureReactor();
+    CaptureReactor(const CaptureReactor&) = delete;
+    CaptureReactor& operator=(const CaptureReactor&) = delete;
+
+    struct Loop;
+    struct Registration;
+
+    // 启动反应器线程，调用者须持有锁
+    bool startLocked();
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Loop>> loops_;
+    size_t thread_count_;
+    CaptureThreadScheduling scheduling_;
+    std::atomic<RegistrationId> next_id_;
+};
+
+} // namespace camera
+} // namespace cam_server
+
+#endif // CAMERA_CAPTURE_REACTOR_H
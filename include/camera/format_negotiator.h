@@ -0,0 +1,110 @@
+#ifndef CAMERA_FORMAT_NEGOTIATOR_H
+#define CAMERA_FORMAT_NEGOTIATOR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "camera/capability_cache.h"
+#include "camera/frame_bus.h"
+
+namespace cam_server {
+namespace camera {
+
+/**
+ * @brief 一个订阅者从摄像头格式到其所需输入的转换路径
+ */
+struct FormatRoute {
+    std::string consumer;
+    FrameConsumerKind kind = FrameConsumerKind::ANY;
+    const char* conversion = "passthrough";  // passthrough/convert/decode/encode
+};
+
+/**
+ * @brief 格式协商结果
+ */
+struct FormatPlan {
+    bool valid = false;
+    uint32_t fourcc = 0;
+    PixelFormat format = PixelFormat::UNKNOWN;
+    int width = 0;
+    int height = 0;
+    int fps = 0;
+    double cost = 0.0;  // 每秒转换代价（百万像素 × 相对单价）
+    std::vector<FormatRoute> routes;
+    bool pending = false;  // 已选定但尚未应用到设备
+};
+
+/**
+ * @brief 摄像头格式协商
+ *
+ * 根据订阅者需要的输入类型，为设备选择总转换代价最低的V4L2像素格式和分辨率。
+ * 代价按每像素相对单价估算：MJPEG直通给JPEG消费者为0，原始格式编码为JPEG、
+ * MJPEG解码、色彩空间转换依次计价；分辨率与请求不一致时计缩放代价，
+ * 达不到请求帧率时按缺口计较高的惩罚，因此高分辨率下带宽受限的原始格式会输给MJPEG。
+ */
+class FormatNegotiator {
+public:
+    /**
+     * @brief 选择代价最低的格式和分辨率
+     * @param capabilities 设备能力
+     * @param width 请求的宽度
+     * @param height 请求的高度
+     * @param fps 请求的帧率
+     * @param demands 该摄像头的订阅者需求
+     * @param forced 强制使用的格式，UNKNOWN表示自动选择
+     * @return 协商结果，设备没有可用格式时valid为false
+     */
+    static FormatPlan negotiate(const DeviceCapabilities& capabilities, int width, int height, int fps,
+                                const std::vector<FrameConsumerDemand>& demands,
+                                PixelFormat forced = PixelFormat::UNKNOWN);
+
+    /**
+     * @brief 计算使用指定格式时的方案
+     * @param capabilities 设备能力
+     * @param format 像素格式
+     * @param width 请求的宽度
+     * @param height 请求的高度
+     * @param fps 请求的帧率
+     * @param demands 该摄像头的订阅者需求
+     * @return 方案，设备不支持该格式时valid为false
+     */
+    static FormatPlan evaluate(const DeviceCapabilities& capabilities, PixelFormat format,
+                               int width, int height, int fps,
+                               const std::vector<FrameConsumerDemand>& demands);
+
+    /**
+     * @brief 获取从摄像头格式转换到订阅者输入的每像素相对代价
+     * @param source 摄像头格式
+     * @param kind 订阅者需要的输入类型
+     * @return 相对代价，格式无法处理时返回负数
+     */
+    static double conversionCost(PixelFormat source, FrameConsumerKind kind);
+
+    /**
+     * @brief 获取转换路径名称
+     * @param source 摄像头格式
+     * @param kind 订阅者需要的输入类型
+     * @return passthrough/convert/decode/encode
+     */
+    static const char* conversionName(PixelFormat source, FrameConsumerKind kind);
+
+    /**
+     * @brief 解析配置项camera.format
+     * @param setting 配置值，如"auto"、"MJPG"、"YUYV"、"NV12"、"YU12"
+     * @return 像素格式，"auto"或无法识别时返回UNKNOWN
+     */
+    static PixelFormat parseFormatSetting(const std::string& setting);
+
+    /**
+     * @brief 获取订阅者输入类型名称
+     * @param kind 输入类型
+     * @return 名称
+     */
+    static const char* consumerKindName(FrameConsumerKind kind);
+};
+
+} // namespace camera
+} // namespace cam_server
+
+#endif // CAMERA_FORMAT_NEGOTIATOR_H
@@ -1,8 +1,12 @@
 #ifndef CAMERA_FRAME_H
 #define CAMERA_FRAME_H
 
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace cam_server {
@@ -34,8 +38,76 @@ struct FrameMetadata {
     uint32_t gain;          // 增益
 };
 
+/**
+ * @brief 帧的流水线轨迹记录
+ *
+ * 记录帧从驱动到发送各阶段的时间点（CLOCK_MONOTONIC，微秒，0表示未经过该阶段）。
+ * 各阶段在自己的Frame副本上填写后续时间点，最终交给PipelineStats统计。
+ */
+struct FrameLineage {
+    uint32_t sequence = 0;          // 驱动帧序号（V4L2 buf.sequence）
+    uint64_t capture_time_us = 0;   // 驱动时间戳
+    uint64_t dequeue_time_us = 0;   // 出队时间
+    uint64_t deliver_time_us = 0;   // 交付给订阅者回调的时间
+    uint64_t encode_start_us = 0;   // 编码开始时间
+    uint64_t encode_end_us = 0;     // 编码结束时间
+    uint64_t send_time_us = 0;      // 发送完成时间
+
+    /**
+     * @brief 获取当前CLOCK_MONOTONIC时间
+     * @return 微秒
+     */
+    static uint64_t nowUs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+};
+
+/**
+ * @brief 外部帧缓冲区接口
+ *
+ * 用于让帧直接引用设备驱动提供的内存（例如V4L2的mmap缓冲区），
+ * 实现类在最后一个引用释放时负责归还缓冲区。
+ */
+class FrameBuffer {
+public:
+    virtual ~FrameBuffer() = default;
+
+    /**
+     * @brief 获取缓冲区数据
+     * @return 数据指针
+     */
+    virtual const uint8_t* data() const = 0;
+
+    /**
+     * @brief 获取有效数据大小
+     * @return 数据大小（字节）
+     */
+    virtual size_t size() const = 0;
+};
+
+/**
+ * @brief 持有数据的共享帧缓冲区
+ *
+ * 用于需要多次发布同一份不可变数据的场景（例如模拟摄像头的预生成帧），
+ * 复制帧时不会复制数据。
+ */
+class VectorFrameBuffer : public FrameBuffer {
+public:
+    explicit VectorFrameBuffer(std::vector<uint8_t> data) : data_(std::move(data)) {}
+
+    const uint8_t* data() const override { return data_.data(); }
+    size_t size() const override { return data_.size(); }
+
+private:
+    std::vector<uint8_t> data_;
+};
+
 /**
  * @brief 帧类，表示一帧图像数据
+ *
+ * 数据可以由帧自身持有（std::vector），也可以是对外部缓冲区的共享引用。
+ * 复制共享帧只增加引用计数，不复制图像数据。
  */
 class Frame {
 public:
@@ -53,6 +125,15 @@ public:
      */
     Frame(int width, int height, PixelFormat format, std::vector<uint8_t> data);
 
+    /**
+     * @brief 构造函数，引用外部缓冲区而不复制数据
+     * @param width 宽度
+     * @param height 高度
+     * @param format 像素格式
+     * @param buffer 外部缓冲区
+     */
+    Frame(int width, int height, PixelFormat format, std::shared_ptr<const FrameBuffer> buffer);
+
     /**
      * @brief 获取帧宽度
      * @return 帧宽度
@@ -72,16 +153,41 @@ public:
     PixelFormat getFormat() const { return format_; }
 
     /**
-     * @brief 获取图像数据
-     * @return 图像数据的常量引用
+     * @brief 获取图像数据指针
+     * @return 图像数据指针，无数据时为nullptr
+     */
+    const uint8_t* getDataPtr() const {
+        if (buffer_) {
+            return buffer_->data();
+        }
+        return data_.empty() ? nullptr : data_.data();
+    }
+
+    /**
+     * @brief 获取图像数据大小
+     * @return 图像数据大小（字节）
+     */
+    size_t getDataSize() const { return buffer_ ? buffer_->size() : data_.size(); }
+
+    /**
+     * @brief 判断是否没有图像数据
+     * @return 是否为空
+     */
+    bool isEmpty() const { return getDataSize() == 0; }
+
+    /**
+     * @brief 判断帧是否引用外部缓冲区
+     * @return 是否为共享缓冲区帧
      */
-    const std::vector<uint8_t>& getData() const { return data_; }
+    bool isShared() const { return buffer_ != nullptr; }
 
     /**
-     * @brief 获取图像数据
+     * @brief 获取可写的图像数据
+     *
+     * 如果帧引用外部缓冲区，会先复制数据并释放对外部缓冲区的引用。
      * @return 图像数据的引用
      */
-    std::vector<uint8_t>& getData() { return data_; }
+    std::vector<uint8_t>& getData();
 
     /**
      * @brief 获取元数据
@@ -119,18 +225,45 @@ public:
      */
     void setTimestamp(uint64_t timestamp) { metadata_.timestamp = timestamp; }
 
+    /**
+     * @brief 获取流水线轨迹记录
+     * @return 轨迹记录的常量引用
+     */
+    const FrameLineage& getLineage() const { return lineage_; }
+
+    /**
+     * @brief 设置流水线轨迹记录
+     * @param lineage 轨迹记录
+     */
+    void setLineage(const FrameLineage& lineage) { lineage_ = lineage; }
+
+    /**
+     * @brief 获取来源摄像头ID
+     * @return 摄像头ID
+     */
+    const std::string& getCameraId() const { return camera_id_; }
+
+    /**
+     * @brief 设置来源摄像头ID
+     * @param camera_id 摄像头ID
+     */
+    void setCameraId(const std::string& camera_id) { camera_id_ = camera_id; }
+
     /**
      * @brief 判断帧是否有效
      * @return 是否有效
      */
-    bool isValid() const { return !data_.empty() && width_ > 0 && height_ > 0; }
+    bool isValid() const { return !isEmpty() && width_ > 0 && height_ > 0; }
 
 private:
     int width_ = 0;                     // 帧宽度
     int height_ = 0;                    // 帧高度
     PixelFormat format_ = PixelFormat::UNKNOWN;  // 像素格式
     std::vector<uint8_t> data_;        // 图像数据
+    std::shared_ptr<const FrameBuffer> buffer_;  // 外部缓冲区引用
     FrameMetadata metadata_;           // 元数据
+    std::string camera_id_;            // 来源摄像头ID
+    FrameLineage lineage_;             // 流水线轨迹
 };
 
 } // namespace camera
@@ -0,0 +1,130 @@
+#ifndef CAMERA_FRAME_BUS_H
+#define CAMERA_FRAME_BUS_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "camera/frame.h"
+#include "camera/frame_mailbox.h"
+
+namespace cam_server {
+namespace camera {
+
+/**
+ * @brief 订阅者需要的输入类型，用于摄像头格式协商
+ */
+enum class FrameConsumerKind {
+    ANY,            // 不关心格式
+    JPEG,           // 需要JPEG数据（MJPEG流、WebSocket JPEG推送）
+    VIDEO_ENCODER,  // 送入视频编码器，需要YUV420P（H.264录制等）
+    RAW_PIXELS      // 需要未压缩像素（视觉分析等）
+};
+
+/**
+ * @brief 帧订阅选项
+ */
+struct FrameSubscriberOptions {
+    size_t queue_depth = 2;                                  // 订阅者队列深度
+    FrameDropPolicy drop_policy = FrameDropPolicy::DROP_OLDEST;  // 队列满时的丢帧策略
+    std::string camera_id;                                   // 只接收该摄像头的帧，为空时接收所有摄像头
+    FrameConsumerKind consumer = FrameConsumerKind::ANY;     // 需要的输入类型
+    bool fixed_format = false;                               // 订阅期间要求格式和分辨率不变（录制、H.264编码）
+};
+
+/**
+ * @brief 订阅者的格式需求
+ */
+struct FrameConsumerDemand {
+    std::string name;         // 订阅者名称
+    std::string camera_id;    // 摄像头过滤，为空时表示所有摄像头
+    FrameConsumerKind kind = FrameConsumerKind::ANY;
+    bool fixed_format = false;  // 捕获中不允许切换格式
+};
+
+/**
+ * @brief 帧订阅者统计信息
+ */
+struct FrameSubscriberStats {
+    uint64_t id = 0;                 // 订阅ID
+    std::string name;                // 订阅者名称
+    uint64_t delivered_frames = 0;   // 已交付给回调的帧数
+    FrameMailboxStats queue;         // 队列统计
+};
+
+/**
+ * @brief 帧发布/订阅总线
+ *
+ * 每个订阅者拥有独立的有界队列和工作线程。publish()只把帧放入各订阅者的队列，
+ * 不调用任何回调，因此慢速消费者（JPEG编码、磁盘写入等）不会阻塞捕获线程，
+ * 也不会影响其他消费者。
+ */
+class FrameBus {
+public:
+    using SubscriptionId = uint64_t;
+    using FrameCallback = std::function<void(const Frame&)>;
+
+    FrameBus();
+    ~FrameBus();
+
+    FrameBus(const FrameBus&) = delete;
+    FrameBus& operator=(const FrameBus&) = delete;
+
+    /**
+     * @brief 添加订阅者并启动其工作线程
+     * @param name 订阅者名称（用于日志和统计）
+     * @param callback 帧回调，在订阅者自己的工作线程中调用
+     * @param options 订阅选项
+     * @return 订阅ID，失败时返回0
+     */
+    SubscriptionId subscribe(const std::string& name, FrameCallback callback,
+                             const FrameSubscriberOptions& options = FrameSubscriberOptions());
+
+    /**
+     * @brief 取消订阅并停止其工作线程
+     * @param id 订阅ID
+     * @return 是否找到该订阅
+     */
+    bool unsubscribe(SubscriptionId id);
+
+    /**
+     * @brief 发布一帧到所有匹配该帧摄像头ID的订阅者，不阻塞
+     * @param frame 帧
+     */
+    void publish(const Frame& frame);
+
+    /**
+     * @brief 获取订阅者数量
+     * @return 订阅者数量
+     */
+    size_t getSubscriberCount() const;
+
+    /**
+     * @brief 获取所有订阅者的统计信息
+     * @return 统计信息列表
+     */
+    std::vector<FrameSubscriberStats> getStats() const;
+
+    /**
+     * @brief 获取所有订阅者的格式需求
+     * @return 格式需求列表
+     */
+    std::vector<FrameConsumerDemand> getConsumerDemands() const;
+
+private:
+    struct Subscriber;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<SubscriptionId, std::shared_ptr<Subscriber>> subscribers_;
+    std::atomic<SubscriptionId> next_id_;
+};
+
+} // namespace camera
+} // namespace cam_server
+
+#endif // CAMERA_FRAME_BUS_H
@@ -0,0 +1,121 @@
+#ifndef CAMERA_FRAME_MAILBOX_H
+#define CAMERA_FRAME_MAILBOX_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "camera/frame.h"
+
+namespace cam_server {
+namespace camera {
+
+/**
+ * @brief 帧邮箱满时的丢帧策略
+ */
+enum class FrameDropPolicy {
+    DROP_OLDEST,   // 丢弃最旧的帧，按先进先出顺序取帧
+    KEEP_LATEST    // 每个摄像头只保留最新的帧，入队时丢弃同一摄像头积压的帧
+};
+
+/**
+ * @brief 帧邮箱统计信息
+ */
+struct FrameMailboxStats {
+    uint64_t pushed_frames = 0;   // 放入的帧总数
+    uint64_t dropped_frames = 0;  // 未被取走即丢弃的帧数
+    size_t depth = 0;             // 当前积压的帧数
+    size_t capacity = 0;          // 容量
+};
+
+/**
+ * @brief 有界帧邮箱
+ *
+ * 替代无界的帧队列：容量固定，满时按策略丢帧，同时保留最新一帧用于快照。
+ * 帧为共享缓冲区时，邮箱中的帧会占用驱动缓冲区，因此容量应保持较小。
+ */
+class FrameMailbox {
+public:
+    /**
+     * @brief 构造函数
+     * @param capacity 容量（至少为1）
+     * @param policy 丢帧策略
+     * @param retain_latest 是否保留最新一帧供peekLatest()使用，只用pop()取帧时应关闭，
+     *                      避免邮箱额外持有共享缓冲区
+     */
+    explicit FrameMailbox(size_t capacity = 2, FrameDropPolicy policy = FrameDropPolicy::DROP_OLDEST,
+                          bool retain_latest = true);
+
+    /**
+     * @brief 修改容量和丢帧策略，超出新容量的帧会被丢弃
+     * @param capacity 容量（至少为1）
+     * @param policy 丢帧策略
+     */
+    void configure(size_t capacity, FrameDropPolicy policy);
+
+    /**
+     * @brief 放入一帧
+     * @param frame 帧
+     */
+    void push(Frame frame);
+
+    /**
+     * @brief 取出一帧，按策略返回最旧或最新的帧
+     * @param frame 输出帧
+     * @param timeout_ms 超时时间（毫秒）
+     * @return 是否取到帧
+     */
+    bool pop(Frame& frame, int timeout_ms);
+
+    /**
+     * @brief 获取最新一帧，不从邮箱中移除
+     *
+     * 已有帧时立即返回；尚未收到任何帧或最新帧已被pop()取走时最多等待timeout_ms。
+     * 构造时关闭retain_latest的邮箱总是等待到超时。
+     * @param frame 输出帧
+     * @param timeout_ms 超时时间（毫秒）
+     * @return 是否取到帧
+     */
+    bool peekLatest(Frame& frame, int timeout_ms);
+
+    /**
+     * @brief 清空邮箱（包括保留的最新帧）
+     */
+    void clear();
+
+    /**
+     * @brief 获取统计信息
+     * @return 统计信息
+     */
+    FrameMailboxStats getStats() const;
+
+private:
+    // 丢弃超出容量的帧，调用者须持有锁
+    void trimLocked();
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Frame> frames_;
+    Frame latest_;
+    bool has_latest_;
+    bool retain_latest_;
+    size_t capacity_;
+    FrameDropPolicy policy_;
+    uint64_t pushed_frames_;
+    uint64_t dropped_frames_;
+};
+
+/**
+ * @brief 将字符串解析为丢帧策略
+ * @param name 策略名称（"drop_oldest" 或 "keep_latest"）
+ * @return 丢帧策略，无法识别时返回DROP_OLDEST
+ */
+FrameDropPolicy parseFrameDropPolicy(const std::string& name);
+
+} // namespace camera
+} // namespace cam_server
+
+#endif // CAMERA_FRAME_MAILBOX_H
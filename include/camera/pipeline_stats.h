@@ -0,0 +1,149 @@
+#ifndef CAMERA_PIPELINE_STATS_H
+#define CAMERA_PIPELINE_STATS_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "camera/frame.h"
+
+namespace cam_server {
+namespace camera {
+
+/**
+ * @brief 对数分桶的延迟直方图（HdrHistogram风格）
+ *
+ * 每个2的幂区间分为16个子桶，相对误差约6%，覆盖全部uint64范围。
+ * 记录只做原子加法，可在任意线程中无锁调用。
+ */
+class LatencyHistogram {
+public:
+    /**
+     * @brief 直方图快照
+     */
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t min = 0;
+        uint64_t max = 0;
+        double mean = 0.0;
+        uint64_t p50 = 0;
+        uint64_t p90 = 0;
+        uint64_t p99 = 0;
+        uint64_t p999 = 0;
+    };
+
+    LatencyHistogram();
+
+    /**
+     * @brief 记录一个值
+     * @param value 延迟（微秒）
+     */
+    void record(uint64_t value);
+
+    /**
+     * @brief 获取快照
+     * @return 计数、极值、均值和分位数
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * @brief 清空直方图
+     */
+    void reset();
+
+private:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr size_t kSubBuckets = size_t(1) << kSubBucketBits;
+    static constexpr size_t kBucketCount = kSubBuckets + (64 - kSubBucketBits) * kSubBuckets;
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);
+
+    std::array<std::atomic<uint64_t>, kBucketCount> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+};
+
+/**
+ * @brief 流水线阶段
+ */
+enum class PipelineStage {
+    DRIVER_TO_DEQUEUE,   // 驱动时间戳到出队
+    DEQUEUE_TO_DELIVER,  // 出队到订阅者回调（帧总线排队）
+    ENCODE,              // 编码耗时
+    ENCODE_TO_SEND,      // 编码结束到发送完成
+    CAPTURE_TO_WIRE,     // 驱动时间戳（或出队）到发送完成
+    COUNT
+};
+
+/**
+ * @brief 获取流水线阶段名称
+ * @param stage 阶段
+ * @return 名称
+ */
+const char* pipelineStageName(PipelineStage stage);
+
+/**
+ * @brief 流水线统计，汇总各阶段延迟直方图和驱动丢帧
+ *
+ * 队列溢出（流水线丢帧）由各FrameMailbox自行计数，通过帧总线和设备的队列统计获取。
+ */
+class PipelineStats {
+public:
+    /**
+     * @brief 获取PipelineStats单例
+     * @return PipelineStats单例的引用
+     */
+    static PipelineStats& getInstance();
+
+    /**
+     * @brief 按轨迹记录中已填写的时间点统计各阶段延迟
+     * @param lineage 轨迹记录
+     */
+    void recordLineage(const FrameLineage& lineage);
+
+    /**
+     * @brief 记录驱动丢帧（帧序号不连续）
+     * @param camera_id 摄像头ID
+     * @param count 丢帧数
+     */
+    void recordDriverDrops(const std::string& camera_id, uint64_t count);
+
+    /**
+     * @brief 获取阶段直方图快照
+     * @param stage 阶段
+     * @return 快照
+     */
+    LatencyHistogram::Snapshot getStageSnapshot(PipelineStage stage) const;
+
+    /**
+     * @brief 获取各摄像头的驱动丢帧数
+     * @return 摄像头ID到丢帧数的映射
+     */
+    std::map<std::string, uint64_t> getDriverDrops() const;
+
+    /**
+     * @brief 清空所有统计
+     */
+    void reset();
+
+private:
+    PipelineStats() = default;
+    PipelineStats(const PipelineStats&) = delete;
+    PipelineStats& operator=(const PipelineStats&) = delete;
+
+    std::array<LatencyHistogram, static_cast<size_t>(PipelineStage::COUNT)> stages_;
+    mutable std::mutex drops_mutex_;
+    std::map<std::string, uint64_t> driver_drops_;
+};
+
+} // namespace camera
+} // namespace cam_server
+
+#endif // CAMERA_PIPELINE_STATS_H
@@ -0,0 +1,62 @@
+#ifndef CAMERA_REPLAY_CAMERA_H
+#define CAMERA_REPLAY_CAMERA_H
+
+#include <memory>
+#include <vector>
+
+#include "camera/simulated_camera.h"
+
+namespace cam_server {
+namespace camera {
+
+class MappedReplayFile;
+
+/**
+ * @brief 回放录制文件的模拟摄像头
+ *
+ * 设备路径为"replay:<文件路径>"。支持以下文件：
+ * - .mjpeg/.mjpg：连续的JPEG帧，分辨率从第一帧的SOF中读取
+ * - .yuyv/.yuv/.nv12：定长原始帧，分辨率取打开时请求的宽高
+ *
+ * 如果存在同名的"<文件路径>.ts"，其中每行一个微秒时间戳，按原始时间间隔回放；
+ * 否则按请求的帧率回放。文件以只读方式映射，帧直接引用映射内存。
+ * 配置项camera.replay_loop（默认true）控制是否循环回放。
+ */
+class ReplayCamera : public SimulatedCamera {
+public:
+    ReplayCamera();
+    ~ReplayCamera() override;
+
+protected:
+    bool openSource(const std::string& source, CameraParams& params, CameraDeviceInfo& info) override;
+    void closeSource() override;
+    bool nextFrame(Frame& frame, uint64_t& interval_us) override;
+
+private:
+    struct FrameEntry {
+        size_t offset;
+        size_t size;
+    };
+
+    // 索引MJPEG文件中的JPEG帧，并读取第一帧的分辨率
+    bool indexMjpeg(int& width, int& height);
+    // 索引定长原始帧
+    bool indexRaw(size_t frame_size);
+    // 读取时间戳文件
+    void loadTimestamps(const std::string& path);
+
+    std::shared_ptr<MappedReplayFile> file_;
+    std::vector<FrameEntry> frames_;
+    std::vector<uint64_t> timestamps_;
+    size_t next_index_;
+    int width_;
+    int height_;
+    PixelFormat format_;
+    uint64_t default_interval_us_;
+    bool loop_;
+};
+
+} // namespace camera
+} // namespace cam_server
+
+#endif // CAMERA_REPLAY_CAMERA_H
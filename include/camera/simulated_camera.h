@@ -0,0 +1,98 @@
+#ifndef CAMERA_SIMULATED_CAMERA_H
+#define CAMERA_SIMULATED_CAMERA_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "camera/camera_device.h"
+
+namespace cam_server {
+namespace camera {
+
+/**
+ * @brief 不依赖硬件的模拟摄像头基类
+ *
+ * 用timerfd按帧间隔触发，并注册到CaptureReactor，因此帧和V4L2设备一样在反应器线程中产生，
+ * 经过相同的帧队列、回调和帧总线。子类只需提供帧源。
+ */
+class SimulatedCamera : public CameraDevice {
+public:
+    SimulatedCamera();
+    ~SimulatedCamera() override;
+
+    bool open(const std::string& device_path, int width, int height, int fps) override;
+    bool close() override;
+    bool isOpen() const override;
+    bool startCapture() override;
+    bool stopCapture() override;
+    bool isCapturing() const override;
+    Frame getFrame(int timeout_ms = 1000) override;
+    Frame getLatestFrame(int timeout_ms = 1000) override;
+    void setFrameQueueConfig(size_t depth, FrameDropPolicy policy) override;
+    FrameMailboxStats getFrameQueueStats() const override;
+    void setFrameCallback(std::function<void(const Frame&)> callback) override;
+    void setCameraId(const std::string& camera_id) override;
+    CameraDeviceInfo getDeviceInfo() const override;
+    CameraParams getParams() const override;
+
+    /**
+     * @brief 设置参数，分辨率、格式或帧率变化时重新打开帧源（捕获期间不允许）
+     * @param params 参数
+     * @return 是否成功设置参数
+     */
+    bool setParams(const CameraParams& params) override;
+
+protected:
+    /**
+     * @brief 打开帧源
+     * @param source 设备路径中前缀之后的部分
+     * @param params 请求的参数，子类可修改为实际使用的分辨率、格式和帧率
+     * @param info 设备信息，子类填写名称和支持的格式
+     * @return 是否成功
+     */
+    virtual bool openSource(const std::string& source, CameraParams& params, CameraDeviceInfo& info) = 0;
+
+    /**
+     * @brief 关闭帧源
+     */
+    virtual void closeSource() = 0;
+
+    /**
+     * @brief 产生下一帧
+     * @param frame 输出帧
+     * @param interval_us 输出到下一帧的间隔（微秒）
+     * @return false表示帧源已结束
+     */
+    virtual bool nextFrame(Frame& frame, uint64_t& interval_us) = 0;
+
+private:
+    // 定时器到期时由捕获反应器调用
+    bool onTimer();
+    // 在指定的CLOCK_MONOTONIC时间（微秒）触发定时器
+    bool armTimer(uint64_t deadline_us);
+
+    std::string device_path_;
+    std::string source_;
+    std::string camera_id_;
+    CameraDeviceInfo device_info_;
+    CameraParams current_params_;
+    bool is_open_;
+    std::atomic<bool> is_capturing_;
+    int timer_fd_;
+    uint64_t reactor_registration_;
+    // 下一帧的计划时间（CLOCK_MONOTONIC，微秒），同时作为帧时间戳
+    uint64_t next_deadline_us_;
+    uint32_t sequence_;
+    std::function<void(const Frame&)> frame_callback_;
+    FrameMailbox frame_mailbox_;
+    // 保护帧源，setParams可能与反应器线程并发
+    std::mutex source_mutex_;
+};
+
+} // namespace camera
+} // namespace cam_server
+
+#endif // CAMERA_SIMULATED_CAMERA_H
@@ -0,0 +1,41 @@
+#ifndef CAMERA_SYNTHETIC_CAMERA_H
+#define CAMERA_SYNTHETIC_CAMERA_H
+
+#include <memory>
+#include <vector>
+
+#include "camera/simulated_camera.h"
+
+namespace cam_server {
+namespace camera {
+
+/**
+ * @brief 合成测试图案的模拟摄像头
+ *
+ * 设备路径为"synthetic"或"synthetic:<格式>"，格式可为yuyv（默认）、nv12或mjpeg。
+ * 打开时预生成一组带移动方块的彩条帧并循环输出，输出时只增加引用计数，
+ * 因此测量的是后续流水线而不是图案生成本身。
+ */
+class SyntheticCamera : public SimulatedCamera {
+public:
+    SyntheticCamera();
+    ~SyntheticCamera() override;
+
+protected:
+    bool openSource(const std::string& source, CameraParams& params, CameraDeviceInfo& info) override;
+    void closeSource() override;
+    bool nextFrame(Frame& frame, uint64_t& interval_us) override;
+
+private:
+    std::vector<std::shared_ptr<const FrameBuffer>> frames_;
+    size_t next_index_;
+    int width_;
+    int height_;
+    PixelFormat format_;
+    uint64_t interval_us_;
+};
+
+} // namespace camera
+} // namespace cam_server
+
+#endif // CAMERA_SYNTHETIC_CAMERA_H
@@ -6,19 +6,28 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
-#include <condition_variable>
-#include <queue>
 #include <functional>
 #include <linux/videodev2.h>
 
 #include "camera_device.h"
 #include "camera/format_utils.h"
+#include "camera/pipeline_stats.h"
 
 namespace cam_server {
 namespace camera {
 
+class MmapBufferPool;
+struct DeviceCapabilities;
+
 /**
  * @brief V4L2摄像头设备实现类
+ *
+ * 捕获的帧直接引用mmap缓冲区，最后一个引用释放时缓冲区重新入队（VIDIOC_QBUF）。
+ * 当驱动中可用的缓冲区不足时，退化为复制数据并立即归还缓冲区。
+ *
+ * 缓冲区数量由配置项camera.buffer_count指定；为0时自动调整：捕获期间测量出队抖动和
+ * 消费者持有缓冲区的时间，下次开始捕获时按其p99重新分配，范围为
+ * camera.buffer_count_min到camera.buffer_count_max。
  */
 class V4L2Camera : public CameraDevice {
 public:
@@ -79,12 +88,38 @@ public:
      */
     Frame getFrame(int timeout_ms = 1000) override;
 
+    /**
+     * @brief 获取最新捕获的一帧，不消耗帧队列
+     * @param timeout_ms 超时时间（毫秒）
+     * @return 帧数据
+     */
+    Frame getLatestFrame(int timeout_ms = 1000) override;
+
+    /**
+     * @brief 设置帧队列的深度和丢帧策略
+     * @param depth 队列深度
+     * @param policy 丢帧策略
+     */
+    void setFrameQueueConfig(size_t depth, FrameDropPolicy policy) override;
+
+    /**
+     * @brief 获取帧队列统计信息
+     * @return 统计信息
+     */
+    FrameMailboxStats getFrameQueueStats() const override;
+
     /**
      * @brief 设置帧回调函数
      * @param callback 帧回调函数
      */
     void setFrameCallback(std::function<void(const Frame&)> callback) override;
 
+    /**
+     * @brief 设置摄像头ID
+     * @param camera_id 摄像头ID
+     */
+    void setCameraId(const std::string& camera_id) override;
+
     /**
      * @brief 获取设备信息
      * @return 设备信息
@@ -116,18 +151,31 @@ public:
      */
     PixelFormat detectPixelFormat() const;
 
+    /**
+     * @brief 获取驱动缓冲区统计信息
+     * @return 统计信息
+     */
+    CaptureBufferStats getBufferStats() const override;
+
 private:
     // 初始化设备
     bool initDevice();
-    // 初始化内存映射
+    // 初始化内存映射，请求buffer_count_个缓冲区
     bool initMmap();
     // 释放内存映射
     void freeMmap();
+    // 释放映射并归还驱动中的缓冲区，之后才能修改格式或数量；
+    // 驱动不支持孤立缓冲区而仍有帧引用缓冲区时不释放并返回false
+    bool releaseBuffers();
+    // 根据出队抖动和持有时间计算建议的缓冲区数量，样本不足时返回0
+    size_t recommendBufferCount() const;
     // 查询设备能力
     bool queryCapabilities();
 
     // 查询设备支持的格式和分辨率
     void queryCapabilities(int fd, CameraDeviceInfo& deviceInfo);
+    // 将缓存的设备能力转换为设备信息
+    static void fillDeviceInfo(const DeviceCapabilities& capabilities, CameraDeviceInfo& deviceInfo);
     // 设置视频格式
     bool setVideoFormat(int width, int height, uint32_t pixelformat);
     // 设置帧率
@@ -136,19 +184,25 @@ private:
     bool startStreaming();
     // 停止视频流
     bool stopStreaming();
-    // 捕获线程函数
-    void captureThreadFunc();
+    // 设备可读时由捕获反应器调用，取出所有就绪的缓冲区；返回false表示出现不可恢复的错误，此时已停止捕获
+    bool onCaptureReady();
+    // 在反应器线程中因不可恢复的错误停止捕获，返回false
+    bool stopOnCaptureError(const std::string& reason);
     // 将V4L2格式转换为PixelFormat
     PixelFormat v4l2FormatToPixelFormat(uint32_t v4l2_format) const;
     // 将PixelFormat转换为V4L2格式
     uint32_t pixelFormatToV4L2Format(PixelFormat format) const;
-    // 处理捕获的帧
-    void processFrame(const void* data, size_t size, const struct v4l2_buffer& buf);
+    // 处理捕获的帧，返回false表示缓冲区无法归还给驱动
+    bool processFrame(const struct v4l2_buffer& buf);
+    // 记录一次拉取，返回之前是否已有拉取方
+    bool markPullConsumer();
 
     // 设备文件描述符
     int fd_;
     // 设备路径
     std::string device_path_;
+    // 摄像头ID，写入每一帧
+    std::string camera_id_;
     // 设备信息
     CameraDeviceInfo device_info_;
     // 当前参数
@@ -157,25 +211,38 @@ private:
     bool is_open_;
     // 是否正在捕获
     std::atomic<bool> is_capturing_;
-    // 捕获线程
-    std::thread capture_thread_;
-    // 停止捕获标志
-    std::atomic<bool> stop_flag_;
+    // 捕获反应器注册ID
+    uint64_t reactor_registration_;
+    // 上一帧的驱动帧序号，-1表示尚未收到帧
+    int64_t last_sequence_;
+    // 配置的缓冲区数量，0表示自动调整
+    unsigned int configured_buffer_count_;
+    // 自动调整的上下限
+    unsigned int min_buffer_count_;
+    unsigned int max_buffer_count_;
+    // 下次分配时请求的缓冲区数量
+    unsigned int buffer_count_;
+    // 上一帧的出队时间和驱动时间戳（微秒）
+    uint64_t last_dequeue_us_;
+    uint64_t last_driver_timestamp_us_;
+    // 出队间隔相对驱动时间戳间隔的抖动
+    LatencyHistogram dequeue_jitter_us_;
+    // 消费者持有缓冲区的时间，由缓冲区池在归还时记录
+    std::shared_ptr<LatencyHistogram> hold_time_us_;
+    // 驱动中缓冲区不足而复制帧数据的次数
+    std::atomic<uint64_t> starved_frames_;
     // 帧回调函数
     std::function<void(const Frame&)> frame_callback_;
-    // 帧队列
-    std::queue<Frame> frame_queue_;
-    // 帧队列互斥锁
-    std::mutex frame_queue_mutex_;
-    // 帧队列条件变量
-    std::condition_variable frame_queue_cond_;
-    // 内存映射缓冲区
-    struct Buffer {
-        void* start;
-        size_t length;
-    };
-    // 缓冲区数组
-    std::vector<Buffer> buffers_;
+    // 有界帧队列，同时保留最新一帧，只在有拉取方时更新
+    FrameMailbox frame_mailbox_;
+    // 最近一次getFrame/getLatestFrame的时间（CLOCK_MONOTONIC微秒），0表示从未调用
+    std::atomic<uint64_t> last_pull_us_;
+    // 内存映射缓冲区池，由帧共享持有
+    std::shared_ptr<MmapBufferPool> buffer_pool_;
+    // 驱动是否报告V4L2_BUF_CAP_SUPPORTS_ORPHANED_BUFS，即释放时允许缓冲区仍被映射
+    bool orphaned_buffers_supported_;
+    // 连续的DQBUF I/O错误次数，只在反应器线程中访问
+    int consecutive_io_errors_;
 };
 
 } // namespace camera
@@ -191,6 +191,13 @@ public:
      */
     static std::string fromHex(const std::string& hex);
 
+    /**
+     * @brief 转义字符串，使其可以放入JSON字符串字面量
+     * @param str 原字符串
+     * @return 转义后的字符串，不含两侧引号
+     */
+    static std::string escapeJson(const std::string& str);
+
     /**
      * @brief 生成随机字符串
      * @param length 字符串长度
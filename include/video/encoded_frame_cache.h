@@ -0,0 +1,109 @@
+#ifndef ENCODED_FRAME_CACHE_H
+#define ENCODED_FRAME_CACHE_H
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "camera/frame.h"
+
+namespace cam_server {
+namespace video {
+
+/**
+ * @brief 编码后的不可变JPEG数据，由所有客户端共享
+ */
+using JpegBuffer = std::shared_ptr<const std::vector<uint8_t>>;
+
+/**
+ * @brief 编码帧缓存统计
+ */
+struct EncodedFrameCacheStats {
+    uint64_t hits = 0;          // 直接复用已编码结果的次数
+    uint64_t waits = 0;         // 等待其他线程正在进行的编码的次数（也算复用）
+    uint64_t encodes = 0;       // 实际编码次数
+    uint64_t passthrough = 0;   // MJPEG帧直接包装的次数
+    uint64_t decodes = 0;       // 为生成缩小的变体而解码MJPEG帧的次数
+    uint64_t failures = 0;      // 编码失败次数
+    uint64_t uncached = 0;      // 帧没有序号信息而无法缓存的次数
+};
+
+/**
+ * @brief 按摄像头缓存的编码帧
+ *
+ * MJPEG流、WebSocket流和拍照接口对同一摄像头帧各自编码，而且每个客户端还要再复制一次。
+ * 本缓存以（帧序号，输出尺寸，质量）为键保存不可变的JPEG数据，同一帧的每种变体最多编码一次，
+ * 之后所有使用者共享同一份数据。多个线程同时请求同一变体时，只有第一个线程编码，其余线程等待其结果。
+ * 每个摄像头只保留最近几帧，旧帧的数据在最后一个使用者释放后回收。
+ * MJPEG帧原尺寸直接转发；请求其他尺寸时先解码一次，同一帧的各尺寸共用解码结果。
+ */
+class EncodedFrameCache {
+public:
+    /**
+     * @brief 获取EncodedFrameCache单例
+     * @return EncodedFrameCache单例的引用
+     */
+    static EncodedFrameCache& getInstance();
+
+    /**
+     * @brief 获取帧的JPEG数据，必要时编码
+     * @param frame 摄像头帧
+     * @param quality JPEG质量（1-100），MJPEG帧按原尺寸转发时忽略此参数
+     * @param width 输出宽度，0表示原始尺寸
+     * @param height 输出高度，0表示原始尺寸
+     * @return JPEG数据，失败时返回空指针
+     */
+    JpegBuffer getJpeg(const camera::Frame& frame, int quality, int width = 0, int height = 0);
+
+    /**
+     * @brief 丢弃摄像头的缓存
+     * @param camera_id 摄像头ID
+     */
+    void clear(const std::string& camera_id);
+
+    /**
+     * @brief 获取统计信息
+     * @return 统计信息
+     */
+    EncodedFrameCacheStats getStats() const;
+
+private:
+    EncodedFrameCache() = default;
+    ~EncodedFrameCache() = default;
+    EncodedFrameCache(const EncodedFrameCache&) = delete;
+    EncodedFrameCache& operator=(const EncodedFrameCache&) = delete;
+
+    struct Variant {
+        int width;
+        int height;
+        int quality;
+        std::shared_future<JpegBuffer> jpeg;
+    };
+
+    struct CachedFrame {
+        uint32_t sequence = 0;
+        uint64_t capture_time_us = 0;
+        std::vector<Variant> variants;
+        std::shared_future<std::shared_ptr<const camera::Frame>> decoded;  // MJPEG帧的解码结果
+    };
+
+    // 实际编码，不经过缓存；decoded为MJPEG帧已有的解码结果
+    JpegBuffer encode(const camera::Frame& frame, int quality, int width, int height,
+                      std::shared_future<std::shared_ptr<const camera::Frame>> decoded = {});
+    // 将MJPEG帧解码为原始像素
+    std::shared_ptr<const camera::Frame> decode(const camera::Frame& frame);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::deque<CachedFrame>> cameras_;  // 最新的帧在后
+    EncodedFrameCacheStats stats_;
+};
+
+} // namespace video
+} // namespace cam_server
+
+#endif // ENCODED_FRAME_CACHE_H
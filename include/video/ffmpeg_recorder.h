@@ -2,13 +2,20 @@
 #define FFMPEG_RECORDER_H
 
 #include "video/i_video_recorder.h"
+#include "video/keyframe_index.h"
+#include "video/pre_roll_buffer.h"
 #include <mutex>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <thread>
+#include <vector>
 
 // 前向声明，避免包含FFmpeg头文件
 struct AVFormatContext;
 struct AVCodecContext;
+struct AVCodecParameters;
 struct AVStream;
 struct AVFrame;
 struct AVPacket;
@@ -19,6 +26,18 @@ namespace video {
 
 /**
  * @brief 基于FFmpeg的视频录制器实现
+ *
+ * 录制分为三级流水线，调用线程（摄像头回调或帧订阅线程）只负责入队：
+ * - processFrame：帧放入有界输入队列，满时按RecordingConfig::drop_policy丢帧，从不阻塞；
+ * - 编码线程：色彩转换（常驻SwsContext）和编码，AVFrame从池中复用；
+ * - 写文件线程：封装写入和分段，磁盘写入卡顿时包队列积压，满后丢弃到下一个关键帧并请求编码器输出关键帧。
+ * RecordingMode::STREAM_COPY时编码线程不解码也不编码，MJPEG帧直接打包，时间戳取自帧的采集时间。
+ * armPreRoll后流水线提前运行，写文件线程把包放入固定内存的预录缓冲；startRecording时由写文件线程
+ * 打开文件，从缓冲中最早的关键帧写起，然后接着写实时的包。
+ * 分段录制时分段线程提前打开下一个分段并写好文件头，写文件线程在关键帧处直接切换到新文件，
+ * 旧分段的文件尾和fsync也由分段线程完成，切换不阻塞写入。按时长分段时编码线程在分段点输出关键帧。
+ * 每个文件写入时记录关键帧的时间、文件偏移和系统时间到伴随的关键帧索引（见KeyframeIndex）。
+ * 各阶段的队列深度、丢弃数和延迟见RecordingStatus。
  */
 class FFmpegRecorder : public IVideoRecorder {
 public:
@@ -95,29 +114,89 @@ public:
      */
     RecordingConfig getConfig() const override;
 
+    /**
+     * @brief 开始预录
+     * @return 是否成功开始预录
+     */
+    bool armPreRoll() override;
+
 private:
+    // 排队等待编码的帧
+    struct QueuedFrame {
+        camera::Frame frame;
+        int64_t enqueue_us;
+    };
+    // 排队等待写入的包
+    struct QueuedPacket {
+        AVPacket* packet;
+        int64_t enqueue_us;
+    };
+    // 阶段统计的累计值，受status_mutex_保护
+    struct StageCounters {
+        uint64_t processed = 0;
+        uint64_t dropped = 0;
+        double total_latency_ms = 0.0;
+        double max_latency_ms = 0.0;
+    };
+
     // 初始化FFmpeg
     bool initFFmpeg();
     // 清理FFmpeg资源
     void cleanupFFmpeg();
-    // 创建输出格式上下文
-    bool createOutputFormatContext();
-    // 创建视频流
-    bool createVideoStream();
     // 打开编码器
     bool openEncoder();
-    // 写入文件头
-    bool writeHeader();
-    // 写入文件尾
-    bool writeTrailer();
-    // 编码并写入一帧
-    bool encodeAndWriteFrame(const camera::Frame& frame);
-    // 更新录制状态
-    void updateStatus();
-    // 检查是否需要分段
-    bool checkSegmentation();
-    // 创建新的分段文件
-    bool createNewSegment();
+    // 保存视频流参数，每个分段的视频流都从这里复制
+    bool initStreamParams();
+    // 打开输出文件，创建视频流并写入文件头
+    AVFormatContext* openOutput(const std::string& path);
+    // 关闭输出文件，不写文件尾
+    static void closeOutput(AVFormatContext*& context);
+    // 写入文件尾，关闭文件并fsync
+    bool finalizeOutput(AVFormatContext*& context);
+    // 停止录制并写入文件尾，调用方持有control_mutex_
+    bool finishRecording();
+    // 启动流水线线程，调用方已准备好编码器或直通参数
+    void startPipeline();
+    // 停止流水线线程，drain为true时先编码和写完已排队的数据
+    void stopPipeline(bool drain);
+    // 预录中开始录制：在写文件线程中打开文件并写入预录缓冲
+    bool openPreRollOutput();
+    // 编码线程
+    void encodeLoop();
+    // 写文件线程
+    void writeLoop();
+    // 转换并编码一帧，输出的包放入写入队列
+    bool encodeFrame(const QueuedFrame& queued);
+    // 取出编码器输出的包放入写入队列
+    bool drainEncoder();
+    // 直通模式：把一帧JPEG打包放入写入队列
+    bool copyFrame(const QueuedFrame& queued);
+    // 按帧的采集时间计算时间戳（time_base_den_时间基）
+    int64_t framePts(const QueuedFrame& queued);
+    // 包放入写入队列，队列满时丢弃到下一个关键帧
+    void queuePacket(AVPacket* packet);
+    // 从池中取一个可写的AVFrame
+    AVFrame* acquireFrame();
+    // 写入一个包，必要时在关键帧处切换分段
+    bool writePacket(AVPacket* packet);
+    // 更新阶段统计
+    void recordStage(StageCounters& counters, int64_t enqueue_us);
+    // 进入错误状态
+    void setError(const std::string& message);
+    // 通知状态回调
+    void notifyStatus();
+    // 检查写入pts时间戳的包之前是否需要分段
+    bool checkSegmentation(int64_t pts);
+    // 切换到下一个分段，旧分段交给分段线程收尾
+    bool rotateSegment();
+    // 请求分段线程提前打开下一个分段
+    void requestNextSegment();
+    // 分段线程
+    void segmentLoop();
+    // 停止分段线程，退出前收尾所有旧分段
+    void stopSegmentThread();
+    // 分段文件名，0为第一个文件
+    std::string segmentPath(int index) const;
     // 生成文件名
     std::string generateFileName();
 
@@ -125,28 +204,86 @@ private:
     RecordingConfig config_;
     // 当前录制状态
     RecordingStatus status_;
-    // 状态互斥锁
+    // 状态互斥锁，只保护status_和阶段统计，不在持有时做编码或IO
     mutable std::mutex status_mutex_;
+    // 串行化初始化、开始、停止和配置修改
+    std::mutex control_mutex_;
     // 状态回调函数
     std::function<void(const RecordingStatus&)> status_callback_;
     // 是否已初始化
     bool is_initialized_;
     // 录制开始时间
     int64_t start_time_;
-    // 上一帧时间戳
-    int64_t last_frame_timestamp_;
     // 分段索引
     int segment_index_;
 
-    // FFmpeg相关
+    // FFmpeg相关，编码器相关只在编码线程中访问，封装相关只在写文件线程中访问
     AVFormatContext* format_context_;
     AVCodecContext* codec_context_;
     AVStream* video_stream_;
-    AVFrame* frame_;
+    AVCodecParameters* stream_params_;
     AVPacket* packet_;
     SwsContext* sws_context_;
-    std::atomic<bool> is_recording_;
-    std::atomic<bool> is_paused_;
+    std::vector<AVFrame*> frame_pool_;
+    size_t next_pool_frame_;
+    camera::Frame decoded_;          // MJPEG输入解码后的帧，复用缓冲区
+    std::vector<uint8_t> jpeg_buffer_;  // 直通模式下非MJPEG输入编码后的JPEG，复用缓冲区
+    int time_base_den_;              // 包时间戳的时间基为1/time_base_den_：转码为帧率，直通为微秒
+
+    // 输入队列
+    std::deque<QueuedFrame> input_queue_;
+    std::vector<std::vector<uint8_t>> free_buffers_;  // 编码完成后回收的帧缓冲区，避免每帧分配
+    mutable std::mutex input_mutex_;
+    std::condition_variable input_cv_;
+    // 写入队列
+    std::deque<QueuedPacket> write_queue_;
+    mutable std::mutex write_mutex_;
+    std::condition_variable write_cv_;
+    bool dropping_to_keyframe_;      // 写入队列满后丢弃到下一个关键帧，受write_mutex_保护
+    bool start_requested_;           // 预录中请求写文件线程打开文件，受write_mutex_保护
+    int start_result_;               // 打开结果：0未完成，1成功，-1失败或写文件线程已退出，受write_mutex_保护
+    std::condition_variable start_cv_;
+
+    // 分段线程，以下成员受segment_mutex_保护
+    std::thread segment_thread_;
+    std::mutex segment_mutex_;
+    std::condition_variable segment_cv_;
+    bool segment_running_;
+    int prepare_index_;              // 请求提前打开的分段索引，-1表示没有请求
+    bool preparing_;                 // 正在打开
+    AVFormatContext* next_output_;   // 已写好文件头的下一个分段
+    int next_output_index_;
+    std::deque<AVFormatContext*> finalize_queue_;  // 等待写文件尾的旧分段
+
+    std::thread encode_thread_;
+    std::thread write_thread_;
+    std::atomic<bool> pipeline_running_;
+    std::atomic<bool> encoder_done_;        // 编码线程已退出并冲刷完编码器
+    std::atomic<bool> force_keyframe_;      // 请求编码器下一帧输出关键帧
+    std::atomic<bool> resume_pending_;      // 暂停后恢复，下一帧的时间戳接续上一帧
+    std::atomic<bool> pre_roll_armed_;      // 预录中，包写入pre_roll_而不是文件
+    std::atomic<int64_t> next_cut_pts_;     // 按时长分段的下一个分段点，编码线程在此输出关键帧
+    std::atomic<int64_t> base_wall_us_;     // 时间戳0对应的系统时间（微秒），由编码线程设置
+    StageCounters encode_counters_;
+    StageCounters write_counters_;
+
+    // 时间戳，只在编码线程中访问
+    int64_t base_capture_us_;
+    int64_t last_pts_;
+    int64_t last_capture_us_;
+    // 当前分段第一个包的时间戳（编码器时间基），写入时减去，每个分段都从0开始，只在写文件线程中访问
+    int64_t segment_start_pts_;
+    // 分段文件名的基础路径，即第一个文件
+    std::string segment_base_path_;
+    // 录制的第一个包的时间戳，用于计算录制时长，只在写文件线程中访问
+    int64_t pts_offset_;
+    // 预录缓冲，只在写文件线程中访问
+    PreRollBuffer pre_roll_;
+    // 当前文件的关键帧索引，只在写文件线程中访问
+    KeyframeIndexWriter index_writer_;
+    bool index_after_write_;
+    // 最近一个索引项的文件内时间（微秒），-1表示当前文件还没有索引项
+    int64_t last_index_us_;
 };
 
 } // namespace video
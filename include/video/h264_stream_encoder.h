@@ -0,0 +1,179 @@
+#ifndef H264_STREAM_ENCODER_H
+#define H264_STREAM_ENCODER_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "camera/frame.h"
+
+// 前向声明，避免包含FFmpeg头文件
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+namespace cam_server {
+namespace video {
+
+/**
+ * @brief 实时H.264流编码配置
+ */
+struct H264StreamConfig {
+    std::string encoder_name;   // 编码器名，为空时依次尝试libx264、h264_rkmpp、h264_v4l2m2m和默认H.264编码器
+    int fps = 30;               // 标称帧率，用于码率控制
+    int bitrate = 0;            // 码率（bps），0表示按分辨率估算
+    int gop = 60;               // 关键帧间隔（帧）
+};
+
+/**
+ * @brief 编码后的H.264访问单元
+ */
+struct H264Packet {
+    std::shared_ptr<const std::vector<uint8_t>> data;  // 不可变数据，由所有客户端共享
+    bool keyframe = false;                             // 是否为IDR帧，关键帧前带SPS/PPS
+    uint64_t timestamp_us = 0;                         // 源帧的采集时间
+    uint32_t sequence = 0;                             // 流内序号，由发送方填写
+};
+
+/**
+ * @brief 常驻的实时H.264编码器
+ *
+ * 每个摄像头一个，所有观看者共用同一路编码输出，新观看者加入时不重启编码器。
+ * 输出Annex-B格式的访问单元，每个关键帧前都带SPS/PPS，浏览器可直接交给WebCodecs解码。
+ * 不使用B帧和前瞻，编码一帧立即输出一帧。同一实例不可被多个线程同时使用。
+ */
+class H264StreamEncoder {
+public:
+    H264StreamEncoder();
+    ~H264StreamEncoder();
+
+    H264StreamEncoder(const H264StreamEncoder&) = delete;
+    H264StreamEncoder& operator=(const H264StreamEncoder&) = delete;
+
+    /**
+     * @brief 编码一帧，首帧或分辨率变化时自动(重新)打开编码器
+     * @param frame 输入帧（MJPEG/YUYV/NV12/YUV420P/RGB24/BGR24）
+     * @param force_keyframe 是否强制输出关键帧
+     * @param packets 输出的访问单元，追加到末尾
+     * @return 是否成功
+     */
+    bool encode(const camera::Frame& frame, bool force_keyframe, std::vector<H264Packet>& packets);
+
+    /**
+     * @brief 设置编码配置，下一次打开编码器时生效
+     * @param config 编码配置
+     */
+    void setConfig(const H264StreamConfig& config) { config_ = config; }
+
+    /**
+     * @brief 关闭编码器，释放所有资源
+     */
+    void close();
+
+    /**
+     * @brief 编码器是否已打开
+     */
+    bool isOpen() const { return codec_ctx_ != nullptr; }
+
+    /**
+     * @brief 输出宽度
+     */
+    int getWidth() const { return out_width_; }
+
+    /**
+     * @brief 输出高度
+     */
+    int getHeight() const { return out_height_; }
+
+    /**
+     * @brief 实际使用的编码器名称
+     */
+    const std::string& getEncoderName() const { return encoder_name_; }
+
+    /**
+     * @brief 当前流的RFC 6381编码字符串（如"avc1.42e01f"），供浏览器配置解码器
+     * @return 编码字符串，还没有输出过关键帧时为空
+     */
+    const std::string& getCodecString() const { return codec_string_; }
+
+    /**
+     * @brief 从Annex-B数据中的SPS生成RFC 6381编码字符串
+     * @param data Annex-B数据
+     * @param size 数据大小
+     * @return 编码字符串，找不到SPS时为空
+     */
+    static std::string codecStringFromAnnexB(const uint8_t* data, size_t size);
+
+private:
+    bool open(int width, int height, camera::PixelFormat format);
+
+    H264StreamConfig config_;
+    AVCodecContext* codec_ctx_;
+    SwsContext* sws_ctx_;
+    AVFrame* frame_;
+    AVPacket* packet_;
+    camera::Frame decoded_;          // MJPEG输入解码后的帧，复用缓冲区
+    std::vector<uint8_t> extradata_; // 编码器只在extradata中给出SPS/PPS时，补在关键帧前
+    std::string encoder_name_;
+    std::string codec_string_;
+    int src_width_;
+    int src_height_;
+    int src_format_;
+    int out_width_;
+    int out_height_;
+    int64_t pts_;
+};
+
+/**
+ * @brief 最近一个GOP的缓存
+ *
+ * 保存从最近一个关键帧开始的所有访问单元。新观看者先收到这些帧，
+ * 解码器可以立即从关键帧开始解码，不必等到下一个关键帧。
+ * 不是线程安全的，由编码线程使用。
+ */
+class H264GopCache {
+public:
+    /**
+     * @brief 构造函数
+     * @param max_packets 最多缓存的访问单元数，超过后清空，等待下一个关键帧
+     */
+    explicit H264GopCache(size_t max_packets = 300);
+
+    /**
+     * @brief 放入一个访问单元，关键帧会替换之前的缓存
+     * @param packet 访问单元
+     */
+    void push(const H264Packet& packet);
+
+    /**
+     * @brief 缓存是否以关键帧开头，即新观看者能否立即开始解码
+     */
+    bool isDecodable() const { return !packets_.empty() && packets_.front().keyframe; }
+
+    /**
+     * @brief 缓存的访问单元数
+     */
+    size_t size() const { return packets_.size(); }
+
+    /**
+     * @brief 缓存的所有访问单元，按解码顺序
+     */
+    const std::deque<H264Packet>& getPackets() const { return packets_; }
+
+    /**
+     * @brief 清空缓存
+     */
+    void clear() { packets_.clear(); }
+
+private:
+    size_t max_packets_;
+    std::deque<H264Packet> packets_;
+};
+
+} // namespace video
+} // namespace cam_server
+
+#endif // H264_STREAM_ENCODER_H
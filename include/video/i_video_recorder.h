@@ -83,6 +83,13 @@ public:
      * @return 录制配置
      */
     virtual RecordingConfig getConfig() const = 0;
+
+    /**
+     * @brief 开始预录：只编码不写文件，最近RecordingConfig::pre_roll_seconds秒的编码结果保存在内存中，
+     *        之后调用startRecording时先从其中最早的关键帧写起
+     * @return 是否成功开始预录，不支持预录的录制器返回false
+     */
+    virtual bool armPreRoll() { return false; }
 };
 
 // 创建FFmpeg录制器的工厂函数
@@ -6,6 +6,7 @@
 #include <memory>
 #include <functional>
 #include <chrono>
+#include <cstdint>
 
 namespace cam_server {
 namespace video {
@@ -139,6 +140,28 @@ public:
      * @return 清理的任务数量
      */
     virtual int cleanupCompletedTasks(int keepLastN = 0) = 0;
+
+    /**
+     * @brief 提取指定时间的一帧并编码为JPEG，有关键帧索引时从目标之前的关键帧开始解码
+     * @param input_path 录像文件
+     * @param seconds 文件内时间（秒）
+     * @param jpeg_data 输出JPEG数据
+     * @param quality JPEG质量（1-100）
+     * @return 是否成功
+     */
+    virtual bool extractFrameAt(const std::string& input_path, double seconds,
+                                std::vector<uint8_t>& jpeg_data, int quality = 90) = 0;
+
+    /**
+     * @brief 导出片段，从起点之前的关键帧开始复制压缩数据，不重新编码
+     * @param input_path 录像文件
+     * @param start_seconds 起点（秒）
+     * @param end_seconds 终点（秒）
+     * @param output_path 输出文件，容器格式按扩展名确定
+     * @return 是否成功
+     */
+    virtual bool exportClip(const std::string& input_path, double start_seconds, double end_seconds,
+                            const std::string& output_path) = 0;
 };
 
 // 创建FFmpeg分割器的工厂函数
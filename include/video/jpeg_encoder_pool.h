@@ -0,0 +1,228 @@
+#ifndef JPEG_ENCODER_POOL_H
+#define JPEG_ENCODER_POOL_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "camera/frame.h"
+
+// 前向声明，避免包含FFmpeg头文件
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+namespace cam_server {
+namespace video {
+
+/**
+ * @brief 常驻的JPEG编码器
+ *
+ * 打开后保持MJPEG编码器上下文、色彩空间转换上下文以及编码输入帧和输出包，
+ * 之后每帧只做一次色彩空间转换和一次编码。同一实例不可被多个线程同时使用。
+ */
+class JpegEncoder {
+public:
+    JpegEncoder();
+    ~JpegEncoder();
+
+    JpegEncoder(const JpegEncoder&) = delete;
+    JpegEncoder& operator=(const JpegEncoder&) = delete;
+
+    /**
+     * @brief 打开编码器
+     * @param width 宽度
+     * @param height 高度
+     * @param format 输入像素格式
+     * @param quality JPEG质量（1-100）
+     * @param out_width 输出宽度，0表示与输入相同
+     * @param out_height 输出高度，0表示与输入相同
+     * @return 是否成功
+     */
+    bool open(int width, int height, camera::PixelFormat format, int quality,
+              int out_width = 0, int out_height = 0);
+
+    /**
+     * @brief 编码一帧
+     * @param data 输入图像数据（紧凑排列）
+     * @param size 数据大小
+     * @param jpeg_data 输出JPEG数据
+     * @return 是否成功
+     */
+    bool encode(const uint8_t* data, size_t size, std::vector<uint8_t>& jpeg_data);
+
+    /**
+     * @brief 是否支持该输入格式
+     * @param format 像素格式
+     * @return 是否支持
+     */
+    static bool isSupported(camera::PixelFormat format);
+
+    /**
+     * @brief 将JPEG质量（1-100）换算为MJPEG编码器的量化参数（31-2）
+     * @param quality JPEG质量
+     * @return 量化参数
+     */
+    static int qualityToQscale(int quality);
+
+private:
+    void close();
+
+    AVCodecContext* codec_ctx_;
+    SwsContext* sws_ctx_;
+    AVFrame* frame_;
+    AVPacket* packet_;
+    int width_;
+    int height_;
+    int src_format_;
+    size_t src_size_;
+    int64_t pts_;
+};
+
+/**
+ * @brief 常驻的JPEG解码器
+ *
+ * 将MJPEG帧解码为YUV420P，用于从MJPEG摄像头生成低分辨率的流。
+ * 解码器上下文、输出帧和输入包在实例生命周期内复用。同一实例不可被多个线程同时使用。
+ */
+class JpegDecoder {
+public:
+    JpegDecoder();
+    ~JpegDecoder();
+
+    JpegDecoder(const JpegDecoder&) = delete;
+    JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+    /**
+     * @brief 解码一帧
+     * @param data JPEG数据
+     * @param size 数据大小
+     * @param frame 输出帧（YUV420P）
+     * @return 是否成功
+     */
+    bool decode(const uint8_t* data, size_t size, camera::Frame& frame);
+
+private:
+    bool open();
+    void close();
+
+    AVCodecContext* codec_ctx_;
+    SwsContext* sws_ctx_;
+    AVFrame* frame_;
+    AVPacket* packet_;
+    int sws_width_;
+    int sws_height_;
+    int sws_format_;
+};
+
+/**
+ * @brief JPEG编码器池统计
+ */
+struct JpegEncoderPoolStats {
+    uint64_t encodes = 0;            // 编码次数
+    uint64_t failures = 0;           // 编码失败次数
+    uint64_t encoders_created = 0;   // 新建编码器次数
+    uint64_t encoders_evicted = 0;   // 因空闲数超限而释放的编码器
+    uint64_t decodes = 0;            // MJPEG解码次数
+    size_t idle = 0;                 // 当前空闲编码器数
+    size_t busy = 0;                 // 当前正在编码的编码器数
+};
+
+/**
+ * @brief 共享的JPEG编码器池
+ *
+ * 按（输入尺寸，输出尺寸，输入格式，质量）缓存常驻编码器，替代每帧创建和释放编码器。
+ * 编码时从池中独占取出一个匹配的编码器，用完放回，池锁只在取放时持有，
+ * 因此多个编码线程可以并行编码；没有空闲的匹配编码器时新建一个。
+ * 空闲编码器按最近使用排序，超过上限时释放最久未用的。
+ */
+class JpegEncoderPool {
+public:
+    /**
+     * @brief 获取JpegEncoderPool单例
+     * @return JpegEncoderPool单例的引用
+     */
+    static JpegEncoderPool& getInstance();
+
+    /**
+     * @brief 将帧编码为JPEG
+     * @param frame 输入帧（YUYV/NV12/YUV420P/RGB24/BGR24）
+     * @param quality JPEG质量（1-100）
+     * @param jpeg_data 输出JPEG数据
+     * @param out_width 输出宽度，0表示与输入相同
+     * @param out_height 输出高度，0表示与输入相同
+     * @return 是否成功
+     */
+    bool encode(const camera::Frame& frame, int quality, std::vector<uint8_t>& jpeg_data,
+                int out_width = 0, int out_height = 0);
+
+    /**
+     * @brief 将MJPEG帧解码为YUV420P
+     * @param jpeg 输入MJPEG帧
+     * @param frame 输出帧，保留输入帧的摄像头ID和元数据
+     * @return 是否成功
+     */
+    bool decode(const camera::Frame& jpeg, camera::Frame& frame);
+
+    /**
+     * @brief 设置空闲编码器上限
+     * @param max_idle 上限
+     */
+    void setMaxIdle(size_t max_idle);
+
+    /**
+     * @brief 释放所有空闲编码器
+     */
+    void clear();
+
+    /**
+     * @brief 获取统计信息
+     * @return 统计信息
+     */
+    JpegEncoderPoolStats getStats() const;
+
+private:
+    JpegEncoderPool();
+    ~JpegEncoderPool() = default;
+    JpegEncoderPool(const JpegEncoderPool&) = delete;
+    JpegEncoderPool& operator=(const JpegEncoderPool&) = delete;
+
+    struct Key {
+        int width;
+        int height;
+        int out_width;
+        int out_height;
+        camera::PixelFormat format;
+        int quality;
+
+        bool operator==(const Key& other) const {
+            return width == other.width && height == other.height &&
+                   out_width == other.out_width && out_height == other.out_height &&
+                   format == other.format && quality == other.quality;
+        }
+    };
+
+    struct IdleEncoder {
+        Key key;
+        std::unique_ptr<JpegEncoder> encoder;
+    };
+
+    // 取出匹配的空闲编码器，没有时新建
+    std::unique_ptr<JpegEncoder> acquire(const Key& key);
+    // 放回编码器
+    void release(const Key& key, std::unique_ptr<JpegEncoder> encoder);
+
+    mutable std::mutex mutex_;
+    std::list<IdleEncoder> idle_;  // 最近使用的在前
+    std::vector<std::unique_ptr<JpegDecoder>> idle_decoders_;
+    size_t max_idle_;
+    JpegEncoderPoolStats stats_;
+};
+
+} // namespace video
+} // namespace cam_server
+
+#endif // JPEG_ENCODER_POOL_H
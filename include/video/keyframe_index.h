@@ -0,0 +1,128 @@
+#ifndef KEYFRAME_INDEX_H
+#define KEYFRAME_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace cam_server {
+namespace video {
+
+/**
+ * @brief 关键帧索引中的一项
+ */
+struct KeyframeEntry {
+    int64_t media_time_us = 0;   // 关键帧在文件中的时间（微秒），每个文件从0开始
+    int64_t byte_offset = 0;     // 写入关键帧前的文件偏移，分片MP4为分片开头
+    int64_t wall_time_us = 0;    // 采集时的系统时间（Unix时间，微秒）
+};
+
+/**
+ * @brief 录像文件的关键帧索引
+ *
+ * 录制时与录像文件一同写入的伴随文件（录像路径加.kfi），按时间或系统时间查找关键帧为二分查找，
+ * 取帧和导出片段时直接定位到目标之前的关键帧，不需要从头解析录像。所有整数大端：
+ *   0  4字节魔数"CSKI"
+ *   4  1字节版本（1）
+ *   5  1字节每项长度（24），新版本只在每项末尾追加字段
+ *   6  2字节保留
+ *   8  起为索引项：8字节文件内时间（微秒），8字节文件偏移，8字节系统时间（微秒）
+ * 相邻索引项至少间隔一秒，关键帧更密（如MJPEG每帧都是关键帧）时只记录其中一部分。
+ * 文件只追加，录制异常退出时末尾不完整的一项在加载时忽略。
+ */
+class KeyframeIndex {
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 8;
+    static constexpr size_t ENTRY_SIZE = 24;
+
+    /**
+     * @brief 录像文件对应的索引文件路径
+     */
+    static std::string sidecarPath(const std::string& video_path);
+
+    /**
+     * @brief 加载录像文件的索引
+     * @param video_path 录像文件路径
+     * @return 索引存在且格式正确时返回true
+     */
+    bool load(const std::string& video_path);
+
+    /**
+     * @brief 只读取索引的第一项和最后一项，用于在多个录像中挑选覆盖某个时间的录像
+     * @param video_path 录像文件路径
+     * @param first 输出第一项
+     * @param last 输出最后一个完整的项
+     * @return 索引存在、格式正确且至少有一项时返回true
+     */
+    static bool readRange(const std::string& video_path, KeyframeEntry& first, KeyframeEntry& last);
+
+    /**
+     * @brief 查找不晚于指定时间的最后一个关键帧
+     * @param media_time_us 文件内时间（微秒）
+     * @return 关键帧，时间早于第一个关键帧时返回第一个，索引为空时返回nullptr
+     */
+    const KeyframeEntry* findByMediaTime(int64_t media_time_us) const;
+
+    /**
+     * @brief 查找不晚于指定系统时间的最后一个关键帧
+     * @param wall_time_us 系统时间（Unix时间，微秒）
+     * @return 关键帧，不在录像时间范围内时返回nullptr
+     */
+    const KeyframeEntry* findByWallTime(int64_t wall_time_us) const;
+
+    /**
+     * @brief 把系统时间换算为文件内时间
+     * @param wall_time_us 系统时间（Unix时间，微秒）
+     * @param media_time_us 输出文件内时间（微秒）
+     * @return 不在录像时间范围内时返回false
+     */
+    bool wallToMediaTime(int64_t wall_time_us, int64_t& media_time_us) const;
+
+    const std::vector<KeyframeEntry>& entries() const { return entries_; }
+    bool empty() const { return entries_.empty(); }
+
+private:
+    std::vector<KeyframeEntry> entries_;
+    int64_t max_interval_us_ = 0;   // 相邻关键帧的最大间隔，用于判断最后一个GOP的结束时间
+};
+
+/**
+ * @brief 关键帧索引写入器，由录制器的写文件线程独占使用
+ */
+class KeyframeIndexWriter {
+public:
+    ~KeyframeIndexWriter();
+
+    /**
+     * @brief 为录像文件创建索引文件并写入文件头
+     * @param video_path 录像文件路径
+     * @return 是否成功
+     */
+    bool open(const std::string& video_path);
+
+    /**
+     * @brief 追加一个关键帧，立即写出，录制异常退出时不丢失已写入的项
+     */
+    bool append(const KeyframeEntry& entry);
+
+    /**
+     * @brief 关闭索引文件
+     */
+    void close();
+
+    bool isOpen() const { return file_.is_open(); }
+    size_t count() const { return count_; }
+
+private:
+    std::ofstream file_;
+    std::string path_;
+    size_t count_ = 0;
+};
+
+} // namespace video
+} // namespace cam_server
+
+#endif // KEYFRAME_INDEX_H
@@ -0,0 +1,103 @@
+#ifndef PRE_ROLL_BUFFER_H
+#define PRE_ROLL_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace cam_server {
+namespace video {
+
+/**
+ * @brief 预录缓冲统计
+ */
+struct PreRollStats {
+    size_t packets = 0;          // 缓冲中的包数
+    size_t bytes = 0;            // 缓冲中的数据量
+    size_t capacity_bytes = 0;   // 内存预算
+    int64_t duration_us = 0;     // 最早与最新包的时间差
+    uint64_t evicted = 0;        // 因超出预算或时长被淘汰的包数
+    uint64_t rejected = 0;       // 单包超过预算而无法缓冲的包数
+};
+
+/**
+ * @brief 编码包的预录环形缓冲
+ *
+ * 保存最近一段时间的编码包（H.264 GOP或MJPEG帧），按字节和时长双重限制。
+ * 数据区和包索引在configure时一次分配，之后每个包只做一次memcpy，没有逐包的堆分配。
+ * 包在数据区中连续存放，尾部放不下时回到开头；空间不够时按先进先出淘汰，
+ * 淘汰后开头不是关键帧的包一并丢弃，因此缓冲总是从关键帧开始，可以直接写入新文件。
+ * 时长按整个GOP淘汰：去掉最旧的GOP后仍不短于预录时长才淘汰，最新的GOP总是保留。
+ * 非线程安全，由录制器的写文件线程独占使用。
+ */
+class PreRollBuffer {
+public:
+    /**
+     * @brief 分配缓冲区并清空
+     * @param max_bytes 内存预算（字节）
+     * @param max_duration_us 最长保留时长（微秒）
+     * @param max_packets 最多保留的包数
+     */
+    void configure(size_t max_bytes, int64_t max_duration_us, size_t max_packets);
+
+    /**
+     * @brief 追加一个包，必要时淘汰最旧的包
+     * @param data 包数据
+     * @param size 包大小
+     * @param pts 时间戳（调用方的时间基），写出时原样返回
+     * @param timestamp_us 采集时间（微秒），用于时长限制
+     * @param keyframe 是否关键帧
+     * @return 是否已缓冲，单包超过预算时返回false
+     */
+    bool push(const uint8_t* data, size_t size, int64_t pts, int64_t timestamp_us, bool keyframe);
+
+    /**
+     * @brief 从最早的关键帧开始依次取出所有包，然后清空
+     * @param fn 回调，参数为数据、大小、时间戳和是否关键帧，返回false时停止
+     * @return 所有回调是否都返回true
+     */
+    bool flush(const std::function<bool(const uint8_t*, size_t, int64_t, bool)>& fn);
+
+    /**
+     * @brief 清空缓冲，保留已分配的内存
+     */
+    void clear();
+
+    /**
+     * @brief 获取统计信息
+     */
+    PreRollStats getStats() const;
+
+private:
+    struct Entry {
+        size_t offset;
+        size_t size;
+        int64_t pts;
+        int64_t timestamp_us;
+        bool keyframe;
+    };
+
+    // 淘汰最旧的包
+    void popFront();
+    // 淘汰开头不是关键帧的包
+    void trimToKeyframe();
+    const Entry& front() const { return entries_[head_]; }
+    const Entry& back() const { return entries_[(head_ + count_ - 1) % entries_.size()]; }
+
+    std::vector<uint8_t> data_;
+    std::vector<Entry> entries_;   // 环形索引
+    size_t head_ = 0;              // 最旧的包
+    size_t count_ = 0;
+    size_t keyframes_ = 0;         // 缓冲中的关键帧数
+    size_t write_offset_ = 0;      // 下一个包在数据区中的位置
+    size_t bytes_ = 0;
+    int64_t max_duration_us_ = 0;
+    uint64_t evicted_ = 0;
+    uint64_t rejected_ = 0;
+};
+
+} // namespace video
+} // namespace cam_server
+
+#endif // PRE_ROLL_BUFFER_H
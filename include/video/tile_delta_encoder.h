@@ -0,0 +1,136 @@
+#ifndef TILE_DELTA_ENCODER_H
+#define TILE_DELTA_ENCODER_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "camera/frame.h"
+#include "video/encoded_frame_cache.h"
+
+namespace cam_server {
+namespace video {
+
+/**
+ * @brief 瓦片增量编码配置
+ */
+struct TileDeltaConfig {
+    int tile_size = 64;               // 瓦片边长（像素），按16对齐
+    int quality = 70;                 // 瓦片和全帧刷新的JPEG质量
+    double threshold = 3.0;           // 瓦片内平均亮度差超过该值视为变化，低于它的按传感器噪声处理
+    int refresh_interval_ms = 10000;  // 定期全帧刷新，纠正低于阈值的累积偏差，0表示不定期刷新
+    double max_changed_ratio = 0.5;   // 变化瓦片超过该比例时直接发全帧，比逐块编码更省
+};
+
+/**
+ * @brief 一个变化瓦片
+ */
+struct TileDeltaTile {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    JpegBuffer jpeg;
+};
+
+/**
+ * @brief 一帧的增量更新
+ */
+struct TileDeltaUpdate {
+    bool full = false;                 // 是否为全帧刷新，此时只有一个覆盖整帧的瓦片
+    int width = 0;                     // 帧宽度
+    int height = 0;                    // 帧高度
+    uint64_t timestamp_us = 0;         // 源帧的采集时间
+    std::vector<TileDeltaTile> tiles;  // 变化的瓦片，为空表示画面没有变化
+
+    bool empty() const { return tiles.empty(); }
+};
+
+/**
+ * @brief 瓦片增量编码统计，用于和整帧MJPEG比较带宽和CPU开销
+ */
+struct TileDeltaStats {
+    uint64_t frames = 0;          // 处理的帧数
+    uint64_t skipped_frames = 0;  // 没有变化、整帧跳过的帧数
+    uint64_t full_frames = 0;     // 全帧刷新次数
+    uint64_t tiles_sent = 0;      // 发送的变化瓦片数
+    uint64_t bytes_sent = 0;      // 发出的JPEG字节数（全帧和瓦片）
+    uint64_t mjpeg_bytes = 0;     // 同样的帧按整帧MJPEG发送的字节数，原始格式输入按最近一次全帧的大小估算
+    uint64_t process_us = 0;      // 所有帧的处理耗时（解码、比较和编码）
+    uint64_t full_us = 0;         // 全帧刷新帧的处理耗时，近似整帧MJPEG每帧的开销
+};
+
+/**
+ * @brief 瓦片增量编码器
+ *
+ * 把画面切成固定大小的瓦片，与客户端当前画面对应的参考亮度逐块比较（SSE2/NEON求绝对差之和），
+ * 只把变化的瓦片编码成小JPEG。画面完全静止时不输出任何数据。首帧、分辨率变化、
+ * 定期刷新或变化范围太大时输出整帧。每个摄像头一个，同一实例不可被多个线程同时使用。
+ *
+ * 支持MJPEG（先解码）、YUYV、NV12和YUV420P输入。
+ */
+class TileDeltaEncoder {
+public:
+    explicit TileDeltaEncoder(const TileDeltaConfig& config = TileDeltaConfig());
+
+    TileDeltaEncoder(const TileDeltaEncoder&) = delete;
+    TileDeltaEncoder& operator=(const TileDeltaEncoder&) = delete;
+
+    /**
+     * @brief 处理一帧
+     * @param frame 输入帧
+     * @param force_full 是否强制全帧刷新（如有新客户端加入）
+     * @param update 输出的增量更新
+     * @return 是否成功，画面没有变化时也返回true，update为空
+     */
+    bool encode(const camera::Frame& frame, bool force_full, TileDeltaUpdate& update);
+
+    /**
+     * @brief 下一帧输出全帧
+     */
+    void reset() { need_full_ = true; }
+
+    /**
+     * @brief 获取统计信息
+     */
+    const TileDeltaStats& getStats() const { return stats_; }
+
+    /**
+     * @brief 是否支持该输入格式
+     */
+    static bool isSupported(camera::PixelFormat format);
+
+    /**
+     * @brief 求两段数据的逐字节绝对差之和
+     * @param a 数据a
+     * @param b 数据b
+     * @param size 字节数
+     * @return 绝对差之和
+     */
+    static uint64_t sumAbsDiff(const uint8_t* a, const uint8_t* b, size_t size);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    const uint8_t* loadLuma(const camera::Frame& frame);
+    bool tileChanged(const uint8_t* luma, int x, int y, int width, int height) const;
+    void updateReference(const uint8_t* luma, int x, int y, int width, int height);
+    JpegBuffer encodeTile(const camera::Frame& frame, int x, int y, int width, int height);
+
+    TileDeltaConfig config_;
+    camera::Frame decoded_;             // MJPEG输入解码后的帧，复用缓冲区
+    std::vector<uint8_t> luma_;         // YUYV输入提取出的亮度
+    std::vector<uint8_t> reference_;    // 客户端当前画面对应的亮度
+    std::vector<uint8_t> tile_buffer_;  // 裁剪出的瓦片数据
+    int width_;
+    int height_;
+    bool need_full_;
+    Clock::time_point last_full_;
+    size_t last_full_size_;
+    TileDeltaStats stats_;
+};
+
+} // namespace video
+} // namespace cam_server
+
+#endif // TILE_DELTA_ENCODER_H
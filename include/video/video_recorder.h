@@ -19,6 +19,22 @@ struct AVPacket;
 namespace cam_server {
 namespace video {
 
+/**
+ * @brief 录制输入队列满时的丢帧策略
+ */
+enum class RecordingDropPolicy {
+    DROP_OLDEST,   // 丢弃队列中最旧的帧，录像尽量跟上实时画面
+    DROP_NEWEST    // 丢弃新到的帧，保留已排队的连续画面
+};
+
+/**
+ * @brief 录制模式
+ */
+enum class RecordingMode {
+    TRANSCODE,     // 解码/色彩转换后重新编码（默认H.264）
+    STREAM_COPY    // MJPEG直通：摄像头输出的JPEG帧不解码、不重编码，直接封装到MKV/AVI/MOV
+};
+
 /**
  * @brief 录制配置结构体
  */
@@ -45,6 +61,22 @@ struct RecordingConfig {
     int max_duration;
     // 最大文件大小（字节），0表示不限制
     int64_t max_size;
+    // 录制模式，STREAM_COPY时忽略编码器、比特率和GOP设置
+    RecordingMode mode = RecordingMode::TRANSCODE;
+    // 输入队列深度（帧），编码跟不上时按丢帧策略丢帧，不阻塞调用线程
+    int input_queue_depth = 8;
+    // 输入队列满时的丢帧策略
+    RecordingDropPolicy drop_policy = RecordingDropPolicy::DROP_OLDEST;
+    // 编码输出到写文件线程的队列深度（包），写入阻塞导致队列满时丢弃到下一个关键帧
+    int write_queue_depth = 120;
+    // 预录时长（秒），0表示不预录；预录时开始录制的文件包含触发前这段时间的画面
+    int pre_roll_seconds = 0;
+    // 预录缓冲的内存预算（字节），先于时长达到上限时按预算淘汰
+    size_t pre_roll_max_bytes = 16 * 1024 * 1024;
+    // MP4/MOV按关键帧分片写入，异常退出时最多丢失最后一个分片，其他容器忽略
+    bool fragmented_mp4 = false;
+    // 同时写入关键帧索引（录像路径加.kfi），用于按时间快速定位
+    bool write_keyframe_index = true;
 };
 
 /**
@@ -57,6 +89,18 @@ enum class RecordingState {
     ERROR       // 错误状态
 };
 
+/**
+ * @brief 录制流水线一个阶段的统计
+ */
+struct RecordingStageStats {
+    size_t queue_depth = 0;        // 当前排队数
+    size_t queue_capacity = 0;     // 队列容量
+    uint64_t processed = 0;        // 已处理数
+    uint64_t dropped = 0;          // 丢弃数
+    double avg_latency_ms = 0.0;   // 入队到处理完成的平均延迟
+    double max_latency_ms = 0.0;   // 入队到处理完成的最大延迟
+};
+
 /**
  * @brief 录制状态信息结构体
  */
@@ -73,6 +117,16 @@ struct RecordingStatus {
     int64_t file_size;
     // 错误信息（如果状态为ERROR）
     std::string error_message;
+    // 输入队列和编码线程（帧）
+    RecordingStageStats encode_stage;
+    // 包队列和写文件线程（包）
+    RecordingStageStats write_stage;
+    // 是否正在预录（编码结果保存在内存中，等待开始录制）
+    bool pre_roll_armed = false;
+    // 预录缓冲中的时长（秒）
+    double pre_roll_duration = 0.0;
+    // 预录缓冲中的数据量（字节）
+    int64_t pre_roll_bytes = 0;
 };
 
 /**
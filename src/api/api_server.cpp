@@ -2,12 +2,16 @@
 #include "api/rest_handler.h"
 #include "api/crow_server.h"
 #include "api/mjpeg_streamer.h"
+#include "api/mjpeg_http_engine.h"
+#include "api/latest_frame_store.h"
 #include "api/camera_api.h"
+#include "api/websocket_camera_streamer.h"
 #include "monitor/logger.h"
 #include "camera/camera_manager.h"
 #include "monitor/logger.h"
 #include "system/system_monitor.h"
 #include "utils/time_utils.h"
+#include "utils/config_manager.h"
 
 #include <chrono>
 #include <thread>
@@ -57,7 +61,7 @@ bool ApiServer::initialize(const ApiServerConfig& config) {
     config_ = config;
 
     // 创建Crow服务器
-    web_server_ = std::make_unique<CrowServer>();
+    web_server_ = std::make_shared<CrowServer>();
     if (!web_server_) {
         LOG_ERROR("创建Crow服务器失败", "ApiServer");
         return false;
@@ -101,6 +105,48 @@ bool ApiServer::initialize(const ApiServerConfig& config) {
         return false;
     }
 
+    // 各流共用的最新帧：新观看者立即收到当前档位的最新一帧，档位无人观看后在保持期内继续低频编码
+    LatestFrameStoreConfig latest_config;
+    latest_config.grace_period_ms = utils::ConfigManager::getInstance().getInt("stream.warm_grace_ms", 30000);
+    latest_config.refresh_interval_ms = utils::ConfigManager::getInstance().getInt("stream.warm_refresh_ms", 500);
+    LatestFrameStore::getInstance().setConfig(latest_config);
+
+    // 初始化/ws/camera的摄像头流处理器，分辨率阶梯与MJPEG流共用配置
+    WebSocketCameraStreamerConfig ws_config;
+    ws_config.ladder = StreamLadder::parse(utils::ConfigManager::getInstance().getString("stream.ladder", ""),
+                                           ws_config.jpeg_quality);
+    ws_config.adaptive.enabled = utils::ConfigManager::getInstance().getBool("stream.adaptive", true);
+    ws_config.adaptive.min_fps = utils::ConfigManager::getInstance().getDouble("stream.adaptive_min_fps", 2.0);
+    ws_config.adaptive.high_latency_ms =
+        utils::ConfigManager::getInstance().getDouble("stream.adaptive_max_latency_ms", 250.0);
+    ws_config.enable_h264 = utils::ConfigManager::getInstance().getBool("stream.h264", true);
+    ws_config.h264.encoder_name = utils::ConfigManager::getInstance().getString("stream.h264_encoder", "");
+    ws_config.h264.bitrate = utils::ConfigManager::getInstance().getInt("stream.h264_bitrate", 0);
+    ws_config.h264.gop = utils::ConfigManager::getInstance().getInt("stream.h264_gop", 60);
+    ws_config.enable_tiles = utils::ConfigManager::getInstance().getBool("stream.tiles", true);
+    ws_config.tiles.tile_size = utils::ConfigManager::getInstance().getInt("stream.tile_size", 64);
+    ws_config.tiles.quality = utils::ConfigManager::getInstance().getInt("stream.tile_quality", 70);
+    ws_config.tiles.threshold = utils::ConfigManager::getInstance().getDouble("stream.tile_threshold", 3.0);
+    ws_config.tiles.refresh_interval_ms = utils::ConfigManager::getInstance().getInt("stream.tile_refresh_ms", 10000);
+    if (!WebSocketCameraStreamer::getInstance().initialize(ws_config, web_server_)) {
+        LOG_WARNING("初始化WebSocket摄像头流处理器失败", "ApiServer");
+    }
+
+    // 独立端口的MJPEG推流引擎，观看者多时不占用Web服务器的处理线程
+    int mjpeg_port = utils::ConfigManager::getInstance().getInt("stream.mjpeg_port", 8082);
+    if (mjpeg_port > 0) {
+        MjpegHttpEngineConfig mjpeg_config;
+        mjpeg_config.address = config_.address;
+        mjpeg_config.port = mjpeg_port;
+        mjpeg_config.num_threads = utils::ConfigManager::getInstance().getInt("stream.mjpeg_threads", 2);
+        mjpeg_config.max_connections = utils::ConfigManager::getInstance().getInt("stream.mjpeg_max_connections", 512);
+        mjpeg_config.ladder = ws_config.ladder;
+        mjpeg_config.adaptive = ws_config.adaptive;
+        if (!MjpegHttpEngine::getInstance().initialize(mjpeg_config)) {
+            LOG_WARNING("初始化MJPEG HTTP引擎失败", "ApiServer");
+        }
+    }
+
     // 设置初始化标志
     is_initialized_ = true;
 
@@ -181,6 +227,15 @@ bool ApiServer::start() {
     LOG_INFO("Web服务器启动成功", "ApiServer");
     LOG_DEBUG("Web服务器启动成功", "ApiServer");
 
+    // 摄像头客户端通过/ws/camera的subscribe命令订阅，没有订阅者的档位不会编码
+    if (!WebSocketCameraStreamer::getInstance().start()) {
+        LOG_WARNING("WebSocket摄像头流处理器启动失败", "ApiServer");
+    }
+    if (utils::ConfigManager::getInstance().getInt("stream.mjpeg_port", 8082) > 0 &&
+        !MjpegHttpEngine::getInstance().start()) {
+        LOG_WARNING("MJPEG HTTP引擎启动失败，MJPEG流仍可通过/api/camera/mjpeg访问", "ApiServer");
+    }
+
     // 检查Web服务器是否正在运行
     LOG_DEBUG("Web服务器已启动", "ApiServer");
 
@@ -218,6 +273,8 @@ bool ApiServer::stop() {
     }
 
     // 停止Web服务器
+    WebSocketCameraStreamer::getInstance().stop();
+    MjpegHttpEngine::getInstance().stop();
     if (web_server_) {
         web_server_->stop();
     }
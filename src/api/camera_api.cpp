@@ -4,10 +4,17 @@
 #include "utils/time_utils.h"  // 添加 TimeUtils 头文件
 #include "utils/string_utils.h"
 #include "utils/file_utils.h"
+#include "utils/config_manager.h"
 #include "video/i_video_recorder.h"
+#include "video/video_recorder_factory.h"
 #include "api/mjpeg_streamer.h"
+#include "api/websocket_camera_streamer.h"
+#include "api/mjpeg_http_engine.h"
 #include "camera/format_utils.h"
 #include "camera/camera_manager.h"  // 添加 CameraManager 头文件
+#include "camera/pipeline_stats.h"
+#include "video/encoded_frame_cache.h"
+#include "video/keyframe_index.h"
 #include <fmt/format.h>
 #include <future>  // 添加 std::promise 和 std::future 支持
 #include <thread>  // 添加 std::this_thread 支持
@@ -114,8 +121,7 @@ public:
         }
 
         // 简单地将帧数据写入文件
-        const auto& data = frame.getData();
-        output_file_.write(reinterpret_cast<const char*>(data.data()), data.size());
+        output_file_.write(reinterpret_cast<const char*>(frame.getDataPtr()), frame.getDataSize());
 
         // 更新状态
         status_.frame_count++;
@@ -181,6 +187,39 @@ namespace fs = std::filesystem;
 namespace cam_server {
 namespace api {
 
+namespace {
+
+// 解析系统时间：Unix时间（秒或毫秒），或本地时间"YYYY-MM-DD HH:MM:SS"，只有"HH:MM:SS"时取当天
+bool parseWallTime(const std::string& text, int64_t& wall_time_us) {
+    if (text.empty()) {
+        return false;
+    }
+    if (std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        if (text.size() > 15) {
+            return false;
+        }
+        int64_t value = std::stoll(text);
+        wall_time_us = value > 100000000000LL ? value * 1000 : value * 1000000;
+        return true;
+    }
+
+    std::time_t now = std::time(nullptr);
+    std::tm today = *std::localtime(&now);
+    for (const char* format : {"%Y-%m-%d %H:%M:%S", "%Y-%m-%dT%H:%M:%S", "%H:%M:%S"}) {
+        std::tm parsed = today;
+        std::istringstream ss(text);
+        ss >> std::get_time(&parsed, format);
+        if (!ss.fail()) {
+            parsed.tm_isdst = -1;
+            wall_time_us = static_cast<int64_t>(std::mktime(&parsed)) * 1000000;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
 // 单例实现
 CameraApi& CameraApi::getInstance() {
     static CameraApi instance;
@@ -191,6 +230,10 @@ CameraApi& CameraApi::getInstance() {
 CameraApi::CameraApi() 
     : is_initialized_(false), 
       video_recorder_(nullptr),
+      recording_subscription_(0),
+      pre_roll_seconds_(0),
+      pre_roll_bitrate_(0),
+      video_splitter_(video::createFFmpegSplitter()),
       mjpeg_streamer_(MjpegStreamer::getInstance()) {
     // 设置图像和视频保存目录
     images_dir_ = "data/images";
@@ -199,6 +242,8 @@ CameraApi::CameraApi()
     // 确保目录存在
     ensureDirectoryExists(images_dir_);
     ensureDirectoryExists(videos_dir_);
+
+    video_splitter_->initialize();
 }
 
 // 析构函数
@@ -273,6 +318,12 @@ bool CameraApi::registerRoutes(RestHandler& rest_handler) {
         return handleStopRecording(request);
     });
 
+    // 预录
+    LOG_DEBUG("注册预录API: POST /api/camera/pre_roll", "CameraApi");
+    rest_handler.registerRoute("POST", "/api/camera/pre_roll", [this](const HttpRequest& request) {
+        return handleSetPreRoll(request);
+    });
+
     LOG_DEBUG("摄像头API路由注册完成", "CameraApi");
 
     // 注册MJPEG流API
@@ -281,6 +332,32 @@ bool CameraApi::registerRoutes(RestHandler& rest_handler) {
         return handleMjpegStream(request);
     });
 
+    // 流分辨率档位
+    LOG_DEBUG("注册流档位API: GET /api/stream/tiers, POST /api/stream/tier, POST /api/stream/feedback", "CameraApi");
+    rest_handler.registerRoute("GET", "/api/stream/tiers", [this](const HttpRequest& request) {
+        return handleGetStreamTiers(request);
+    });
+    rest_handler.registerRoute("POST", "/api/stream/tier", [this](const HttpRequest& request) {
+        return handleSetStreamTier(request);
+    });
+    rest_handler.registerRoute("POST", "/api/stream/feedback", [this](const HttpRequest& request) {
+        return handleStreamFeedback(request);
+    });
+
+    // 流水线延迟和丢帧统计
+    LOG_DEBUG("注册流水线统计API: GET /api/stats/pipeline", "CameraApi");
+    rest_handler.registerRoute("GET", "/api/stats/pipeline", [this](const HttpRequest& request) {
+        return handleGetPipelineStats(request);
+    });
+
+    // 录像取帧和导出片段，按关键帧索引定位
+    rest_handler.registerRoute("GET", "/api/videos/frame", [this](const HttpRequest& request) {
+        return handleGetVideoFrame(request);
+    });
+    rest_handler.registerRoute("POST", "/api/videos/clip", [this](const HttpRequest& request) {
+        return handleExportVideoClip(request);
+    });
+
     return true;
 }
 
@@ -288,17 +365,12 @@ bool CameraApi::registerRoutes(RestHandler& rest_handler) {
 std::vector<CameraDeviceInfo> CameraApi::getAllCameras() {
     std::vector<CameraDeviceInfo> devices;
 
-    for (const auto& entry : fs::directory_iterator("/dev")) {
-        std::string path = entry.path().string();
-        if (path.find("/dev/video") == 0) {
-            // 尝试提取数字部分
-            std::string num_part = path.substr(10); // 跳过"/dev/video"
-            if (!num_part.empty() && std::all_of(num_part.begin(), num_part.end(), ::isdigit)) {
-                CameraDeviceInfo info;
-                if (queryDevice(path, info) && !info.formats.empty()) {
-                    devices.push_back(info);
-                }
-            }
+    // 设备能力由CapabilityCache缓存，热插拔前重复调用不会重新枚举
+    for (const auto& capabilities : camera::CapabilityCache::getInstance().scan()) {
+        CameraDeviceInfo info;
+        fillDeviceInfo(*capabilities, info);
+        if (!info.formats.empty()) {
+            devices.push_back(info);
         }
     }
 
@@ -336,82 +408,29 @@ bool CameraApi::openCamera(const std::string& device_path,
 
 // 查询设备信息
 bool CameraApi::queryDevice(const std::string& device_path, CameraDeviceInfo& info) {
-    int fd = open(device_path.c_str(), O_RDWR);
-    if (fd < 0) {
-        LOG_ERROR(fmt::format("无法打开设备: {} (errno: {})", device_path, strerror(errno)), "CameraApi");
-        return false;
-    }
-
-    // 简化V4L2技术细节日志
-    LOG_DEBUG(fmt::format("查询设备能力: {}", device_path), "CameraApi");
-    
-    // 获取设备信息
-    struct v4l2_capability cap;
-    if (ioctl(fd, VIDIOC_QUERYCAP, &cap) < 0) {
-        LOG_ERROR("无法查询设备能力: " + device_path, "CameraApi");
-        close(fd);
+    auto capabilities = camera::CapabilityCache::getInstance().get(device_path);
+    if (!capabilities) {
+        LOG_ERROR("无法查询设备能力或不是视频捕获设备: " + device_path, "CameraApi");
         return false;
     }
 
-    // 检查是否是视频捕获设备
-    if (!(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE)) {
-        LOG_ERROR("不是视频捕获设备: " + device_path, "CameraApi");
-        close(fd);
-        return false;
-    }
+    fillDeviceInfo(*capabilities, info);
+    return true;
+}
 
-    info.path = device_path;
-    info.name = reinterpret_cast<const char*>(cap.card);
-    info.bus_info = reinterpret_cast<const char*>(cap.bus_info);
-
-    // 查询支持的格式
-    struct v4l2_fmtdesc fmt;
-    memset(&fmt, 0, sizeof(fmt));
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-
-    while (ioctl(fd, VIDIOC_ENUM_FMT, &fmt) == 0) {
-        std::string format_name = camera::FormatUtils::getV4L2FormatName(fmt.pixelformat);
-
-        // 查询该格式支持的分辨率
-        struct v4l2_frmsizeenum frmsize;
-        memset(&frmsize, 0, sizeof(frmsize));
-        frmsize.pixel_format = fmt.pixelformat;
-        frmsize.index = 0;
-
-        if (ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &frmsize) == 0) {
-            if (frmsize.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
-                // 离散分辨率
-                do {
-                    ResolutionInfo res = {frmsize.discrete.width, frmsize.discrete.height};
-                    info.formats[format_name].insert(res);
-                    frmsize.index++;
-                } while (ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &frmsize) == 0);
-            } else if (frmsize.type == V4L2_FRMSIZE_TYPE_STEPWISE ||
-                      frmsize.type == V4L2_FRMSIZE_TYPE_CONTINUOUS) {
-                // 连续或步进分辨率，我们选择一些常用的分辨率
-                std::vector<std::pair<uint32_t, uint32_t>> common_resolutions = {
-                    {640, 480}, {800, 600}, {1024, 768}, {1280, 720},
-                    {1280, 960}, {1600, 1200}, {1920, 1080}, {2560, 1440},
-                    {3840, 2160}
-                };
-
-                for (const auto& res : common_resolutions) {
-                    if (res.first >= frmsize.stepwise.min_width &&
-                        res.first <= frmsize.stepwise.max_width &&
-                        res.second >= frmsize.stepwise.min_height &&
-                        res.second <= frmsize.stepwise.max_height) {
-                        ResolutionInfo r = {res.first, res.second};
-                        info.formats[format_name].insert(r);
-                    }
-                }
-            }
+// 将缓存的设备能力转换为设备信息
+void CameraApi::fillDeviceInfo(const camera::DeviceCapabilities& capabilities, CameraDeviceInfo& info) {
+    info.path = capabilities.device_path;
+    info.name = capabilities.card;
+    info.bus_info = capabilities.bus_info;
+
+    for (const auto& format : capabilities.formats) {
+        // 步进/连续范围只列出探测过的标准分辨率
+        auto& resolutions = info.formats[format.name];
+        for (const auto& size : format.sizes) {
+            resolutions.insert(ResolutionInfo{size.width, size.height});
         }
-
-        fmt.index++;
     }
-
-    close(fd);
-    return true;
 }
 
 // 启动摄像头预览
@@ -515,7 +534,7 @@ bool CameraApi::ensureDirectoryExists(const std::string& path) {
 }
 
 // 拍照并保存图像
-std::string CameraApi::captureImage(const std::string& output_path, int /*quality*/) {
+std::string CameraApi::captureImage(const std::string& output_path, int quality) {
     try {
         // 获取摄像头管理器实例
         auto& camera_manager = camera::CameraManager::getInstance();
@@ -526,11 +545,11 @@ std::string CameraApi::captureImage(const std::string& output_path, int /*qualit
             return "";
         }
 
-        // 获取一帧图像
-        auto frame = camera_manager.getFrame();
+        // 获取最新一帧图像，避免返回积压的旧帧
+        auto frame = camera_manager.getLatestFrame();
 
         // 验证帧数据
-        if (frame.getData().empty()) {
+        if (frame.isEmpty()) {
             LOG_ERROR("捕获图像失败：空数据", "CameraApi");
             return "";
         }
@@ -551,22 +570,14 @@ std::string CameraApi::captureImage(const std::string& output_path, int /*qualit
             return "";
         }
 
-        // 如果是MJPEG格式，直接写入
-        if (frame.getFormat() == camera::PixelFormat::MJPEG) {
-            const auto& data = frame.getData();
-            file.write(reinterpret_cast<const char*>(data.data()), data.size());
-            file.close();
-            return output_path;
-        }
-
-        // 否则需要转换为JPEG
-        std::vector<uint8_t> jpeg_data;
-        if (!mjpeg_streamer_.encodeToJpeg(frame, jpeg_data)) {
+        // 与正在推流的客户端共享同一帧的编码结果
+        video::JpegBuffer jpeg = video::EncodedFrameCache::getInstance().getJpeg(frame, quality);
+        if (!jpeg) {
             LOG_ERROR("JPEG编码失败", "CameraApi");
             return "";
         }
 
-        file.write(reinterpret_cast<const char*>(jpeg_data.data()), jpeg_data.size());
+        file.write(reinterpret_cast<const char*>(jpeg->data()), jpeg->size());
         file.close();
 
         return output_path;
@@ -592,97 +603,35 @@ bool CameraApi::startRecording(const std::string& output_path,
             return true;
         }
 
-        // 获取摄像头管理器实例
-        auto& camera_manager = camera::CameraManager::getInstance();
-
-        // 检查摄像头是否已打开并正在捕获
-        if (!camera_manager.isDeviceOpen() || !camera_manager.isCapturing()) {
-            LOG_ERROR("摄像头未打开或未在预览中", "CameraApi");
-            return false;
-        }
-
-        // 获取当前设备
-        auto device = camera_manager.getCurrentDevice();
-        if (!device) {
-            LOG_ERROR("无法获取摄像头设备", "CameraApi");
-            return false;
+        // 预录中：沿用预录的编码设置，只更新输出路径和最大时长
+        if (video_recorder_ && video_recorder_->getStatus().pre_roll_armed) {
+            auto config = video_recorder_->getConfig();
+            config.output_path = output_path.empty()
+                ? makeVideoPath(config.container_format == "matroska" ? "mkv" : config.container_format)
+                : output_path;
+            config.max_duration = max_duration;
+            ensureDirectoryExists(std::filesystem::path(config.output_path).parent_path().string());
+            if (video_recorder_->setConfig(config) && video_recorder_->startRecording()) {
+                LOG_INFO("成功开始录制（含预录）: " + config.output_path, "CameraApi");
+                return true;
+            }
+            LOG_ERROR("预录转为录制失败，重新创建录制器", "CameraApi");
         }
-
-        // 获取设备信息
-        auto device_info = device->getDeviceInfo();
-        auto params = device->getParams();
-
-        // 生成文件名
-        std::string file_path;
-        if (output_path.empty()) {
-            // 使用当前时间生成文件名
-            auto now = std::chrono::system_clock::now();
-            auto now_time_t = std::chrono::system_clock::to_time_t(now);
-            std::stringstream ss;
-            ss << videos_dir_ << "/video_";
-            ss << std::put_time(std::localtime(&now_time_t), "%Y%m%d_%H%M%S");
-            ss << "." << format;
-            file_path = ss.str();
-        } else {
-            file_path = output_path;
-        }
-
-        // 确保目录存在
-        std::filesystem::path p(file_path);
-        ensureDirectoryExists(p.parent_path().string());
-
-        // 创建录制配置
-        video::RecordingConfig config;
-        config.output_path = file_path;
-        config.encoder_name = encoder;
-        config.container_format = format;
-        config.width = params.width;
-        config.height = params.height;
-        config.fps = params.fps;
-        config.bitrate = bitrate;
-        config.gop = params.fps * 2; // 关键帧间隔设为2秒
-        config.use_hw_accel = true;  // 使用硬件加速
-        config.max_duration = max_duration;
-        config.max_size = 0; // 不限制文件大小
+        releaseRecorderLocked();
 
         // 创建录制器
-        video_recorder_ = std::make_shared<video::SimpleVideoRecorder>();
-        if (!video_recorder_) {
-            LOG_ERROR("无法创建视频录制器", "CameraApi");
-            return false;
-        }
-
-        // 初始化录制器
-        if (!video_recorder_->initialize(config)) {
-            LOG_ERROR("无法初始化视频录制器", "CameraApi");
-            video_recorder_.reset();
+        if (!createRecorderLocked(output_path, format, encoder, bitrate, max_duration, 0)) {
             return false;
         }
 
-        // 设置状态回调
-        video_recorder_->setStatusCallback([this](const video::RecordingStatus& status) {
-            // 可以在这里处理状态变化，例如记录日志
-            if (status.state == video::RecordingState::ERROR) {
-                LOG_ERROR("录制错误: " + status.error_message, "CameraApi");
-            }
-        });
-
         // 开始录制
         if (!video_recorder_->startRecording()) {
             LOG_ERROR("无法开始录制", "CameraApi");
-            video_recorder_.reset();
+            releaseRecorderLocked();
             return false;
         }
 
-        // 设置帧回调
-        camera_manager.setFrameCallback([this](const camera::Frame& frame) {
-            if (video_recorder_ &&
-                video_recorder_->getStatus().state == video::RecordingState::RECORDING) {
-                video_recorder_->processFrame(frame);
-            }
-        });
-
-        LOG_INFO("成功开始录制: " + file_path, "CameraApi");
+        LOG_INFO("成功开始录制: " + video_recorder_->getStatus().current_file, "CameraApi");
         return true;
     } catch (const std::exception& e) {
         LOG_ERROR("开始录制异常: " + std::string(e.what()), "CameraApi");
@@ -706,20 +655,13 @@ std::string CameraApi::stopRecording() {
         auto status = video_recorder_->getStatus();
         std::string file_path = status.current_file;
 
-        // 停止录制
-        if (!video_recorder_->stopRecording()) {
-            LOG_ERROR("无法停止录制", "CameraApi");
-            return "";
-        }
-
-        // 清除帧回调
-        auto& camera_manager = camera::CameraManager::getInstance();
-        camera_manager.setFrameCallback(nullptr);
-
-        // 清除录制器
-        video_recorder_.reset();
+        // 先取消帧订阅，确保录制线程不再写入，然后停止录制
+        releaseRecorderLocked();
 
         LOG_INFO("成功停止录制: " + file_path, "CameraApi");
+
+        // 继续预录，为下一次录制做准备
+        armPreRollLocked();
         return file_path;
     } catch (const std::exception& e) {
         LOG_ERROR("停止录制异常: " + std::string(e.what()), "CameraApi");
@@ -727,6 +669,170 @@ std::string CameraApi::stopRecording() {
     }
 }
 
+// 设置预录
+bool CameraApi::setPreRoll(int seconds, const std::string& format, const std::string& encoder, int bitrate) {
+    std::lock_guard<std::mutex> lock(recording_mutex_);
+
+    try {
+        pre_roll_seconds_ = std::max(0, seconds);
+        pre_roll_format_ = format;
+        pre_roll_encoder_ = encoder;
+        pre_roll_bitrate_ = bitrate;
+
+        // 录制中不打断，停止录制后按新设置预录
+        if (video_recorder_ && video_recorder_->getStatus().state == video::RecordingState::RECORDING) {
+            LOG_INFO("预录设置将在录制结束后生效", "CameraApi");
+            return true;
+        }
+
+        releaseRecorderLocked();
+        if (pre_roll_seconds_ == 0) {
+            LOG_INFO("已关闭预录", "CameraApi");
+            return true;
+        }
+        return armPreRollLocked();
+    } catch (const std::exception& e) {
+        LOG_ERROR("设置预录异常: " + std::string(e.what()), "CameraApi");
+        return false;
+    }
+}
+
+std::string CameraApi::makeVideoPath(const std::string& container) const {
+    // 使用当前时间生成文件名
+    auto now = std::chrono::system_clock::now();
+    auto now_time_t = std::chrono::system_clock::to_time_t(now);
+    std::stringstream ss;
+    ss << videos_dir_ << "/video_";
+    ss << std::put_time(std::localtime(&now_time_t), "%Y%m%d_%H%M%S");
+    ss << "." << container;
+    return ss.str();
+}
+
+bool CameraApi::createRecorderLocked(const std::string& output_path, const std::string& format,
+                                     const std::string& encoder, int bitrate, int max_duration,
+                                     int pre_roll_seconds) {
+    // 获取摄像头管理器实例
+    auto& camera_manager = camera::CameraManager::getInstance();
+
+    // 检查摄像头是否已打开并正在捕获
+    if (!camera_manager.isDeviceOpen() || !camera_manager.isCapturing()) {
+        LOG_ERROR("摄像头未打开或未在预览中", "CameraApi");
+        return false;
+    }
+
+    // 获取当前设备
+    auto device = camera_manager.getCurrentDevice();
+    if (!device) {
+        LOG_ERROR("无法获取摄像头设备", "CameraApi");
+        return false;
+    }
+
+    // 获取设备信息
+    auto params = device->getParams();
+
+    // fmp4为按关键帧分片的MP4，异常退出时文件仍可播放
+    bool fragmented = format == "fmp4";
+    std::string container = fragmented ? "mp4" : format;
+
+    // encoder为copy时MJPEG直通录制，时间戳为微秒。AVI以时间基作为帧率并为跳过的每个时间单位写空块，
+    // MP4中的MJPEG很多播放器不支持，都改用MKV
+    bool stream_copy = encoder == "copy";
+    if (stream_copy && container != "mkv" && container != "mov") {
+        LOG_INFO("MJPEG直通录制不支持" + container + "，使用mkv", "CameraApi");
+        container = "mkv";
+    }
+
+    // 生成文件名，预录时开始录制再确定最终的文件名
+    std::string file_path = output_path.empty() ? makeVideoPath(container) : output_path;
+
+    // 确保目录存在
+    std::filesystem::path p(file_path);
+    ensureDirectoryExists(p.parent_path().string());
+
+    // 创建录制配置
+    video::RecordingConfig config;
+    config.output_path = file_path;
+    config.encoder_name = stream_copy ? "" : encoder;
+    config.container_format = container == "mkv" ? "matroska" : container;
+    config.mode = stream_copy ? video::RecordingMode::STREAM_COPY : video::RecordingMode::TRANSCODE;
+    config.width = params.width;
+    config.height = params.height;
+    config.fps = params.fps;
+    config.bitrate = bitrate;
+    config.gop = params.fps * 2; // 关键帧间隔设为2秒
+    config.use_hw_accel = true;  // 使用硬件加速
+    config.max_duration = max_duration;
+    config.max_size = 0; // 不限制文件大小
+    config.pre_roll_seconds = pre_roll_seconds;
+    config.fragmented_mp4 = fragmented;
+
+    // 创建录制器，编码和写文件在录制器自己的线程中进行
+    video_recorder_ = video::VideoRecorderFactory::createRecorder();
+    if (!video_recorder_ || !video_recorder_->initialize(config)) {
+        LOG_WARNING("无法初始化FFmpeg录制器，使用简单录制器", "CameraApi");
+        video_recorder_ = std::make_shared<video::SimpleVideoRecorder>();
+
+        // 初始化录制器
+        if (!video_recorder_->initialize(config)) {
+            LOG_ERROR("无法初始化视频录制器", "CameraApi");
+            video_recorder_.reset();
+            return false;
+        }
+    }
+
+    // 设置状态回调
+    video_recorder_->setStatusCallback([this](const video::RecordingStatus& status) {
+        // 可以在这里处理状态变化，例如记录日志
+        if (status.state == video::RecordingState::ERROR) {
+            LOG_ERROR("录制错误: " + status.error_message, "CameraApi");
+        }
+    });
+
+    // 订阅帧，录制器只复制入队，排队和丢帧由录制器的输入队列负责，是否接收（录制或预录中）由录制器判断
+    camera::FrameSubscriberOptions options;
+    options.queue_depth = 2;
+    options.drop_policy = camera::FrameDropPolicy::DROP_OLDEST;
+    options.consumer = stream_copy || encoder.find("mjpeg") != std::string::npos
+                           ? camera::FrameConsumerKind::JPEG
+                           : camera::FrameConsumerKind::VIDEO_ENCODER;
+    // 录制期间切换格式或分辨率会使流复制丢弃所有帧，编码器也不会重新初始化
+    options.fixed_format = true;
+    auto recorder = video_recorder_;
+    recording_subscription_ = camera_manager.subscribeFrames("recorder", [recorder](const camera::Frame& frame) {
+        recorder->processFrame(frame);
+    }, options);
+    return true;
+}
+
+void CameraApi::releaseRecorderLocked() {
+    if (recording_subscription_ != 0) {
+        camera::CameraManager::getInstance().unsubscribeFrames(recording_subscription_);
+        recording_subscription_ = 0;
+    }
+    if (video_recorder_) {
+        if (!video_recorder_->stopRecording()) {
+            LOG_ERROR("无法停止录制", "CameraApi");
+        }
+        video_recorder_.reset();
+    }
+}
+
+bool CameraApi::armPreRollLocked() {
+    if (pre_roll_seconds_ <= 0) {
+        return true;
+    }
+    if (!createRecorderLocked("", pre_roll_format_, pre_roll_encoder_, pre_roll_bitrate_, 0, pre_roll_seconds_)) {
+        return false;
+    }
+    if (!video_recorder_->armPreRoll()) {
+        LOG_ERROR("无法开始预录", "CameraApi");
+        releaseRecorderLocked();
+        return false;
+    }
+    LOG_INFO("开始预录: " + std::to_string(pre_roll_seconds_) + "秒", "CameraApi");
+    return true;
+}
+
 // 获取录制状态
 std::string CameraApi::getRecordingStatus() {
     std::lock_guard<std::mutex> lock(recording_mutex_);
@@ -746,7 +852,26 @@ std::string CameraApi::getRecordingStatus() {
         json << "\"file\":\"" << status.current_file << "\",";
         json << "\"duration\":" << status.duration << ",";
         json << "\"frame_count\":" << status.frame_count << ",";
-        json << "\"file_size\":" << status.file_size;
+        json << "\"file_size\":" << status.file_size << ",";
+        auto stage = [&json](const char* name, const video::RecordingStageStats& stats) {
+            json << "\"" << name << "\":{";
+            json << "\"queue_depth\":" << stats.queue_depth << ",";
+            json << "\"queue_capacity\":" << stats.queue_capacity << ",";
+            json << "\"processed\":" << stats.processed << ",";
+            json << "\"dropped\":" << stats.dropped << ",";
+            json << "\"avg_latency_ms\":" << stats.avg_latency_ms << ",";
+            json << "\"max_latency_ms\":" << stats.max_latency_ms;
+            json << "}";
+        };
+        stage("encode_stage", status.encode_stage);
+        json << ",";
+        stage("write_stage", status.write_stage);
+        json << ",\"pre_roll\":{";
+        json << "\"armed\":" << (status.pre_roll_armed ? "true" : "false") << ",";
+        json << "\"seconds\":" << pre_roll_seconds_ << ",";
+        json << "\"duration\":" << status.pre_roll_duration << ",";
+        json << "\"bytes\":" << status.pre_roll_bytes;
+        json << "}";
         if (status.state == video::RecordingState::ERROR) {
             json << ",\"error\":\"" << status.error_message << "\"";
         }
@@ -965,6 +1090,372 @@ HttpResponse CameraApi::handleGetRecordingStatus(const HttpRequest& /*request*/)
     return response;
 }
 
+// 处理预录设置请求
+HttpResponse CameraApi::handleSetPreRoll(const HttpRequest& request) {
+    HttpResponse response;
+    response.status_code = 200;
+    response.content_type = "application/json";
+
+    try {
+        // 解析请求参数
+        int seconds = 0;
+        std::string format = "mp4";
+        std::string encoder = "h264_rkmpp";
+        int bitrate = 4000000;
+
+        // 简单的JSON解析
+        std::string body = request.body;
+        if (!body.empty()) {
+            auto extract_value = [&body](const std::string& key) -> std::string {
+                std::string search = "\"" + key + "\":";
+                size_t pos = body.find(search);
+                if (pos == std::string::npos) {
+                    return "";
+                }
+
+                pos += search.length();
+
+                // 检查是否是字符串值
+                bool is_string = false;
+                if (pos < body.length() && body[pos] == '"') {
+                    is_string = true;
+                    pos++;
+                }
+
+                size_t end_pos;
+                if (is_string) {
+                    end_pos = body.find("\"", pos);
+                } else {
+                    end_pos = body.find_first_of(",}", pos);
+                }
+
+                if (end_pos == std::string::npos) {
+                    return "";
+                }
+
+                return body.substr(pos, end_pos - pos);
+            };
+
+            std::string seconds_str = extract_value("seconds");
+            if (!seconds_str.empty()) {
+                seconds = std::stoi(seconds_str);
+            }
+
+            std::string format_str = extract_value("format");
+            if (!format_str.empty()) {
+                format = format_str;
+            }
+
+            std::string encoder_str = extract_value("encoder");
+            if (!encoder_str.empty()) {
+                encoder = encoder_str;
+            }
+
+            std::string bitrate_str = extract_value("bitrate");
+            if (!bitrate_str.empty()) {
+                bitrate = std::stoi(bitrate_str);
+            }
+        }
+
+        // 设置预录
+        if (setPreRoll(seconds, format, encoder, bitrate)) {
+            response.body = "{\"success\":true,\"pre_roll_seconds\":" + std::to_string(std::max(0, seconds)) + "}";
+        } else {
+            response.status_code = 500;
+            response.body = "{\"success\":false,\"error\":\"无法开始预录\"}";
+        }
+    } catch (const std::exception& e) {
+        response.status_code = 500;
+        response.body = "{\"success\":false,\"error\":\"" + std::string(e.what()) + "\"}";
+    }
+
+    return response;
+}
+
+// 获取流分辨率档位
+HttpResponse CameraApi::handleGetStreamTiers(const HttpRequest& /*request*/) {
+    HttpResponse response;
+    response.status_code = 200;
+    response.content_type = "application/json";
+
+    // 流处理器在第一个MJPEG请求时才初始化，此前按配置返回
+    StreamLadder ladder = mjpeg_streamer_.getLadder();
+    if (ladder.empty()) {
+        ladder = StreamLadder(StreamLadder::parse(
+            utils::ConfigManager::getInstance().getString("stream.ladder", ""), 80));
+    }
+    // 浏览器通过HTTP访问时可以改用独立端口的MJPEG引擎
+    auto& engine = MjpegHttpEngine::getInstance();
+    response.body = "{\"success\":true,\"tiers\":" + ladder.toJson() +
+                    ",\"mjpeg_engine\":{\"enabled\":" + (engine.isRunning() ? "true" : "false") +
+                    ",\"port\":" + std::to_string(engine.isRunning() ? engine.getPort() : 0) +
+                    ",\"path\":\"/mjpeg\"}}";
+    return response;
+}
+
+// 切换MJPEG客户端的分辨率档位，不需要重新连接
+HttpResponse CameraApi::handleSetStreamTier(const HttpRequest& request) {
+    HttpResponse response;
+    response.content_type = "application/json";
+
+    auto client_it = request.query_params.find("client_id");
+    auto tier_it = request.query_params.find("tier");
+    if (client_it == request.query_params.end() || tier_it == request.query_params.end()) {
+        response.status_code = 400;
+        response.body = "{\"success\":false,\"error\":\"缺少client_id或tier参数\"}";
+        return response;
+    }
+
+    if (!mjpeg_streamer_.getLadder().find(tier_it->second) &&
+        !MjpegHttpEngine::getInstance().getLadder().find(tier_it->second)) {
+        response.status_code = 400;
+        response.body = "{\"success\":false,\"error\":\"未知的档位: " +
+                        utils::StringUtils::escapeJson(tier_it->second) + "\"}";
+        return response;
+    }
+    if (!mjpeg_streamer_.setClientTier(client_it->second, tier_it->second) &&
+        !MjpegHttpEngine::getInstance().setClientTier(client_it->second, tier_it->second)) {
+        response.status_code = 404;
+        response.body = "{\"success\":false,\"error\":\"找不到客户端: " +
+                        utils::StringUtils::escapeJson(client_it->second) + "\"}";
+        return response;
+    }
+
+    response.status_code = 200;
+    response.body = "{\"success\":true,\"client_id\":\"" + utils::StringUtils::escapeJson(client_it->second) +
+                    "\",\"tier\":\"" + utils::StringUtils::escapeJson(tier_it->second) + "\"}";
+    return response;
+}
+
+// MJPEG客户端上报播放延迟和积压帧数，供自适应控制使用
+HttpResponse CameraApi::handleStreamFeedback(const HttpRequest& request) {
+    HttpResponse response;
+    response.content_type = "application/json";
+
+    auto client_it = request.query_params.find("client_id");
+    if (client_it == request.query_params.end()) {
+        response.status_code = 400;
+        response.body = "{\"success\":false,\"error\":\"缺少client_id参数\"}";
+        return response;
+    }
+
+    ClientFeedback feedback;
+    auto lag_it = request.query_params.find("lag_ms");
+    if (lag_it != request.query_params.end()) {
+        feedback.lag_ms = utils::StringUtils::toDouble(lag_it->second, -1.0);
+    }
+    auto buffered_it = request.query_params.find("buffered");
+    if (buffered_it != request.query_params.end()) {
+        feedback.buffered_frames = utils::StringUtils::toInt(buffered_it->second, -1);
+    }
+
+    if (!mjpeg_streamer_.onClientFeedback(client_it->second, feedback) &&
+        !MjpegHttpEngine::getInstance().onClientFeedback(client_it->second, feedback)) {
+        response.status_code = 404;
+        response.body = "{\"success\":false,\"error\":\"找不到客户端: " +
+                        utils::StringUtils::escapeJson(client_it->second) + "\"}";
+        return response;
+    }
+
+    response.status_code = 200;
+    response.body = "{\"success\":true}";
+    return response;
+}
+
+// 处理获取流水线统计请求
+HttpResponse CameraApi::handleGetPipelineStats(const HttpRequest& /*request*/) {
+    HttpResponse response;
+    response.status_code = 200;
+    response.content_type = "application/json";
+
+    try {
+        auto& camera_manager = camera::CameraManager::getInstance();
+        auto& pipeline_stats = camera::PipelineStats::getInstance();
+
+        auto write_queue = [](std::ostringstream& json, const camera::FrameMailboxStats& queue) {
+            json << "{";
+            json << "\"depth\":" << queue.depth << ",";
+            json << "\"capacity\":" << queue.capacity << ",";
+            json << "\"pushed_frames\":" << queue.pushed_frames << ",";
+            json << "\"dropped_frames\":" << queue.dropped_frames;
+            json << "}";
+        };
+
+        std::ostringstream json;
+        json << "{";
+        json << "\"success\":true,";
+
+        // 各阶段延迟直方图（微秒）
+        json << "\"stages\":{";
+        for (size_t i = 0; i < static_cast<size_t>(camera::PipelineStage::COUNT); ++i) {
+            auto stage = static_cast<camera::PipelineStage>(i);
+            auto snapshot = pipeline_stats.getStageSnapshot(stage);
+            if (i > 0) json << ",";
+            json << "\"" << camera::pipelineStageName(stage) << "\":{";
+            json << "\"count\":" << snapshot.count << ",";
+            json << "\"min_us\":" << snapshot.min << ",";
+            json << "\"mean_us\":" << std::fixed << std::setprecision(1) << snapshot.mean << ",";
+            json << "\"p50_us\":" << snapshot.p50 << ",";
+            json << "\"p90_us\":" << snapshot.p90 << ",";
+            json << "\"p99_us\":" << snapshot.p99 << ",";
+            json << "\"p999_us\":" << snapshot.p999 << ",";
+            json << "\"max_us\":" << snapshot.max;
+            json << "}";
+        }
+        json << "},";
+
+        // 驱动丢帧（帧序号不连续）和设备拉取队列
+        auto driver_drops = pipeline_stats.getDriverDrops();
+        uint64_t driver_drop_total = 0;
+        json << "\"cameras\":[";
+        bool first = true;
+        for (const auto& camera_id : camera_manager.getCameraIds()) {
+            uint64_t drops = driver_drops.count(camera_id) ? driver_drops[camera_id] : 0;
+            if (!first) json << ",";
+            first = false;
+            json << "{";
+            json << "\"id\":\"" << camera_id << "\",";
+            json << "\"driver_drops\":" << drops << ",";
+            json << "\"pull_queue\":";
+            write_queue(json, camera_manager.getFrameQueueStats(camera_id));
+
+            // 驱动缓冲区数量及自动调整依据
+            auto device = camera_manager.getDevice(camera_id);
+            if (device) {
+                auto buffers = device->getBufferStats();
+                json << ",\"buffers\":{";
+                json << "\"count\":" << buffers.buffer_count << ",";
+                json << "\"recommended\":" << buffers.recommended_count << ",";
+                json << "\"starved_frames\":" << buffers.starved_frames << ",";
+                json << "\"hold_p99_us\":" << buffers.hold_p99_us << ",";
+                json << "\"dequeue_jitter_p99_us\":" << buffers.dequeue_jitter_p99_us;
+                json << "}";
+            }
+
+            // 格式协商结果和各订阅者的转换路径
+            auto plan = camera_manager.getFormatPlan(camera_id);
+            if (plan.valid) {
+                json << ",\"format_plan\":{";
+                json << "\"format\":\"" << camera::FormatUtils::getPixelFormatName(plan.format) << "\",";
+                json << "\"width\":" << plan.width << ",";
+                json << "\"height\":" << plan.height << ",";
+                json << "\"fps\":" << plan.fps << ",";
+                json << "\"cost\":" << std::fixed << std::setprecision(2) << plan.cost << ",";
+                json << "\"pending\":" << (plan.pending ? "true" : "false") << ",";
+                json << "\"routes\":[";
+                for (size_t i = 0; i < plan.routes.size(); ++i) {
+                    if (i > 0) json << ",";
+                    json << "{\"consumer\":\"" << plan.routes[i].consumer << "\",";
+                    json << "\"input\":\"" << camera::FormatNegotiator::consumerKindName(plan.routes[i].kind) << "\",";
+                    json << "\"conversion\":\"" << plan.routes[i].conversion << "\"}";
+                }
+                json << "]}";
+            }
+            json << "}";
+        }
+        for (const auto& pair : driver_drops) {
+            driver_drop_total += pair.second;
+        }
+        json << "],";
+
+        // 订阅者队列溢出即流水线丢帧
+        uint64_t pipeline_drop_total = 0;
+        json << "\"subscribers\":[";
+        first = true;
+        for (const auto& subscriber : camera_manager.getFrameSubscriberStats()) {
+            pipeline_drop_total += subscriber.queue.dropped_frames;
+            if (!first) json << ",";
+            first = false;
+            json << "{";
+            json << "\"id\":" << subscriber.id << ",";
+            json << "\"name\":\"" << subscriber.name << "\",";
+            json << "\"delivered_frames\":" << subscriber.delivered_frames << ",";
+            json << "\"queue\":";
+            write_queue(json, subscriber.queue);
+            json << "}";
+        }
+        json << "],";
+
+        // 编码帧缓存：命中和等待都表示省去了一次重复编码
+        auto cache = video::EncodedFrameCache::getInstance().getStats();
+        json << "\"encoded_frame_cache\":{";
+        json << "\"hits\":" << cache.hits << ",";
+        json << "\"waits\":" << cache.waits << ",";
+        json << "\"encodes\":" << cache.encodes << ",";
+        json << "\"passthrough\":" << cache.passthrough << ",";
+        json << "\"failures\":" << cache.failures << ",";
+        json << "\"uncached\":" << cache.uncached;
+        json << "},";
+
+        // 各流客户端的发送队列：慢客户端只丢自己的帧
+        auto client_stats = mjpeg_streamer_.getClientSendStats();
+        auto ws_client_stats = WebSocketCameraStreamer::getInstance().getClientSendStats();
+        client_stats.insert(client_stats.end(), ws_client_stats.begin(), ws_client_stats.end());
+        auto engine_client_stats = MjpegHttpEngine::getInstance().getClientSendStats();
+        client_stats.insert(client_stats.end(), engine_client_stats.begin(), engine_client_stats.end());
+        uint64_t client_drop_total = 0;
+        json << "\"clients\":[";
+        first = true;
+        for (const auto& client : client_stats) {
+            client_drop_total += client.dropped_frames;
+            if (!first) json << ",";
+            first = false;
+            json << "{";
+            json << "\"id\":\"" << client.client_id << "\",";
+            json << "\"transport\":\"" << client.transport << "\",";
+            json << "\"tier\":\"" << client.tier << "\",";
+            json << "\"queued_frames\":" << client.queued_frames << ",";
+            json << "\"sent_frames\":" << client.sent_frames << ",";
+            json << "\"dropped_frames\":" << client.dropped_frames << ",";
+            json << "\"depth\":" << client.depth << ",";
+            json << "\"capacity\":" << client.capacity << ",";
+            json << "\"fps\":" << std::fixed << std::setprecision(1) << client.fps << ",";
+            json << "\"target_fps\":" << client.target_fps << ",";
+            json << "\"latency_ms\":" << client.latency_ms;
+            json << "}";
+        }
+        json << "],";
+
+        // 瓦片增量流相对整帧MJPEG的带宽和处理开销，全帧刷新的耗时近似整帧编码的开销
+        json << "\"tile_streams\":{";
+        first = true;
+        for (const auto& pair : WebSocketCameraStreamer::getInstance().getTileStats()) {
+            const auto& tiles = pair.second;
+            if (!first) json << ",";
+            first = false;
+            json << "\"" << pair.first << "\":{";
+            json << "\"frames\":" << tiles.frames << ",";
+            json << "\"skipped_frames\":" << tiles.skipped_frames << ",";
+            json << "\"full_frames\":" << tiles.full_frames << ",";
+            json << "\"tiles_sent\":" << tiles.tiles_sent << ",";
+            json << "\"bytes_sent\":" << tiles.bytes_sent << ",";
+            json << "\"mjpeg_bytes\":" << tiles.mjpeg_bytes << ",";
+            json << "\"bandwidth_ratio\":" << std::fixed << std::setprecision(3)
+                 << (tiles.mjpeg_bytes > 0 ? static_cast<double>(tiles.bytes_sent) / tiles.mjpeg_bytes : 0.0) << ",";
+            json << "\"mean_process_us\":" << std::setprecision(1)
+                 << (tiles.frames > 0 ? static_cast<double>(tiles.process_us) / tiles.frames : 0.0) << ",";
+            json << "\"mean_full_us\":"
+                 << (tiles.full_frames > 0 ? static_cast<double>(tiles.full_us) / tiles.full_frames : 0.0);
+            json << "}";
+        }
+        json << "},";
+
+        json << "\"drops\":{";
+        json << "\"driver\":" << driver_drop_total << ",";
+        json << "\"pipeline\":" << pipeline_drop_total << ",";
+        json << "\"client\":" << client_drop_total;
+        json << "}";
+
+        json << "}";
+        response.body = json.str();
+    } catch (const std::exception& e) {
+        response.status_code = 500;
+        response.body = "{\"success\":false,\"error\":\"" + std::string(e.what()) + "\"}";
+    }
+
+    return response;
+}
+
 // 处理获取摄像头状态请求
 HttpResponse CameraApi::handleGetCameraStatus(const HttpRequest& /*request*/) {
     try {
@@ -1004,6 +1495,14 @@ HttpResponse CameraApi::handleGetCameraStatus(const HttpRequest& /*request*/) {
                 json << "\"contrast\":" << params.contrast << ",";
                 json << "\"saturation\":" << params.saturation << ",";
                 json << "\"exposure\":" << params.exposure;
+                json << "},";
+
+                const auto queue_stats = camera_manager.getFrameQueueStats();
+                json << "\"frame_queue\":{";
+                json << "\"depth\":" << queue_stats.depth << ",";
+                json << "\"capacity\":" << queue_stats.capacity << ",";
+                json << "\"pushed_frames\":" << queue_stats.pushed_frames << ",";
+                json << "\"dropped_frames\":" << queue_stats.dropped_frames;
                 json << "}";
             } catch (const std::exception& e) {
                 LOG_ERROR("获取设备信息失败: " + std::string(e.what()), "CameraApi");
@@ -1072,6 +1571,13 @@ HttpResponse CameraApi::handleMjpegStream(const HttpRequest& request) {
         camera_id = it->second;
     }
 
+    // 分辨率档位，如tier=quarter用于缩略图
+    std::string tier;
+    it = request.query_params.find("tier");
+    if (it != request.query_params.end()) {
+        tier = it->second;
+    }
+
     LOG_INFO("收到MJPEG流请求: client_id=" + client_id + ", camera_id=" + camera_id, "CameraApi");
 
     // 检查摄像头是否已打开
@@ -1089,6 +1595,12 @@ HttpResponse CameraApi::handleMjpegStream(const HttpRequest& request) {
     config.jpeg_quality = 80;
     config.max_fps = 30;
     config.max_clients = 10;  // 增加最大客户端数量
+    config.ladder = StreamLadder::parse(utils::ConfigManager::getInstance().getString("stream.ladder", ""),
+                                        config.jpeg_quality);
+    config.adaptive.enabled = utils::ConfigManager::getInstance().getBool("stream.adaptive", true);
+    config.adaptive.min_fps = utils::ConfigManager::getInstance().getDouble("stream.adaptive_min_fps", 2.0);
+    config.adaptive.high_latency_ms =
+        utils::ConfigManager::getInstance().getDouble("stream.adaptive_max_latency_ms", 250.0);
     if (!mjpeg_streamer_.initialize(config)) {
         response.status_code = 500;
         response.content_type = "application/json";
@@ -1114,7 +1626,7 @@ HttpResponse CameraApi::handleMjpegStream(const HttpRequest& request) {
     LOG_DEBUG("创建连接状态跟踪器，初始状态: true", "CameraApi");
 
     // 添加流回调
-    response.stream_callback = [this, client_id, camera_id, connection_ok, connection_established](std::function<void(const std::vector<uint8_t>&)> write_callback) {
+    response.stream_callback = [this, client_id, camera_id, tier, connection_ok, connection_established](std::function<void(const std::vector<uint8_t>&)> write_callback) {
         LOG_DEBUG("进入流回调，客户端ID: " + client_id, "CameraApi");
         LOG_INFO("开始设置MJPEG流客户端: " + client_id, "CameraApi");
         
@@ -1256,7 +1768,8 @@ HttpResponse CameraApi::handleMjpegStream(const HttpRequest& request) {
                 if (auto conn = connection_weak.lock()) {
                     conn->store(false, std::memory_order_release);
                 }
-            }
+            },
+            tier
         );
         
         if (!client_added) {
@@ -1509,5 +2022,166 @@ HttpResponse CameraApi::handleStopPreview(const HttpRequest& /*request*/) {
     return response;
 }
 
+bool CameraApi::resolveVideoTime(const HttpRequest& request, const std::string& seconds_key,
+                                 const std::string& wall_key, std::string& video_path, double& seconds,
+                                 int& status_code, std::string& error) const {
+    // 指定系统时间时，在录像目录中查找索引覆盖该时间的录像
+    auto wall_it = request.query_params.find(wall_key);
+    if (wall_it != request.query_params.end()) {
+        int64_t wall_time_us = 0;
+        if (!parseWallTime(wall_it->second, wall_time_us)) {
+            status_code = 400;
+            error = "无法解析" + wall_key + "参数";
+            return false;
+        }
+
+        // 每个索引只读首尾两项挑出一个录像：优先首尾范围覆盖该时间的，其次是该时间之前最后开始的
+        // （时间可能落在最后一个关键帧之后的GOP中），只完整加载选中的索引
+        std::string best_path;
+        int64_t best_start_us = 0;
+        bool best_covers = false;
+        std::error_code ec;
+        for (const auto& item : fs::directory_iterator(videos_dir_, ec)) {
+            if (item.path().extension() != ".kfi") {
+                continue;
+            }
+            std::string candidate = (item.path().parent_path() / item.path().stem()).string();
+            video::KeyframeEntry first;
+            video::KeyframeEntry last;
+            if (!video::KeyframeIndex::readRange(candidate, first, last) || first.wall_time_us > wall_time_us) {
+                continue;
+            }
+            bool covers = wall_time_us <= last.wall_time_us;
+            if (best_path.empty() || (covers && !best_covers) ||
+                (covers == best_covers && first.wall_time_us > best_start_us)) {
+                best_path = candidate;
+                best_start_us = first.wall_time_us;
+                best_covers = covers;
+            }
+        }
+
+        video::KeyframeIndex index;
+        int64_t media_time_us = 0;
+        if (best_path.empty() || !fs::exists(best_path, ec) || !index.load(best_path) ||
+            !index.wallToMediaTime(wall_time_us, media_time_us)) {
+            status_code = 404;
+            error = "没有录像覆盖该时间";
+            return false;
+        }
+        video_path = best_path;
+        seconds = media_time_us / 1000000.0;
+        return true;
+    }
+
+    // 指定录像文件名和文件内时间，文件名只取最后一级，不允许访问录像目录之外
+    auto file_it = request.query_params.find("file");
+    auto seconds_it = request.query_params.find(seconds_key);
+    if (file_it == request.query_params.end() || seconds_it == request.query_params.end()) {
+        status_code = 400;
+        error = "缺少file和" + seconds_key + "参数，或" + wall_key + "参数";
+        return false;
+    }
+    std::string file_name = fs::path(file_it->second).filename().string();
+    video_path = videos_dir_ + "/" + file_name;
+    if (file_name.empty() || file_name == ".." || !fs::is_regular_file(video_path)) {
+        status_code = 404;
+        error = "录像不存在";
+        return false;
+    }
+    seconds = std::max(0.0, utils::StringUtils::toDouble(seconds_it->second, 0.0));
+    return true;
+}
+
+// 获取录像中指定时间的一帧（JPEG）
+HttpResponse CameraApi::handleGetVideoFrame(const HttpRequest& request) {
+    HttpResponse response;
+    response.content_type = "application/json";
+
+    std::string video_path;
+    double seconds = 0.0;
+    std::string error;
+    if (!resolveVideoTime(request, "t", "at", video_path, seconds, response.status_code, error)) {
+        response.body = "{\"success\":false,\"error\":\"" + error + "\"}";
+        return response;
+    }
+
+    int quality = 90;
+    auto quality_it = request.query_params.find("quality");
+    if (quality_it != request.query_params.end()) {
+        quality = std::max(1, std::min(100, utils::StringUtils::toInt(quality_it->second, 90)));
+    }
+
+    std::vector<uint8_t> jpeg_data;
+    if (!video_splitter_->extractFrameAt(video_path, seconds, jpeg_data, quality)) {
+        response.status_code = 500;
+        response.body = "{\"success\":false,\"error\":\"无法提取帧\"}";
+        return response;
+    }
+
+    response.status_code = 200;
+    response.content_type = "image/jpeg";
+    response.headers["X-Video-File"] = fs::path(video_path).filename().string();
+    response.headers["X-Video-Time"] = std::to_string(seconds);
+    response.body.assign(jpeg_data.begin(), jpeg_data.end());
+    return response;
+}
+
+// 导出录像片段，不重新编码
+HttpResponse CameraApi::handleExportVideoClip(const HttpRequest& request) {
+    HttpResponse response;
+    response.content_type = "application/json";
+
+    // 起点：file加start，或from；终点：end，或to（与起点在同一个录像中）
+    std::string video_path;
+    double start_seconds = 0.0;
+    std::string error;
+    if (!resolveVideoTime(request, "start", "from", video_path, start_seconds, response.status_code, error)) {
+        response.body = "{\"success\":false,\"error\":\"" + error + "\"}";
+        return response;
+    }
+    double end_seconds = -1.0;
+    auto end_it = request.query_params.find("end");
+    auto from_it = request.query_params.find("from");
+    auto to_it = request.query_params.find("to");
+    int64_t from_us = 0;
+    int64_t to_us = 0;
+    if (from_it != request.query_params.end() && to_it != request.query_params.end() &&
+        parseWallTime(from_it->second, from_us) && parseWallTime(to_it->second, to_us)) {
+        end_seconds = start_seconds + (to_us - from_us) / 1000000.0;
+    } else if (end_it != request.query_params.end()) {
+        end_seconds = utils::StringUtils::toDouble(end_it->second, -1.0);
+    }
+    if (end_seconds <= start_seconds) {
+        response.status_code = 400;
+        response.body = "{\"success\":false,\"error\":\"缺少终点或终点早于起点\"}";
+        return response;
+    }
+
+    // 片段保存在录像目录的clips子目录，扩展名与原录像相同
+    fs::path source(video_path);
+    std::string clips_dir = videos_dir_ + "/clips";
+    ensureDirectoryExists(clips_dir);
+    std::string clip_path = clips_dir + "/" + source.stem().string() + "_" +
+                            std::to_string(static_cast<int64_t>(start_seconds * 1000)) + "-" +
+                            std::to_string(static_cast<int64_t>(end_seconds * 1000)) + source.extension().string();
+    if (!video_splitter_->exportClip(video_path, start_seconds, end_seconds, clip_path)) {
+        response.status_code = 500;
+        response.body = "{\"success\":false,\"error\":\"导出片段失败\"}";
+        return response;
+    }
+
+    std::ostringstream json;
+    json << "{";
+    json << "\"success\":true,";
+    json << "\"file\":\"" << source.filename().string() << "\",";
+    json << "\"clip\":\"" << clip_path << "\",";
+    json << "\"start\":" << start_seconds << ",";
+    json << "\"end\":" << end_seconds;
+    json << "}";
+    response.status_code = 200;
+    response.body = json.str();
+    return response;
+}
+
 } // namespace api
 } // namespace cam_server
@@ -0,0 +1,136 @@
+#include "../../include/api/client_send_queue.h"
+
+#include <algorithm>
+
+namespace cam_server {
+namespace api {
+
+ClientSendMeter::ClientSendMeter(size_t capacity)
+    : window_frames_(0),
+      window_start_(std::chrono::steady_clock::now()) {
+    stats_.capacity = capacity;
+}
+
+void ClientSendMeter::onQueued() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.queued_frames++;
+    stats_.depth++;
+}
+
+void ClientSendMeter::onCompleted(bool sent, int64_t latency_us) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stats_.depth > 0) {
+        stats_.depth--;
+    }
+    if (sent) {
+        stats_.sent_frames++;
+        window_frames_++;
+        if (latency_us >= 0) {
+            // 指数平均，最近的帧权重更大
+            double latency_ms = latency_us / 1000.0;
+            stats_.latency_ms = stats_.sent_frames == 1 ? latency_ms : stats_.latency_ms * 0.8 + latency_ms * 0.2;
+        }
+    } else {
+        stats_.dropped_frames++;
+    }
+    updateFps(now);
+}
+
+ClientSendStats ClientSendMeter::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ClientSendStats stats = stats_;
+    // 客户端长时间没有发送完成时，帧率按当前窗口估算，避免停留在旧值
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - window_start_).count();
+    if (elapsed >= 2.0) {
+        stats.fps = window_frames_ / elapsed;
+    }
+    return stats;
+}
+
+void ClientSendMeter::updateFps(std::chrono::steady_clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - window_start_).count();
+    if (elapsed >= 1.0) {
+        stats_.fps = window_frames_ / elapsed;
+        window_frames_ = 0;
+        window_start_ = now;
+    }
+}
+
+ClientSendQueue::ClientSendQueue(size_t capacity)
+    : capacity_(std::max<size_t>(1, capacity)),
+      closed_(false),
+      meter_(std::max<size_t>(1, capacity)) {
+}
+
+bool ClientSendQueue::push(SendPayload payload) {
+    SendPayload dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) {
+            return false;
+        }
+        if (queue_.size() >= capacity_) {
+            dropped = std::move(queue_.front().payload);
+            queue_.pop_front();
+            meter_.onCompleted(false);
+        }
+        queue_.push_back(PendingPayload{std::move(payload), std::chrono::steady_clock::now()});
+        meter_.onQueued();
+    }
+    cv_.notify_one();
+    // dropped在锁外释放
+    return true;
+}
+
+bool ClientSendQueue::pop(SendPayload& payload, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cv_.wait_for(lock, timeout, [this]() { return closed_ || !queue_.empty(); })) {
+        return false;
+    }
+    if (closed_) {
+        return false;
+    }
+    payload = std::move(queue_.front().payload);
+    sending_since_ = queue_.front().queued_time;
+    queue_.pop_front();
+    return true;
+}
+
+void ClientSendQueue::markSent(bool sent) {
+    std::chrono::steady_clock::time_point since;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        since = sending_since_;
+    }
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since);
+    meter_.onCompleted(sent, latency.count());
+}
+
+void ClientSendQueue::close() {
+    std::deque<PendingPayload> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+        pending.swap(queue_);
+        for (size_t i = 0; i < pending.size(); i++) {
+            meter_.onCompleted(false);
+        }
+    }
+    cv_.notify_all();
+}
+
+bool ClientSendQueue::isClosed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+}
+
+ClientSendStats ClientSendQueue::getStats() const {
+    return meter_.getStats();
+}
+
+} // namespace api
+} // namespace cam_server
@@ -1,4 +1,5 @@
 #include "../../include/api/crow_server.h"
+#include "../../include/api/client_send_queue.h"
 #include "../../include/monitor/logger.h"
 #include "../../include/utils/file_utils.h"
 #include "../../include/system/system_monitor.h"
@@ -14,16 +15,23 @@
 #include <chrono>
 #include <atomic>
 #include <memory>
+#include <vector>
 
 namespace cam_server {
 namespace api {
 
 // 简化的WebSocket连接信息
+// 发送时只持有该连接自己的send_mutex，连接关闭时在同一把锁下将ws置空，
+// 因此发送路径不需要持有全局连接表锁，也不会向已销毁的连接发送。
+// close()可能在IO线程中同步触发onclose，所以使用递归锁
 struct SimpleWebSocketConnection {
     std::string client_id;
     crow::websocket::connection* ws;
     bool is_connected;
     std::chrono::steady_clock::time_point last_activity;
+    std::recursive_mutex send_mutex;
+    // 视频帧的发送统计；连接写队列中最多一帧在写、一帧等待
+    std::shared_ptr<ClientSendMeter> frame_meter = std::make_shared<ClientSendMeter>(2);
 };
 
 // CrowServer的简化实现
@@ -170,51 +178,100 @@ public:
     }
 
     void registerWebSocketHandler(
-        [[maybe_unused]] const std::string& path,
-        [[maybe_unused]] std::function<void(std::string_view, void*, bool, std::string)> message_handler,
-        [[maybe_unused]] std::function<void(std::string)> open_handler,
-        [[maybe_unused]] std::function<void(std::string, int, std::string_view)> close_handler) {
+        const std::string& path,
+        std::function<void(std::string_view, void*, bool, std::string)> message_handler,
+        std::function<void(std::string)> open_handler,
+        std::function<void(std::string, int, std::string_view)> close_handler) {
 
         LOG_DEBUG("注册WebSocket处理器，路径: " + path, "CrowServer");
-        // 简化版本暂时不实现动态注册
+        // 路由在启动时固定创建，这里只登记处理函数，由已有路由在收到事件时调用
+        std::lock_guard<std::mutex> lock(ws_handlers_mutex_);
+        ws_handlers_[path] = WebSocketHandlers{std::move(message_handler), std::move(open_handler),
+                                               std::move(close_handler)};
     }
 
     void broadcastWebSocketMessage(const std::string& path, const std::string& message, bool is_binary) {
-        std::lock_guard<std::mutex> lock(ws_connections_mutex_);
+        // 帧头和负载只构造一次，所有连接共享
+        auto payload = std::make_shared<const std::string>(message);
+        auto shared = crow::websocket::shared_message::make(is_binary ? 0x2 : 0x1, payload,
+                                                            payload->data(), payload->size());
+        size_t sent = sendShared(snapshotConnections(nullptr), shared);
+
+        LOG_DEBUG("广播消息到路径: " + path + ", 长度: " + std::to_string(message.size()) +
+                  ", 客户端数: " + std::to_string(sent), "CrowServer");
+    }
 
-        for (auto& [client_id, conn] : ws_connections_) {
-            if (conn.is_connected && conn.ws) {
-                try {
-                    if (is_binary) {
-                        conn.ws->send_binary(message);
-                    } else {
-                        conn.ws->send_text(message);
-                    }
-                    request_count_++;
-                } catch (const std::exception& e) {
-                    LOG_ERROR("广播消息失败: " + std::string(e.what()), "CrowServer");
-                    error_count_++;
-                }
+    size_t broadcastWebSocketPayload(const std::vector<std::string>& client_ids,
+                                     std::shared_ptr<const std::vector<uint8_t>> payload, bool is_binary,
+                                     bool latest_only, const std::string& prefix) {
+        if (!payload || client_ids.empty()) {
+            return 0;
+        }
+        const char* data = reinterpret_cast<const char*>(payload->data());
+        size_t size = payload->size();
+        auto shared = crow::websocket::shared_message::make(is_binary ? 0x2 : 0x1, std::move(payload), data, size);
+        if (!prefix.empty()) {
+            // 前缀跟在WebSocket帧头之后一起写出，帧长度包含前缀
+            shared.header = std::make_shared<const std::string>(
+                crow::websocket::build_frame_header(is_binary ? 0x2 : 0x1, prefix.size() + size) + prefix);
+        }
+        // JPEG帧只保留最新的：慢客户端还没开始写的旧帧直接被替换，不会在写队列中堆积
+        shared.latest_only = latest_only;
+
+        size_t sent = 0;
+        for (const auto& conn : snapshotConnections(&client_ids)) {
+            auto meter = conn->frame_meter;
+            auto queued_time = std::chrono::steady_clock::now();
+            shared.on_complete = [meter, queued_time](bool written) {
+                auto latency = std::chrono::steady_clock::now() - queued_time;
+                meter->onCompleted(written, std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+            };
+            meter->onQueued();
+            if (sendShared({conn}, shared) == 0) {
+                meter->onCompleted(false);
+                continue;
             }
+            sent++;
         }
+        return sent;
+    }
 
-        LOG_DEBUG("广播消息到路径: " + path + ", 长度: " + std::to_string(message.size()), "CrowServer");
+    std::vector<ClientSendStats> getWebSocketClientStats() {
+        std::vector<ClientSendStats> stats;
+        for (const auto& conn : snapshotConnections(nullptr)) {
+            ClientSendStats client_stats = conn->frame_meter->getStats();
+            client_stats.client_id = conn->client_id;
+            client_stats.transport = "websocket";
+            stats.push_back(client_stats);
+        }
+        return stats;
     }
 
     bool sendWebSocketMessage(const std::string& client_id, const std::string& message, bool is_binary) {
-        std::lock_guard<std::mutex> lock(ws_connections_mutex_);
+        std::shared_ptr<SimpleWebSocketConnection> conn;
+        {
+            std::lock_guard<std::mutex> lock(ws_connections_mutex_);
+            auto it = ws_connections_.find(client_id);
+            if (it != ws_connections_.end()) {
+                conn = it->second;
+            }
+        }
 
-        auto it = ws_connections_.find(client_id);
-        if (it == ws_connections_.end() || !it->second.is_connected || !it->second.ws) {
+        if (!conn) {
             LOG_WARNING("找不到客户端: " + client_id, "CrowServer");
             return false;
         }
 
         try {
+            std::lock_guard<std::recursive_mutex> send_lock(conn->send_mutex);
+            if (!conn->is_connected || !conn->ws) {
+                LOG_WARNING("客户端已断开: " + client_id, "CrowServer");
+                return false;
+            }
             if (is_binary) {
-                it->second.ws->send_binary(message);
+                conn->ws->send_binary(message);
             } else {
-                it->second.ws->send_text(message);
+                conn->ws->send_text(message);
             }
             request_count_++;
 
@@ -228,17 +285,27 @@ public:
     }
 
     bool disconnectClient(const std::string& client_id) {
-        std::lock_guard<std::mutex> lock(ws_connections_mutex_);
-
-        auto it = ws_connections_.find(client_id);
-        if (it == ws_connections_.end() || !it->second.is_connected || !it->second.ws) {
+        std::shared_ptr<SimpleWebSocketConnection> conn;
+        {
+            std::lock_guard<std::mutex> lock(ws_connections_mutex_);
+            auto it = ws_connections_.find(client_id);
+            if (it != ws_connections_.end()) {
+                conn = it->second;
+            }
+        }
+        if (!conn) {
             LOG_WARNING("找不到要断开的客户端: " + client_id, "CrowServer");
             return false;
         }
 
         try {
-            it->second.ws->close();
-            it->second.is_connected = false;
+            std::lock_guard<std::recursive_mutex> send_lock(conn->send_mutex);
+            if (!conn->is_connected || !conn->ws) {
+                LOG_WARNING("客户端已断开: " + client_id, "CrowServer");
+                return false;
+            }
+            conn->ws->close();
+            conn->is_connected = false;
 
             LOG_DEBUG("断开客户端连接: " + client_id, "CrowServer");
             return true;
@@ -249,6 +316,115 @@ public:
     }
 
 private:
+    struct WebSocketHandlers {
+        std::function<void(std::string_view, void*, bool, std::string)> on_message;
+        std::function<void(std::string)> on_open;
+        std::function<void(std::string, int, std::string_view)> on_close;
+    };
+
+    // 取出路径上登记的处理函数，在锁外调用
+    WebSocketHandlers getHandlers(const std::string& path) {
+        std::lock_guard<std::mutex> lock(ws_handlers_mutex_);
+        auto it = ws_handlers_.find(path);
+        return it != ws_handlers_.end() ? it->second : WebSocketHandlers{};
+    }
+
+    // 查找连接对应的客户端ID
+    std::string clientIdOf(crow::websocket::connection& conn) {
+        std::lock_guard<std::mutex> lock(ws_connections_mutex_);
+        for (const auto& pair : ws_connections_) {
+            if (pair.second->ws == &conn) {
+                return pair.first;
+            }
+        }
+        return "";
+    }
+
+    // 在连接表锁下取出连接的引用，client_ids为空指针时取出全部连接
+    std::vector<std::shared_ptr<SimpleWebSocketConnection>> snapshotConnections(
+        const std::vector<std::string>* client_ids) {
+        std::vector<std::shared_ptr<SimpleWebSocketConnection>> connections;
+        std::lock_guard<std::mutex> lock(ws_connections_mutex_);
+        if (!client_ids) {
+            connections.reserve(ws_connections_.size());
+            for (const auto& pair : ws_connections_) {
+                connections.push_back(pair.second);
+            }
+            return connections;
+        }
+        connections.reserve(client_ids->size());
+        for (const auto& client_id : *client_ids) {
+            auto it = ws_connections_.find(client_id);
+            if (it != ws_connections_.end()) {
+                connections.push_back(it->second);
+            }
+        }
+        return connections;
+    }
+
+    // 将共享消息投递给各连接，只持有各连接自己的锁
+    size_t sendShared(const std::vector<std::shared_ptr<SimpleWebSocketConnection>>& connections,
+                      const crow::websocket::shared_message& message) {
+        size_t sent = 0;
+        for (const auto& conn : connections) {
+            std::lock_guard<std::recursive_mutex> send_lock(conn->send_mutex);
+            if (!conn->is_connected || !conn->ws) {
+                continue;
+            }
+            try {
+                conn->ws->send_shared(message);
+                request_count_++;
+                sent++;
+            } catch (const std::exception& e) {
+                LOG_ERROR("广播消息失败: " + std::string(e.what()), "CrowServer");
+                error_count_++;
+            }
+        }
+        return sent;
+    }
+
+    // 注册新连接
+    std::string addConnection(crow::websocket::connection& conn) {
+        auto ws_conn = std::make_shared<SimpleWebSocketConnection>();
+        ws_conn->client_id = generateClientId();
+        ws_conn->ws = &conn;
+        ws_conn->is_connected = true;
+        ws_conn->last_activity = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(ws_connections_mutex_);
+        ws_connections_[ws_conn->client_id] = ws_conn;
+        return ws_conn->client_id;
+    }
+
+    // 注销连接，返回后不会再有发送引用该连接
+    std::string removeConnection(crow::websocket::connection& conn) {
+        std::shared_ptr<SimpleWebSocketConnection> removed;
+        {
+            std::lock_guard<std::mutex> lock(ws_connections_mutex_);
+            for (auto it = ws_connections_.begin(); it != ws_connections_.end(); ++it) {
+                if (it->second->ws == &conn) {
+                    removed = it->second;
+                    ws_connections_.erase(it);
+                    break;
+                }
+            }
+        }
+        if (!removed) {
+            return "";
+        }
+
+        // 等待正在进行的发送结束，之后连接对象可以被Crow销毁
+        std::lock_guard<std::recursive_mutex> send_lock(removed->send_mutex);
+        removed->ws = nullptr;
+        removed->is_connected = false;
+        return removed->client_id;
+    }
+
+    size_t connectionCount() {
+        std::lock_guard<std::mutex> lock(ws_connections_mutex_);
+        return ws_connections_.size();
+    }
+
     // 设置基本路由
     void setupRoutes() {
         if (!app_ || !rest_handler_) {
@@ -312,36 +488,19 @@ private:
                   std::cout << "=== /ws WebSocket连接打开 ===" << std::endl;
                   std::cout << "远程IP: " << conn.get_remote_ip() << std::endl;
 
-                  std::lock_guard<std::mutex> lock(ws_connections_mutex_);
-
-                  // 生成客户端ID
-                  std::string client_id = generateClientId();
+                  // 生成客户端ID并存储连接信息
+                  std::string client_id = addConnection(conn);
 
-                  // 存储连接信息
-                  SimpleWebSocketConnection ws_conn;
-                  ws_conn.client_id = client_id;
-                  ws_conn.ws = &conn;
-                  ws_conn.is_connected = true;
-                  ws_conn.last_activity = std::chrono::steady_clock::now();
-                  ws_connections_[client_id] = ws_conn;
-
-                  std::cout << "客户端ID: " << client_id << ", 当前连接数: " << ws_connections_.size() << std::endl;
+                  std::cout << "客户端ID: " << client_id << ", 当前连接数: " << connectionCount() << std::endl;
               })
               .onclose([this](crow::websocket::connection& conn, const std::string& reason, uint16_t code) {
                   std::cout << "=== /ws WebSocket连接关闭 ===" << std::endl;
                   std::cout << "原因: " << reason << ", 代码: " << code << std::endl;
 
-                  std::lock_guard<std::mutex> lock(ws_connections_mutex_);
-
                   // 清理连接信息
-                  for (auto it = ws_connections_.begin(); it != ws_connections_.end(); ++it) {
-                      if (it->second.ws == &conn) {
-                          ws_connections_.erase(it);
-                          break;
-                      }
-                  }
+                  removeConnection(conn);
 
-                  std::cout << "当前连接数: " << ws_connections_.size() << std::endl;
+                  std::cout << "当前连接数: " << connectionCount() << std::endl;
               })
               .onmessage([this](crow::websocket::connection& conn, const std::string& data, [[maybe_unused]] bool is_binary) {
                   std::cout << "=== /ws 收到WebSocket消息 ===" << std::endl;
@@ -379,45 +538,44 @@ private:
                   std::cout << "=== /ws/camera WebSocket连接打开 ===" << std::endl;
                   std::cout << "远程IP: " << conn.get_remote_ip() << std::endl;
 
-                  std::lock_guard<std::mutex> lock(ws_connections_mutex_);
-
-                  // 生成客户端ID
-                  std::string client_id = generateClientId();
-
-                  // 存储连接信息
-                  SimpleWebSocketConnection ws_conn;
-                  ws_conn.client_id = client_id;
-                  ws_conn.ws = &conn;
-                  ws_conn.is_connected = true;
-                  ws_conn.last_activity = std::chrono::steady_clock::now();
-                  ws_connections_[client_id] = ws_conn;
+                  // 生成客户端ID并存储连接信息
+                  std::string client_id = addConnection(conn);
 
-                  std::cout << "摄像头客户端ID: " << client_id << ", 当前连接数: " << ws_connections_.size() << std::endl;
+                  std::cout << "摄像头客户端ID: " << client_id << ", 当前连接数: " << connectionCount() << std::endl;
 
                   // 通知WebSocket摄像头流处理器
-                  // TODO: 集成WebSocket摄像头流处理器
+                  auto handlers = getHandlers("/ws/camera");
+                  if (handlers.on_open) {
+                      handlers.on_open(client_id);
+                  }
               })
               .onclose([this](crow::websocket::connection& conn, const std::string& reason, uint16_t code) {
                   std::cout << "=== /ws/camera WebSocket连接关闭 ===" << std::endl;
                   std::cout << "原因: " << reason << ", 代码: " << code << std::endl;
 
-                  std::lock_guard<std::mutex> lock(ws_connections_mutex_);
-
                   // 清理连接信息
-                  for (auto it = ws_connections_.begin(); it != ws_connections_.end(); ++it) {
-                      if (it->second.ws == &conn) {
-                          std::cout << "移除摄像头客户端: " << it->second.client_id << std::endl;
-                          ws_connections_.erase(it);
-                          break;
+                  std::string client_id = removeConnection(conn);
+                  if (!client_id.empty()) {
+                      std::cout << "移除摄像头客户端: " << client_id << std::endl;
+                      auto handlers = getHandlers("/ws/camera");
+                      if (handlers.on_close) {
+                          handlers.on_close(client_id, code, reason);
                       }
                   }
 
-                  std::cout << "当前连接数: " << ws_connections_.size() << std::endl;
+                  std::cout << "当前连接数: " << connectionCount() << std::endl;
               })
               .onmessage([this](crow::websocket::connection& conn, const std::string& data, [[maybe_unused]] bool is_binary) {
                   std::cout << "=== /ws/camera 收到WebSocket消息 ===" << std::endl;
                   std::cout << "数据: " << data << std::endl;
 
+                  // 已登记处理函数时交给摄像头流处理器
+                  auto handlers = getHandlers("/ws/camera");
+                  if (handlers.on_message) {
+                      handlers.on_message(data, &conn, is_binary, clientIdOf(conn));
+                      return;
+                  }
+
                   // 处理摄像头控制消息
                   try {
                       std::cout << "收到摄像头命令: " << data << std::endl;
@@ -472,8 +630,12 @@ private:
     std::atomic<int64_t> error_count_;
 
     // WebSocket连接管理
-    std::unordered_map<std::string, SimpleWebSocketConnection> ws_connections_;
+    std::unordered_map<std::string, std::shared_ptr<SimpleWebSocketConnection>> ws_connections_;
     std::mutex ws_connections_mutex_;
+
+    // 按路径登记的WebSocket处理函数
+    std::unordered_map<std::string, WebSocketHandlers> ws_handlers_;
+    std::mutex ws_handlers_mutex_;
 };
 
 // CrowServer类实现
@@ -572,6 +734,16 @@ void CrowServer::broadcastWebSocketMessage(const std::string& path, const std::s
     impl_->broadcastWebSocketMessage(path, message, is_binary);
 }
 
+size_t CrowServer::broadcastWebSocketPayload(const std::vector<std::string>& client_ids,
+                                            std::shared_ptr<const std::vector<uint8_t>> payload, bool is_binary,
+                                            bool latest_only, const std::string& prefix) {
+    return impl_ ? impl_->broadcastWebSocketPayload(client_ids, std::move(payload), is_binary, latest_only, prefix) : 0;
+}
+
+std::vector<ClientSendStats> CrowServer::getWebSocketClientStats() const {
+    return impl_ ? impl_->getWebSocketClientStats() : std::vector<ClientSendStats>();
+}
+
 bool CrowServer::sendWebSocketMessage(const std::string& client_id, const std::string& message, bool is_binary) {
     return impl_ ? impl_->sendWebSocketMessage(client_id, message, is_binary) : false;
 }
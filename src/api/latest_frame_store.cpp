@@ -0,0 +1,121 @@
+#include "api/latest_frame_store.h"
+
+#include <algorithm>
+
+namespace cam_server {
+namespace api {
+
+LatestFrameStore& LatestFrameStore::getInstance() {
+    static LatestFrameStore instance;
+    return instance;
+}
+
+void LatestFrameStore::setConfig(const LatestFrameStoreConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+    config_.grace_period_ms = std::max(0, config_.grace_period_ms);
+    config_.refresh_interval_ms = std::max(1, config_.refresh_interval_ms);
+}
+
+LatestFrameStoreConfig LatestFrameStore::getConfig() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return config_;
+}
+
+LatestFrameStore::Clock::duration LatestFrameStore::maxFrameAge() const {
+    // 保持期内的档位按刷新间隔更新，留出几次刷新的余量
+    return std::max<Clock::duration>(std::chrono::seconds(2),
+                                     std::chrono::milliseconds(config_.refresh_interval_ms) * 4);
+}
+
+void LatestFrameStore::put(const std::string& camera_id, const std::string& tier, video::JpegBuffer jpeg,
+                           uint64_t capture_time_us, bool viewed) {
+    if (!jpeg) {
+        return;
+    }
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = cameras_[camera_id][tier];
+    entry.jpeg = std::move(jpeg);
+    entry.capture_time_us = capture_time_us;
+    entry.stored_time = now;
+    if (viewed) {
+        entry.viewed_time = now;
+    }
+}
+
+video::JpegBuffer LatestFrameStore::get(const std::string& camera_id, const std::string& tier,
+                                       uint64_t* capture_time_us) const {
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Entry* latest = nullptr;
+    for (const auto& camera : cameras_) {
+        if (!camera_id.empty() && camera.first != camera_id) {
+            continue;
+        }
+        auto it = camera.second.find(tier);
+        if (it != camera.second.end() && (!latest || it->second.stored_time > latest->stored_time)) {
+            latest = &it->second;
+        }
+    }
+    if (!latest || now - latest->stored_time > maxFrameAge()) {
+        return nullptr;
+    }
+    if (capture_time_us) {
+        *capture_time_us = latest->capture_time_us;
+    }
+    return latest->jpeg;
+}
+
+std::vector<std::string> LatestFrameStore::getTiersToRefresh(const std::string& camera_id) {
+    std::vector<std::string> tiers;
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto camera_it = cameras_.find(camera_id);
+    if (camera_it == cameras_.end()) {
+        return tiers;
+    }
+    auto grace = std::chrono::milliseconds(config_.grace_period_ms);
+    auto refresh = std::chrono::milliseconds(config_.refresh_interval_ms);
+    auto& entries = camera_it->second;
+    for (auto it = entries.begin(); it != entries.end();) {
+        // 保持期外的档位不再刷新，帧过时后丢弃
+        if (now - it->second.viewed_time > grace) {
+            if (now - it->second.stored_time > maxFrameAge()) {
+                it = entries.erase(it);
+                continue;
+            }
+        } else if (now - it->second.stored_time >= refresh) {
+            tiers.push_back(it->first);
+        }
+        ++it;
+    }
+    if (entries.empty()) {
+        cameras_.erase(camera_it);
+    }
+    return tiers;
+}
+
+bool LatestFrameStore::isWarm(const std::string& camera_id, const std::string& tier) const {
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto camera_it = cameras_.find(camera_id);
+    if (camera_it == cameras_.end()) {
+        return false;
+    }
+    auto it = camera_it->second.find(tier);
+    return it != camera_it->second.end() &&
+           now - it->second.viewed_time <= std::chrono::milliseconds(config_.grace_period_ms);
+}
+
+void LatestFrameStore::clear(const std::string& camera_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (camera_id.empty()) {
+        cameras_.clear();
+    } else {
+        cameras_.erase(camera_id);
+    }
+}
+
+} // namespace api
+} // namespace cam_server
@@ -0,0 +1,1058 @@
+#include "../../include/api/mjpeg_http_engine.h"
+#include "../../include/api/latest_frame_store.h"
+#include "../../include/camera/camera_manager.h"
+#include "../../include/camera/pipeline_stats.h"
+#include "../../include/monitor/logger.h"
+#include "../../include/utils/string_utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace cam_server {
+namespace api {
+
+namespace {
+
+// 请求头的最大长度，超过后直接断开
+constexpr size_t kMaxRequestSize = 8192;
+
+// 每次epoll_wait最多处理的事件数
+constexpr int kMaxEvents = 64;
+
+// epoll_wait超时，用于检查请求超时和停止标志
+constexpr int kEpollTimeoutMs = 200;
+
+// 超过该时间没有收到帧的摄像头视为未在预览
+constexpr int kCameraIdleTimeoutMs = 2000;
+
+// epoll事件数据中的保留键，连接从kFirstConnectionKey开始编号
+constexpr uint64_t kEventKey = 0;
+constexpr uint64_t kListenKey = 1;
+constexpr uint64_t kFirstConnectionKey = 2;
+
+// 每个分段JPEG后的结尾
+const char kPartTrailer[] = "\r\n";
+
+const char kStreamResponse[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: multipart/x-mixed-replace;boundary=frame\r\n"
+    "Cache-Control: no-cache, no-store, must-revalidate\r\n"
+    "Pragma: no-cache\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+const char kBusyResponse[] =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+// 解码URL中的%XX和+
+std::string urlDecode(const std::string& value) {
+    std::string result;
+    result.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '%' && i + 2 < value.size() &&
+            std::isxdigit(static_cast<unsigned char>(value[i + 1])) &&
+            std::isxdigit(static_cast<unsigned char>(value[i + 2]))) {
+            result += static_cast<char>(std::stoi(value.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else if (value[i] == '+') {
+            result += ' ';
+        } else {
+            result += value[i];
+        }
+    }
+    return result;
+}
+
+void parseQuery(const std::string& query, std::unordered_map<std::string, std::string>& params) {
+    for (const auto& item : utils::StringUtils::split(query, '&')) {
+        size_t pos = item.find('=');
+        if (pos == std::string::npos) {
+            params[urlDecode(item)] = "";
+        } else {
+            params[urlDecode(item.substr(0, pos))] = urlDecode(item.substr(pos + 1));
+        }
+    }
+}
+
+std::shared_ptr<const std::string> makeErrorResponse(int status, const std::string& reason, const std::string& error) {
+    // 错误信息可能包含请求路径，转义后再放入JSON
+    std::string body = "{\"error\":\"" + utils::StringUtils::escapeJson(error) + "\"}";
+    return std::make_shared<const std::string>(
+        "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n"
+        "\r\n" + body);
+}
+
+} // namespace
+
+// 单个HTTP连接，只由所属网络线程访问
+struct MjpegHttpEngine::Connection {
+    Connection(uint64_t connection_key, int socket_fd)
+        : key(connection_key), fd(socket_fd), meter(2) {}
+
+    uint64_t key;
+    int fd;
+    std::string id;
+    std::string camera_id;
+    std::string tier;                  // 修改时持有所属网络线程的stats_mutex_
+    double target_fps = 0.0;           // 修改时持有所属网络线程的stats_mutex_
+    std::string request;               // 已收到的请求头
+    Clock::time_point accepted_time;
+    bool streaming = false;            // 已发送响应头，开始推流
+    bool close_after_write = false;    // 写完当前数据后关闭（错误响应）
+    bool want_write = false;           // 是否已关注EPOLLOUT
+    Part writing;                      // 正在写的分段
+    size_t written = 0;                // 正在写的分段已写出的字节数
+    Part pending;                      // 等待写的最新分段
+    ClientSendMeter meter;
+    StreamRateController rate;
+};
+
+/**
+ * @brief 网络线程
+ *
+ * 每个线程一个epoll实例和一个eventfd，其他线程通过post投递任务、通过publish投递新帧，
+ * 然后用eventfd唤醒。连接只在本线程内访问，读写不需要加锁。
+ */
+class MjpegHttpEngine::Worker {
+public:
+    Worker(MjpegHttpEngine& engine, size_t index)
+        : engine_(engine), index_(index), epoll_fd_(-1), event_fd_(-1),
+          running_(false), next_key_(kFirstConnectionKey) {}
+
+    ~Worker() {
+        stop();
+    }
+
+    bool start() {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd_ < 0 || event_fd_ < 0) {
+            LOG_ERROR("创建epoll实例失败: " + std::string(strerror(errno)), "MjpegHttpEngine");
+            return false;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = kEventKey;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &ev);
+
+        running_ = true;
+        thread_ = std::thread(&Worker::run, this);
+        return true;
+    }
+
+    // 由本线程接受新连接，所有网络线程都已加入workers_后才能调用
+    bool addListener(int listen_fd) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = kListenKey;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+            LOG_ERROR("注册监听套接字失败: " + std::string(strerror(errno)), "MjpegHttpEngine");
+            return false;
+        }
+        return true;
+    }
+
+    void stop() {
+        running_ = false;
+        if (thread_.joinable()) {
+            wake();
+            thread_.join();
+        }
+        if (event_fd_ >= 0) {
+            ::close(event_fd_);
+            event_fd_ = -1;
+        }
+        if (epoll_fd_ >= 0) {
+            ::close(epoll_fd_);
+            epoll_fd_ = -1;
+        }
+    }
+
+    // 在网络线程中执行任务
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        wake();
+    }
+
+    // 投递一帧，网络线程来不及处理时只保留每个摄像头每个档位的最新帧
+    void publish(const std::string& camera_id, const std::string& tier, const Part& part) {
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex_);
+            frames_[std::make_pair(camera_id, tier)] = part;
+        }
+        wake();
+    }
+
+    void addConnection(int fd) {
+        auto conn = std::make_unique<Connection>(next_key_++, fd);
+        conn->accepted_time = Clock::now();
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u64 = conn->key;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            LOG_ERROR("注册连接失败: " + std::string(strerror(errno)), "MjpegHttpEngine");
+            ::close(fd);
+            engine_.connection_count_--;
+            return;
+        }
+        uint64_t key = conn->key;
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        connections_[key] = std::move(conn);
+    }
+
+    void setClientTier(const std::string& client_id, const std::string& tier) {
+        Connection* conn = findClient(client_id);
+        if (!conn) {
+            return;
+        }
+        conn->rate.setCeiling(tier);
+        changeTier(*conn, tier);
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            conn->target_fps = conn->rate.getTargetFps();
+        }
+        LOG_INFO("MJPEG客户端 " + client_id + " 切换到档位: " + tier, "MjpegHttpEngine");
+        queueLatestFrame(*conn);
+        if (!flush(*conn)) {
+            closeConnection(conn->key);
+        }
+    }
+
+    void onClientFeedback(const std::string& client_id, const ClientFeedback& feedback) {
+        Connection* conn = findClient(client_id);
+        if (conn) {
+            conn->rate.onFeedback(feedback, Clock::now());
+        }
+    }
+
+    void collectStats(std::vector<ClientSendStats>& stats) const {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        for (const auto& pair : connections_) {
+            const Connection& conn = *pair.second;
+            if (!conn.streaming) {
+                continue;
+            }
+            ClientSendStats client_stats = conn.meter.getStats();
+            client_stats.client_id = conn.id;
+            client_stats.transport = "mjpeg-epoll";
+            client_stats.tier = conn.tier;
+            client_stats.target_fps = conn.target_fps;
+            stats.push_back(client_stats);
+        }
+    }
+
+private:
+    void wake() {
+        uint64_t one = 1;
+        ssize_t ret = ::write(event_fd_, &one, sizeof(one));
+        (void)ret;
+    }
+
+    void run() {
+        LOG_DEBUG("MJPEG网络线程 " + std::to_string(index_) + " 启动", "MjpegHttpEngine");
+        epoll_event events[kMaxEvents];
+        while (running_) {
+            int count = epoll_wait(epoll_fd_, events, kMaxEvents, kEpollTimeoutMs);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOG_ERROR("epoll_wait失败: " + std::string(strerror(errno)), "MjpegHttpEngine");
+                break;
+            }
+
+            for (int i = 0; i < count; ++i) {
+                uint64_t key = events[i].data.u64;
+                if (key == kEventKey) {
+                    drainInbox();
+                    continue;
+                }
+                if (key == kListenKey) {
+                    engine_.acceptConnections();
+                    continue;
+                }
+
+                // 连接可能已在本轮前面的事件中关闭
+                auto it = connections_.find(key);
+                if (it == connections_.end()) {
+                    continue;
+                }
+                Connection& conn = *it->second;
+                uint32_t flags = events[i].events;
+                bool ok = (flags & (EPOLLERR | EPOLLHUP)) == 0;
+                if (ok && (flags & (EPOLLIN | EPOLLRDHUP))) {
+                    ok = handleReadable(conn);
+                }
+                if (ok && (flags & EPOLLOUT)) {
+                    ok = flush(conn);
+                }
+                if (!ok) {
+                    closeConnection(key);
+                }
+            }
+
+            closeExpired(Clock::now());
+        }
+
+        // 执行尚未执行的任务，已接受的连接也要正常关闭
+        drainInbox();
+        std::vector<uint64_t> keys;
+        for (const auto& pair : connections_) {
+            keys.push_back(pair.first);
+        }
+        for (uint64_t key : keys) {
+            closeConnection(key);
+        }
+        LOG_DEBUG("MJPEG网络线程 " + std::to_string(index_) + " 退出", "MjpegHttpEngine");
+    }
+
+    void drainInbox() {
+        uint64_t value = 0;
+        ssize_t ret = ::read(event_fd_, &value, sizeof(value));
+        (void)ret;
+
+        std::vector<std::function<void()>> tasks;
+        std::map<std::pair<std::string, std::string>, Part> frames;
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex_);
+            tasks.swap(tasks_);
+            frames.swap(frames_);
+        }
+        for (auto& task : tasks) {
+            task();
+        }
+        if (!frames.empty()) {
+            deliverFrames(frames);
+        }
+    }
+
+    // 把新帧交给本线程的各连接并尽量立即写出
+    void deliverFrames(const std::map<std::pair<std::string, std::string>, Part>& frames) {
+        auto now = Clock::now();
+        std::vector<uint64_t> to_close;
+        for (auto& pair : connections_) {
+            Connection& conn = *pair.second;
+            if (!conn.streaming || conn.close_after_write) {
+                continue;
+            }
+
+            // 按待写帧被替换的比例和写出延迟调整档位，并按目标帧率抽帧
+            if (conn.rate.needsUpdate(now)) {
+                if (conn.rate.update(conn.meter.getStats(), now)) {
+                    LOG_INFO("MJPEG客户端 " + conn.id + " 自适应切换档位: " + conn.tier + " -> " +
+                             conn.rate.getTier() + "，状态: " + conn.rate.getStateName(), "MjpegHttpEngine");
+                    changeTier(conn, conn.rate.getTier());
+                }
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                conn.target_fps = conn.rate.getTargetFps();
+            }
+
+            const Part* part = nullptr;
+            for (const auto& frame : frames) {
+                if (frame.first.second == conn.tier &&
+                    (conn.camera_id.empty() || frame.first.first.empty() || frame.first.first == conn.camera_id)) {
+                    part = &frame.second;
+                    break;
+                }
+            }
+            if (!part || !conn.rate.admitFrame(now)) {
+                continue;
+            }
+
+            // 上一帧还没开始写，直接用新帧替换
+            if (conn.pending.header) {
+                conn.meter.onCompleted(false);
+            }
+            conn.pending = *part;
+            conn.meter.onQueued();
+            if (!flush(conn)) {
+                to_close.push_back(pair.first);
+            }
+        }
+        for (uint64_t key : to_close) {
+            closeConnection(key);
+        }
+    }
+
+    // 读取请求头；推流开始后客户端发来的数据直接丢弃
+    bool handleReadable(Connection& conn) {
+        char buffer[4096];
+        while (true) {
+            ssize_t n = ::recv(conn.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                if (conn.streaming || conn.close_after_write) {
+                    continue;
+                }
+                conn.request.append(buffer, static_cast<size_t>(n));
+                if (conn.request.find("\r\n\r\n") != std::string::npos) {
+                    if (!handleRequest(conn)) {
+                        return false;
+                    }
+                } else if (conn.request.size() > kMaxRequestSize) {
+                    LOG_WARNING("MJPEG请求头过长，断开连接", "MjpegHttpEngine");
+                    return false;
+                }
+                continue;
+            }
+            if (n == 0) {
+                return false;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+
+    bool handleRequest(Connection& conn) {
+        std::string line = conn.request.substr(0, conn.request.find("\r\n"));
+        conn.request.clear();
+        conn.request.shrink_to_fit();
+
+        auto fields = utils::StringUtils::split(line, ' ');
+        if (fields.size() < 3 || fields[0] != "GET") {
+            return respondError(conn, 405, "Method Not Allowed", "只支持GET请求");
+        }
+        std::string path = fields[1];
+        std::string query;
+        size_t query_pos = path.find('?');
+        if (query_pos != std::string::npos) {
+            query = path.substr(query_pos + 1);
+            path = path.substr(0, query_pos);
+        }
+        if (path != "/mjpeg" && path != "/api/camera/mjpeg") {
+            return respondError(conn, 404, "Not Found", "未知路径: " + path);
+        }
+
+        std::unordered_map<std::string, std::string> params;
+        parseQuery(query, params);
+
+        // 按帧回调记录的收帧时间判断，网络线程不访问CameraManager，打开设备等操作持锁时不会阻塞
+        if (!engine_.isCameraStreaming(params["camera_id"])) {
+            LOG_ERROR("MJPEG流请求失败: 摄像头未打开或未在预览状态", "MjpegHttpEngine");
+            return respondError(conn, 400, "Bad Request", "摄像头未打开或未在预览状态");
+        }
+
+        std::string client_id = params["client_id"];
+        if (client_id.empty()) {
+            client_id = "client-" + utils::StringUtils::randomString(8);
+        }
+        std::string tier = engine_.ladder_.resolve(params["tier"]);
+
+        conn.camera_id = params["camera_id"];
+        conn.rate = StreamRateController(engine_.ladder_, engine_.config_.adaptive, tier);
+        // 不能在持有stats_mutex_时登记，统计接口按clients_mutex_、stats_mutex_的顺序加锁
+        std::string id = engine_.registerClient(client_id, this);
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            conn.id = id;
+            conn.tier = tier;
+            conn.target_fps = conn.rate.getTargetFps();
+            conn.streaming = true;
+        }
+        engine_.addDemand(conn.camera_id, conn.tier);
+
+        // 响应头直接作为第一段写出，不会被新帧替换，随后是保存的最新一帧
+        static const auto response = std::make_shared<const std::string>(kStreamResponse);
+        conn.writing = Part{response, nullptr, Clock::now()};
+        conn.written = 0;
+        queueLatestFrame(conn);
+
+        LOG_INFO("添加MJPEG客户端: " + conn.id + "，摄像头: " + (conn.camera_id.empty() ? "任意" : conn.camera_id) +
+                 "，档位: " + conn.tier + "，当前连接数: " + std::to_string(engine_.connection_count_.load()),
+                 "MjpegHttpEngine");
+        return flush(conn);
+    }
+
+    // 用保存的最新一帧替换待写帧，新观看者不等下一帧采集和编码
+    void queueLatestFrame(Connection& conn) {
+        video::JpegBuffer jpeg = LatestFrameStore::getInstance().get(conn.camera_id, conn.tier);
+        if (!jpeg) {
+            return;
+        }
+        if (conn.pending.header) {
+            conn.meter.onCompleted(false);
+        }
+        conn.pending = makePart(std::move(jpeg));
+        conn.meter.onQueued();
+    }
+
+    bool respondError(Connection& conn, int status, const std::string& reason, const std::string& error) {
+        conn.writing = Part{makeErrorResponse(status, reason, error), nullptr, Clock::now()};
+        conn.written = 0;
+        conn.close_after_write = true;
+        return flush(conn);
+    }
+
+    /**
+     * 写出正在写的分段和待写分段，直到写完或socket缓冲区满
+     * @return 连接需要关闭时返回false
+     */
+    bool flush(Connection& conn) {
+        while (true) {
+            if (!conn.writing.header) {
+                if (!conn.pending.header) {
+                    break;
+                }
+                conn.writing = std::move(conn.pending);
+                conn.pending = Part();
+                conn.written = 0;
+            }
+
+            // 分段头、JPEG和结尾用一次sendmsg写出，JPEG数据不拷贝
+            const std::string& header = *conn.writing.header;
+            const video::JpegBuffer& jpeg = conn.writing.jpeg;
+            size_t trailer_size = jpeg ? sizeof(kPartTrailer) - 1 : 0;
+            size_t total = header.size() + (jpeg ? jpeg->size() : 0) + trailer_size;
+
+            iovec iov[3];
+            int iov_count = 0;
+            size_t skip = conn.written;
+            auto add = [&](const void* data, size_t size) {
+                if (skip >= size) {
+                    skip -= size;
+                    return;
+                }
+                iov[iov_count].iov_base = const_cast<char*>(static_cast<const char*>(data)) + skip;
+                iov[iov_count].iov_len = size - skip;
+                skip = 0;
+                iov_count++;
+            };
+            add(header.data(), header.size());
+            if (jpeg) {
+                add(jpeg->data(), jpeg->size());
+                add(kPartTrailer, trailer_size);
+            }
+
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = static_cast<size_t>(iov_count);
+            ssize_t n = ::sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return setWriteInterest(conn, true);
+                }
+                LOG_DEBUG("MJPEG客户端写入失败: " + std::string(strerror(errno)) + ", client_id=" + conn.id,
+                          "MjpegHttpEngine");
+                if (jpeg) {
+                    conn.meter.onCompleted(false);
+                }
+                return false;
+            }
+
+            conn.written += static_cast<size_t>(n);
+            if (conn.written < total) {
+                continue;
+            }
+            if (jpeg) {
+                auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                    Clock::now() - conn.writing.queued_time).count();
+                conn.meter.onCompleted(true, latency);
+            }
+            conn.writing = Part();
+            conn.written = 0;
+            if (conn.close_after_write) {
+                return false;
+            }
+        }
+        return setWriteInterest(conn, false);
+    }
+
+    bool setWriteInterest(Connection& conn, bool enable) {
+        if (conn.want_write == enable) {
+            return true;
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        if (enable) {
+            ev.events |= EPOLLOUT;
+        }
+        ev.data.u64 = conn.key;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &ev) < 0) {
+            LOG_ERROR("修改连接事件失败: " + std::string(strerror(errno)), "MjpegHttpEngine");
+            return false;
+        }
+        conn.want_write = enable;
+        return true;
+    }
+
+    void changeTier(Connection& conn, const std::string& tier) {
+        if (conn.tier == tier) {
+            return;
+        }
+        engine_.removeDemand(conn.camera_id, conn.tier);
+        engine_.addDemand(conn.camera_id, tier);
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        conn.tier = tier;
+    }
+
+    Connection* findClient(const std::string& client_id) {
+        for (auto& pair : connections_) {
+            if (pair.second->streaming && pair.second->id == client_id) {
+                return pair.second.get();
+            }
+        }
+        return nullptr;
+    }
+
+    // 关闭迟迟不发请求头的连接
+    void closeExpired(Clock::time_point now) {
+        auto timeout = std::chrono::milliseconds(engine_.config_.request_timeout_ms);
+        std::vector<uint64_t> expired;
+        for (const auto& pair : connections_) {
+            if (!pair.second->streaming && now - pair.second->accepted_time > timeout) {
+                expired.push_back(pair.first);
+            }
+        }
+        for (uint64_t key : expired) {
+            closeConnection(key);
+        }
+    }
+
+    void closeConnection(uint64_t key) {
+        auto it = connections_.find(key);
+        if (it == connections_.end()) {
+            return;
+        }
+        Connection& conn = *it->second;
+        if (conn.streaming) {
+            engine_.removeDemand(conn.camera_id, conn.tier);
+            engine_.unregisterClient(conn.id);
+            LOG_INFO("MJPEG客户端断开连接: " + conn.id, "MjpegHttpEngine");
+        }
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn.fd, nullptr);
+        ::close(conn.fd);
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            connections_.erase(it);
+        }
+        engine_.connection_count_--;
+    }
+
+    MjpegHttpEngine& engine_;
+    size_t index_;
+    int epoll_fd_;
+    int event_fd_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+    uint64_t next_key_;
+
+    // 其他线程投递的任务和新帧
+    std::mutex inbox_mutex_;
+    std::vector<std::function<void()>> tasks_;
+    std::map<std::pair<std::string, std::string>, Part> frames_;
+
+    // 连接只在本线程内读写，增删连接和修改档位时持有stats_mutex_，供统计接口在其他线程读取
+    std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections_;
+    mutable std::mutex stats_mutex_;
+};
+
+MjpegHttpEngine& MjpegHttpEngine::getInstance() {
+    static MjpegHttpEngine instance;
+    return instance;
+}
+
+MjpegHttpEngine::MjpegHttpEngine()
+    : is_initialized_(false),
+      is_running_(false),
+      listen_fd_(-1),
+      next_worker_(0),
+      connection_count_(0),
+      frame_subscription_(0) {
+}
+
+MjpegHttpEngine::~MjpegHttpEngine() {
+    stop();
+}
+
+bool MjpegHttpEngine::initialize(const MjpegHttpEngineConfig& config) {
+    if (is_initialized_) {
+        LOG_DEBUG("MJPEG HTTP引擎已经初始化", "MjpegHttpEngine");
+        return true;
+    }
+
+    config_ = config;
+    if (config_.port <= 0 || config_.port > 65535) {
+        LOG_ERROR("无效的MJPEG HTTP引擎端口: " + std::to_string(config_.port), "MjpegHttpEngine");
+        return false;
+    }
+    if (config_.jpeg_quality <= 0 || config_.jpeg_quality > 100) {
+        config_.jpeg_quality = 80;
+    }
+    if (config_.max_fps <= 0) {
+        config_.max_fps = 30;
+    }
+    config_.num_threads = std::max(1, config_.num_threads);
+    config_.max_connections = std::max(1, config_.max_connections);
+
+    // 未配置阶梯时保持原来的单一输出
+    if (config_.ladder.empty()) {
+        StreamTier tier;
+        tier.name = "full";
+        tier.quality = config_.jpeg_quality;
+        config_.ladder.push_back(tier);
+    }
+    ladder_ = StreamLadder(config_.ladder);
+    if (ladder_.empty()) {
+        LOG_ERROR("没有有效的流档位", "MjpegHttpEngine");
+        return false;
+    }
+    config_.adaptive.max_fps = config_.max_fps;
+
+    is_initialized_ = true;
+    LOG_INFO("MJPEG HTTP引擎初始化成功，端口: " + std::to_string(config_.port) +
+             "，网络线程数: " + std::to_string(config_.num_threads), "MjpegHttpEngine");
+    return true;
+}
+
+bool MjpegHttpEngine::start() {
+    if (!is_initialized_) {
+        LOG_ERROR("MJPEG HTTP引擎未初始化", "MjpegHttpEngine");
+        return false;
+    }
+    if (is_running_) {
+        return true;
+    }
+
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        LOG_ERROR("创建监听套接字失败: " + std::string(strerror(errno)), "MjpegHttpEngine");
+        return false;
+    }
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(config_.port));
+    if (inet_pton(AF_INET, config_.address.c_str(), &addr.sin_addr) != 1) {
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    }
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listen_fd_, SOMAXCONN) < 0) {
+        LOG_ERROR("监听 " + config_.address + ":" + std::to_string(config_.port) + " 失败: " +
+                  std::string(strerror(errno)), "MjpegHttpEngine");
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    // 先启动所有网络线程，workers_完整后再注册监听套接字，接受连接时不会看到不完整的列表
+    bool started = true;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (int i = 0; i < config_.num_threads && started; ++i) {
+            auto worker = std::make_unique<Worker>(*this, static_cast<size_t>(i));
+            started = worker->start();
+            workers_.push_back(std::move(worker));
+        }
+        started = started && !workers_.empty() && workers_.front()->addListener(listen_fd_);
+    }
+    if (!started) {
+        // 监听套接字未注册，网络线程中没有连接，停止后即可释放
+        for (auto& worker : workers_) {
+            worker->stop();
+        }
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex_);
+            workers_.clear();
+        }
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    is_running_ = true;
+
+    // 订阅帧，编码在独立线程中进行，只保留最新帧以保持实时性
+    camera::FrameSubscriberOptions options;
+    options.queue_depth = 4;
+    options.drop_policy = camera::FrameDropPolicy::KEEP_LATEST;
+    options.consumer = camera::FrameConsumerKind::JPEG;
+    frame_subscription_ = camera::CameraManager::getInstance().subscribeFrames("mjpeg_http_engine",
+        [this](const camera::Frame& frame) {
+            handleFrame(frame);
+        }, options);
+
+    LOG_INFO("MJPEG HTTP引擎已启动: " + config_.address + ":" + std::to_string(config_.port), "MjpegHttpEngine");
+    return true;
+}
+
+bool MjpegHttpEngine::stop() {
+    if (!is_running_) {
+        return true;
+    }
+
+    // 先停止帧回调，之后不会再有线程访问workers_
+    camera::CameraManager::getInstance().unsubscribeFrames(frame_subscription_);
+    frame_subscription_ = 0;
+    is_running_ = false;
+
+    // 网络线程退出前关闭自己的所有连接
+    for (auto& worker : workers_) {
+        worker->stop();
+    }
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        workers_.clear();
+        client_workers_.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(demand_mutex_);
+        demand_.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(frame_times_mutex_);
+        last_frame_times_.clear();
+    }
+    if (listen_fd_ >= 0) {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+
+    LOG_INFO("MJPEG HTTP引擎已停止", "MjpegHttpEngine");
+    return true;
+}
+
+bool MjpegHttpEngine::setClientTier(const std::string& client_id, const std::string& tier) {
+    if (!ladder_.find(tier)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    auto it = client_workers_.find(client_id);
+    if (it == client_workers_.end()) {
+        return false;
+    }
+    Worker* worker = it->second;
+    worker->post([worker, client_id, tier]() {
+        worker->setClientTier(client_id, tier);
+    });
+    return true;
+}
+
+bool MjpegHttpEngine::onClientFeedback(const std::string& client_id, const ClientFeedback& feedback) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    auto it = client_workers_.find(client_id);
+    if (it == client_workers_.end()) {
+        return false;
+    }
+    Worker* worker = it->second;
+    worker->post([worker, client_id, feedback]() {
+        worker->onClientFeedback(client_id, feedback);
+    });
+    return true;
+}
+
+std::vector<ClientSendStats> MjpegHttpEngine::getClientSendStats() const {
+    std::vector<ClientSendStats> stats;
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (const auto& worker : workers_) {
+        worker->collectStats(stats);
+    }
+    return stats;
+}
+
+bool MjpegHttpEngine::isCameraStreaming(const std::string& camera_id) const {
+    auto deadline = Clock::now() - std::chrono::milliseconds(kCameraIdleTimeoutMs);
+    std::lock_guard<std::mutex> lock(frame_times_mutex_);
+    for (const auto& entry : last_frame_times_) {
+        if ((camera_id.empty() || entry.first == camera_id) && entry.second >= deadline) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MjpegHttpEngine::acceptConnections() {
+    while (true) {
+        int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR("接受连接失败: " + std::string(strerror(errno)), "MjpegHttpEngine");
+            }
+            return;
+        }
+
+        if (connection_count_.load() >= config_.max_connections) {
+            LOG_WARNING("MJPEG连接数已达上限: " + std::to_string(config_.max_connections), "MjpegHttpEngine");
+            ssize_t ret = ::send(fd, kBusyResponse, sizeof(kBusyResponse) - 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+            (void)ret;
+            ::close(fd);
+            continue;
+        }
+
+        // 分段结尾很短，关闭Nagle避免最后一段等待ACK
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        connection_count_++;
+        Worker* worker = workers_[next_worker_++ % workers_.size()].get();
+        worker->post([worker, fd]() {
+            worker->addConnection(fd);
+        });
+    }
+}
+
+void MjpegHttpEngine::handleFrame(const camera::Frame& frame) {
+    if (!is_running_) {
+        return;
+    }
+
+    const std::string& camera_id = frame.getCameraId();
+    {
+        std::lock_guard<std::mutex> lock(frame_times_mutex_);
+        last_frame_times_[camera_id] = Clock::now();
+    }
+
+    // 只编码有观看者和保持期内的档位，有观看者的在前
+    std::vector<std::string> tiers;
+    {
+        std::lock_guard<std::mutex> lock(demand_mutex_);
+        for (const auto& camera : demand_) {
+            if (!camera.first.empty() && !camera_id.empty() && camera.first != camera_id) {
+                continue;
+            }
+            for (const auto& tier : camera.second) {
+                if (std::find(tiers.begin(), tiers.end(), tier.first) == tiers.end()) {
+                    tiers.push_back(tier.first);
+                }
+            }
+        }
+    }
+
+    // 保持期内没有观看者的档位也低频刷新，保存的最新帧不会过时
+    size_t demand_tiers = tiers.size();
+    auto& latest_frames = LatestFrameStore::getInstance();
+    for (const auto& name : latest_frames.getTiersToRefresh(camera_id)) {
+        if (ladder_.find(name) && std::find(tiers.begin(), tiers.end(), name) == tiers.end()) {
+            tiers.push_back(name);
+        }
+    }
+    if (tiers.empty()) {
+        return;
+    }
+
+    if (frame.isEmpty() || frame.getWidth() <= 0 || frame.getHeight() <= 0 ||
+        frame.getFormat() == camera::PixelFormat::UNKNOWN) {
+        LOG_ERROR("无效帧数据 - 大小: " + std::to_string(frame.getDataSize()) +
+                  ", 宽度: " + std::to_string(frame.getWidth()) +
+                  ", 高度: " + std::to_string(frame.getHeight()), "MjpegHttpEngine");
+        return;
+    }
+
+    try {
+        // 同一帧的同一档位在各流和拍照接口之间只编码一次
+        camera::FrameLineage lineage = frame.getLineage();
+        lineage.encode_start_us = camera::FrameLineage::nowUs();
+        std::vector<std::pair<std::string, Part>> parts;
+        for (size_t i = 0; i < tiers.size(); ++i) {
+            const std::string& name = tiers[i];
+            const StreamTier* tier = ladder_.find(name);
+            if (!tier) {
+                continue;
+            }
+            int width = 0;
+            int height = 0;
+            StreamLadder::getOutputSize(*tier, frame.getWidth(), frame.getHeight(), width, height);
+            video::JpegBuffer jpeg = video::EncodedFrameCache::getInstance().getJpeg(frame, tier->quality, width, height);
+            if (!jpeg) {
+                LOG_ERROR("JPEG编码失败，档位: " + name, "MjpegHttpEngine");
+                continue;
+            }
+            bool viewed = i < demand_tiers;
+            latest_frames.put(camera_id, name, jpeg, lineage.capture_time_us, viewed);
+            if (viewed) {
+                // 分段头每帧每档位只生成一次，所有连接共享
+                parts.emplace_back(name, makePart(std::move(jpeg)));
+            }
+        }
+        if (parts.empty()) {
+            return;
+        }
+        lineage.encode_end_us = camera::FrameLineage::nowUs();
+
+        for (const auto& worker : workers_) {
+            for (const auto& part : parts) {
+                worker->publish(camera_id, part.first, part.second);
+            }
+        }
+
+        lineage.send_time_us = camera::FrameLineage::nowUs();
+        camera::PipelineStats::getInstance().recordLineage(lineage);
+    } catch (const std::exception& e) {
+        LOG_ERROR("处理帧时发生异常: " + std::string(e.what()), "MjpegHttpEngine");
+    }
+}
+
+MjpegHttpEngine::Part MjpegHttpEngine::makePart(video::JpegBuffer jpeg) {
+    auto header = std::make_shared<const std::string>(
+        "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(jpeg->size()) + "\r\n\r\n");
+    return Part{std::move(header), std::move(jpeg), Clock::now()};
+}
+
+void MjpegHttpEngine::addDemand(const std::string& camera_id, const std::string& tier) {
+    std::lock_guard<std::mutex> lock(demand_mutex_);
+    demand_[camera_id][tier]++;
+}
+
+void MjpegHttpEngine::removeDemand(const std::string& camera_id, const std::string& tier) {
+    std::lock_guard<std::mutex> lock(demand_mutex_);
+    auto camera_it = demand_.find(camera_id);
+    if (camera_it == demand_.end()) {
+        return;
+    }
+    auto tier_it = camera_it->second.find(tier);
+    if (tier_it != camera_it->second.end() && --tier_it->second <= 0) {
+        camera_it->second.erase(tier_it);
+    }
+    if (camera_it->second.empty()) {
+        demand_.erase(camera_it);
+    }
+}
+
+std::string MjpegHttpEngine::registerClient(const std::string& client_id, Worker* worker) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    std::string id = client_id;
+    while (client_workers_.count(id)) {
+        id = client_id + "-" + utils::StringUtils::randomString(4);
+    }
+    client_workers_[id] = worker;
+    return id;
+}
+
+void MjpegHttpEngine::unregisterClient(const std::string& client_id) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    client_workers_.erase(client_id);
+}
+
+} // namespace api
+} // namespace cam_server
@@ -1,7 +1,11 @@
 #include "../../include/api/mjpeg_streamer.h"
+#include "../../include/api/latest_frame_store.h"
 #include "../../include/camera/camera_manager.h"
+#include "../../include/camera/pipeline_stats.h"
 #include "../../include/monitor/logger.h"
 #include "../../include/utils/time_utils.h"
+#include "../../include/video/encoded_frame_cache.h"
+#include "../../include/video/jpeg_encoder_pool.h"
 
 #include <chrono>
 #include <algorithm>
@@ -33,7 +37,8 @@ MjpegStreamer::MjpegStreamer()
       clients_mutex_(),
       current_fps_(0.0),
       frame_count_(0),
-      last_fps_time_() {
+      last_fps_time_(),
+      frame_subscription_(0) {
     LOG_DEBUG("创建 MjpegStreamer 实例", "MjpegStreamer");
 }
 
@@ -68,6 +73,22 @@ bool MjpegStreamer::initialize(const MjpegStreamerConfig& config) {
         config_.max_clients = 5;
     }
 
+    // 未配置阶梯时保持原来的单一输出
+    if (config_.ladder.empty()) {
+        StreamTier tier;
+        tier.name = "full";
+        tier.width = config_.output_width;
+        tier.height = config_.output_height;
+        tier.quality = config_.jpeg_quality;
+        config_.ladder.push_back(tier);
+    }
+    ladder_ = StreamLadder(config_.ladder);
+    if (ladder_.empty()) {
+        LOG_ERROR("没有有效的流档位", "MjpegStreamer");
+        return false;
+    }
+    config_.adaptive.max_fps = config_.max_fps;
+
     is_initialized_ = true;
     LOG_DEBUG("MJPEG流处理器初始化成功", "MjpegStreamer");
     LOG_INFO("MJPEG流处理器初始化成功", "MjpegStreamer");
@@ -92,11 +113,17 @@ bool MjpegStreamer::start() {
     LOG_DEBUG("获取摄像头管理器...", "MjpegStreamer");
     auto& camera_manager = camera::CameraManager::getInstance();
 
-    // 设置帧回调
-    LOG_DEBUG("设置帧回调...", "MjpegStreamer");
-    camera_manager.setFrameCallback([this](const camera::Frame& frame) {
+    // 订阅帧，编码在独立线程中进行，只保留最新帧以保持实时性
+    LOG_DEBUG("订阅摄像头帧...", "MjpegStreamer");
+    camera::FrameSubscriberOptions options;
+    // KEEP_LATEST下每个摄像头只保留最新一帧，深度限制同时服务的摄像头数
+    options.queue_depth = 4;
+    options.drop_policy = camera::FrameDropPolicy::KEEP_LATEST;
+    // 摄像头输出MJPEG时直接转发，不解码也不重新编码
+    options.consumer = camera::FrameConsumerKind::JPEG;
+    frame_subscription_ = camera_manager.subscribeFrames("mjpeg_streamer", [this](const camera::Frame& frame) {
         handleFrame(frame);
-    });
+    }, options);
 
     is_running_ = true;
     frame_count_ = 0;
@@ -115,13 +142,19 @@ bool MjpegStreamer::stop() {
     // 获取摄像头管理器
     auto& camera_manager = camera::CameraManager::getInstance();
 
-    // 移除帧回调
-    camera_manager.setFrameCallback(nullptr);
+    // 取消帧订阅
+    camera_manager.unsubscribeFrames(frame_subscription_);
+    frame_subscription_ = 0;
 
-    // 清空客户端列表
+    // 清空客户端列表，发送线程在锁外回收
+    std::unordered_map<std::string, std::shared_ptr<MjpegClient>> clients;
     {
         std::lock_guard<std::mutex> lock(clients_mutex_);
-        clients_.clear();
+        clients.swap(clients_);
+        camera_clients_.clear();
+    }
+    for (const auto& pair : clients) {
+        stopClientSender(pair.second);
     }
 
     is_running_ = false;
@@ -133,7 +166,8 @@ bool MjpegStreamer::addClient(const std::string& client_id,
                              const std::string& camera_id,
                              std::function<void(const std::vector<uint8_t>&)> frame_callback,
                              std::function<void(const std::string&)> error_callback,
-                             std::function<void()> close_callback) {
+                             std::function<void()> close_callback,
+                             const std::string& tier) {
     LOG_DEBUG("客户端连接建立 - ID: " + client_id + 
               ", 摄像头: " + (camera_id.empty() ? "无" : camera_id) + 
               ", 回调函数: frame:" + std::to_string((uintptr_t)&frame_callback) + 
@@ -146,7 +180,8 @@ bool MjpegStreamer::addClient(const std::string& client_id,
         return false;
     }
 
-    std::lock_guard<std::mutex> lock(clients_mutex_);
+    std::unique_lock<std::mutex> lock(clients_mutex_);
+    std::shared_ptr<MjpegClient> replaced;
 
     // 检查客户端数量是否已达上限
     if (clients_.size() >= static_cast<size_t>(config_.max_clients)) {
@@ -199,6 +234,7 @@ bool MjpegStreamer::addClient(const std::string& client_id,
         }
 
         // 从客户端列表中移除
+        replaced = clients_[client_id];
         clients_.erase(client_id);
     }
 
@@ -206,11 +242,19 @@ bool MjpegStreamer::addClient(const std::string& client_id,
     auto client = std::make_shared<MjpegClient>();
     client->id = client_id;
     client->camera_id = camera_id;
+    client->tier = ladder_.resolve(tier);
     client->frame_callback = frame_callback;
     client->error_callback = error_callback;
     client->close_callback = close_callback;
     client->last_frame_time = utils::TimeUtils::getCurrentTimeMicros();
     client->last_activity_time = utils::TimeUtils::getCurrentTimeMicros();
+    client->send_queue = std::make_shared<ClientSendQueue>(static_cast<size_t>(std::max(1, config_.send_queue_depth)));
+    client->rate = StreamRateController(ladder_, config_.adaptive, client->tier);
+    client->sender = std::thread(&MjpegStreamer::runClientSender, this, client);
+    // 先发出保存的最新一帧，不等下一帧采集和编码
+    if (auto jpeg = LatestFrameStore::getInstance().get(camera_id, client->tier)) {
+        client->send_queue->push(std::move(jpeg));
+    }
 
     // 添加到客户端列表
     clients_[client_id] = client;
@@ -221,7 +265,7 @@ bool MjpegStreamer::addClient(const std::string& client_id,
         LOG_INFO("将客户端 " + client_id + " 关联到摄像头 " + camera_id, "MjpegStreamer");
     }
 
-    LOG_INFO("添加MJPEG客户端: " + client_id +
+    LOG_INFO("添加MJPEG客户端: " + client_id + "，档位: " + client->tier +
              "，当前客户端数量: " + std::to_string(clients_.size()) +
              "/" + std::to_string(config_.max_clients), "MjpegStreamer");
 
@@ -232,16 +276,19 @@ bool MjpegStreamer::addClient(const std::string& client_id,
     }
     LOG_DEBUG(client_list, "MjpegStreamer");
 
+    lock.unlock();
+    stopClientSender(replaced);
     return true;
 }
 
 bool MjpegStreamer::removeClient(const std::string& client_id) {
-    std::lock_guard<std::mutex> lock(clients_mutex_);
+    std::unique_lock<std::mutex> lock(clients_mutex_);
 
     auto it = clients_.find(client_id);
     if (it == clients_.end()) {
         return false;
     }
+    std::shared_ptr<MjpegClient> removed = it->second;
 
     // 调用关闭回调
     if (it->second->close_callback) {
@@ -267,9 +314,122 @@ bool MjpegStreamer::removeClient(const std::string& client_id) {
     LOG_INFO("移除MJPEG客户端: " + client_id +
              "，当前客户端数量: " + std::to_string(clients_.size()) +
              "/" + std::to_string(config_.max_clients), "MjpegStreamer");
+
+    // 发送线程可能正在帧回调中等待clients_mutex_，必须在锁外回收
+    lock.unlock();
+    stopClientSender(removed);
     return true;
 }
 
+bool MjpegStreamer::setClientTier(const std::string& client_id, const std::string& tier) {
+    if (!ladder_.find(tier)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    auto it = clients_.find(client_id);
+    if (it == clients_.end()) {
+        return false;
+    }
+    it->second->rate.setCeiling(tier);
+    it->second->tier = tier;
+    if (auto jpeg = LatestFrameStore::getInstance().get(it->second->camera_id, tier)) {
+        it->second->send_queue->push(std::move(jpeg));
+    }
+    LOG_INFO("MJPEG客户端 " + client_id + " 切换到档位: " + tier, "MjpegStreamer");
+    return true;
+}
+
+bool MjpegStreamer::onClientFeedback(const std::string& client_id, const ClientFeedback& feedback) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    auto it = clients_.find(client_id);
+    if (it == clients_.end()) {
+        return false;
+    }
+    it->second->rate.onFeedback(feedback, StreamRateController::Clock::now());
+    return true;
+}
+
+void MjpegStreamer::stopClientSender(const std::shared_ptr<MjpegClient>& client) {
+    if (!client || !client->send_queue) {
+        return;
+    }
+    client->send_queue->close();
+    if (client->sender.joinable()) {
+        if (client->sender.get_id() == std::this_thread::get_id()) {
+            // 客户端在自己的帧回调中被移除，发送线程返回后自行退出
+            client->sender.detach();
+        } else {
+            client->sender.join();
+        }
+    }
+}
+
+void MjpegStreamer::runClientSender(std::shared_ptr<MjpegClient> client) {
+    video::JpegBuffer jpeg;
+    while (!client->send_queue->isClosed()) {
+        if (!client->send_queue->pop(jpeg, std::chrono::milliseconds(100))) {
+            continue;
+        }
+
+        std::string error;
+        try {
+            // 所有客户端共享同一份只读JPEG数据
+            client->frame_callback(*jpeg);
+            client->send_queue->markSent(true);
+        } catch (const std::exception& e) {
+            error = "回调执行异常: " + std::string(e.what());
+        } catch (...) {
+            error = "回调执行未知异常";
+        }
+        jpeg.reset();
+        if (error.empty()) {
+            continue;
+        }
+
+        client->send_queue->markSent(false);
+        LOG_ERROR("客户端" + error + ", client_id=" + client->id, "MjpegStreamer");
+        if (client->error_callback) {
+            try {
+                client->error_callback(error);
+            } catch (...) {
+                // 忽略错误回调中的异常
+                LOG_ERROR("执行错误回调时发生异常", "MjpegStreamer");
+            }
+        }
+
+        // 只移除自己，同ID的客户端可能已被替换
+        bool current = false;
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex_);
+            auto it = clients_.find(client->id);
+            current = it != clients_.end() && it->second == client;
+        }
+        if (current) {
+            LOG_INFO("移除异常客户端: " + client->id, "MjpegStreamer");
+            removeClient(client->id);
+        }
+        break;
+    }
+}
+
+std::vector<ClientSendStats> MjpegStreamer::getClientSendStats() const {
+    std::vector<ClientSendStats> stats;
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    stats.reserve(clients_.size());
+    for (const auto& pair : clients_) {
+        if (!pair.second->send_queue) {
+            continue;
+        }
+        ClientSendStats client_stats = pair.second->send_queue->getStats();
+        client_stats.client_id = pair.first;
+        client_stats.transport = "mjpeg";
+        client_stats.tier = pair.second->tier;
+        client_stats.target_fps = pair.second->rate.getTargetFps();
+        stats.push_back(client_stats);
+    }
+    return stats;
+}
+
 int MjpegStreamer::getClientCount() const {
     std::lock_guard<std::mutex> lock(clients_mutex_);
     return clients_.size();
@@ -287,39 +447,64 @@ void MjpegStreamer::handleFrame(const camera::Frame& frame) {
     }
 
     try {
-        // 检查是否有客户端连接
+        // 检查是否有客户端连接，按档位分组
         std::vector<std::shared_ptr<MjpegClient>> active_clients;
+        std::unordered_map<std::string, std::vector<std::shared_ptr<MjpegClient>>> tier_clients;
+        // 保持期内的档位即使没有客户端也低频刷新，保存的最新帧不会过时
+        auto& latest_frames = LatestFrameStore::getInstance();
+        std::vector<std::string> refresh_tiers = latest_frames.getTiersToRefresh(frame.getCameraId());
         {
             std::lock_guard<std::mutex> lock(clients_mutex_);
-            if (clients_.empty()) {
+            if (clients_.empty() && refresh_tiers.empty()) {
                 LOG_DEBUG("没有客户端连接，忽略帧", "MjpegStreamer");
                 return;  // 没有客户端，不需要处理帧
             }
             
             // 在持有锁的情况下，复制所有客户端的智能指针
             // 这确保即使在处理过程中客户端被移除，我们仍然持有有效的引用
+            // 只选择未指定摄像头或指定了该帧来源摄像头的客户端
+            const std::string& frame_camera_id = frame.getCameraId();
+            auto now = StreamRateController::Clock::now();
             active_clients.reserve(clients_.size());
             for (const auto& pair : clients_) {
-                if (pair.second) {
-                    active_clients.push_back(pair.second);
+                if (pair.second && (pair.second->camera_id.empty() || frame_camera_id.empty() ||
+                                    pair.second->camera_id == frame_camera_id)) {
+                    auto& client = pair.second;
+                    // 按发送队列的积压、丢帧和写出延迟调整档位，并按目标帧率抽帧
+                    if (client->rate.needsUpdate(now) && client->rate.update(client->send_queue->getStats(), now)) {
+                        LOG_INFO("MJPEG客户端 " + client->id + " 自适应切换档位: " + client->tier + " -> " +
+                                 client->rate.getTier() + "，状态: " + client->rate.getStateName(), "MjpegStreamer");
+                        client->tier = client->rate.getTier();
+                    }
+                    if (!client->rate.admitFrame(now)) {
+                        continue;
+                    }
+                    active_clients.push_back(client);
+                    tier_clients[client->tier].push_back(client);
                 }
             }
             
             LOG_DEBUG("处理帧 - 客户端数: " + std::to_string(active_clients.size()), "MjpegStreamer");
         }
         
-        // 如果没有活跃客户端，直接返回
-        if (active_clients.empty()) {
+        for (const auto& name : refresh_tiers) {
+            if (ladder_.find(name)) {
+                tier_clients[name];
+            }
+        }
+
+        // 既没有活跃客户端也没有需要刷新的档位，直接返回
+        if (tier_clients.empty()) {
             LOG_DEBUG("没有有效客户端，忽略帧", "MjpegStreamer");
             return;
         }
         
         // 验证帧数据
-        if (frame.getData().empty() || 
+        if (frame.isEmpty() || 
             frame.getWidth() <= 0 || 
             frame.getHeight() <= 0 || 
             frame.getFormat() == camera::PixelFormat::UNKNOWN) {
-            LOG_ERROR("无效帧数据 - 大小: " + std::to_string(frame.getData().size()) + 
+            LOG_ERROR("无效帧数据 - 大小: " + std::to_string(frame.getDataSize()) + 
                      ", 宽度: " + std::to_string(frame.getWidth()) + 
                      ", 高度: " + std::to_string(frame.getHeight()) + 
                      ", 格式: " + std::to_string(static_cast<int>(frame.getFormat())), 
@@ -327,25 +512,38 @@ void MjpegStreamer::handleFrame(const camera::Frame& frame) {
             return;
         }
 
-        LOG_DEBUG("有效帧数据 - 大小: " + std::to_string(frame.getData().size()) + 
+        LOG_DEBUG("有效帧数据 - 大小: " + std::to_string(frame.getDataSize()) + 
                  ", 宽度: " + std::to_string(frame.getWidth()) + 
                  ", 高度: " + std::to_string(frame.getHeight()) + 
                  ", 格式: " + std::to_string(static_cast<int>(frame.getFormat())),
                  "MjpegStreamer");
 
-        // 编码为JPEG
-        std::vector<uint8_t> jpeg_data;
-        if (!encodeToJpeg(frame, jpeg_data)) {
-            LOG_ERROR("JPEG编码失败", "MjpegStreamer");
-            return;
+        // 只编码有客户端订阅的档位，同一帧的同一档位在各流和拍照接口之间只编码一次
+        camera::FrameLineage lineage = frame.getLineage();
+        lineage.encode_start_us = camera::FrameLineage::nowUs();
+        std::unordered_map<std::string, video::JpegBuffer> tier_jpegs;
+        for (const auto& pair : tier_clients) {
+            const StreamTier* tier = ladder_.find(pair.first);
+            if (!tier) {
+                continue;
+            }
+            int width = 0;
+            int height = 0;
+            StreamLadder::getOutputSize(*tier, frame.getWidth(), frame.getHeight(), width, height);
+            video::JpegBuffer jpeg = video::EncodedFrameCache::getInstance().getJpeg(frame, tier->quality, width, height);
+            if (!jpeg) {
+                LOG_ERROR("JPEG编码失败，档位: " + pair.first, "MjpegStreamer");
+                continue;
+            }
+            LOG_DEBUG("JPEG编码成功 - 档位: " + pair.first + ", 数据大小: " + std::to_string(jpeg->size()),
+                      "MjpegStreamer");
+            latest_frames.put(frame.getCameraId(), pair.first, jpeg, lineage.capture_time_us, !pair.second.empty());
+            tier_jpegs[pair.first] = std::move(jpeg);
         }
-        
-        if (jpeg_data.empty()) {
-            LOG_ERROR("JPEG编码后数据为空", "MjpegStreamer");
+        if (tier_jpegs.empty() || active_clients.empty()) {
             return;
         }
-
-        LOG_DEBUG("JPEG编码成功 - 数据大小: " + std::to_string(jpeg_data.size()), "MjpegStreamer");
+        lineage.encode_end_us = camera::FrameLineage::nowUs();
 
         // 更新帧率统计
         frame_count_++;
@@ -361,76 +559,29 @@ void MjpegStreamer::handleFrame(const camera::Frame& frame) {
 
         LOG_DEBUG("开始处理 " + std::to_string(active_clients.size()) + " 个客户端", "MjpegStreamer");
 
-        // 在不持有锁的情况下处理所有客户端
+        // 只放入各客户端的发送队列，由客户端自己的发送线程写出，慢客户端只会丢自己的帧
+        // 档位名在锁内随分组一起取出，不在锁外读取client->tier
         std::vector<std::string> clients_to_remove;
-        
-        for (const auto& client : active_clients) {
-            if (!client || !client->frame_callback) {
-                if (client) {
+        for (const auto& pair : tier_clients) {
+            auto jpeg_it = tier_jpegs.find(pair.first);
+            for (const auto& client : pair.second) {
+                if (!client->frame_callback) {
                     LOG_WARNING("客户端 " + client->id + " 没有有效的帧回调", "MjpegStreamer");
                     clients_to_remove.push_back(client->id);
-                } else {
-                    LOG_WARNING("发现无效客户端指针", "MjpegStreamer");
+                    continue;
                 }
-                continue;
-            }
-            
-            try {
-                // 为每个客户端创建一个独立的JPEG数据副本
-                // 这确保了即使一个客户端的回调修改了数据，也不会影响其他客户端
-                std::vector<uint8_t> client_jpeg_data = jpeg_data;
-                
-                LOG_DEBUG("调用客户端 " + client->id + " 的帧回调", "MjpegStreamer");
-                
-                // 执行回调
-                client->frame_callback(client_jpeg_data);
-                
-                LOG_DEBUG("客户端 " + client->id + " 的帧回调执行成功", "MjpegStreamer");
-                
-            } catch (const std::exception& e) {
-                LOG_ERROR("客户端回调异常: " + std::string(e.what()) + ", client_id=" + client->id, "MjpegStreamer");
-                clients_to_remove.push_back(client->id);
-                
-                // 调用错误回调
-                if (client->error_callback) {
-                    try {
-                        client->error_callback("回调执行异常: " + std::string(e.what()));
-                    } catch (...) {
-                        // 忽略错误回调中的异常
-                        LOG_ERROR("执行错误回调时发生异常", "MjpegStreamer");
-                    }
-                }
-            } catch (...) {
-                if (client) {
-                    LOG_ERROR("客户端回调未知异常, client_id=" + client->id, "MjpegStreamer");
-                    clients_to_remove.push_back(client->id);
-                    
-                    // 调用错误回调
-                    if (client->error_callback) {
-                        try {
-                            client->error_callback("回调执行未知异常");
-                        } catch (...) {
-                            // 忽略错误回调中的异常
-                            LOG_ERROR("执行错误回调时发生未知异常", "MjpegStreamer");
-                        }
-                    }
+                if (jpeg_it != tier_jpegs.end()) {
+                    client->send_queue->push(jpeg_it->second);
                 }
             }
         }
-        
-        // 移除出错的客户端
-        if (!clients_to_remove.empty()) {
-            std::lock_guard<std::mutex> lock(clients_mutex_);
-            for (const auto& client_id : clients_to_remove) {
-                auto it = clients_.find(client_id);
-                if (it != clients_.end()) {
-                    // 从客户端列表中移除
-                    clients_.erase(it);
-                    LOG_INFO("移除异常客户端: " + client_id, "MjpegStreamer");
-                }
-            }
-            LOG_INFO("移除了 " + std::to_string(clients_to_remove.size()) + " 个异常客户端，剩余 " + 
-                    std::to_string(clients_.size()) + " 个客户端", "MjpegStreamer");
+
+        // 帧已交给所有客户端的发送队列，记录各阶段延迟
+        lineage.send_time_us = camera::FrameLineage::nowUs();
+        camera::PipelineStats::getInstance().recordLineage(lineage);
+
+        for (const auto& client_id : clients_to_remove) {
+            removeClient(client_id);
         }
         
     } catch (const std::exception& e) {
@@ -443,12 +594,12 @@ void MjpegStreamer::handleFrame(const camera::Frame& frame) {
 bool MjpegStreamer::encodeToJpeg(const camera::Frame& frame, std::vector<uint8_t>& jpeg_data) {
     LOG_DEBUG("开始编码 - 分辨率: " + std::to_string(frame.getWidth()) + "x" + std::to_string(frame.getHeight()) +
              ", 格式: " + std::to_string(static_cast<int>(frame.getFormat())) +
-             ", 数据大小: " + std::to_string(frame.getData().size()) +
-             ", 数据地址: " + std::to_string((uintptr_t)frame.getData().data()), 
+             ", 数据大小: " + std::to_string(frame.getDataSize()) +
+             ", 数据地址: " + std::to_string((uintptr_t)frame.getDataPtr()), 
              "MjpegStreamer");
 
     // 验证输入数据
-    if (frame.getData().empty()) {
+    if (frame.isEmpty()) {
         LOG_DEBUG("错误: 空帧数据", "MjpegStreamer");
         LOG_ERROR("输入帧数据为空", "MjpegStreamer");
         return false;
@@ -463,13 +614,14 @@ bool MjpegStreamer::encodeToJpeg(const camera::Frame& frame, std::vector<uint8_t
 
     try {
         // 检查数据头部是否为JPEG魔数
-        if (frame.getData().size() >= 2 && 
-            frame.getData()[0] == 0xFF && 
-            frame.getData()[1] == 0xD8) {
+        const uint8_t* frame_data = frame.getDataPtr();
+        if (frame.getDataSize() >= 2 && 
+            frame_data[0] == 0xFF && 
+            frame_data[1] == 0xD8) {
             
             LOG_DEBUG("检测到JPEG魔数，直接使用帧数据", "MjpegStreamer");
             // 直接使用数据
-            jpeg_data = frame.getData();
+            jpeg_data.assign(frame_data, frame_data + frame.getDataSize());
             
             // 记录编码后的JPEG数据的前几个字节，用于调试
             std::stringstream hex_header;
@@ -483,196 +635,13 @@ bool MjpegStreamer::encodeToJpeg(const camera::Frame& frame, std::vector<uint8_t
             return true;
         }
 
-        // 如果是YUYV格式，需要转换为JPEG
-        if (frame.getFormat() == camera::PixelFormat::YUYV) {
-            AVCodecContext* codec_ctx = nullptr;
-            SwsContext* sws_ctx = nullptr;
-            AVFrame* yuv_frame = nullptr;
-            AVFrame* jpeg_frame = nullptr;
-            AVPacket* packet = nullptr;
-            bool success = false;
-
-            try {
-                // 创建编码器上下文
-                const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
-                if (!codec) {
-                    LOG_ERROR("找不到MJPEG编码器", "MjpegStreamer");
-                    return false;
-                }
-                LOG_DEBUG("找到MJPEG编码器", "MjpegStreamer");
-
-                codec_ctx = avcodec_alloc_context3(codec);
-                if (!codec_ctx) {
-                    LOG_ERROR("无法创建编码器上下文", "MjpegStreamer");
-                    return false;
-                }
-                LOG_DEBUG("创建编码器上下文成功", "MjpegStreamer");
-
-                // 设置编码参数
-                codec_ctx->width = frame.getWidth();
-                codec_ctx->height = frame.getHeight();
-                AVRational time_base = {1, 25};
-                codec_ctx->time_base = time_base;
-                codec_ctx->pix_fmt = AV_PIX_FMT_YUVJ422P;
-                codec_ctx->flags |= AV_CODEC_FLAG_QSCALE;
-                codec_ctx->global_quality = FF_QP2LAMBDA * config_.jpeg_quality;
-
-                // 打开编码器
-                int ret = avcodec_open2(codec_ctx, codec, nullptr);
-                if (ret < 0) {
-                    char error_buf[AV_ERROR_MAX_STRING_SIZE];
-                    av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-                    LOG_ERROR(std::string("无法打开编码器: ") + error_buf, "MjpegStreamer");
-                    throw std::runtime_error("无法打开编码器");
-                }
-                LOG_DEBUG("打开编码器成功", "MjpegStreamer");
-
-                // 创建图像转换上下文
-                sws_ctx = sws_getContext(
-                    frame.getWidth(), frame.getHeight(), AV_PIX_FMT_YUYV422,
-                    frame.getWidth(), frame.getHeight(), AV_PIX_FMT_YUVJ422P,
-                    SWS_BICUBIC, nullptr, nullptr, nullptr);
-                if (!sws_ctx) {
-                    LOG_ERROR("无法创建图像转换上下文", "MjpegStreamer");
-                    throw std::runtime_error("无法创建图像转换上下文");
-                }
-                LOG_DEBUG("创建图像转换上下文成功", "MjpegStreamer");
-
-                // 分配帧缓冲区
-                yuv_frame = av_frame_alloc();
-                jpeg_frame = av_frame_alloc();
-                if (!yuv_frame || !jpeg_frame) {
-                    LOG_ERROR("无法分配帧缓冲区", "MjpegStreamer");
-                    throw std::runtime_error("无法分配帧缓冲区");
-                }
-                LOG_DEBUG("分配帧缓冲区成功", "MjpegStreamer");
-
-                yuv_frame->width = frame.getWidth();
-                yuv_frame->height = frame.getHeight();
-                yuv_frame->format = AV_PIX_FMT_YUYV422;
-                
-                jpeg_frame->width = frame.getWidth();
-                jpeg_frame->height = frame.getHeight();
-                jpeg_frame->format = AV_PIX_FMT_YUVJ422P;
-
-                // 分配图像数据缓冲区
-                ret = av_image_alloc(yuv_frame->data, yuv_frame->linesize,
-                                 frame.getWidth(), frame.getHeight(),
-                                 AV_PIX_FMT_YUYV422, 1);
-                if (ret < 0) {
-                    char error_buf[AV_ERROR_MAX_STRING_SIZE];
-                    av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-                    LOG_ERROR(std::string("无法分配YUV图像缓冲区: ") + error_buf, "MjpegStreamer");
-                    throw std::runtime_error("无法分配YUV图像缓冲区");
-                }
-                LOG_DEBUG("分配YUV图像缓冲区成功", "MjpegStreamer");
-                                
-                ret = av_image_alloc(jpeg_frame->data, jpeg_frame->linesize,
-                                  frame.getWidth(), frame.getHeight(),
-                                  AV_PIX_FMT_YUVJ422P, 1);
-                if (ret < 0) {
-                    char error_buf[AV_ERROR_MAX_STRING_SIZE];
-                    av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-                    LOG_ERROR(std::string("无法分配JPEG图像缓冲区: ") + error_buf, "MjpegStreamer");
-                    throw std::runtime_error("无法分配JPEG图像缓冲区");
-                }
-                LOG_DEBUG("分配JPEG图像缓冲区成功", "MjpegStreamer");
-
-                // 复制输入数据
-                size_t frame_size = frame.getData().size();
-                if (frame_size > 0) {
-                    LOG_DEBUG("复制输入数据到YUV帧, 大小: " + std::to_string(frame_size), "MjpegStreamer");
-                    memcpy(yuv_frame->data[0], frame.getData().data(), frame_size);
-                } else {
-                    LOG_ERROR("输入帧数据大小为0", "MjpegStreamer");
-                    throw std::runtime_error("输入帧数据大小为0");
-                }
-
-                // 转换颜色空间
-                LOG_DEBUG("开始转换颜色空间", "MjpegStreamer");
-                int height = sws_scale(sws_ctx,
-                          yuv_frame->data, yuv_frame->linesize, 0, frame.getHeight(),
-                          jpeg_frame->data, jpeg_frame->linesize);
-                if (height <= 0) {
-                    LOG_ERROR("颜色空间转换失败", "MjpegStreamer");
-                    throw std::runtime_error("颜色空间转换失败");
-                }
-                LOG_DEBUG("颜色空间转换成功, 输出高度: " + std::to_string(height), "MjpegStreamer");
-
-                // 编码为JPEG
-                packet = av_packet_alloc();
-                if (!packet) {
-                    LOG_ERROR("无法分配AVPacket", "MjpegStreamer");
-                    throw std::runtime_error("无法分配AVPacket");
-                }
-                LOG_DEBUG("分配AVPacket成功", "MjpegStreamer");
-
-                ret = avcodec_send_frame(codec_ctx, jpeg_frame);
-                if (ret < 0) {
-                    char error_buf[AV_ERROR_MAX_STRING_SIZE];
-                    av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-                    LOG_ERROR(std::string("发送帧到编码器失败: ") + error_buf, "MjpegStreamer");
-                    throw std::runtime_error("发送帧到编码器失败");
-                }
-                LOG_DEBUG("发送帧到编码器成功", "MjpegStreamer");
-
-                ret = avcodec_receive_packet(codec_ctx, packet);
-                if (ret < 0) {
-                    char error_buf[AV_ERROR_MAX_STRING_SIZE];
-                    av_strerror(ret, error_buf, AV_ERROR_MAX_STRING_SIZE);
-                    LOG_ERROR(std::string("从编码器接收数据失败: ") + error_buf, "MjpegStreamer");
-                    throw std::runtime_error("从编码器接收数据失败");
-                }
-                LOG_DEBUG("从编码器接收数据成功, 数据大小: " + std::to_string(packet->size), "MjpegStreamer");
-
-                // 复制编码后的数据
-                jpeg_data.resize(packet->size);
-                if (packet->size > 0) {
-                    memcpy(jpeg_data.data(), packet->data, packet->size);
-                    
-                    // 记录编码后的JPEG数据的前几个字节，用于调试
-                    std::stringstream hex_header;
-                    hex_header << "JPEG数据头: ";
-                    for (size_t i = 0; i < std::min(size_t(16), jpeg_data.size()); ++i) {
-                        hex_header << std::hex << std::setw(2) << std::setfill('0') 
-                                  << static_cast<int>(jpeg_data[i]) << " ";
-                    }
-                    LOG_DEBUG(hex_header.str(), "MjpegStreamer");
-                    
-                    success = true;
-                } else {
-                    LOG_ERROR("编码后的数据大小为0", "MjpegStreamer");
-                }
-            } catch (const std::exception& e) {
-                LOG_ERROR(std::string("JPEG编码异常: ") + e.what(), "MjpegStreamer");
-            } catch (...) {
-                LOG_ERROR("JPEG编码过程中发生未知异常", "MjpegStreamer");
-            }
-
-            // 清理资源
-            if (yuv_frame) {
-                if (yuv_frame->data[0]) {
-                    av_freep(&yuv_frame->data[0]);
-                }
-                av_frame_free(&yuv_frame);
+        // 原始格式使用共享编码器池中的常驻编码器
+        if (video::JpegEncoder::isSupported(frame.getFormat())) {
+            if (!video::JpegEncoderPool::getInstance().encode(frame, config_.jpeg_quality, jpeg_data)) {
+                LOG_ERROR("JPEG编码失败", "MjpegStreamer");
+                return false;
             }
-            if (jpeg_frame) {
-                if (jpeg_frame->data[0]) {
-                    av_freep(&jpeg_frame->data[0]);
-                }
-                av_frame_free(&jpeg_frame);
-            }
-            if (packet) {
-                av_packet_free(&packet);
-            }
-            if (sws_ctx) {
-                sws_freeContext(sws_ctx);
-            }
-            if (codec_ctx) {
-                avcodec_free_context(&codec_ctx);
-            }
-
-            return success && !jpeg_data.empty();
+            return true;
         }
 
         // 如果没有JPEG魔数，记录错误
@@ -717,7 +686,7 @@ bool MjpegStreamer::resizeFrame(const camera::Frame& frame, camera::Frame& resiz
         (frame.getFormat() == camera::PixelFormat::YUYV ? 2 : 3));
 
     // 转换图像
-    const uint8_t* src_data[4] = {frame.getData().data(), nullptr, nullptr, nullptr};
+    const uint8_t* src_data[4] = {frame.getDataPtr(), nullptr, nullptr, nullptr};
     uint8_t* dst_data[4] = {resized_frame.getData().data(), nullptr, nullptr, nullptr};
     int src_linesize[4] = {frame.getWidth() * (frame.getFormat() == camera::PixelFormat::YUYV ? 2 : 3), 0, 0, 0};
     int dst_linesize[4] = {config_.output_width * (frame.getFormat() == camera::PixelFormat::YUYV ? 2 : 3), 0, 0, 0};
@@ -0,0 +1,92 @@
+#include "../../include/api/stream_envelope.h"
+
+#include <algorithm>
+
+namespace cam_server {
+namespace api {
+
+namespace {
+
+constexpr size_t kMaxFieldSize = 255;
+
+void appendBigEndian(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<char>(value >> (8 * (bytes - 1 - i))));
+    }
+}
+
+uint64_t readBigEndian(const uint8_t* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+} // namespace
+
+size_t StreamEnvelope::size() const {
+    return FIXED_SIZE + std::min(camera_id.size(), kMaxFieldSize) + std::min(tier.size(), kMaxFieldSize);
+}
+
+void StreamEnvelope::appendTo(std::string& out) const {
+    size_t camera_size = std::min(camera_id.size(), kMaxFieldSize);
+    size_t tier_size = std::min(tier.size(), kMaxFieldSize);
+    out.reserve(out.size() + size());
+    out.push_back('C');
+    out.push_back('S');
+    out.push_back(static_cast<char>(VERSION));
+    out.push_back(static_cast<char>(codec));
+    appendBigEndian(out, FIXED_SIZE + camera_size + tier_size, 2);
+    out.push_back(static_cast<char>(flags));
+    out.push_back(static_cast<char>(camera_size));
+    out.push_back(static_cast<char>(tier_size));
+    out.append(3, '\0');
+    appendBigEndian(out, sequence, 4);
+    appendBigEndian(out, capture_time_us, 8);
+    appendBigEndian(out, send_time_us, 8);
+    appendBigEndian(out, payload_size, 4);
+    out.append(camera_id, 0, camera_size);
+    out.append(tier, 0, tier_size);
+}
+
+bool StreamEnvelope::parse(const uint8_t* data, size_t size, StreamEnvelope& envelope, size_t& header_size) {
+    if (!data || size < FIXED_SIZE || data[0] != 'C' || data[1] != 'S' || data[2] == 0) {
+        return false;
+    }
+    header_size = static_cast<size_t>(readBigEndian(data + 4, 2));
+    size_t camera_size = data[7];
+    size_t tier_size = data[8];
+    if (header_size < FIXED_SIZE + camera_size + tier_size || header_size > size) {
+        return false;
+    }
+    envelope.codec = static_cast<StreamCodec>(data[3]);
+    envelope.flags = data[6];
+    envelope.sequence = static_cast<uint32_t>(readBigEndian(data + 12, 4));
+    envelope.capture_time_us = readBigEndian(data + 16, 8);
+    envelope.send_time_us = readBigEndian(data + 24, 8);
+    envelope.payload_size = static_cast<uint32_t>(readBigEndian(data + 32, 4));
+    if (envelope.payload_size != size - header_size) {
+        return false;
+    }
+    const char* fields = reinterpret_cast<const char*>(data + FIXED_SIZE);
+    envelope.camera_id.assign(fields, camera_size);
+    envelope.tier.assign(fields + camera_size, tier_size);
+    return true;
+}
+
+StreamCodec StreamEnvelope::codecFromString(const std::string& codec) {
+    if (codec == "jpeg") {
+        return StreamCodec::JPEG;
+    }
+    if (codec == "h264") {
+        return StreamCodec::H264;
+    }
+    if (codec == "tiles") {
+        return StreamCodec::TILES;
+    }
+    return StreamCodec::UNKNOWN;
+}
+
+} // namespace api
+} // namespace cam_server
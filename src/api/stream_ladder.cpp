@@ -0,0 +1,114 @@
+#include "../../include/api/stream_ladder.h"
+#include "../../include/monitor/logger.h"
+#include "../../include/utils/string_utils.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace cam_server {
+namespace api {
+
+namespace {
+
+// 输出尺寸取偶数，YUV 4:2:0编码要求
+int evenSize(double size) {
+    int value = static_cast<int>(size) & ~1;
+    return std::max(2, value);
+}
+
+} // namespace
+
+StreamLadder::StreamLadder(const std::vector<StreamTier>& tiers) {
+    for (const auto& tier : tiers) {
+        if (tier.name.empty() || find(tier.name)) {
+            continue;
+        }
+        if ((tier.width <= 0 || tier.height <= 0) && (tier.scale <= 0.0 || tier.scale > 1.0)) {
+            LOG_WARNING("忽略无效的流档位: " + tier.name, "StreamLadder");
+            continue;
+        }
+        tiers_.push_back(tier);
+    }
+}
+
+std::vector<StreamTier> StreamLadder::parse(const std::string& spec, int default_quality) {
+    std::vector<StreamTier> tiers;
+    for (const auto& item : utils::StringUtils::split(spec, ',')) {
+        auto fields = utils::StringUtils::split(utils::StringUtils::trim(item), ':');
+        if (fields.size() < 2 || fields.size() > 3) {
+            if (!utils::StringUtils::trim(item).empty()) {
+                LOG_WARNING("无法解析流档位: " + item, "StreamLadder");
+            }
+            continue;
+        }
+
+        StreamTier tier;
+        tier.name = utils::StringUtils::trim(fields[0]);
+        std::string size = utils::StringUtils::trim(fields[1]);
+        size_t x = size.find('x');
+        if (x != std::string::npos) {
+            tier.width = utils::StringUtils::toInt(size.substr(0, x));
+            tier.height = utils::StringUtils::toInt(size.substr(x + 1));
+            tier.scale = 0.0;
+        } else {
+            tier.scale = utils::StringUtils::toDouble(size);
+        }
+        tier.quality = fields.size() == 3 ? utils::StringUtils::toInt(utils::StringUtils::trim(fields[2]), default_quality)
+                                          : default_quality;
+        tier.quality = std::max(1, std::min(100, tier.quality));
+        tiers.push_back(tier);
+    }
+    return tiers;
+}
+
+void StreamLadder::getOutputSize(const StreamTier& tier, int src_width, int src_height, int& width, int& height) {
+    if (tier.width > 0 && tier.height > 0) {
+        width = tier.width;
+        height = tier.height;
+    } else if (tier.scale > 0.0 && tier.scale < 1.0) {
+        width = evenSize(src_width * tier.scale);
+        height = evenSize(src_height * tier.scale);
+    } else {
+        width = 0;
+        height = 0;
+        return;
+    }
+    if (width == src_width && height == src_height) {
+        width = 0;
+        height = 0;
+    }
+}
+
+const StreamTier* StreamLadder::find(const std::string& name) const {
+    for (const auto& tier : tiers_) {
+        if (tier.name == name) {
+            return &tier;
+        }
+    }
+    return nullptr;
+}
+
+std::string StreamLadder::resolve(const std::string& name) const {
+    if (tiers_.empty()) {
+        return "";
+    }
+    return find(name) ? name : tiers_.front().name;
+}
+
+std::string StreamLadder::toJson() const {
+    std::ostringstream json;
+    json << "[";
+    for (size_t i = 0; i < tiers_.size(); ++i) {
+        if (i > 0) json << ",";
+        json << "{\"name\":\"" << tiers_[i].name << "\",";
+        json << "\"scale\":" << tiers_[i].scale << ",";
+        json << "\"width\":" << tiers_[i].width << ",";
+        json << "\"height\":" << tiers_[i].height << ",";
+        json << "\"quality\":" << tiers_[i].quality << "}";
+    }
+    json << "]";
+    return json.str();
+}
+
+} // namespace api
+} // namespace cam_server
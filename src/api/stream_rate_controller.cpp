@@ -0,0 +1,233 @@
+#include "../../include/api/stream_rate_controller.h"
+
+#include <algorithm>
+
+namespace cam_server {
+namespace api {
+
+namespace {
+
+// 客户端反馈在这段时间内有效，客户端停止上报后不再影响判断
+constexpr std::chrono::seconds kFeedbackTimeout(3);
+
+// 丢帧比例达到1/10才视为拥塞，偶尔一帧被替换不降级
+constexpr uint64_t kDropRatioDivisor = 10;
+
+// 客户端积压超过该帧数视为拥塞
+constexpr int kMaxBufferedFrames = 2;
+
+} // namespace
+
+StreamRateController::StreamRateController()
+    : ceiling_(0),
+      current_(0),
+      target_fps_(0.0),
+      state_(State::STEADY),
+      last_dropped_(0),
+      last_sent_(0),
+      probe_interval_(0) {
+    config_.enabled = false;
+}
+
+StreamRateController::StreamRateController(const StreamLadder& ladder, const StreamRateConfig& config,
+                                           const std::string& tier)
+    : config_(config),
+      ceiling_(0),
+      current_(0),
+      target_fps_(0.0),
+      state_(State::STEADY),
+      last_dropped_(0),
+      last_sent_(0),
+      probe_interval_(config.probe_interval_ms) {
+    for (const auto& item : ladder.getTiers()) {
+        tiers_.push_back(item.name);
+    }
+    config_.max_fps = std::max(1.0, config_.max_fps);
+    config_.min_fps = std::max(0.5, std::min(config_.min_fps, config_.max_fps));
+    config_.max_probe_interval_ms = std::max(config_.max_probe_interval_ms, config_.probe_interval_ms);
+    setCeiling(tier);
+}
+
+void StreamRateController::setCeiling(const std::string& tier) {
+    auto it = std::find(tiers_.begin(), tiers_.end(), tier);
+    ceiling_ = it != tiers_.end() ? static_cast<size_t>(it - tiers_.begin()) : 0;
+    current_ = ceiling_;
+    target_fps_ = config_.max_fps;
+    state_ = State::STEADY;
+    hold_until_ = Clock::time_point();
+    clear_since_ = Clock::time_point();
+    last_tier_up_ = Clock::time_point();
+    probe_interval_ = std::chrono::milliseconds(config_.probe_interval_ms);
+}
+
+bool StreamRateController::admitFrame(Clock::time_point now) {
+    if (!enabled() || target_fps_ >= config_.max_fps) {
+        return true;
+    }
+
+    auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / target_fps_));
+    // 允许帧到达时间有十分之一间隔的抖动，避免源帧率与目标帧率接近时随机漏帧
+    if (next_frame_ != Clock::time_point() && now + interval / 10 < next_frame_) {
+        return false;
+    }
+    // 源帧率低于目标时最多补发一帧，不会突发
+    next_frame_ = std::max(next_frame_, now - interval) + interval;
+    return true;
+}
+
+bool StreamRateController::needsUpdate(Clock::time_point now) const {
+    return enabled() && now - last_update_ >= std::chrono::milliseconds(config_.evaluate_interval_ms);
+}
+
+bool StreamRateController::update(const ClientSendStats& stats, Clock::time_point now) {
+    if (!enabled()) {
+        return false;
+    }
+
+    uint64_t dropped = stats.dropped_frames >= last_dropped_ ? stats.dropped_frames - last_dropped_ : 0;
+    uint64_t sent = stats.sent_frames >= last_sent_ ? stats.sent_frames - last_sent_ : 0;
+    last_dropped_ = stats.dropped_frames;
+    last_sent_ = stats.sent_frames;
+    last_update_ = now;
+
+    if (isCongested(stats, dropped, sent, now)) {
+        clear_since_ = Clock::time_point();
+        if (now < hold_until_) {
+            return false;  // 上次降级的效果还没体现出来
+        }
+        // 刚升档就拥塞，说明链路撑不住该档位，推迟下次尝试
+        if (last_tier_up_ != Clock::time_point() && now - last_tier_up_ < probe_interval_) {
+            probe_interval_ = std::min(probe_interval_ * 2, std::chrono::milliseconds(config_.max_probe_interval_ms));
+        }
+        last_tier_up_ = Clock::time_point();
+        state_ = State::CONGESTED;
+        hold_until_ = now + std::chrono::milliseconds(config_.hold_ms);
+        return stepDown();
+    }
+
+    if (!isClear(stats, dropped, now)) {
+        clear_since_ = Clock::time_point();
+        return false;
+    }
+    if (clear_since_ == Clock::time_point()) {
+        clear_since_ = now;
+    }
+    // 升档后稳定了一个探测周期，恢复正常的探测间隔
+    if (last_tier_up_ != Clock::time_point() && now - last_tier_up_ >= probe_interval_) {
+        probe_interval_ = std::chrono::milliseconds(config_.probe_interval_ms);
+        last_tier_up_ = Clock::time_point();
+    }
+    if (now < hold_until_) {
+        return false;
+    }
+    return stepUp(now);
+}
+
+void StreamRateController::onFeedback(const ClientFeedback& feedback, Clock::time_point now) {
+    feedback_ = feedback;
+    feedback_time_ = now;
+}
+
+const std::string& StreamRateController::getTier() const {
+    return tiers_.empty() ? empty_tier_ : tiers_[current_];
+}
+
+const std::string& StreamRateController::getCeiling() const {
+    return tiers_.empty() ? empty_tier_ : tiers_[ceiling_];
+}
+
+const char* StreamRateController::getStateName() const {
+    switch (state_) {
+        case State::CONGESTED: return "congested";
+        case State::RECOVERING: return "recovering";
+        default: return "steady";
+    }
+}
+
+bool StreamRateController::hasFreshFeedback(Clock::time_point now) const {
+    return feedback_time_ != Clock::time_point() && now - feedback_time_ < kFeedbackTimeout;
+}
+
+bool StreamRateController::isCongested(const ClientSendStats& stats, uint64_t dropped, uint64_t sent,
+                                       Clock::time_point now) const {
+    // 丢帧比例过高：客户端取帧的速度跟不上发送速度
+    if (dropped > 0 && dropped * kDropRatioDivisor >= dropped + sent) {
+        return true;
+    }
+    // 有积压但整个周期一帧都没写出去
+    if (stats.depth > 0 && sent == 0) {
+        return true;
+    }
+    if (stats.latency_ms > config_.high_latency_ms) {
+        return true;
+    }
+    if (hasFreshFeedback(now)) {
+        if (feedback_.lag_ms > config_.high_latency_ms || feedback_.buffered_frames > kMaxBufferedFrames) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool StreamRateController::isClear(const ClientSendStats& stats, uint64_t dropped, Clock::time_point now) const {
+    if (dropped > 0 || stats.depth > 1 || stats.latency_ms > config_.low_latency_ms) {
+        return false;
+    }
+    if (hasFreshFeedback(now)) {
+        if (feedback_.lag_ms > config_.low_latency_ms || feedback_.buffered_frames > 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StreamRateController::stepDown() {
+    double half_fps = std::max(config_.min_fps, config_.max_fps / 2);
+    // 先降帧率到一半，画面仍然清晰
+    if (target_fps_ > half_fps) {
+        target_fps_ = std::max(half_fps, target_fps_ * 0.7);
+        return false;
+    }
+    // 再逐级降分辨率
+    if (current_ + 1 < tiers_.size()) {
+        current_++;
+        return true;
+    }
+    // 已是最低档，继续降帧率保持实时
+    target_fps_ = std::max(config_.min_fps, target_fps_ * 0.7);
+    return false;
+}
+
+bool StreamRateController::stepUp(Clock::time_point now) {
+    double half_fps = std::max(config_.min_fps, config_.max_fps / 2);
+    double step = std::max(1.0, config_.max_fps / 10);
+
+    if (current_ > ceiling_) {
+        if (target_fps_ < half_fps) {
+            target_fps_ = std::min(half_fps, target_fps_ + step);
+            state_ = State::RECOVERING;
+            return false;
+        }
+        // 升档会明显增加带宽，链路持续畅通一个探测周期才尝试
+        if (now - clear_since_ < probe_interval_) {
+            state_ = State::RECOVERING;
+            return false;
+        }
+        current_--;
+        last_tier_up_ = now;
+        clear_since_ = now;
+        state_ = State::RECOVERING;
+        return true;
+    }
+
+    if (target_fps_ < config_.max_fps) {
+        target_fps_ = std::min(config_.max_fps, target_fps_ + step);
+        state_ = State::RECOVERING;
+        return false;
+    }
+    state_ = State::STEADY;
+    return false;
+}
+
+} // namespace api
+} // namespace cam_server
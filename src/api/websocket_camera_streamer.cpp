@@ -1,7 +1,12 @@
 #include "../../include/api/websocket_camera_streamer.h"
+#include "../../include/api/latest_frame_store.h"
 #include "../../include/camera/camera_manager.h"
+#include "../../include/camera/pipeline_stats.h"
 #include "../../include/monitor/logger.h"
+#include "../../include/utils/string_utils.h"
 #include "../../include/utils/time_utils.h"
+#include "../../include/video/encoded_frame_cache.h"
+#include "../../include/video/jpeg_encoder_pool.h"
 
 #include <chrono>
 #include <algorithm>
@@ -10,16 +15,87 @@
 #include <sstream>
 #include <iomanip>
 
-// 使用FFmpeg进行JPEG编码
-extern "C" {
-#include <libavcodec/avcodec.h>
-#include <libavutil/imgutils.h>
-#include <libswscale/swscale.h>
-}
+#include "crow/json.h"
 
 namespace cam_server {
 namespace api {
 
+namespace {
+
+// 取出JSON命令中的字符串字段，不存在或类型不符时返回空字符串
+std::string stringField(const crow::json::rvalue& json, const char* key) {
+    if (!json.has(key) || json[key].t() != crow::json::type::String) {
+        return "";
+    }
+    return json[key].s();
+}
+
+// 取出JSON命令中的数值字段，不存在或类型不符时返回默认值
+double numberField(const crow::json::rvalue& json, const char* key, double default_value) {
+    if (!json.has(key) || json[key].t() != crow::json::type::Number) {
+        return default_value;
+    }
+    return json[key].d();
+}
+
+// H.264消息头：1字节标志，3字节保留，8字节大端采集时间
+constexpr size_t kH264HeaderSize = 12;
+constexpr uint8_t kH264FlagKeyframe = 0x01;
+
+// 在访问单元前加上消息头，每个访问单元只构造一次，所有H.264客户端共享
+std::shared_ptr<const std::vector<uint8_t>> makeH264Message(const video::H264Packet& packet) {
+    auto message = std::make_shared<std::vector<uint8_t>>(kH264HeaderSize);
+    (*message)[0] = packet.keyframe ? kH264FlagKeyframe : 0;
+    for (int i = 0; i < 8; ++i) {
+        (*message)[4 + i] = static_cast<uint8_t>(packet.timestamp_us >> (56 - 8 * i));
+    }
+    message->insert(message->end(), packet.data->begin(), packet.data->end());
+    return message;
+}
+
+// 瓦片消息头：2字节魔数，1字节版本，1字节标志，宽、高、瓦片数、保留各2字节，8字节采集时间
+constexpr size_t kTileHeaderSize = 20;
+constexpr size_t kTileEntryHeaderSize = 12;
+constexpr uint8_t kTileVersion = 1;
+constexpr uint8_t kTileFlagFull = 0x01;
+
+void putBigEndian(uint8_t* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * (bytes - 1 - i)));
+    }
+}
+
+// 把一次瓦片更新打包成一条消息，所有瓦片客户端共享
+std::shared_ptr<const std::vector<uint8_t>> makeTileMessage(const video::TileDeltaUpdate& update) {
+    size_t size = kTileHeaderSize;
+    for (const auto& tile : update.tiles) {
+        size += kTileEntryHeaderSize + tile.jpeg->size();
+    }
+    auto message = std::make_shared<std::vector<uint8_t>>(size);
+    uint8_t* out = message->data();
+    out[0] = 'T';
+    out[1] = 'D';
+    out[2] = kTileVersion;
+    out[3] = update.full ? kTileFlagFull : 0;
+    putBigEndian(out + 4, static_cast<uint64_t>(update.width), 2);
+    putBigEndian(out + 6, static_cast<uint64_t>(update.height), 2);
+    putBigEndian(out + 8, update.tiles.size(), 2);
+    putBigEndian(out + 12, update.timestamp_us, 8);
+    out += kTileHeaderSize;
+    for (const auto& tile : update.tiles) {
+        putBigEndian(out, static_cast<uint64_t>(tile.x), 2);
+        putBigEndian(out + 2, static_cast<uint64_t>(tile.y), 2);
+        putBigEndian(out + 4, static_cast<uint64_t>(tile.width), 2);
+        putBigEndian(out + 6, static_cast<uint64_t>(tile.height), 2);
+        putBigEndian(out + 8, tile.jpeg->size(), 4);
+        std::memcpy(out + kTileEntryHeaderSize, tile.jpeg->data(), tile.jpeg->size());
+        out += kTileEntryHeaderSize + tile.jpeg->size();
+    }
+    return message;
+}
+
+} // namespace
+
 WebSocketCameraStreamer& WebSocketCameraStreamer::getInstance() {
     static WebSocketCameraStreamer instance;
     return instance;
@@ -27,7 +103,8 @@ WebSocketCameraStreamer& WebSocketCameraStreamer::getInstance() {
 
 WebSocketCameraStreamer::WebSocketCameraStreamer()
     : is_initialized_(false), is_running_(false), current_fps_(0.0), 
-      frame_count_(0), cleanup_running_(false) {
+      frame_count_(0), cleanup_running_(false), frame_subscription_(0), h264_subscription_(0),
+      tile_subscription_(0) {
     last_fps_time_ = std::chrono::steady_clock::now();
 }
 
@@ -64,10 +141,32 @@ bool WebSocketCameraStreamer::initialize(const WebSocketCameraStreamerConfig& co
         return false;
     }
 
+    // 未配置阶梯时保持原来的单一输出
+    if (config_.ladder.empty()) {
+        StreamTier tier;
+        tier.name = "full";
+        tier.width = config_.output_width;
+        tier.height = config_.output_height;
+        tier.quality = config_.jpeg_quality;
+        config_.ladder.push_back(tier);
+    }
+    ladder_ = StreamLadder(config_.ladder);
+    if (ladder_.empty()) {
+        LOG_ERROR("没有有效的流档位", "WebSocketCameraStreamer");
+        return false;
+    }
+    config_.adaptive.max_fps = config_.max_fps;
+    if (config_.h264.fps <= 0) {
+        config_.h264.fps = config_.max_fps;
+    }
+
     // 重置统计信息
-    current_fps_ = 0.0;
-    frame_count_ = 0;
-    last_fps_time_ = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(fps_mutex_);
+        current_fps_ = 0.0;
+        frame_count_ = 0;
+        last_fps_time_ = std::chrono::steady_clock::now();
+    }
 
     is_initialized_ = true;
     LOG_INFO("WebSocket摄像头流处理器初始化成功", "WebSocketCameraStreamer");
@@ -87,17 +186,43 @@ bool WebSocketCameraStreamer::start() {
         return true;
     }
 
-    // 获取摄像头管理器并设置帧回调
+    // 订阅摄像头帧，编码和发送在独立线程中进行
     auto& camera_manager = camera::CameraManager::getInstance();
-    camera_manager.setFrameCallback([this](const camera::Frame& frame) {
+    camera::FrameSubscriberOptions options;
+    // KEEP_LATEST下每个摄像头只保留最新一帧，深度限制同时服务的摄像头数
+    options.queue_depth = 4;
+    options.drop_policy = camera::FrameDropPolicy::KEEP_LATEST;
+    options.consumer = camera::FrameConsumerKind::JPEG;
+    frame_subscription_ = camera_manager.subscribeFrames("websocket_streamer", [this](const camera::Frame& frame) {
         handleFrame(frame);
-    });
+    }, options);
+
+    // 接收/ws/camera上的订阅和切换档位命令
+    crow_server_->registerWebSocketHandler("/ws/camera",
+        [this](std::string_view message, void* /*conn*/, bool is_binary, std::string client_id) {
+            if (!is_binary && !client_id.empty()) {
+                handleClientMessage(client_id, std::string(message));
+            }
+        },
+        nullptr,
+        [this](std::string client_id, int /*code*/, std::string_view /*reason*/) {
+            bool subscribed = false;
+            {
+                std::lock_guard<std::mutex> lock(clients_mutex_);
+                subscribed = clients_.count(client_id) > 0;
+            }
+            if (subscribed) {
+                removeClient(client_id);
+            }
+        });
 
     // 启动清理线程
     cleanup_running_ = true;
     cleanup_thread_ = std::thread([this]() {
         while (cleanup_running_) {
             cleanupInactiveClients();
+            // 保持期结束后释放H.264编码器
+            updateEncoderSubscriptions();
             std::this_thread::sleep_for(std::chrono::seconds(5));
         }
     });
@@ -114,20 +239,25 @@ bool WebSocketCameraStreamer::stop() {
 
     LOG_DEBUG("停止WebSocket摄像头流处理器...", "WebSocketCameraStreamer");
 
+    // 取消帧订阅
+    camera::CameraManager::getInstance().unsubscribeFrames(frame_subscription_);
+    frame_subscription_ = 0;
+
     // 停止清理线程
     cleanup_running_ = false;
     if (cleanup_thread_.joinable()) {
         cleanup_thread_.join();
     }
 
-    // 清理所有客户端
+    // 清理所有客户端，随后取消H.264和瓦片订阅，停止时不保留编码器
     {
         std::lock_guard<std::mutex> lock(clients_mutex_);
         clients_.clear();
         camera_clients_.clear();
     }
-
     is_running_ = false;
+    updateEncoderSubscriptions();
+
     LOG_INFO("WebSocket摄像头流处理器已停止", "WebSocketCameraStreamer");
     return true;
 }
@@ -136,12 +266,34 @@ bool WebSocketCameraStreamer::isRunning() const {
     return is_running_;
 }
 
-bool WebSocketCameraStreamer::addClient(const std::string& client_id, const std::string& camera_id) {
-    std::lock_guard<std::mutex> lock(clients_mutex_);
+bool WebSocketCameraStreamer::addClient(const std::string& client_id, const std::string& camera_id,
+                                        const std::string& tier, const std::string& codec, bool envelope) {
+    if (codec != "jpeg" && !(codec == "h264" && config_.enable_h264) &&
+        !(codec == "tiles" && config_.enable_tiles)) {
+        LOG_WARNING("不支持的流编码: " + codec, "WebSocketCameraStreamer");
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(clients_mutex_);
+
+    // 重复订阅视为切换摄像头
+    auto existing = clients_.find(client_id);
+    if (existing != clients_.end()) {
+        auto camera_it = camera_clients_.find(existing->second->camera_id);
+        if (camera_it != camera_clients_.end()) {
+            camera_it->second.erase(client_id);
+            if (camera_it->second.empty()) {
+                camera_clients_.erase(camera_it);
+            }
+        }
+        clients_.erase(existing);
+    }
 
     // 检查客户端数量限制
     if (clients_.size() >= static_cast<size_t>(config_.max_clients)) {
         LOG_WARNING("达到最大客户端数量限制: " + std::to_string(config_.max_clients), "WebSocketCameraStreamer");
+        lock.unlock();
+        updateEncoderSubscriptions();
         return false;
     }
 
@@ -149,6 +301,10 @@ bool WebSocketCameraStreamer::addClient(const std::string& client_id, const std:
     auto client = std::make_shared<WebSocketCameraClient>();
     client->client_id = client_id;
     client->camera_id = camera_id;
+    client->tier = ladder_.resolve(tier);
+    client->codec = codec;
+    client->envelope = envelope;
+    client->rate = StreamRateController(ladder_, config_.adaptive, client->tier);
     client->last_frame_time = std::chrono::steady_clock::now();
     client->is_active = true;
     client->frame_count = 0;
@@ -158,12 +314,201 @@ bool WebSocketCameraStreamer::addClient(const std::string& client_id, const std:
     clients_[client_id] = client;
     camera_clients_[camera_id].insert(client_id);
 
-    LOG_INFO("添加WebSocket摄像头客户端: " + client_id + ", 摄像头: " + camera_id, "WebSocketCameraStreamer");
+    LOG_INFO("添加WebSocket摄像头客户端: " + client_id + ", 摄像头: " + camera_id + ", 编码: " + codec +
+             (codec == "jpeg" ? ", 档位: " + client->tier : ""), "WebSocketCameraStreamer");
+
+    lock.unlock();
+    updateEncoderSubscriptions();
     return true;
 }
 
-bool WebSocketCameraStreamer::removeClient(const std::string& client_id) {
+bool WebSocketCameraStreamer::setClientTier(const std::string& client_id, const std::string& tier) {
+    if (!ladder_.find(tier)) {
+        return false;
+    }
     std::lock_guard<std::mutex> lock(clients_mutex_);
+    auto it = clients_.find(client_id);
+    if (it == clients_.end()) {
+        return false;
+    }
+    it->second->rate.setCeiling(tier);
+    it->second->tier = tier;
+    LOG_INFO("WebSocket摄像头客户端 " + client_id + " 切换到档位: " + tier, "WebSocketCameraStreamer");
+    return true;
+}
+
+bool WebSocketCameraStreamer::onClientFeedback(const std::string& client_id, const ClientFeedback& feedback) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    auto it = clients_.find(client_id);
+    if (it == clients_.end()) {
+        return false;
+    }
+    it->second->rate.onFeedback(feedback, StreamRateController::Clock::now());
+    return true;
+}
+
+void WebSocketCameraStreamer::handleClientMessage(const std::string& client_id, const std::string& message) {
+    auto json = crow::json::load(message);
+    if (!json || json.t() != crow::json::type::Object) {
+        reply(client_id, "{\"status\":\"error\",\"message\":\"无效的JSON格式\"}");
+        return;
+    }
+    std::string action = stringField(json, "action");
+    std::string tier = stringField(json, "tier");
+
+    if (action == "subscribe") {
+        std::string camera_id = stringField(json, "camera_id");
+        std::string codec = stringField(json, "codec");
+        if (codec.empty()) {
+            codec = "jpeg";
+        }
+        if (!tier.empty() && !ladder_.find(tier)) {
+            reply(client_id, "{\"status\":\"error\",\"action\":\"subscribe\",\"message\":\"未知的档位: " +
+                             utils::StringUtils::escapeJson(tier) + "\"}");
+            return;
+        }
+        // 只认识当前版本的信封，更高的版本按当前版本发送，客户端从回复中得知实际版本
+        bool envelope = numberField(json, "envelope", 0.0) >= 1.0;
+        if (!addClient(client_id, camera_id, tier, codec, envelope)) {
+            reply(client_id, "{\"status\":\"error\",\"action\":\"subscribe\",\"message\":\"订阅失败\"}");
+            return;
+        }
+        reply(client_id, "{\"status\":\"success\",\"action\":\"subscribe\",\"camera_id\":\"" +
+                         utils::StringUtils::escapeJson(camera_id) + "\",\"codec\":\"" +
+                         utils::StringUtils::escapeJson(codec) + "\",\"tier\":\"" + ladder_.resolve(tier) +
+                         "\",\"envelope\":" + std::to_string(envelope ? StreamEnvelope::VERSION : 0) +
+                         ",\"clock_us\":" + std::to_string(camera::FrameLineage::nowUs()) + "}");
+        sendLatestFrame(client_id);
+    } else if (action == "set_tier") {
+        if (!setClientTier(client_id, tier)) {
+            reply(client_id, "{\"status\":\"error\",\"action\":\"set_tier\",\"message\":\"未订阅或未知的档位: " +
+                             utils::StringUtils::escapeJson(tier) + "\"}");
+            return;
+        }
+        reply(client_id, "{\"status\":\"success\",\"action\":\"set_tier\",\"tier\":\"" +
+                         utils::StringUtils::escapeJson(tier) + "\"}");
+        sendLatestFrame(client_id);
+    } else if (action == "feedback") {
+        // 反馈很频繁，不回复
+        ClientFeedback feedback;
+        feedback.lag_ms = numberField(json, "lag_ms", -1.0);
+        feedback.buffered_frames = static_cast<int>(numberField(json, "buffered", -1.0));
+        onClientFeedback(client_id, feedback);
+    } else if (action == "unsubscribe") {
+        removeClient(client_id);
+        reply(client_id, "{\"status\":\"success\",\"action\":\"unsubscribe\"}");
+    } else if (action == "time") {
+        // 客户端按往返时间的一半估计服务器时钟与本地时钟的差
+        reply(client_id, "{\"status\":\"success\",\"action\":\"time\",\"clock_us\":" +
+                         std::to_string(camera::FrameLineage::nowUs()) + "}");
+    } else if (action == "get_tiers") {
+        reply(client_id, "{\"status\":\"success\",\"action\":\"get_tiers\",\"tiers\":" + ladder_.toJson() + "}");
+    } else {
+        reply(client_id, "{\"status\":\"error\",\"message\":\"未知命令\"}");
+    }
+}
+
+void WebSocketCameraStreamer::sendLatestFrame(const std::string& client_id) {
+    std::string camera_id;
+    std::string tier;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        auto it = clients_.find(client_id);
+        if (it == clients_.end() || it->second->codec != "jpeg") {
+            return;
+        }
+        camera_id = it->second->camera_id;
+        tier = it->second->tier;
+    }
+    // 不等下一帧采集和编码，新画面随后按正常节奏到达
+    StreamEnvelope envelope;
+    video::JpegBuffer jpeg = LatestFrameStore::getInstance().get(camera_id, tier, &envelope.capture_time_us);
+    if (jpeg && crow_server_) {
+        envelope.codec = StreamCodec::JPEG;
+        envelope.flags = StreamEnvelope::FLAG_KEYFRAME | StreamEnvelope::FLAG_CACHED;
+        envelope.camera_id = camera_id;
+        envelope.tier = tier;
+        sendJpeg({client_id}, std::move(jpeg), std::move(envelope), true);
+    }
+}
+
+void WebSocketCameraStreamer::reply(const std::string& client_id, const std::string& message) {
+    if (crow_server_) {
+        crow_server_->sendWebSocketMessage(client_id, message, false);
+    }
+}
+
+void WebSocketCameraStreamer::sendMedia(const std::vector<std::string>& client_ids,
+                                        std::shared_ptr<const std::vector<uint8_t>> payload,
+                                        StreamEnvelope envelope, bool latest_only) {
+    if (!crow_server_ || !payload || client_ids.empty()) {
+        return;
+    }
+    std::vector<std::string> plain;
+    std::vector<std::string> enveloped;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (const auto& client_id : client_ids) {
+            auto it = clients_.find(client_id);
+            (it != clients_.end() && it->second->envelope ? enveloped : plain).push_back(client_id);
+        }
+    }
+    if (!plain.empty()) {
+        crow_server_->broadcastWebSocketPayload(plain, payload, true, latest_only);
+    }
+    if (!enveloped.empty()) {
+        // 发送时间取投递到写队列的时间，信封与帧头一起构造一次，所有客户端共享
+        envelope.send_time_us = camera::FrameLineage::nowUs();
+        envelope.payload_size = static_cast<uint32_t>(payload->size());
+        std::string prefix;
+        envelope.appendTo(prefix);
+        crow_server_->broadcastWebSocketPayload(enveloped, std::move(payload), true, latest_only, prefix);
+    }
+}
+
+void WebSocketCameraStreamer::sendJpeg(const std::vector<std::string>& client_ids,
+                                       std::shared_ptr<const std::vector<uint8_t>> jpeg,
+                                       StreamEnvelope envelope, bool cached) {
+    if (!crow_server_ || !jpeg || client_ids.empty()) {
+        return;
+    }
+    envelope.send_time_us = camera::FrameLineage::nowUs();
+    envelope.payload_size = static_cast<uint32_t>(jpeg->size());
+    std::vector<std::string> plain;
+    std::vector<std::pair<std::string, std::string>> enveloped;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (const auto& client_id : client_ids) {
+            auto it = clients_.find(client_id);
+            if (it == clients_.end() || !it->second->envelope) {
+                plain.push_back(client_id);
+                continue;
+            }
+            // 缓存重发沿用最近一次的序号，客户端不计入丢帧统计
+            if (!cached) {
+                it->second->jpeg_sequence++;
+            }
+            envelope.sequence = it->second->jpeg_sequence;
+            std::string prefix;
+            envelope.appendTo(prefix);
+            enveloped.emplace_back(client_id, std::move(prefix));
+        }
+    }
+    if (!plain.empty()) {
+        crow_server_->broadcastWebSocketPayload(plain, jpeg, true, true);
+    }
+    for (const auto& item : enveloped) {
+        crow_server_->broadcastWebSocketPayload({item.first}, jpeg, true, true, item.second);
+    }
+}
+
+uint32_t WebSocketCameraStreamer::nextSequence(const std::string& camera_id, const std::string& codec) {
+    std::lock_guard<std::mutex> lock(sequences_mutex_);
+    return ++sequences_[camera_id + '\n' + codec];
+}
+
+bool WebSocketCameraStreamer::removeClient(const std::string& client_id) {
+    std::unique_lock<std::mutex> lock(clients_mutex_);
 
     auto it = clients_.find(client_id);
     if (it == clients_.end()) {
@@ -185,6 +530,9 @@ bool WebSocketCameraStreamer::removeClient(const std::string& client_id) {
     clients_.erase(it);
 
     LOG_INFO("移除WebSocket摄像头客户端: " + client_id, "WebSocketCameraStreamer");
+
+    lock.unlock();
+    updateEncoderSubscriptions();
     return true;
 }
 
@@ -203,101 +551,517 @@ double WebSocketCameraStreamer::getCurrentFPS() const {
     return current_fps_.load();
 }
 
-void WebSocketCameraStreamer::broadcastFrame(const std::string& camera_id, const std::vector<uint8_t>& frame_data) {
-    if (!is_running_ || !crow_server_) {
+std::vector<ClientSendStats> WebSocketCameraStreamer::getClientSendStats() const {
+    std::vector<ClientSendStats> stats;
+    if (!crow_server_) {
+        return stats;
+    }
+
+    // 连接表中还有其他路径的连接，只保留摄像头流客户端
+    std::unordered_map<std::string, std::pair<std::string, double>> client_rates;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (const auto& pair : clients_) {
+            bool jpeg = pair.second->codec == "jpeg";
+            client_rates[pair.first] = std::make_pair(jpeg ? pair.second->tier : pair.second->codec,
+                                                      pair.second->rate.getTargetFps());
+        }
+    }
+    for (auto& client_stats : crow_server_->getWebSocketClientStats()) {
+        auto it = client_rates.find(client_stats.client_id);
+        if (it != client_rates.end()) {
+            client_stats.tier = it->second.first;
+            client_stats.target_fps = it->second.second;
+            stats.push_back(std::move(client_stats));
+        }
+    }
+    return stats;
+}
+
+std::unordered_map<std::string, video::TileDeltaStats> WebSocketCameraStreamer::getTileStats() const {
+    std::lock_guard<std::mutex> lock(tile_stats_mutex_);
+    return tile_stats_;
+}
+
+void WebSocketCameraStreamer::handleFrame(const camera::Frame& frame) {
+    if (!is_running_) {
         return;
     }
 
-    std::lock_guard<std::mutex> lock(clients_mutex_);
-    
-    auto camera_it = camera_clients_.find(camera_id);
-    if (camera_it == camera_clients_.end()) {
-        return; // 没有该摄像头的客户端
+    if (!crow_server_) {
+        return;
+    }
+
+    // 连接的发送统计在Crow中，按评估周期取一次，不在客户端锁内调用
+    auto now = std::chrono::steady_clock::now();
+    std::unordered_map<std::string, ClientSendStats> send_stats;
+    if (config_.adaptive.enabled && now >= next_rate_update_) {
+        for (auto& client_stats : crow_server_->getWebSocketClientStats()) {
+            send_stats[client_stats.client_id] = std::move(client_stats);
+        }
+        next_rate_update_ = now + std::chrono::milliseconds(config_.adaptive.evaluate_interval_ms);
+    }
+
+    // 按档位收集订阅了该摄像头的客户端
+    const std::string& camera_id = frame.getCameraId();
+    std::unordered_map<std::string, std::vector<std::string>> tier_clients;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        auto camera_it = camera_clients_.find(camera_id);
+        if (camera_it != camera_clients_.end()) {
+            for (const auto& client_id : camera_it->second) {
+                auto client_it = clients_.find(client_id);
+                if (client_it == clients_.end() || !client_it->second->is_active ||
+                    client_it->second->codec != "jpeg") {
+                    continue;
+                }
+                auto& client = client_it->second;
+                // 按连接写队列的丢帧和写出延迟调整档位，并按目标帧率抽帧
+                auto stats_it = send_stats.find(client_id);
+                if (stats_it != send_stats.end() && client->rate.needsUpdate(now) &&
+                    client->rate.update(stats_it->second, now)) {
+                    LOG_INFO("WebSocket摄像头客户端 " + client_id + " 自适应切换档位: " + client->tier + " -> " +
+                             client->rate.getTier() + "，状态: " + client->rate.getStateName(), "WebSocketCameraStreamer");
+                    client->tier = client->rate.getTier();
+                }
+                if (!client->rate.admitFrame(now)) {
+                    continue;
+                }
+                tier_clients[client->tier].push_back(client_id);
+                client->frame_count++;
+                client->last_frame_time = now;
+            }
+        }
     }
 
-    // 将帧数据转换为字符串
-    std::string frame_str(frame_data.begin(), frame_data.end());
+    // 保持期内的档位即使没有客户端也低频刷新，保存的最新帧不会过时
+    auto& latest_frames = LatestFrameStore::getInstance();
+    for (const auto& name : latest_frames.getTiersToRefresh(camera_id)) {
+        if (ladder_.find(name)) {
+            tier_clients[name];
+        }
+    }
+    if (tier_clients.empty()) {
+        return;
+    }
 
-    // 广播给该摄像头的所有客户端
-    for (const auto& client_id : camera_it->second) {
-        auto client_it = clients_.find(client_id);
-        if (client_it != clients_.end() && client_it->second->is_active) {
-            // 通过Crow服务器发送WebSocket消息
-            crow_server_->sendWebSocketMessage(client_id, frame_str, true); // true表示二进制消息
-            
-            // 更新客户端统计
-            client_it->second->frame_count++;
-            client_it->second->last_frame_time = std::chrono::steady_clock::now();
+    // 只编码有客户端订阅的档位，同一帧的同一档位在各流之间只编码一次
+    camera::FrameLineage lineage = frame.getLineage();
+    lineage.encode_start_us = camera::FrameLineage::nowUs();
+    struct TierOutput {
+        const std::string* tier;
+        const std::vector<std::string>* clients;
+        video::JpegBuffer jpeg;
+    };
+    std::vector<TierOutput> outputs;
+    for (const auto& pair : tier_clients) {
+        const StreamTier* tier = ladder_.find(pair.first);
+        if (!tier) {
+            continue;
         }
+        int width = 0;
+        int height = 0;
+        StreamLadder::getOutputSize(*tier, frame.getWidth(), frame.getHeight(), width, height);
+        video::JpegBuffer jpeg = video::EncodedFrameCache::getInstance().getJpeg(frame, tier->quality, width, height);
+        if (!jpeg) {
+            LOG_ERROR("编码JPEG失败，档位: " + pair.first, "WebSocketCameraStreamer");
+            continue;
+        }
+        latest_frames.put(camera_id, pair.first, jpeg, lineage.capture_time_us, !pair.second.empty());
+        if (!pair.second.empty()) {
+            outputs.push_back(TierOutput{&pair.first, &pair.second, std::move(jpeg)});
+        }
+    }
+    if (outputs.empty()) {
+        return;
     }
+    lineage.encode_end_us = camera::FrameLineage::nowUs();
 
-    // 更新全局帧率统计
+    // 每个档位的帧头构造一次，同档位客户端引用同一份JPEG数据
+    for (auto& output : outputs) {
+        StreamEnvelope envelope;
+        envelope.codec = StreamCodec::JPEG;
+        envelope.flags = StreamEnvelope::FLAG_KEYFRAME;
+        envelope.capture_time_us = lineage.capture_time_us;
+        envelope.camera_id = camera_id;
+        envelope.tier = *output.tier;
+        sendJpeg(*output.clients, std::move(output.jpeg), std::move(envelope), false);
+    }
     updateFPS();
+
+    lineage.send_time_us = camera::FrameLineage::nowUs();
+    camera::PipelineStats::getInstance().recordLineage(lineage);
 }
 
-bool WebSocketCameraStreamer::sendFrameToClient(const std::string& client_id, const std::vector<uint8_t>& frame_data) {
+void WebSocketCameraStreamer::handleH264Frame(const camera::Frame& frame) {
     if (!is_running_ || !crow_server_) {
-        return false;
+        return;
     }
 
-    std::lock_guard<std::mutex> lock(clients_mutex_);
-    
-    auto it = clients_.find(client_id);
-    if (it == clients_.end() || !it->second->is_active) {
-        return false;
+    // 已同步的客户端接收新数据，其余客户端等待GOP缓存或下一个关键帧
+    const std::string& camera_id = frame.getCameraId();
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::string> synced;
+    std::vector<std::string> joining;
+    std::vector<std::string> resyncing;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        auto camera_it = camera_clients_.find(camera_id);
+        if (camera_it != camera_clients_.end()) {
+            for (const auto& client_id : camera_it->second) {
+                auto client_it = clients_.find(client_id);
+                if (client_it == clients_.end() || !client_it->second->is_active ||
+                    client_it->second->codec != "h264") {
+                    continue;
+                }
+                auto& client = client_it->second;
+                if (client->h264_synced) {
+                    synced.push_back(client_id);
+                } else if (client->h264_joined) {
+                    resyncing.push_back(client_id);
+                } else {
+                    joining.push_back(client_id);
+                }
+                client->frame_count++;
+                client->last_frame_time = now;
+            }
+        }
+    }
+    if (synced.empty() && joining.empty() && resyncing.empty()) {
+        // 保持期内继续编码但不发送，新客户端可以直接从GOP缓存开始，不用等编码器重新打开
+        auto grace = std::chrono::milliseconds(LatestFrameStore::getInstance().getConfig().grace_period_ms);
+        auto it = h264_streams_.find(camera_id);
+        if (it == h264_streams_.end() || now - it->second->last_viewed > grace) {
+            if (it != h264_streams_.end()) {
+                h264_streams_.erase(it);
+            }
+            return;
+        }
+        std::vector<video::H264Packet> packets;
+        if (it->second->encoder.encode(frame, false, packets)) {
+            for (auto& packet : packets) {
+                packet.data = makeH264Message(packet);
+                packet.sequence = nextSequence(camera_id, "h264");
+                it->second->gop.push(packet);
+            }
+        }
+        return;
     }
 
-    // 将帧数据转换为字符串
-    std::string frame_str(frame_data.begin(), frame_data.end());
+    auto& stream = h264_streams_[camera_id];
+    if (!stream) {
+        stream.reset(new H264CameraStream());
+        stream->encoder.setConfig(config_.h264);
+    }
+    stream->last_viewed = now;
 
-    // 发送WebSocket消息
-    bool success = crow_server_->sendWebSocketMessage(client_id, frame_str, true);
-    
-    if (success) {
-        // 更新客户端统计
-        it->second->frame_count++;
-        it->second->last_frame_time = std::chrono::steady_clock::now();
+    // 写队列积压过多的客户端停发，丢掉的P帧之后无法解码，只能等下一个关键帧
+    if (!synced.empty()) {
+        std::unordered_set<std::string> backlogged;
+        for (const auto& stats : crow_server_->getWebSocketClientStats()) {
+            if (stats.depth > static_cast<size_t>(std::max(1, config_.h264_max_backlog))) {
+                backlogged.insert(stats.client_id);
+            }
+        }
+        auto it = std::remove_if(synced.begin(), synced.end(), [&](const std::string& client_id) {
+            if (backlogged.count(client_id) == 0) {
+                return false;
+            }
+            LOG_WARNING("H.264客户端 " + client_id + " 积压过多，等待下一个关键帧", "WebSocketCameraStreamer");
+            resyncing.push_back(client_id);
+            return true;
+        });
+        synced.erase(it, synced.end());
+    }
+
+    // 新客户端能用GOP缓存立即开始时不打断其他客户端，否则请求关键帧，每秒最多一次
+    size_t join_burst = static_cast<size_t>(std::max(1, config_.h264_join_burst));
+    bool cache_usable = stream->gop.isDecodable() && stream->gop.size() < join_burst;
+    bool force_keyframe = false;
+    if ((!resyncing.empty() || (!joining.empty() && !cache_usable)) &&
+        now - stream->last_forced_keyframe >= std::chrono::seconds(1)) {
+        force_keyframe = true;
+        stream->last_forced_keyframe = now;
+    }
+
+    camera::FrameLineage lineage = frame.getLineage();
+    lineage.encode_start_us = camera::FrameLineage::nowUs();
+    std::vector<video::H264Packet> packets;
+    if (!stream->encoder.encode(frame, force_keyframe, packets)) {
+        LOG_ERROR("H.264编码失败，摄像头: " + camera_id, "WebSocketCameraStreamer");
+        return;
+    }
+    lineage.encode_end_us = camera::FrameLineage::nowUs();
+    if (packets.empty()) {
+        return;
+    }
+    for (auto& packet : packets) {
+        packet.data = makeH264Message(packet);
+        packet.sequence = nextSequence(camera_id, "h264");
+        stream->gop.push(packet);
+    }
+
+    // 分辨率变化后编码器已重新打开，所有客户端都要按新的参数重新配置解码器
+    if (stream->width != stream->encoder.getWidth() || stream->height != stream->encoder.getHeight()) {
+        stream->width = stream->encoder.getWidth();
+        stream->height = stream->encoder.getHeight();
+        resyncing.insert(resyncing.end(), synced.begin(), synced.end());
+        synced.clear();
     }
 
-    return success;
+    // 新客户端从GOP缓存开始，缓存已包含本帧；重新同步的客户端只从新的关键帧开始，避免重复收到旧帧
+    std::vector<std::string> starting;
+    if (!joining.empty() && stream->gop.isDecodable() && stream->gop.size() <= join_burst) {
+        starting = joining;
+    }
+    std::vector<std::string> restarting;
+    if (!resyncing.empty() && packets.front().keyframe) {
+        restarting = resyncing;
+    }
+    if (!starting.empty() || !restarting.empty()) {
+        std::ostringstream info;
+        info << "{\"action\":\"stream_info\",\"camera_id\":\"" << utils::StringUtils::escapeJson(camera_id) << "\",";
+        info << "\"codec\":\"h264\",\"format\":\"annexb\",";
+        info << "\"codec_string\":\"" << stream->encoder.getCodecString() << "\",";
+        info << "\"encoder\":\"" << stream->encoder.getEncoderName() << "\",";
+        info << "\"width\":" << stream->width << ",\"height\":" << stream->height << "}";
+        for (const auto& client_id : starting) {
+            reply(client_id, info.str());
+        }
+        for (const auto& client_id : restarting) {
+            reply(client_id, info.str());
+        }
+    }
+
+    // 不能按最新帧替换，同一连接上的消息按编码顺序写出
+    auto make_envelope = [&camera_id](const video::H264Packet& packet, bool cached) {
+        StreamEnvelope envelope;
+        envelope.codec = StreamCodec::H264;
+        envelope.flags = (packet.keyframe ? StreamEnvelope::FLAG_KEYFRAME : 0) |
+                         (cached ? StreamEnvelope::FLAG_CACHED : 0);
+        envelope.sequence = packet.sequence;
+        envelope.capture_time_us = packet.timestamp_us;
+        envelope.camera_id = camera_id;
+        return envelope;
+    };
+    if (!starting.empty()) {
+        for (const auto& packet : stream->gop.getPackets()) {
+            sendMedia(starting, packet.data, make_envelope(packet, packet.sequence < packets.front().sequence), false);
+        }
+    }
+    synced.insert(synced.end(), restarting.begin(), restarting.end());
+    for (const auto& packet : packets) {
+        sendMedia(synced, packet.data, make_envelope(packet, false), false);
+    }
+    updateFPS();
+
+    lineage.send_time_us = camera::FrameLineage::nowUs();
+    camera::PipelineStats::getInstance().recordLineage(lineage);
+
+    // 更新同步状态
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (const auto& client_id : starting) {
+        auto it = clients_.find(client_id);
+        if (it != clients_.end()) {
+            it->second->h264_joined = true;
+            it->second->h264_synced = true;
+        }
+    }
+    for (const auto& client_id : resyncing) {
+        auto it = clients_.find(client_id);
+        if (it != clients_.end()) {
+            it->second->h264_synced = std::find(restarting.begin(), restarting.end(), client_id) != restarting.end();
+        }
+    }
 }
 
-void WebSocketCameraStreamer::handleFrame(const camera::Frame& frame) {
-    if (!is_running_) {
+void WebSocketCameraStreamer::handleTileFrame(const camera::Frame& frame) {
+    if (!is_running_ || !crow_server_) {
+        return;
+    }
+
+    // 没有变化时不发送数据，这里也要刷新活动时间，静止画面的客户端不能被当作非活跃清理掉
+    const std::string& camera_id = frame.getCameraId();
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::string> synced;
+    std::vector<std::string> joining;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        auto camera_it = camera_clients_.find(camera_id);
+        if (camera_it != camera_clients_.end()) {
+            for (const auto& client_id : camera_it->second) {
+                auto client_it = clients_.find(client_id);
+                if (client_it == clients_.end() || !client_it->second->is_active ||
+                    client_it->second->codec != "tiles") {
+                    continue;
+                }
+                (client_it->second->tiles_synced ? synced : joining).push_back(client_id);
+                client_it->second->last_frame_time = now;
+            }
+        }
+    }
+    if (synced.empty() && joining.empty()) {
+        tile_streams_.erase(camera_id);
         return;
     }
 
-    // 编码为JPEG
-    std::vector<uint8_t> jpeg_data;
-    if (!encodeToJpeg(frame, jpeg_data)) {
-        LOG_ERROR("编码JPEG失败", "WebSocketCameraStreamer");
+    // 写队列积压的客户端本帧不发送，丢掉的瓦片无法补回，积压消化后重新发全帧
+    std::vector<std::string> backlogged;
+    {
+        std::unordered_set<std::string> congested;
+        for (const auto& stats : crow_server_->getWebSocketClientStats()) {
+            if (stats.depth > static_cast<size_t>(std::max(1, config_.tiles_max_backlog))) {
+                congested.insert(stats.client_id);
+            }
+        }
+        for (auto* clients : {&synced, &joining}) {
+            auto it = std::remove_if(clients->begin(), clients->end(), [&](const std::string& client_id) {
+                if (congested.count(client_id) == 0) {
+                    return false;
+                }
+                backlogged.push_back(client_id);
+                return true;
+            });
+            clients->erase(it, clients->end());
+        }
+    }
+
+    auto& encoder = tile_streams_[camera_id];
+    if (!encoder) {
+        encoder.reset(new video::TileDeltaEncoder(config_.tiles));
+    }
+
+    // 有客户端等待同步时输出全帧，全帧同时作为已同步客户端的新参考
+    camera::FrameLineage lineage = frame.getLineage();
+    lineage.encode_start_us = camera::FrameLineage::nowUs();
+    video::TileDeltaUpdate update;
+    bool encoded = encoder->encode(frame, !joining.empty(), update);
+    {
+        std::lock_guard<std::mutex> lock(tile_stats_mutex_);
+        tile_stats_[camera_id] = encoder->getStats();
+    }
+    if (!encoded) {
+        LOG_ERROR("瓦片增量编码失败，摄像头: " + camera_id, "WebSocketCameraStreamer");
         return;
     }
+    lineage.encode_end_us = camera::FrameLineage::nowUs();
 
-    // 广播到所有客户端（假设使用默认摄像头ID）
-    broadcastFrame("default", jpeg_data);
+    std::vector<std::string> receivers = synced;
+    if (update.full) {
+        receivers.insert(receivers.end(), joining.begin(), joining.end());
+    }
+    if (!update.empty() && !receivers.empty()) {
+        // 更新要按顺序叠加，不能按最新帧替换
+        StreamEnvelope envelope;
+        envelope.codec = StreamCodec::TILES;
+        envelope.flags = update.full ? StreamEnvelope::FLAG_KEYFRAME : 0;
+        envelope.sequence = nextSequence(camera_id, "tiles");
+        envelope.capture_time_us = update.timestamp_us;
+        envelope.camera_id = camera_id;
+        sendMedia(receivers, makeTileMessage(update), std::move(envelope), false);
+        updateFPS();
+        lineage.send_time_us = camera::FrameLineage::nowUs();
+        camera::PipelineStats::getInstance().recordLineage(lineage);
+    }
+
+    // 更新同步状态
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    for (const auto& client_id : receivers) {
+        auto it = clients_.find(client_id);
+        if (it != clients_.end()) {
+            if (!update.empty()) {
+                it->second->frame_count++;
+            }
+            it->second->tiles_synced = true;
+        }
+    }
+    for (const auto& client_id : backlogged) {
+        auto it = clients_.find(client_id);
+        if (it != clients_.end()) {
+            it->second->tiles_synced = false;
+        }
+    }
+}
+
+void WebSocketCameraStreamer::updateEncoderSubscriptions() {
+    bool h264_needed = false;
+    bool tiles_needed = false;
+    if (is_running_) {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (const auto& pair : clients_) {
+            h264_needed = h264_needed || pair.second->codec == "h264";
+            tiles_needed = tiles_needed || pair.second->codec == "tiles";
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(encoder_subscription_mutex_);
+    auto& camera_manager = camera::CameraManager::getInstance();
+
+    // 最后一个H.264客户端离开后，保持期内保留订阅和编码器
+    auto now = std::chrono::steady_clock::now();
+    bool h264_warm = false;
+    if (h264_needed) {
+        h264_last_client_time_ = now;
+    } else if (is_running_ && h264_subscription_ != 0) {
+        auto grace = std::chrono::milliseconds(LatestFrameStore::getInstance().getConfig().grace_period_ms);
+        h264_warm = now - h264_last_client_time_ <= grace;
+    }
+
+    if (h264_needed && h264_subscription_ == 0) {
+        // H.264编码需要YUV输入，只在有H.264客户端时参与格式协商
+        camera::FrameSubscriberOptions options;
+        options.queue_depth = 4;
+        options.drop_policy = camera::FrameDropPolicy::KEEP_LATEST;
+        options.consumer = camera::FrameConsumerKind::VIDEO_ENCODER;
+        options.fixed_format = true;  // 切换分辨率会重新打开编码器，所有客户端都要等关键帧重新同步
+        h264_subscription_ = camera_manager.subscribeFrames("websocket_h264", [this](const camera::Frame& frame) {
+            handleH264Frame(frame);
+        }, options);
+    } else if (!h264_needed && !h264_warm && h264_subscription_ != 0) {
+        // 取消订阅会等待订阅线程退出，之后可以安全释放编码器
+        camera_manager.unsubscribeFrames(h264_subscription_);
+        h264_subscription_ = 0;
+        h264_streams_.clear();
+    }
+
+    if (tiles_needed && tile_subscription_ == 0) {
+        // 比较瓦片需要像素数据，MJPEG输入要先解码
+        camera::FrameSubscriberOptions options;
+        options.queue_depth = 4;
+        options.drop_policy = camera::FrameDropPolicy::KEEP_LATEST;
+        options.consumer = camera::FrameConsumerKind::RAW_PIXELS;
+        tile_subscription_ = camera_manager.subscribeFrames("websocket_tiles", [this](const camera::Frame& frame) {
+            handleTileFrame(frame);
+        }, options);
+    } else if (!tiles_needed && tile_subscription_ != 0) {
+        camera_manager.unsubscribeFrames(tile_subscription_);
+        tile_subscription_ = 0;
+        tile_streams_.clear();
+    }
 }
 
 bool WebSocketCameraStreamer::encodeToJpeg(const camera::Frame& frame, std::vector<uint8_t>& jpeg_data) {
-    // 这里使用简化的JPEG编码实现
-    // 实际项目中应该使用FFmpeg进行编码
-    
-    if (frame.getData().empty()) {
+    if (frame.isEmpty()) {
         return false;
     }
 
     // 如果帧已经是JPEG格式，直接使用
     if (frame.getFormat() == camera::PixelFormat::MJPEG) {
-        jpeg_data = frame.getData();
+        jpeg_data.assign(frame.getDataPtr(), frame.getDataPtr() + frame.getDataSize());
         return true;
     }
 
-    // TODO: 实现其他格式到JPEG的转换
-    LOG_WARNING("暂不支持非MJPEG格式的编码", "WebSocketCameraStreamer");
-    return false;
+    if (!video::JpegEncoder::isSupported(frame.getFormat())) {
+        LOG_WARNING("不支持的编码输入格式: " + std::to_string(static_cast<int>(frame.getFormat())),
+                    "WebSocketCameraStreamer");
+        return false;
+    }
+    return video::JpegEncoderPool::getInstance().encode(frame, config_.jpeg_quality, jpeg_data);
 }
 
 void WebSocketCameraStreamer::updateFPS() {
+    // JPEG档位、H.264和瓦片工作线程都会调用
+    std::lock_guard<std::mutex> lock(fps_mutex_);
     frame_count_++;
     
     auto now = std::chrono::steady_clock::now();
@@ -312,20 +1076,21 @@ void WebSocketCameraStreamer::updateFPS() {
 }
 
 void WebSocketCameraStreamer::cleanupInactiveClients() {
-    std::lock_guard<std::mutex> lock(clients_mutex_);
-    
     auto now = std::chrono::steady_clock::now();
     std::vector<std::string> inactive_clients;
     
     // 查找非活跃客户端（超过30秒没有活动）
-    for (const auto& [client_id, client] : clients_) {
-        auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - client->last_frame_time);
-        if (duration.count() > 30) {
-            inactive_clients.push_back(client_id);
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (const auto& [client_id, client] : clients_) {
+            auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - client->last_frame_time);
+            if (duration.count() > 30) {
+                inactive_clients.push_back(client_id);
+            }
         }
     }
     
-    // 移除非活跃客户端
+    // 移除非活跃客户端，removeClient自己加锁
     for (const auto& client_id : inactive_clients) {
         LOG_INFO("清理非活跃客户端: " + client_id, "WebSocketCameraStreamer");
         removeClient(client_id);
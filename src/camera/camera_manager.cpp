@@ -1,25 +1,61 @@
 #include "camera/camera_manager.h"
 #include "camera/v4l2_camera.h"
+#include "camera/synthetic_camera.h"
+#include "camera/replay_camera.h"
+#include "camera/capture_reactor.h"
+#include "camera/capability_cache.h"
+#include "camera/format_utils.h"
 #include "monitor/logger.h"
 #include "utils/config_manager.h"
+#include "utils/string_utils.h"
 #include <sstream>
 #include <typeinfo>  // for typeid
-#include <atomic>    // for std::atomic
 #include <chrono>    // for std::chrono
+#include <future>    // for std::packaged_task
 #include <thread>    // for std::thread
+#include <algorithm>
 
 namespace cam_server {
 namespace camera {
 
+namespace {
+
+// 设备打开/停止/关闭操作的超时时间
+constexpr int kDeviceOpTimeoutSeconds = 5;
+// 捕获中重新协商时，新方案代价须低于当前方案的该比例才切换格式
+constexpr double kRenegotiateThreshold = 0.8;
+
+/**
+ * @brief 在独立线程中执行设备操作，超时后放弃等待
+ *
+ * 任务持有所需对象的共享引用，超时后线程继续在后台运行也不会访问已释放的对象。
+ */
+bool runWithTimeout(const std::string& what, std::function<bool()> task, bool* timed_out = nullptr) {
+    auto packaged = std::make_shared<std::packaged_task<bool()>>(std::move(task));
+    std::future<bool> result = packaged->get_future();
+    std::thread([packaged]() { (*packaged)(); }).detach();
+
+    if (result.wait_for(std::chrono::seconds(kDeviceOpTimeoutSeconds)) != std::future_status::ready) {
+        LOG_ERROR(what + "操作超时!", "CameraManager");
+        if (timed_out) {
+            *timed_out = true;
+        }
+        return false;
+    }
+    return result.get();
+}
+
+} // namespace
+
 // 单例实例
 CameraManager& CameraManager::getInstance() {
     static CameraManager instance;
     return instance;
 }
 
-CameraManager::CameraManager()
-    : current_device_(nullptr),
-      is_capturing_(false) {
+CameraManager::CameraManager() {
+    // 先构造反应器单例，保证其在摄像头之后析构
+    CaptureReactor::getInstance();
 }
 
 bool CameraManager::initialize(const std::string& config_path) {
@@ -35,6 +71,18 @@ bool CameraManager::initialize(const std::string& config_path) {
     }
     LOG_DEBUG("配置文件加载成功", "CameraManager");
 
+    // 捕获反应器线程数，所有摄像头共用
+    int capture_threads = config.getInt("camera.capture_threads", 1);
+    CaptureReactor::getInstance().setThreadCount(capture_threads > 0 ? static_cast<size_t>(capture_threads) : 1);
+
+    // 捕获线程调度：实时优先级或nice值，以及CPU亲和性（如固定到大核）
+    CaptureThreadScheduling scheduling;
+    scheduling.realtime = utils::StringUtils::toLower(config.getString("camera.capture_sched_policy", "other")) == "fifo";
+    scheduling.priority = config.getInt("camera.capture_priority", 10);
+    scheduling.nice = config.getInt("camera.capture_nice", 0);
+    scheduling.cpus = CaptureReactor::parseCpuList(config.getString("camera.capture_cpus", ""));
+    CaptureReactor::getInstance().setScheduling(scheduling);
+
     // 获取互斥锁
     LOG_DEBUG("正在获取互斥锁...", "CameraManager");
     std::lock_guard<std::mutex> lock(device_mutex_);
@@ -51,320 +99,518 @@ std::vector<CameraDeviceInfo> CameraManager::scanDevices() {
     return v4l2Camera->scanDevices();
 }
 
-bool CameraManager::openDevice(const std::string& device_path, int width, int height, int fps) {
+bool CameraManager::openCamera(const std::string& camera_id, const std::string& device_path,
+                               int width, int height, int fps) {
     std::stringstream ss;
-    ss << "开始打开摄像头设备: " << device_path
+    ss << "开始打开摄像头: " << camera_id << " (" << device_path << ")"
        << ", 分辨率: " << width << "x" << height
        << ", 帧率: " << fps;
     LOG_DEBUG(ss.str(), "CameraManager");
 
-    std::lock_guard<std::mutex> lock(device_mutex_);
-    LOG_DEBUG("获取互斥锁成功", "CameraManager");
+    if (camera_id.empty()) {
+        LOG_ERROR("摄像头ID不能为空", "CameraManager");
+        return false;
+    }
 
-    // 检查是否有已打开的设备
-    if (current_device_ && current_device_->isOpen()) {
-        LOG_DEBUG("已有打开的设备，尝试关闭...", "CameraManager");
-
-        // 为了避免可能的死锁，我们先将当前设备置为nullptr，然后在后台关闭它
-        std::shared_ptr<CameraDevice> old_device = current_device_;
-        current_device_ = nullptr;
-
-        // 在后台线程中关闭设备
-        std::thread close_thread([old_device]() {
-            LOG_DEBUG("在后台线程中关闭设备...", "CameraManager");
-            old_device->close();
-            LOG_DEBUG("设备关闭完成", "CameraManager");
-        });
-        close_thread.detach();  // 分离线程，让它在后台运行
-
-        LOG_DEBUG("已在后台启动设备关闭线程", "CameraManager");
-    } else {
-        LOG_DEBUG("没有已打开的设备", "CameraManager");
-    }
-
-    // 创建新的摄像头设备
-    LOG_DEBUG("正在创建V4L2摄像头设备...", "CameraManager");
-    current_device_ = createV4L2CameraDevice();
-    LOG_DEBUG(std::string("V4L2摄像头设备创建") + (current_device_ ? "成功" : "失败"), "CameraManager");
-
-    // 打开设备
-    LOG_DEBUG("正在打开设备...", "CameraManager");
-    LOG_DEBUG(std::string("设备类型: ") + typeid(*current_device_).name(), "CameraManager");
-
-    // 尝试将current_device_转换为V4L2Camera
-    auto v4l2_camera = std::dynamic_pointer_cast<V4L2Camera>(current_device_);
-    if (v4l2_camera) {
-        LOG_DEBUG("成功将设备转换为V4L2Camera", "CameraManager");
-    } else {
-        LOG_WARNING("无法将设备转换为V4L2Camera", "CameraManager");
-    }
-
-    // 添加超时机制
-    LOG_DEBUG("尝试打开摄像头设备，添加超时机制...", "CameraManager");
-
-    // 创建一个线程来执行打开设备的操作
-    std::atomic<bool> open_success(false);
-    std::atomic<bool> open_completed(false);
-
-    std::thread open_thread([&]() {
-        LOG_DEBUG("打开设备线程开始执行...", "CameraManager");
-        bool result = current_device_->open(device_path, width, height, fps);
-        open_success.store(result);
-        open_completed.store(true);
-        LOG_DEBUG(std::string("打开设备线程执行完成，结果: ") + (result ? "成功" : "失败"), "CameraManager");
-    });
+    // 同一ID已有摄像头时先关闭
+    closeCamera(camera_id);
 
-    // 等待打开设备操作完成或超时
-    const int timeout_seconds = 5;
-    std::stringstream timeout_ss;
-    timeout_ss << "等待打开设备操作完成，超时时间: " << timeout_seconds << "秒...";
-    LOG_DEBUG(timeout_ss.str(), "CameraManager");
+    // 打开设备时不持有锁，避免阻塞其他摄像头
+    LOG_DEBUG("正在创建摄像头设备...", "CameraManager");
+    std::shared_ptr<CameraDevice> device = createCameraDevice(device_path);
+    if (!device) {
+        LOG_ERROR("无法创建摄像头设备", "CameraManager");
+        return false;
+    }
 
-    auto start_time = std::chrono::steady_clock::now();
-    while (!open_completed.load()) {
-        auto current_time = std::chrono::steady_clock::now();
-        auto elapsed_time = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
+    bool timed_out = false;
+    bool opened = runWithTimeout("打开设备", [device, device_path, width, height, fps]() {
+        return device->open(device_path, width, height, fps);
+    }, &timed_out);
+    if (!opened) {
+        LOG_ERROR(std::string(timed_out ? "打开摄像头设备超时: " : "无法打开摄像头设备: ") + device_path,
+                  "CameraManager");
+        return false;
+    }
 
-        if (elapsed_time >= timeout_seconds) {
-            LOG_ERROR("打开设备操作超时!", "CameraManager");
-            break;
+    // 设置帧队列深度和丢帧策略
+    auto& config = utils::ConfigManager::getInstance();
+    int queue_depth = config.getInt("camera.frame_queue_depth", 2);
+    std::string queue_policy = config.getString("camera.frame_queue_policy", "drop_oldest");
+    device->setFrameQueueConfig(queue_depth > 0 ? static_cast<size_t>(queue_depth) : 1,
+                                parseFrameDropPolicy(queue_policy));
+    LOG_DEBUG("帧队列深度: " + std::to_string(queue_depth) + ", 丢帧策略: " + queue_policy, "CameraManager");
+
+    // 帧带有摄像头ID后发布到总线，捕获线程只负责入队
+    device->setCameraId(camera_id);
+    device->setFrameCallback([this](const Frame& frame) {
+        frame_bus_.publish(frame);
+    });
+
+    std::shared_ptr<CameraDevice> replaced;
+    {
+        std::lock_guard<std::mutex> lock(device_mutex_);
+        // 打开期间其他线程可能以同一ID打开了摄像头
+        auto it = cameras_.find(camera_id);
+        if (it != cameras_.end()) {
+            replaced = it->second;
+        }
+        cameras_[camera_id] = device;
+        if (default_camera_id_.empty()) {
+            default_camera_id_ = camera_id;
         }
+        CameraParams requested = device->getParams();
+        requested.width = width;
+        requested.height = height;
+        requested.fps = fps;
+        requested_params_[camera_id] = requested;
+    }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (replaced) {
+        LOG_WARNING("摄像头 " + camera_id + " 被并发替换，关闭旧设备", "CameraManager");
+        runWithTimeout("关闭设备", [replaced]() { return replaced->close(); });
     }
 
-    // 如果线程仍在运行，分离它
-    if (!open_completed.load()) {
-        LOG_DEBUG("打开设备操作未完成，分离线程...", "CameraManager");
-        open_thread.detach();
-        LOG_ERROR("打开摄像头设备超时: " + device_path, "CameraManager");
-        current_device_ = nullptr;
-        return false;
-    } else {
-        open_thread.join();
+    // 尚未开始捕获，此时按订阅者需求切换格式不会中断画面
+    negotiateFormat(camera_id, true);
 
-        if (!open_success.load()) {
-            LOG_ERROR("无法打开摄像头设备: " + device_path, "CameraManager");
-            current_device_ = nullptr;
-            return false;
+    LOG_INFO("成功打开摄像头: " + camera_id + " (" + device_path + ")", "CameraManager");
+    return true;
+}
+
+bool CameraManager::closeCamera(const std::string& camera_id) {
+    std::lock_guard<std::mutex> control_lock(control_mutex_);
+    std::shared_ptr<CameraDevice> device;
+    {
+        std::lock_guard<std::mutex> lock(device_mutex_);
+        auto it = cameras_.find(camera_id);
+        if (it == cameras_.end()) {
+            LOG_DEBUG("没有打开的摄像头: " + camera_id, "CameraManager");
+            return true;
+        }
+        device = it->second;
+        cameras_.erase(it);
+        requested_params_.erase(camera_id);
+        format_plans_.erase(camera_id);
+        demand_signatures_.erase(camera_id);
+        pending_params_.erase(camera_id);
+        if (default_camera_id_ == camera_id) {
+            default_camera_id_.clear();
         }
     }
 
-    // 设置帧回调
-    LOG_DEBUG("正在设置帧回调...", "CameraManager");
-    current_device_->setFrameCallback([this](const Frame& frame) {
-        if (frame_callback_) {
-            frame_callback_(frame);
-        }
-    });
-    LOG_DEBUG("帧回调设置成功", "CameraManager");
+    // 已从表中移除，停止和关闭时不持有锁
+    LOG_DEBUG("开始关闭摄像头: " + camera_id, "CameraManager");
+    if (device->isCapturing()) {
+        runWithTimeout("停止捕获", [device]() { return device->stopCapture(); });
+    }
 
-    LOG_INFO("成功打开摄像头设备: " + device_path, "CameraManager");
-    return true;
+    bool timed_out = false;
+    bool result = runWithTimeout("关闭设备", [device]() { return device->close(); }, &timed_out);
+    LOG_INFO("关闭摄像头: " + camera_id + (timed_out ? "（超时）" : ""), "CameraManager");
+    return result;
 }
 
-bool CameraManager::closeDevice() {
-    LOG_DEBUG("开始关闭设备...", "CameraManager");
+void CameraManager::closeAllCameras() {
+    for (const auto& camera_id : getCameraIds()) {
+        closeCamera(camera_id);
+    }
+}
 
+std::vector<std::string> CameraManager::getCameraIds() const {
     std::lock_guard<std::mutex> lock(device_mutex_);
-    LOG_DEBUG("获取互斥锁成功", "CameraManager");
+    std::vector<std::string> ids;
+    ids.reserve(cameras_.size());
+    for (const auto& pair : cameras_) {
+        ids.push_back(pair.first);
+    }
+    return ids;
+}
 
-    // 停止捕获
-    if (is_capturing_) {
-        LOG_DEBUG("设备正在捕获中，尝试停止捕获...", "CameraManager");
-
-        // 添加超时机制
-        std::atomic<bool> stop_completed(false);
-
-        std::thread stop_thread([&]() {
-            LOG_DEBUG("停止捕获线程开始执行...", "CameraManager");
-            bool result = stopCapture();
-            LOG_DEBUG(std::string("停止捕获结果: ") + (result ? "成功" : "失败"), "CameraManager");
-            stop_completed.store(true);
-        });
-
-        // 等待停止捕获操作完成或超时
-        const int timeout_seconds = 5; // 增加超时时间到5秒
-        std::stringstream stop_timeout_ss;
-        stop_timeout_ss << "等待停止捕获操作完成，超时时间: " << timeout_seconds << "秒...";
-        LOG_DEBUG(stop_timeout_ss.str(), "CameraManager");
-
-        auto start_time = std::chrono::steady_clock::now();
-        while (!stop_completed.load()) {
-            auto current_time = std::chrono::steady_clock::now();
-            auto elapsed_time = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
-
-            if (elapsed_time >= timeout_seconds) {
-                LOG_ERROR("停止捕获操作超时!", "CameraManager");
-                break;
-            }
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
+std::shared_ptr<CameraDevice> CameraManager::findDeviceLocked(const std::string& camera_id) const {
+    auto it = cameras_.find(camera_id);
+    return it != cameras_.end() ? it->second : nullptr;
+}
 
-        // 如果线程仍在运行，分离它
-        if (!stop_completed.load()) {
-            LOG_DEBUG("停止捕获操作未完成，分离线程...", "CameraManager");
-            stop_thread.detach();
-            LOG_DEBUG("强制设置捕获状态为false", "CameraManager");
-            is_capturing_ = false;
-        } else {
-            stop_thread.join();
-        }
-    } else {
-        LOG_DEBUG("设备未在捕获中", "CameraManager");
-    }
-
-    // 关闭设备
-    if (current_device_) {
-        LOG_DEBUG("尝试关闭设备...", "CameraManager");
-
-        // 添加超时机制
-        std::atomic<bool> close_completed(false);
-        std::atomic<bool> close_result(false);
-
-        std::thread close_thread([&]() {
-            LOG_DEBUG("关闭设备线程开始执行...", "CameraManager");
-            bool result = current_device_->close();
-            close_result.store(result);
-            close_completed.store(true);
-            LOG_DEBUG(std::string("关闭设备结果: ") + (result ? "成功" : "失败"), "CameraManager");
-        });
-
-        // 等待关闭设备操作完成或超时
-        const int timeout_seconds = 5; // 增加超时时间到5秒
-        std::stringstream close_timeout_ss;
-        close_timeout_ss << "等待关闭设备操作完成，超时时间: " << timeout_seconds << "秒...";
-        LOG_DEBUG(close_timeout_ss.str(), "CameraManager");
-
-        auto start_time = std::chrono::steady_clock::now();
-        while (!close_completed.load()) {
-            auto current_time = std::chrono::steady_clock::now();
-            auto elapsed_time = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
-
-            if (elapsed_time >= timeout_seconds) {
-                LOG_ERROR("关闭设备操作超时!", "CameraManager");
-                break;
-            }
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
+std::shared_ptr<CameraDevice> CameraManager::getDevice(const std::string& camera_id) const {
+    std::lock_guard<std::mutex> lock(device_mutex_);
+    return findDeviceLocked(camera_id);
+}
 
-        // 如果线程仍在运行，分离它
-        if (!close_completed.load()) {
-            LOG_DEBUG("关闭设备操作未完成，分离线程...", "CameraManager");
-            close_thread.detach();
-            current_device_ = nullptr;
-            LOG_INFO("关闭摄像头设备（超时）", "CameraManager");
-            LOG_DEBUG("设备关闭完成（超时）", "CameraManager");
+bool CameraManager::startCapture(const std::string& camera_id) {
+    std::lock_guard<std::mutex> control_lock(control_mutex_);
+
+    std::shared_ptr<CameraDevice> device;
+    bool has_pending_params = false;
+    CameraParams pending_params;
+    bool pending_plan = false;
+    {
+        std::lock_guard<std::mutex> lock(device_mutex_);
+        device = findDeviceLocked(camera_id);
+        if (!device) {
+            LOG_ERROR("没有打开的摄像头设备: " + camera_id, "CameraManager");
             return false;
-        } else {
-            close_thread.join();
-            current_device_ = nullptr;
-            LOG_INFO("关闭摄像头设备", "CameraManager");
-            LOG_DEBUG("设备关闭完成", "CameraManager");
-            return close_result.load();
         }
-    } else {
-        LOG_DEBUG("没有打开的设备", "CameraManager");
+        if (device->isCapturing()) {
+            return true;  // 已经在捕获中
+        }
+        auto params_it = pending_params_.find(camera_id);
+        if (params_it != pending_params_.end()) {
+            has_pending_params = true;
+            pending_params = params_it->second;
+            pending_params_.erase(params_it);
+        }
+        auto plan_it = format_plans_.find(camera_id);
+        pending_plan = plan_it != format_plans_.end() && plan_it->second.pending;
     }
 
-    LOG_DEBUG("设备关闭完成", "CameraManager");
+    // 捕获中推迟的参数和格式方案在开始捕获前应用
+    if (has_pending_params && !device->setParams(pending_params)) {
+        LOG_WARNING("无法应用推迟的摄像头参数: " + camera_id, "CameraManager");
+    }
+    if (has_pending_params || pending_plan) {
+        negotiateFormatLocked(camera_id, true);
+    }
+
+    if (!device->startCapture()) {
+        LOG_ERROR("无法开始捕获: " + camera_id, "CameraManager");
+        return false;
+    }
+
+    LOG_INFO("开始捕获视频帧: " + camera_id, "CameraManager");
     return true;
 }
 
-bool CameraManager::isDeviceOpen() const {
-    std::lock_guard<std::mutex> lock(device_mutex_);
-    return current_device_ && current_device_->isOpen();
+bool CameraManager::stopCapture(const std::string& camera_id) {
+    std::lock_guard<std::mutex> control_lock(control_mutex_);
+
+    auto device = getDevice(camera_id);
+    if (!device) {
+        LOG_ERROR("没有打开的摄像头设备: " + camera_id, "CameraManager");
+        return false;
+    }
+
+    if (!device->isCapturing()) {
+        return true;  // 没有在捕获
+    }
+
+    if (!device->stopCapture()) {
+        LOG_ERROR("无法停止捕获: " + camera_id, "CameraManager");
+        return false;
+    }
+
+    LOG_INFO("停止捕获视频帧: " + camera_id, "CameraManager");
+    return true;
 }
 
-std::shared_ptr<CameraDevice> CameraManager::getCurrentDevice() {
+bool CameraManager::isCapturing(const std::string& camera_id) const {
     std::lock_guard<std::mutex> lock(device_mutex_);
-    return current_device_;
+    auto device = findDeviceLocked(camera_id);
+    return device && device->isCapturing();
 }
 
-void CameraManager::setFrameCallback(std::function<void(const Frame&)> callback) {
-    std::lock_guard<std::mutex> lock(device_mutex_);
-    frame_callback_ = callback;
+Frame CameraManager::getFrame(const std::string& camera_id, int timeout_ms) {
+    auto device = getDevice(camera_id);
+    if (!device || !device->isCapturing()) {
+        return Frame();
+    }
+
+    // 等待时不持有设备锁
+    return device->getFrame(timeout_ms);
+}
 
-    if (current_device_) {
-        current_device_->setFrameCallback([this](const Frame& frame) {
-            if (frame_callback_) {
-                frame_callback_(frame);
-            }
-        });
+Frame CameraManager::getLatestFrame(const std::string& camera_id, int timeout_ms) {
+    auto device = getDevice(camera_id);
+    if (!device || !device->isCapturing()) {
+        return Frame();
     }
+
+    // 等待时不持有设备锁
+    return device->getLatestFrame(timeout_ms);
 }
 
-bool CameraManager::startCapture() {
+FrameMailboxStats CameraManager::getFrameQueueStats(const std::string& camera_id) const {
+    auto device = getDevice(camera_id);
+    if (!device) {
+        return FrameMailboxStats();
+    }
+
+    return device->getFrameQueueStats();
+}
+
+std::string CameraManager::getDefaultCameraId() const {
     std::lock_guard<std::mutex> lock(device_mutex_);
+    return default_camera_id_;
+}
 
-    if (!current_device_) {
-        LOG_ERROR("没有打开的摄像头设备", "CameraManager");
+bool CameraManager::openDevice(const std::string& device_path, int width, int height, int fps) {
+    // 替换之前的默认摄像头，其他摄像头不受影响
+    std::string previous = getDefaultCameraId();
+    if (!previous.empty() && previous != device_path) {
+        LOG_DEBUG("已有打开的默认摄像头，尝试关闭: " + previous, "CameraManager");
+        closeCamera(previous);
+    }
+
+    if (!openCamera(device_path, device_path, width, height, fps)) {
         return false;
     }
 
-    if (is_capturing_) {
-        return true;  // 已经在捕获中
+    std::lock_guard<std::mutex> lock(device_mutex_);
+    default_camera_id_ = device_path;
+    return true;
+}
+
+bool CameraManager::closeDevice() {
+    std::string camera_id = getDefaultCameraId();
+    if (camera_id.empty()) {
+        LOG_DEBUG("没有打开的设备", "CameraManager");
+        return true;
     }
+    return closeCamera(camera_id);
+}
 
-    if (!current_device_->startCapture()) {
-        LOG_ERROR("无法开始捕获", "CameraManager");
-        return false;
+bool CameraManager::isDeviceOpen() const {
+    std::lock_guard<std::mutex> lock(device_mutex_);
+    auto device = findDeviceLocked(default_camera_id_);
+    return device && device->isOpen();
+}
+
+std::shared_ptr<CameraDevice> CameraManager::getCurrentDevice() {
+    std::lock_guard<std::mutex> lock(device_mutex_);
+    return findDeviceLocked(default_camera_id_);
+}
+
+FrameBus::SubscriptionId CameraManager::subscribeFrames(const std::string& name,
+                                                       FrameBus::FrameCallback callback,
+                                                       const FrameSubscriberOptions& options) {
+    auto id = frame_bus_.subscribe(name, std::move(callback), options);
+    if (id != 0) {
+        renegotiateFormats();
     }
+    return id;
+}
 
-    is_capturing_ = true;
-    LOG_INFO("开始捕获视频帧", "CameraManager");
+bool CameraManager::unsubscribeFrames(FrameBus::SubscriptionId id) {
+    if (!frame_bus_.unsubscribe(id)) {
+        return false;
+    }
+    renegotiateFormats();
     return true;
 }
 
-bool CameraManager::stopCapture() {
+std::vector<FrameSubscriberStats> CameraManager::getFrameSubscriberStats() const {
+    return frame_bus_.getStats();
+}
+
+FormatPlan CameraManager::getFormatPlan(const std::string& camera_id) const {
     std::lock_guard<std::mutex> lock(device_mutex_);
+    auto it = format_plans_.find(camera_id);
+    return it != format_plans_.end() ? it->second : FormatPlan();
+}
 
-    if (!is_capturing_) {
-        return true;  // 没有在捕获
+void CameraManager::renegotiateFormats() {
+    for (const auto& camera_id : getCameraIds()) {
+        negotiateFormat(camera_id, false);
     }
+}
 
-    if (!current_device_) {
-        LOG_ERROR("没有打开的摄像头设备", "CameraManager");
-        return false;
+void CameraManager::negotiateFormat(const std::string& camera_id, bool force) {
+    std::lock_guard<std::mutex> control_lock(control_mutex_);
+    negotiateFormatLocked(camera_id, force);
+}
+
+void CameraManager::negotiateFormatLocked(const std::string& camera_id, bool force) {
+    // 调用者持有control_mutex_，设备调用期间不持有device_mutex_
+    std::shared_ptr<CameraDevice> device;
+    CameraParams requested;
+    {
+        std::lock_guard<std::mutex> lock(device_mutex_);
+        device = findDeviceLocked(camera_id);
+        auto it = requested_params_.find(camera_id);
+        if (!device || it == requested_params_.end()) {
+            return;
+        }
+        requested = it->second;
     }
 
-    if (!current_device_->stopCapture()) {
-        LOG_ERROR("无法停止捕获", "CameraManager");
-        return false;
+    // 模拟摄像头的格式由数据源决定
+    std::string device_path = device->getDeviceInfo().device_path;
+    if (device_path.compare(0, 5, "/dev/") != 0) {
+        return;
+    }
+    auto capabilities = CapabilityCache::getInstance().get(device_path);
+    if (!capabilities) {
+        return;
     }
 
-    is_capturing_ = false;
-    LOG_INFO("停止捕获视频帧", "CameraManager");
-    return true;
+    std::vector<FrameConsumerDemand> demands;
+    bool fixed_format = false;
+    for (const auto& demand : frame_bus_.getConsumerDemands()) {
+        if (demand.camera_id.empty() || demand.camera_id == camera_id) {
+            demands.push_back(demand);
+            fixed_format = fixed_format || demand.fixed_format;
+        }
+    }
+    std::sort(demands.begin(), demands.end(), [](const FrameConsumerDemand& a, const FrameConsumerDemand& b) {
+        return a.kind != b.kind ? a.kind < b.kind : a.name < b.name;
+    });
+    std::string signature;
+    for (const auto& demand : demands) {
+        signature += std::string(FormatNegotiator::consumerKindName(demand.kind)) + ",";
+    }
+
+    auto& config = utils::ConfigManager::getInstance();
+    PixelFormat forced = FormatNegotiator::parseFormatSetting(config.getString("camera.format", "auto"));
+    FormatPlan plan = FormatNegotiator::negotiate(*capabilities, requested.width, requested.height,
+                                                  requested.fps, demands, forced);
+    if (!plan.valid) {
+        LOG_WARNING("摄像头 " + camera_id + " 没有可用的像素格式，保持当前格式", "CameraManager");
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(device_mutex_);
+        if (findDeviceLocked(camera_id) != device) {
+            return;  // 协商期间摄像头被关闭或替换
+        }
+        auto it = format_plans_.find(camera_id);
+        bool pending = it != format_plans_.end() && it->second.pending;
+        if (!force && !pending && demand_signatures_[camera_id] == signature) {
+            return;
+        }
+        demand_signatures_[camera_id] = signature;
+    }
+
+    CameraParams current = device->getParams();
+    bool unchanged = current.format == plan.format && current.width == plan.width && current.height == plan.height;
+    if (!unchanged && !force) {
+        // 捕获中切换格式会中断若干帧，代价降低不明显时保持当前格式
+        FormatPlan current_plan = FormatNegotiator::evaluate(*capabilities, current.format, requested.width,
+                                                             requested.height, requested.fps, demands);
+        if (current_plan.valid && plan.cost > current_plan.cost * kRenegotiateThreshold) {
+            plan = current_plan;
+            unchanged = true;
+        }
+    }
+
+    if (!unchanged && fixed_format && device->isCapturing()) {
+        // 录制或H.264编码依赖当前格式和分辨率，只记录方案，停止捕获后再应用
+        plan.pending = true;
+    } else if (!unchanged) {
+        CameraParams params = current;
+        params.format = plan.format;
+        params.width = plan.width;
+        params.height = plan.height;
+        params.fps = requested.fps;
+        if (!device->setParams(params)) {
+            LOG_WARNING("摄像头 " + camera_id + " 无法切换到协商的格式 " +
+                        FormatUtils::getPixelFormatName(plan.format) + "，保持当前格式", "CameraManager");
+            current = device->getParams();
+            plan = FormatNegotiator::evaluate(*capabilities, current.format, current.width, current.height,
+                                              requested.fps, demands);
+        }
+    }
+
+    std::ostringstream ss;
+    ss << "摄像头 " << camera_id << " 格式协商: " << FormatUtils::getPixelFormatName(plan.format)
+       << " " << plan.width << "x" << plan.height << "@" << plan.fps
+       << ", 代价: " << plan.cost;
+    for (const auto& route : plan.routes) {
+        ss << ", " << route.consumer << "=" << route.conversion;
+    }
+    if (plan.pending) {
+        ss << "（捕获中有固定格式的订阅者，暂不切换）";
+    }
+    LOG_INFO(ss.str(), "CameraManager");
+
+    std::lock_guard<std::mutex> lock(device_mutex_);
+    if (findDeviceLocked(camera_id) == device) {
+        format_plans_[camera_id] = plan;
+    }
+}
+
+bool CameraManager::startCapture() {
+    return startCapture(getDefaultCameraId());
+}
+
+bool CameraManager::stopCapture() {
+    return stopCapture(getDefaultCameraId());
 }
 
 bool CameraManager::isCapturing() const {
-    std::lock_guard<std::mutex> lock(device_mutex_);
-    return is_capturing_;
+    return isCapturing(getDefaultCameraId());
 }
 
-CameraParams CameraManager::getCurrentParams() const {
-    std::lock_guard<std::mutex> lock(device_mutex_);
+Frame CameraManager::getFrame(int timeout_ms) {
+    return getFrame(getDefaultCameraId(), timeout_ms);
+}
 
-    if (!current_device_) {
+Frame CameraManager::getLatestFrame(int timeout_ms) {
+    return getLatestFrame(getDefaultCameraId(), timeout_ms);
+}
+
+FrameMailboxStats CameraManager::getFrameQueueStats() const {
+    return getFrameQueueStats(getDefaultCameraId());
+}
+
+CameraParams CameraManager::getCurrentParams() const {
+    auto device = getDevice(getDefaultCameraId());
+    if (!device) {
         LOG_ERROR("没有打开的摄像头设备", "CameraManager");
         return CameraParams();
     }
 
-    return current_device_->getParams();
+    return device->getParams();
 }
 
 bool CameraManager::setParams(const CameraParams& params) {
-    std::lock_guard<std::mutex> lock(device_mutex_);
+    std::lock_guard<std::mutex> control_lock(control_mutex_);
+
+    std::string camera_id;
+    std::shared_ptr<CameraDevice> device;
+    {
+        std::lock_guard<std::mutex> lock(device_mutex_);
+        camera_id = default_camera_id_;
+        device = findDeviceLocked(camera_id);
+        if (!device) {
+            LOG_ERROR("没有打开的摄像头设备", "CameraManager");
+            return false;
+        }
 
-    if (!current_device_) {
-        LOG_ERROR("没有打开的摄像头设备", "CameraManager");
-        return false;
+        // 之后的重新协商以新的分辨率和帧率为目标
+        auto it = requested_params_.find(camera_id);
+        if (it != requested_params_.end()) {
+            it->second.width = params.width;
+            it->second.height = params.height;
+            it->second.fps = params.fps;
+        }
+        pending_params_.erase(camera_id);
     }
 
-    return current_device_->setParams(params);
+    // 与格式协商相同：捕获中有固定格式的订阅者时不切换格式和分辨率，下次开始捕获前再应用
+    CameraParams current = device->getParams();
+    bool changes_format = current.format != params.format || current.width != params.width ||
+                          current.height != params.height;
+    if (changes_format && device->isCapturing() && hasFixedFormatConsumer(camera_id)) {
+        std::lock_guard<std::mutex> lock(device_mutex_);
+        if (findDeviceLocked(camera_id) == device) {
+            pending_params_[camera_id] = params;
+        }
+        LOG_INFO("摄像头 " + camera_id + " 捕获中有固定格式的订阅者，参数推迟到下次开始捕获时应用",
+                 "CameraManager");
+        return true;
+    }
+
+    return device->setParams(params);
+}
+
+bool CameraManager::hasFixedFormatConsumer(const std::string& camera_id) const {
+    for (const auto& demand : frame_bus_.getConsumerDemands()) {
+        if ((demand.camera_id.empty() || demand.camera_id == camera_id) && demand.fixed_format) {
+            return true;
+        }
+    }
+    return false;
 }
 
 // 创建V4L2摄像头设备的工厂函数实现
@@ -372,6 +618,24 @@ std::shared_ptr<CameraDevice> createV4L2CameraDevice() {
     return std::make_shared<V4L2Camera>();
 }
 
+std::shared_ptr<CameraDevice> createSyntheticCameraDevice() {
+    return std::make_shared<SyntheticCamera>();
+}
+
+std::shared_ptr<CameraDevice> createReplayCameraDevice() {
+    return std::make_shared<ReplayCamera>();
+}
+
+std::shared_ptr<CameraDevice> createCameraDevice(const std::string& device_path) {
+    if (device_path == "synthetic" || device_path.compare(0, 10, "synthetic:") == 0) {
+        return createSyntheticCameraDevice();
+    }
+    if (device_path.compare(0, 7, "replay:") == 0) {
+        return createReplayCameraDevice();
+    }
+    return createV4L2CameraDevice();
+}
+
 // 扫描系统中可用的摄像头设备
 std::vector<CameraDeviceInfo> scanCameraDevices() {
     return CameraManager::getInstance().scanDevices();
@@ -0,0 +1,380 @@
+#include "camera/capability_cache.h"
+#include "camera/format_utils.h"
+#include "monitor/logger.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <linux/videodev2.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace cam_server {
+namespace camera {
+
+namespace {
+
+// 枚举上限，防止异常驱动返回大量条目
+constexpr uint32_t kMaxFormats = 32;
+constexpr uint32_t kMaxFrameSizes = 64;
+constexpr uint32_t kMaxFrameIntervals = 16;
+
+// 步进/连续分辨率范围内探测的标准分辨率
+const std::pair<uint32_t, uint32_t> kStandardResolutions[] = {
+    {160, 120}, {320, 240}, {640, 480}, {800, 600}, {1024, 768},
+    {1280, 720}, {1280, 960}, {1600, 1200}, {1920, 1080}, {2560, 1440},
+    {3840, 2160}
+};
+
+// 步进/连续帧间隔范围内报告的标准帧率
+const int kStandardFps[] = {60, 50, 30, 25, 20, 15, 10, 5};
+
+bool isVideoNode(const std::string& name) {
+    if (name.compare(0, 5, "video") != 0 || name.size() == 5) {
+        return false;
+    }
+    return std::all_of(name.begin() + 5, name.end(), ::isdigit);
+}
+
+int intervalToFps(const struct v4l2_fract& interval) {
+    if (interval.numerator == 0) {
+        return 0;
+    }
+    return static_cast<int>(std::lround(static_cast<double>(interval.denominator) / interval.numerator));
+}
+
+// 查询指定格式和分辨率支持的帧率，步进/连续范围只报告端点和其中的标准帧率
+std::vector<int> probeFrameRates(int fd, uint32_t fourcc, uint32_t width, uint32_t height) {
+    std::vector<int> fps;
+
+    struct v4l2_frmivalenum frmival;
+    memset(&frmival, 0, sizeof(frmival));
+    frmival.pixel_format = fourcc;
+    frmival.width = width;
+    frmival.height = height;
+
+    for (frmival.index = 0; frmival.index < kMaxFrameIntervals; ++frmival.index) {
+        if (ioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &frmival) < 0) {
+            break;
+        }
+
+        if (frmival.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
+            int rate = intervalToFps(frmival.discrete);
+            if (rate > 0) {
+                fps.push_back(rate);
+            }
+            continue;
+        }
+
+        // 最短间隔对应最高帧率
+        int max_fps = intervalToFps(frmival.stepwise.min);
+        int min_fps = intervalToFps(frmival.stepwise.max);
+        if (max_fps > 0) {
+            fps.push_back(max_fps);
+        }
+        if (min_fps > 0) {
+            fps.push_back(min_fps);
+        }
+        for (int rate : kStandardFps) {
+            if (rate > min_fps && rate < max_fps) {
+                fps.push_back(rate);
+            }
+        }
+        break;
+    }
+
+    std::sort(fps.begin(), fps.end(), std::greater<int>());
+    fps.erase(std::unique(fps.begin(), fps.end()), fps.end());
+    return fps;
+}
+
+// 枚举一种格式的分辨率
+void probeFrameSizes(int fd, FormatCapability& format) {
+    struct v4l2_frmsizeenum frmsize;
+    memset(&frmsize, 0, sizeof(frmsize));
+    frmsize.pixel_format = format.fourcc;
+
+    for (frmsize.index = 0; frmsize.index < kMaxFrameSizes; ++frmsize.index) {
+        if (ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &frmsize) < 0) {
+            break;
+        }
+
+        if (frmsize.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+            FrameSizeCapability size;
+            size.width = frmsize.discrete.width;
+            size.height = frmsize.discrete.height;
+            size.fps = probeFrameRates(fd, format.fourcc, size.width, size.height);
+            format.sizes.push_back(std::move(size));
+            continue;
+        }
+
+        // 步进/连续分辨率只有一个条目，保留范围并只探测其中的标准分辨率
+        format.has_range = true;
+        format.range.min_width = frmsize.stepwise.min_width;
+        format.range.max_width = frmsize.stepwise.max_width;
+        format.range.min_height = frmsize.stepwise.min_height;
+        format.range.max_height = frmsize.stepwise.max_height;
+        bool continuous = frmsize.type == V4L2_FRMSIZE_TYPE_CONTINUOUS;
+        format.range.step_width = continuous ? 1 : std::max<uint32_t>(frmsize.stepwise.step_width, 1);
+        format.range.step_height = continuous ? 1 : std::max<uint32_t>(frmsize.stepwise.step_height, 1);
+
+        for (const auto& resolution : kStandardResolutions) {
+            if (!format.range.contains(resolution.first, resolution.second)) {
+                continue;
+            }
+            FrameSizeCapability size;
+            size.width = resolution.first;
+            size.height = resolution.second;
+            size.fps = probeFrameRates(fd, format.fourcc, size.width, size.height);
+            format.sizes.push_back(std::move(size));
+        }
+        break;
+    }
+}
+
+} // namespace
+
+bool FrameSizeRange::contains(uint32_t width, uint32_t height) const {
+    if (width < min_width || width > max_width || height < min_height || height > max_height) {
+        return false;
+    }
+    return (width - min_width) % std::max<uint32_t>(step_width, 1) == 0 &&
+           (height - min_height) % std::max<uint32_t>(step_height, 1) == 0;
+}
+
+bool DeviceCapabilities::supports(uint32_t fourcc, uint32_t width, uint32_t height) const {
+    for (const auto& format : formats) {
+        if (format.fourcc != fourcc) {
+            continue;
+        }
+        if (format.has_range && format.range.contains(width, height)) {
+            return true;
+        }
+        for (const auto& size : format.sizes) {
+            if (size.width == width && size.height == height) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+CapabilityCache& CapabilityCache::getInstance() {
+    static CapabilityCache instance;
+    return instance;
+}
+
+CapabilityCache::CapabilityCache() : inotify_fd_(-1) {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        LOG_WARNING("无法初始化热插拔监视，能力缓存仅按bus_info复用: " + std::string(strerror(errno)), "CapabilityCache");
+        return;
+    }
+    if (inotify_add_watch(fd, "/dev", IN_CREATE | IN_DELETE | IN_ATTRIB) < 0) {
+        LOG_WARNING("无法监视/dev，能力缓存仅按bus_info复用: " + std::string(strerror(errno)), "CapabilityCache");
+        ::close(fd);
+        return;
+    }
+    inotify_fd_ = fd;
+}
+
+CapabilityCache::~CapabilityCache() {
+    if (inotify_fd_ >= 0) {
+        ::close(inotify_fd_);
+    }
+}
+
+std::shared_ptr<const DeviceCapabilities> CapabilityCache::get(const std::string& device_path, int fd) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    processHotplugEventsLocked();
+
+    if (inotify_fd_ >= 0) {
+        auto path_it = path_index_.find(device_path);
+        if (path_it != path_index_.end()) {
+            auto it = by_bus_.find(path_it->second);
+            if (it != by_bus_.end()) {
+                return it->second;
+            }
+            path_index_.erase(path_it);
+        }
+    }
+
+    bool owns_fd = fd < 0;
+    if (owns_fd) {
+        fd = ::open(device_path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            return nullptr;
+        }
+    }
+
+    std::shared_ptr<const DeviceCapabilities> result;
+    struct v4l2_capability cap;
+    memset(&cap, 0, sizeof(cap));
+    if (ioctl(fd, VIDIOC_QUERYCAP, &cap) == 0) {
+        uint32_t caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+        if (caps & V4L2_CAP_VIDEO_CAPTURE) {
+            std::string card = reinterpret_cast<const char*>(cap.card);
+            std::string bus_info = reinterpret_cast<const char*>(cap.bus_info);
+            // 同一总线位置上的同型号设备能力相同；没有bus_info时退化为按路径缓存
+            std::string key = (bus_info.empty() ? device_path : bus_info) + "|" + card;
+
+            auto it = by_bus_.find(key);
+            if (it != by_bus_.end() && it->second->device_path != device_path &&
+                access(it->second->device_path.c_str(), F_OK) == 0) {
+                // 同一总线位置有多个捕获节点（如ISP），按路径区分
+                key += "|" + device_path;
+                it = by_bus_.find(key);
+            }
+            if (it != by_bus_.end() && it->second->device_path == device_path) {
+                result = it->second;
+            } else if (it != by_bus_.end()) {
+                // 设备重新出现在不同的节点上，复用能力只更新路径
+                auto moved = std::make_shared<DeviceCapabilities>(*it->second);
+                moved->device_path = device_path;
+                result = moved;
+            } else {
+                auto start = std::chrono::steady_clock::now();
+                auto capabilities = enumerate(fd);
+                capabilities->device_path = device_path;
+                capabilities->card = card;
+                capabilities->driver = reinterpret_cast<const char*>(cap.driver);
+                capabilities->bus_info = bus_info;
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                LOG_DEBUG("枚举设备能力: " + device_path + " (" + card + "), 格式数: " +
+                          std::to_string(capabilities->formats.size()) + ", 耗时: " +
+                          std::to_string(elapsed) + "ms", "CapabilityCache");
+                result = capabilities;
+            }
+
+            by_bus_[key] = result;
+            if (inotify_fd_ >= 0) {
+                path_index_[device_path] = key;
+            }
+        }
+    }
+
+    if (owns_fd) {
+        ::close(fd);
+    }
+    return result;
+}
+
+std::vector<std::shared_ptr<const DeviceCapabilities>> CapabilityCache::scan() {
+    std::vector<std::string> paths;
+    DIR* dir = opendir("/dev");
+    if (!dir) {
+        LOG_ERROR("无法打开/dev目录", "CapabilityCache");
+        return {};
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        std::string name = entry->d_name;
+        if (isVideoNode(name)) {
+            paths.push_back("/dev/" + name);
+        }
+    }
+    closedir(dir);
+
+    std::sort(paths.begin(), paths.end(), [](const std::string& a, const std::string& b) {
+        return a.size() != b.size() ? a.size() < b.size() : a < b;
+    });
+
+    std::vector<std::shared_ptr<const DeviceCapabilities>> devices;
+    for (const auto& path : paths) {
+        auto capabilities = get(path);
+        if (capabilities) {
+            devices.push_back(capabilities);
+        }
+    }
+    return devices;
+}
+
+void CapabilityCache::invalidate(const std::string& device_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    invalidateLocked(device_path);
+}
+
+void CapabilityCache::invalidateAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    by_bus_.clear();
+    path_index_.clear();
+}
+
+void CapabilityCache::processHotplugEventsLocked() {
+    if (inotify_fd_ < 0) {
+        return;
+    }
+
+    alignas(struct inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return;
+        }
+
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                LOG_DEBUG("热插拔事件队列溢出，清空能力缓存", "CapabilityCache");
+                by_bus_.clear();
+                path_index_.clear();
+                continue;
+            }
+            if (event->len == 0 || !isVideoNode(event->name)) {
+                continue;
+            }
+
+            std::string path = std::string("/dev/") + event->name;
+            LOG_DEBUG("检测到设备节点变化: " + path, "CapabilityCache");
+            invalidateLocked(path);
+        }
+    }
+}
+
+void CapabilityCache::invalidateLocked(const std::string& device_path) {
+    auto path_it = path_index_.find(device_path);
+    if (path_it != path_index_.end()) {
+        by_bus_.erase(path_it->second);
+        path_index_.erase(path_it);
+    }
+    for (auto it = by_bus_.begin(); it != by_bus_.end();) {
+        if (it->second->device_path == device_path) {
+            it = by_bus_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::shared_ptr<DeviceCapabilities> CapabilityCache::enumerate(int fd) {
+    auto capabilities = std::make_shared<DeviceCapabilities>();
+
+    struct v4l2_fmtdesc fmtdesc;
+    memset(&fmtdesc, 0, sizeof(fmtdesc));
+    fmtdesc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    for (fmtdesc.index = 0; fmtdesc.index < kMaxFormats; ++fmtdesc.index) {
+        if (ioctl(fd, VIDIOC_ENUM_FMT, &fmtdesc) < 0) {
+            break;
+        }
+
+        FormatCapability format;
+        format.fourcc = fmtdesc.pixelformat;
+        format.format = FormatUtils::v4l2FormatToPixelFormat(fmtdesc.pixelformat);
+        format.name = FormatUtils::getV4L2FormatName(fmtdesc.pixelformat);
+        probeFrameSizes(fd, format);
+        capabilities->formats.push_back(std::move(format));
+    }
+
+    return capabilities;
+}
+
+} // namespace camera
+} // namespace cam_server
@@ -0,0 +1,364 @@
+#include "camera/capture_reactor.h"
+#include "monitor/logger.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace cam_server {
+namespace camera {
+
+namespace {
+// 单次epoll_wait返回的最大事件数
+constexpr int kMaxEvents = 16;
+// 唤醒事件使用的保留ID
+constexpr uint64_t kWakeupId = 0;
+
+// 在当前线程中应用调度参数，失败时只记录警告
+void applyScheduling(const CaptureThreadScheduling& scheduling, size_t index) {
+    std::string name = "捕获反应器线程 #" + std::to_string(index);
+
+    if (!scheduling.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : scheduling.cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            LOG_WARNING(name + " 无法设置CPU亲和性: " + std::string(strerror(err)), "CaptureReactor");
+        }
+    }
+
+    if (scheduling.realtime) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = std::min(std::max(scheduling.priority, sched_get_priority_min(SCHED_FIFO)),
+                                        sched_get_priority_max(SCHED_FIFO));
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err == 0) {
+            LOG_INFO(name + " 使用SCHED_FIFO，优先级: " + std::to_string(param.sched_priority), "CaptureReactor");
+            return;
+        }
+        LOG_WARNING(name + " 无法使用SCHED_FIFO（需要CAP_SYS_NICE或RLIMIT_RTPRIO）: " +
+                    std::string(strerror(err)) + "，改用nice值", "CaptureReactor");
+    }
+
+    if (scheduling.nice != 0) {
+        pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(tid), scheduling.nice) < 0) {
+            LOG_WARNING(name + " 无法设置nice值 " + std::to_string(scheduling.nice) + ": " +
+                        std::string(strerror(errno)), "CaptureReactor");
+        }
+    }
+}
+
+} // namespace
+
+struct CaptureReactor::Registration {
+    RegistrationId id = 0;
+    int fd = -1;
+    std::string name;
+    ReadyHandler handler;
+    // 执行处理函数期间持有，注销时用于等待正在执行的处理函数
+    std::mutex run_mutex;
+    bool active = true;
+};
+
+struct CaptureReactor::Loop {
+    int epoll_fd = -1;
+    int wake_fd = -1;
+    std::atomic<bool> running{false};
+    std::thread thread;
+    std::mutex mutex;
+    std::unordered_map<RegistrationId, std::shared_ptr<Registration>> registrations;
+
+    ~Loop() {
+        stop();
+        if (wake_fd >= 0) {
+            ::close(wake_fd);
+        }
+        if (epoll_fd >= 0) {
+            ::close(epoll_fd);
+        }
+    }
+
+    bool start(size_t index, const CaptureThreadScheduling& scheduling) {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd < 0 || wake_fd < 0) {
+            LOG_ERROR("无法创建epoll或eventfd: " + std::string(strerror(errno)), "CaptureReactor");
+            return false;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = kWakeupId;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0) {
+            LOG_ERROR("无法注册唤醒事件: " + std::string(strerror(errno)), "CaptureReactor");
+            return false;
+        }
+
+        running = true;
+        thread = std::thread([this, index, scheduling]() {
+            applyScheduling(scheduling, index);
+            run();
+        });
+        LOG_INFO("捕获反应器线程已启动: #" + std::to_string(index), "CaptureReactor");
+        return true;
+    }
+
+    void stop() {
+        if (!running.exchange(false)) {
+            return;
+        }
+        uint64_t one = 1;
+        if (::write(wake_fd, &one, sizeof(one)) < 0) {
+            LOG_WARNING("无法唤醒反应器线程: " + std::string(strerror(errno)), "CaptureReactor");
+        }
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return registrations.size();
+    }
+
+    void run() {
+        struct epoll_event events[kMaxEvents];
+
+        while (running) {
+            int n = epoll_wait(epoll_fd, events, kMaxEvents, -1);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOG_ERROR("epoll_wait错误: " + std::string(strerror(errno)), "CaptureReactor");
+                break;
+            }
+
+            for (int i = 0; i < n; ++i) {
+                if (events[i].data.u64 == kWakeupId) {
+                    uint64_t value;
+                    while (::read(wake_fd, &value, sizeof(value)) > 0) {
+                    }
+                    continue;
+                }
+
+                std::shared_ptr<Registration> reg;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto it = registrations.find(events[i].data.u64);
+                    if (it == registrations.end()) {
+                        continue;
+                    }
+                    reg = it->second;
+                }
+
+                bool keep = true;
+                {
+                    std::lock_guard<std::mutex> run_lock(reg->run_mutex);
+                    if (!reg->active) {
+                        continue;
+                    }
+                    keep = reg->handler();
+                    if (!keep) {
+                        reg->active = false;
+                    }
+                }
+
+                if (!keep) {
+                    LOG_WARNING("处理函数报告错误，注销: " + reg->name, "CaptureReactor");
+                    detach(reg->id);
+                }
+            }
+        }
+    }
+
+    // 从epoll和注册表中移除，返回被移除的注册
+    std::shared_ptr<Registration> detach(RegistrationId id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = registrations.find(id);
+        if (it == registrations.end()) {
+            return nullptr;
+        }
+        auto reg = it->second;
+        registrations.erase(it);
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, reg->fd, nullptr);
+        return reg;
+    }
+};
+
+CaptureReactor& CaptureReactor::getInstance() {
+    static CaptureReactor instance;
+    return instance;
+}
+
+CaptureReactor::CaptureReactor()
+    : thread_count_(1),
+      next_id_(1) {
+}
+
+CaptureReactor::~CaptureReactor() {
+    shutdown();
+}
+
+void CaptureReactor::setThreadCount(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!loops_.empty()) {
+        LOG_WARNING("反应器线程已启动，忽略线程数设置", "CaptureReactor");
+        return;
+    }
+    thread_count_ = std::max<size_t>(count, 1);
+}
+
+size_t CaptureReactor::getThreadCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return thread_count_;
+}
+
+void CaptureReactor::setScheduling(const CaptureThreadScheduling& scheduling) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!loops_.empty()) {
+        LOG_WARNING("反应器线程已启动，忽略调度设置", "CaptureReactor");
+        return;
+    }
+    scheduling_ = scheduling;
+}
+
+std::vector<int> CaptureReactor::parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        try {
+            size_t dash = item.find('-');
+            if (dash == std::string::npos) {
+                if (item.find_first_not_of(" \t") != std::string::npos) {
+                    cpus.push_back(std::stoi(item));
+                }
+                continue;
+            }
+            int first = std::stoi(item.substr(0, dash));
+            int last = std::stoi(item.substr(dash + 1));
+            for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            LOG_WARNING("忽略无效的CPU列表项: " + item, "CaptureReactor");
+        }
+    }
+    return cpus;
+}
+
+bool CaptureReactor::startLocked() {
+    for (size_t i = 0; i < thread_count_; ++i) {
+        auto loop = std::make_unique<Loop>();
+        if (!loop->start(i, scheduling_)) {
+            loops_.clear();
+            return false;
+        }
+        loops_.push_back(std::move(loop));
+    }
+    return true;
+}
+
+CaptureReactor::RegistrationId CaptureReactor::add(int fd, const std::string& name, ReadyHandler handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (loops_.empty() && !startLocked()) {
+        return 0;
+    }
+
+    // 选择注册数最少的线程
+    Loop* loop = loops_.front().get();
+    for (auto& candidate : loops_) {
+        if (candidate->size() < loop->size()) {
+            loop = candidate.get();
+        }
+    }
+
+    auto reg = std::make_shared<Registration>();
+    reg->id = next_id_++;
+    reg->fd = fd;
+    reg->name = name;
+    reg->handler = std::move(handler);
+
+    {
+        std::lock_guard<std::mutex> loop_lock(loop->mutex);
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u64 = reg->id;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            LOG_ERROR("无法注册文件描述符 " + name + ": " + std::string(strerror(errno)), "CaptureReactor");
+            return 0;
+        }
+        loop->registrations[reg->id] = reg;
+    }
+
+    LOG_DEBUG("注册捕获文件描述符: " + name + " (ID: " + std::to_string(reg->id) + ")", "CaptureReactor");
+    return reg->id;
+}
+
+bool CaptureReactor::remove(RegistrationId id) {
+    if (id == 0) {
+        return false;
+    }
+
+    std::shared_ptr<Registration> reg;
+    bool on_loop_thread = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& loop : loops_) {
+            reg = loop->detach(id);
+            if (reg) {
+                on_loop_thread = loop->thread.get_id() == std::this_thread::get_id();
+                break;
+            }
+        }
+    }
+
+    if (!reg) {
+        return false;
+    }
+
+    if (on_loop_thread) {
+        // 在处理函数中注销，处理函数返回后不会再被调用
+        reg->active = false;
+    } else {
+        // 等待正在执行的处理函数结束
+        std::lock_guard<std::mutex> run_lock(reg->run_mutex);
+        reg->active = false;
+    }
+
+    LOG_DEBUG("注销捕获文件描述符: " + reg->name + " (ID: " + std::to_string(id) + ")", "CaptureReactor");
+    return true;
+}
+
+void CaptureReactor::shutdown() {
+    std::vector<std::unique_ptr<Loop>> loops;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        loops.swap(loops_);
+    }
+    // Loop析构时停止并等待线程
+    loops.clear();
+}
+
+} // namespace camera
+} // namespace cam_server
@@ -0,0 +1,262 @@
+#include "camera/format_negotiator.h"
+#include "camera/format_utils.h"
+#include "monitor/logger.h"
+#include "utils/string_utils.h"
+
+#include <algorithm>
+
+namespace cam_server {
+namespace camera {
+
+namespace {
+
+// 分辨率与请求不一致时，每个订阅者每像素的缩放代价
+constexpr double kScaleCost = 0.5;
+// 达不到请求帧率时的惩罚权重，高于任何转换代价
+constexpr double kFrameRateShortfallWeight = 10.0;
+// 总线带宽权重，仅在转换代价相同时区分格式
+constexpr double kBandwidthWeight = 0.05;
+// 未指定分辨率时的默认请求
+constexpr int kDefaultWidth = 640;
+constexpr int kDefaultHeight = 480;
+
+// 每像素平均字节数，MJPEG按典型压缩比估算
+double bytesPerPixel(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::MJPEG:
+            return 0.3;
+        case PixelFormat::YUYV:
+            return 2.0;
+        case PixelFormat::NV12:
+        case PixelFormat::YUV420P:
+            return 1.5;
+        case PixelFormat::RGB24:
+        case PixelFormat::BGR24:
+            return 3.0;
+        default:
+            return 4.0;
+    }
+}
+
+bool isRawFormat(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::YUYV:
+        case PixelFormat::NV12:
+        case PixelFormat::YUV420P:
+        case PixelFormat::RGB24:
+        case PixelFormat::BGR24:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+double FormatNegotiator::conversionCost(PixelFormat source, FrameConsumerKind kind) {
+    if (source != PixelFormat::MJPEG && !isRawFormat(source)) {
+        return -1.0;  // 流水线无法处理的格式（H.264等）
+    }
+
+    switch (kind) {
+        case FrameConsumerKind::ANY:
+            return 0.0;
+        case FrameConsumerKind::JPEG:
+            // MJPEG直接转发，原始格式需要JPEG编码
+            if (source == PixelFormat::MJPEG) {
+                return 0.0;
+            }
+            return (source == PixelFormat::RGB24 || source == PixelFormat::BGR24) ? 5.0 : 4.0;
+        case FrameConsumerKind::VIDEO_ENCODER:
+            // 编码器输入为YUV420P
+            switch (source) {
+                case PixelFormat::YUV420P:
+                    return 0.0;
+                case PixelFormat::NV12:
+                    return 0.5;
+                case PixelFormat::YUYV:
+                    return 1.0;
+                case PixelFormat::RGB24:
+                case PixelFormat::BGR24:
+                    return 1.5;
+                default:
+                    return 3.5;  // MJPEG解码后再转换色度采样
+            }
+        case FrameConsumerKind::RAW_PIXELS:
+            return source == PixelFormat::MJPEG ? 3.0 : 0.0;
+    }
+    return 0.0;
+}
+
+const char* FormatNegotiator::conversionName(PixelFormat source, FrameConsumerKind kind) {
+    switch (kind) {
+        case FrameConsumerKind::JPEG:
+            return source == PixelFormat::MJPEG ? "passthrough" : "encode";
+        case FrameConsumerKind::VIDEO_ENCODER:
+            if (source == PixelFormat::MJPEG) {
+                return "decode";
+            }
+            return source == PixelFormat::YUV420P ? "passthrough" : "convert";
+        case FrameConsumerKind::RAW_PIXELS:
+            return source == PixelFormat::MJPEG ? "decode" : "passthrough";
+        default:
+            return "passthrough";
+    }
+}
+
+const char* FormatNegotiator::consumerKindName(FrameConsumerKind kind) {
+    switch (kind) {
+        case FrameConsumerKind::JPEG:
+            return "jpeg";
+        case FrameConsumerKind::VIDEO_ENCODER:
+            return "video_encoder";
+        case FrameConsumerKind::RAW_PIXELS:
+            return "raw_pixels";
+        default:
+            return "any";
+    }
+}
+
+PixelFormat FormatNegotiator::parseFormatSetting(const std::string& setting) {
+    std::string value = utils::StringUtils::toUpper(utils::StringUtils::trim(setting));
+    if (value == "MJPG" || value == "MJPEG") {
+        return PixelFormat::MJPEG;
+    }
+    if (value == "YUYV") {
+        return PixelFormat::YUYV;
+    }
+    if (value == "NV12") {
+        return PixelFormat::NV12;
+    }
+    if (value == "YU12" || value == "YUV420" || value == "YUV420P") {
+        return PixelFormat::YUV420P;
+    }
+    if (value == "RGB3" || value == "RGB24") {
+        return PixelFormat::RGB24;
+    }
+    if (value == "BGR3" || value == "BGR24") {
+        return PixelFormat::BGR24;
+    }
+    return PixelFormat::UNKNOWN;
+}
+
+FormatPlan FormatNegotiator::evaluate(const DeviceCapabilities& capabilities, PixelFormat format,
+                                      int width, int height, int fps,
+                                      const std::vector<FrameConsumerDemand>& demands) {
+    FormatPlan plan;
+
+    auto entry = std::find_if(capabilities.formats.begin(), capabilities.formats.end(),
+                              [format](const FormatCapability& item) { return item.format == format; });
+    if (entry == capabilities.formats.end()) {
+        return plan;
+    }
+
+    double per_pixel = bytesPerPixel(format) * kBandwidthWeight;
+    int consumers = 0;
+    for (const auto& demand : demands) {
+        double cost = conversionCost(format, demand.kind);
+        if (cost < 0) {
+            return plan;
+        }
+        per_pixel += cost;
+        if (demand.kind != FrameConsumerKind::ANY) {
+            consumers++;
+        }
+    }
+
+    uint32_t target_width = static_cast<uint32_t>(width > 0 ? width : kDefaultWidth);
+    uint32_t target_height = static_cast<uint32_t>(height > 0 ? height : kDefaultHeight);
+    int target_fps = fps > 0 ? fps : 30;
+
+    // 分辨率：完全匹配 > 覆盖请求的最小分辨率 > 最大分辨率
+    uint32_t chosen_width = target_width;
+    uint32_t chosen_height = target_height;
+    const std::vector<int>* frame_rates = nullptr;
+    const FrameSizeCapability* exact = nullptr;
+    const FrameSizeCapability* covering = nullptr;
+    const FrameSizeCapability* largest = nullptr;
+    for (const auto& size : entry->sizes) {
+        uint64_t area = static_cast<uint64_t>(size.width) * size.height;
+        if (size.width == target_width && size.height == target_height) {
+            exact = &size;
+        }
+        if (size.width >= target_width && size.height >= target_height &&
+            (!covering || area < static_cast<uint64_t>(covering->width) * covering->height)) {
+            covering = &size;
+        }
+        if (!largest || area > static_cast<uint64_t>(largest->width) * largest->height) {
+            largest = &size;
+        }
+    }
+
+    if (exact) {
+        frame_rates = &exact->fps;
+    } else if (entry->has_range && entry->range.contains(target_width, target_height)) {
+        // 范围内未探测的分辨率，帧率未知，按可以达到请求帧率处理
+    } else if (covering || largest) {
+        const FrameSizeCapability* size = covering ? covering : largest;
+        chosen_width = size->width;
+        chosen_height = size->height;
+        frame_rates = &size->fps;
+    }
+
+    int achieved_fps = target_fps;
+    if (frame_rates && !frame_rates->empty()) {
+        int best = *std::max_element(frame_rates->begin(), frame_rates->end());
+        achieved_fps = std::min(target_fps, best);
+    }
+
+    double chosen_mp = static_cast<double>(chosen_width) * chosen_height / 1e6;
+    double target_mp = static_cast<double>(target_width) * target_height / 1e6;
+    double cost = chosen_mp * achieved_fps * per_pixel;
+    if (chosen_width != target_width || chosen_height != target_height) {
+        cost += target_mp * achieved_fps * kScaleCost * std::max(consumers, 1);
+    }
+    if (achieved_fps < target_fps) {
+        cost += target_mp * target_fps * kFrameRateShortfallWeight *
+                static_cast<double>(target_fps - achieved_fps) / target_fps;
+    }
+
+    plan.valid = true;
+    plan.fourcc = entry->fourcc;
+    plan.format = format;
+    plan.width = static_cast<int>(chosen_width);
+    plan.height = static_cast<int>(chosen_height);
+    plan.fps = achieved_fps;
+    plan.cost = cost;
+    for (const auto& demand : demands) {
+        FormatRoute route;
+        route.consumer = demand.name;
+        route.kind = demand.kind;
+        route.conversion = conversionName(format, demand.kind);
+        plan.routes.push_back(route);
+    }
+    return plan;
+}
+
+FormatPlan FormatNegotiator::negotiate(const DeviceCapabilities& capabilities, int width, int height, int fps,
+                                       const std::vector<FrameConsumerDemand>& demands, PixelFormat forced) {
+    if (forced != PixelFormat::UNKNOWN) {
+        FormatPlan plan = evaluate(capabilities, forced, width, height, fps, demands);
+        if (plan.valid) {
+            return plan;
+        }
+        LOG_WARNING("设备 " + capabilities.device_path + " 不支持配置的格式 " +
+                    FormatUtils::getPixelFormatName(forced) + "，改为自动选择", "FormatNegotiator");
+    }
+
+    FormatPlan best;
+    for (const auto& format : capabilities.formats) {
+        if (format.format == PixelFormat::UNKNOWN) {
+            continue;
+        }
+        FormatPlan plan = evaluate(capabilities, format.format, width, height, fps, demands);
+        if (plan.valid && (!best.valid || plan.cost < best.cost)) {
+            best = plan;
+        }
+    }
+    return best;
+}
+
+} // namespace camera
+} // namespace cam_server
@@ -10,5 +10,21 @@ Frame::Frame(int width, int height, PixelFormat format, std::vector<uint8_t> dat
     , data_(std::move(data)) {
 }
 
+Frame::Frame(int width, int height, PixelFormat format, std::shared_ptr<const FrameBuffer> buffer)
+    : width_(width)
+    , height_(height)
+    , format_(format)
+    , buffer_(std::move(buffer)) {
+}
+
+std::vector<uint8_t>& Frame::getData() {
+    if (buffer_) {
+        // 写时复制：脱离外部缓冲区，尽早归还给驱动
+        data_.assign(buffer_->data(), buffer_->data() + buffer_->size());
+        buffer_.reset();
+    }
+    return data_;
+}
+
 } // namespace camera
 } // namespace cam_server 
\ No newline at end of file
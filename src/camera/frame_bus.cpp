@@ -0,0 +1,174 @@
+#include "camera/frame_bus.h"
+#include "monitor/logger.h"
+
+#include <thread>
+
+namespace cam_server {
+namespace camera {
+
+namespace {
+// 工作线程等待帧的超时时间，决定取消订阅时的最长响应延迟
+constexpr int kWorkerPollMs = 100;
+} // namespace
+
+struct FrameBus::Subscriber {
+    SubscriptionId id = 0;
+    std::string name;
+    std::string camera_id;
+    FrameConsumerKind consumer = FrameConsumerKind::ANY;
+    bool fixed_format = false;
+    FrameCallback callback;
+    FrameMailbox mailbox;
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> delivered_frames{0};
+    std::thread worker;
+
+    // 订阅者只用pop()取帧，不保留最新帧，否则每个订阅者都会一直占用一个驱动缓冲区
+    Subscriber(size_t depth, FrameDropPolicy policy) : mailbox(depth, policy, false) {}
+
+    void run() {
+        Frame frame;
+        while (running) {
+            if (!mailbox.pop(frame, kWorkerPollMs)) {
+                continue;
+            }
+
+            FrameLineage lineage = frame.getLineage();
+            lineage.deliver_time_us = FrameLineage::nowUs();
+            frame.setLineage(lineage);
+
+            try {
+                callback(frame);
+            } catch (const std::exception& e) {
+                LOG_ERROR("帧订阅者 " + name + " 回调异常: " + std::string(e.what()), "FrameBus");
+            } catch (...) {
+                LOG_ERROR("帧订阅者 " + name + " 回调未知异常", "FrameBus");
+            }
+            delivered_frames++;
+
+            // 尽早释放帧，让共享缓冲区归还给设备
+            frame = Frame();
+        }
+    }
+};
+
+FrameBus::FrameBus() : next_id_(1) {
+}
+
+FrameBus::~FrameBus() {
+    std::unordered_map<SubscriptionId, std::shared_ptr<Subscriber>> subscribers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscribers.swap(subscribers_);
+    }
+
+    for (auto& pair : subscribers) {
+        pair.second->running = false;
+        if (pair.second->worker.joinable()) {
+            pair.second->worker.join();
+        }
+    }
+}
+
+FrameBus::SubscriptionId FrameBus::subscribe(const std::string& name, FrameCallback callback,
+                                             const FrameSubscriberOptions& options) {
+    if (!callback) {
+        LOG_ERROR("帧订阅者 " + name + " 的回调为空", "FrameBus");
+        return 0;
+    }
+
+    auto subscriber = std::make_shared<Subscriber>(options.queue_depth, options.drop_policy);
+    subscriber->id = next_id_++;
+    subscriber->name = name;
+    subscriber->camera_id = options.camera_id;
+    subscriber->consumer = options.consumer;
+    subscriber->fixed_format = options.fixed_format;
+    subscriber->callback = std::move(callback);
+    // 工作线程持有订阅者的引用，保证在回调中取消订阅时对象仍然有效
+    subscriber->worker = std::thread([subscriber]() { subscriber->run(); });
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscribers_[subscriber->id] = subscriber;
+    }
+
+    LOG_INFO("添加帧订阅者: " + name + " (ID: " + std::to_string(subscriber->id) +
+             ", 队列深度: " + std::to_string(options.queue_depth) + ")", "FrameBus");
+    return subscriber->id;
+}
+
+bool FrameBus::unsubscribe(SubscriptionId id) {
+    std::shared_ptr<Subscriber> subscriber;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = subscribers_.find(id);
+        if (it == subscribers_.end()) {
+            return false;
+        }
+        subscriber = it->second;
+        subscribers_.erase(it);
+    }
+
+    subscriber->running = false;
+    if (subscriber->worker.joinable()) {
+        if (subscriber->worker.get_id() == std::this_thread::get_id()) {
+            // 在自己的回调中取消订阅，线程在回调返回后自行退出
+            subscriber->worker.detach();
+        } else {
+            subscriber->worker.join();
+        }
+    }
+
+    LOG_INFO("移除帧订阅者: " + subscriber->name + " (ID: " + std::to_string(id) + ")", "FrameBus");
+    return true;
+}
+
+void FrameBus::publish(const Frame& frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& pair : subscribers_) {
+        const std::string& filter = pair.second->camera_id;
+        if (!filter.empty() && filter != frame.getCameraId()) {
+            continue;
+        }
+        // 复制帧只增加共享缓冲区的引用计数
+        pair.second->mailbox.push(frame);
+    }
+}
+
+size_t FrameBus::getSubscriberCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return subscribers_.size();
+}
+
+std::vector<FrameSubscriberStats> FrameBus::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<FrameSubscriberStats> stats;
+    stats.reserve(subscribers_.size());
+    for (const auto& pair : subscribers_) {
+        FrameSubscriberStats item;
+        item.id = pair.first;
+        item.name = pair.second->name;
+        item.delivered_frames = pair.second->delivered_frames;
+        item.queue = pair.second->mailbox.getStats();
+        stats.push_back(item);
+    }
+    return stats;
+}
+
+std::vector<FrameConsumerDemand> FrameBus::getConsumerDemands() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<FrameConsumerDemand> demands;
+    demands.reserve(subscribers_.size());
+    for (const auto& pair : subscribers_) {
+        FrameConsumerDemand demand;
+        demand.name = pair.second->name;
+        demand.camera_id = pair.second->camera_id;
+        demand.kind = pair.second->consumer;
+        demand.fixed_format = pair.second->fixed_format;
+        demands.push_back(demand);
+    }
+    return demands;
+}
+
+} // namespace camera
+} // namespace cam_server
@@ -0,0 +1,108 @@
+#include "camera/frame_mailbox.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace cam_server {
+namespace camera {
+
+FrameMailbox::FrameMailbox(size_t capacity, FrameDropPolicy policy, bool retain_latest)
+    : has_latest_(false),
+      retain_latest_(retain_latest),
+      capacity_(std::max<size_t>(capacity, 1)),
+      policy_(policy),
+      pushed_frames_(0),
+      dropped_frames_(0) {
+}
+
+void FrameMailbox::configure(size_t capacity, FrameDropPolicy policy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = std::max<size_t>(capacity, 1);
+    policy_ = policy;
+    trimLocked();
+}
+
+void FrameMailbox::push(Frame frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (retain_latest_) {
+            latest_ = frame;
+            has_latest_ = true;
+        }
+        if (policy_ == FrameDropPolicy::KEEP_LATEST) {
+            // 同一摄像头只保留最新帧，积压的旧帧计为丢弃
+            const std::string& camera_id = frame.getCameraId();
+            auto it = std::remove_if(frames_.begin(), frames_.end(), [&camera_id](const Frame& queued) {
+                return queued.getCameraId() == camera_id;
+            });
+            dropped_frames_ += static_cast<uint64_t>(std::distance(it, frames_.end()));
+            frames_.erase(it, frames_.end());
+        }
+        frames_.push_back(std::move(frame));
+        pushed_frames_++;
+        trimLocked();
+    }
+    cond_.notify_all();
+}
+
+bool FrameMailbox::pop(Frame& frame, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return !frames_.empty(); })) {
+        return false;
+    }
+
+    // KEEP_LATEST策略下入队时已丢弃同一摄像头的旧帧，队列中每个摄像头最多一帧
+    frame = std::move(frames_.front());
+    frames_.pop_front();
+    // 最新帧已被取走，不再额外持有，避免共享缓冲区一直滞留在邮箱中
+    if (frames_.empty()) {
+        latest_ = Frame();
+        has_latest_ = false;
+    }
+    return true;
+}
+
+bool FrameMailbox::peekLatest(Frame& frame, int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return has_latest_; })) {
+        return false;
+    }
+
+    frame = latest_;
+    return true;
+}
+
+void FrameMailbox::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frames_.clear();
+    latest_ = Frame();
+    has_latest_ = false;
+}
+
+FrameMailboxStats FrameMailbox::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FrameMailboxStats stats;
+    stats.pushed_frames = pushed_frames_;
+    stats.dropped_frames = dropped_frames_;
+    stats.depth = frames_.size();
+    stats.capacity = capacity_;
+    return stats;
+}
+
+void FrameMailbox::trimLocked() {
+    while (frames_.size() > capacity_) {
+        frames_.pop_front();
+        dropped_frames_++;
+    }
+}
+
+FrameDropPolicy parseFrameDropPolicy(const std::string& name) {
+    if (name == "keep_latest") {
+        return FrameDropPolicy::KEEP_LATEST;
+    }
+    return FrameDropPolicy::DROP_OLDEST;
+}
+
+} // namespace camera
+} // namespace cam_server
@@ -0,0 +1,168 @@
+#include "camera/pipeline_stats.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace cam_server {
+namespace camera {
+
+LatencyHistogram::LatencyHistogram()
+    : count_(0),
+      sum_(0),
+      min_(std::numeric_limits<uint64_t>::max()),
+      max_(0) {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < kSubBuckets) {
+        return static_cast<size_t>(value);
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - kSubBucketBits;
+    size_t sub = static_cast<size_t>((value >> shift) & (kSubBuckets - 1));
+    return kSubBuckets + static_cast<size_t>(shift) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    size_t shift = (index - kSubBuckets) / kSubBuckets;
+    uint64_t sub = (index - kSubBuckets) % kSubBuckets;
+    uint64_t lower = (uint64_t(1) << (shift + kSubBucketBits)) + (sub << shift);
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t current = min_.load(std::memory_order_relaxed);
+    while (value < current && !min_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+    current = max_.load(std::memory_order_relaxed);
+    while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot snapshot;
+
+    std::array<uint64_t, kBucketCount> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return snapshot;
+    }
+
+    snapshot.count = total;
+    snapshot.min = min_.load(std::memory_order_relaxed);
+    snapshot.max = max_.load(std::memory_order_relaxed);
+    snapshot.mean = static_cast<double>(sum_.load(std::memory_order_relaxed)) / static_cast<double>(total);
+
+    // 分位数取所在桶的上界，并以最大值为上限
+    const double quantiles[] = {0.50, 0.90, 0.99, 0.999};
+    uint64_t* outputs[] = {&snapshot.p50, &snapshot.p90, &snapshot.p99, &snapshot.p999};
+    size_t q = 0;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount && q < 4; ++i) {
+        seen += counts[i];
+        while (q < 4 && static_cast<double>(seen) >= quantiles[q] * static_cast<double>(total)) {
+            *outputs[q] = std::min(bucketUpperBound(i), snapshot.max);
+            q++;
+        }
+    }
+    for (; q < 4; ++q) {
+        *outputs[q] = snapshot.max;
+    }
+
+    return snapshot;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_ = 0;
+    sum_ = 0;
+    min_ = std::numeric_limits<uint64_t>::max();
+    max_ = 0;
+}
+
+const char* pipelineStageName(PipelineStage stage) {
+    switch (stage) {
+        case PipelineStage::DRIVER_TO_DEQUEUE:
+            return "driver_to_dequeue";
+        case PipelineStage::DEQUEUE_TO_DELIVER:
+            return "dequeue_to_deliver";
+        case PipelineStage::ENCODE:
+            return "encode";
+        case PipelineStage::ENCODE_TO_SEND:
+            return "encode_to_send";
+        case PipelineStage::CAPTURE_TO_WIRE:
+            return "capture_to_wire";
+        default:
+            return "unknown";
+    }
+}
+
+PipelineStats& PipelineStats::getInstance() {
+    static PipelineStats instance;
+    return instance;
+}
+
+void PipelineStats::recordLineage(const FrameLineage& lineage) {
+    auto record = [this](PipelineStage stage, uint64_t start, uint64_t end) {
+        // 缺少时间点或时钟不一致时忽略
+        if (start != 0 && end >= start) {
+            stages_[static_cast<size_t>(stage)].record(end - start);
+        }
+    };
+
+    if (lineage.dequeue_time_us != 0) {
+        record(PipelineStage::DRIVER_TO_DEQUEUE, lineage.capture_time_us, lineage.dequeue_time_us);
+    }
+    if (lineage.deliver_time_us != 0) {
+        record(PipelineStage::DEQUEUE_TO_DELIVER, lineage.dequeue_time_us, lineage.deliver_time_us);
+    }
+    if (lineage.encode_end_us != 0) {
+        record(PipelineStage::ENCODE, lineage.encode_start_us, lineage.encode_end_us);
+    }
+    if (lineage.send_time_us != 0) {
+        record(PipelineStage::ENCODE_TO_SEND, lineage.encode_end_us, lineage.send_time_us);
+        uint64_t origin = lineage.capture_time_us != 0 ? lineage.capture_time_us : lineage.dequeue_time_us;
+        record(PipelineStage::CAPTURE_TO_WIRE, origin, lineage.send_time_us);
+    }
+}
+
+void PipelineStats::recordDriverDrops(const std::string& camera_id, uint64_t count) {
+    std::lock_guard<std::mutex> lock(drops_mutex_);
+    driver_drops_[camera_id] += count;
+}
+
+LatencyHistogram::Snapshot PipelineStats::getStageSnapshot(PipelineStage stage) const {
+    return stages_[static_cast<size_t>(stage)].snapshot();
+}
+
+std::map<std::string, uint64_t> PipelineStats::getDriverDrops() const {
+    std::lock_guard<std::mutex> lock(drops_mutex_);
+    return driver_drops_;
+}
+
+void PipelineStats::reset() {
+    for (auto& stage : stages_) {
+        stage.reset();
+    }
+    std::lock_guard<std::mutex> lock(drops_mutex_);
+    driver_drops_.clear();
+}
+
+} // namespace camera
+} // namespace cam_server
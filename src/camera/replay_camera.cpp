@@ -0,0 +1,283 @@
+#include "camera/replay_camera.h"
+#include "monitor/logger.h"
+#include "utils/config_manager.h"
+#include "utils/file_utils.h"
+#include "utils/string_utils.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <fstream>
+
+namespace cam_server {
+namespace camera {
+
+/**
+ * @brief 只读映射的回放文件，由所有引用它的帧共享
+ */
+class MappedReplayFile {
+public:
+    ~MappedReplayFile() {
+        if (data_) {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+    }
+
+    bool map(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            LOG_ERROR("无法打开回放文件: " + path + ", 错误: " + std::string(strerror(errno)), "ReplayCamera");
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+            LOG_ERROR("回放文件为空或无法读取: " + path, "ReplayCamera");
+            ::close(fd);
+            return false;
+        }
+
+        void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            LOG_ERROR("无法映射回放文件: " + path + ", 错误: " + std::string(strerror(errno)), "ReplayCamera");
+            return false;
+        }
+
+        data_ = static_cast<const uint8_t*>(addr);
+        size_ = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+namespace {
+
+/**
+ * @brief 引用回放文件中一段数据的帧缓冲区
+ */
+class ReplayFrameBuffer : public FrameBuffer {
+public:
+    ReplayFrameBuffer(std::shared_ptr<const MappedReplayFile> file, size_t offset, size_t size)
+        : file_(std::move(file)), offset_(offset), size_(size) {}
+
+    const uint8_t* data() const override { return file_->data() + offset_; }
+    size_t size() const override { return size_; }
+
+private:
+    std::shared_ptr<const MappedReplayFile> file_;
+    size_t offset_;
+    size_t size_;
+};
+
+// 从JPEG的SOF段读取分辨率
+bool readJpegSize(const uint8_t* data, size_t size, int& width, int& height) {
+    size_t pos = 2;  // 跳过SOI
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos++;  // 填充字节
+            continue;
+        }
+        size_t length = (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+        bool is_sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (is_sof) {
+            if (pos + 9 > size) {
+                return false;
+            }
+            height = (data[pos + 5] << 8) | data[pos + 6];
+            width = (data[pos + 7] << 8) | data[pos + 8];
+            return width > 0 && height > 0;
+        }
+        if (marker == 0xDA) {
+            return false;  // 扫描开始前没有SOF
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+} // namespace
+
+ReplayCamera::ReplayCamera()
+    : next_index_(0),
+      width_(0),
+      height_(0),
+      format_(PixelFormat::UNKNOWN),
+      default_interval_us_(0),
+      loop_(true) {
+}
+
+ReplayCamera::~ReplayCamera() {
+    close();
+}
+
+bool ReplayCamera::openSource(const std::string& source, CameraParams& params, CameraDeviceInfo& info) {
+    if (source.empty()) {
+        LOG_ERROR("回放设备路径应为 replay:<文件路径>", "ReplayCamera");
+        return false;
+    }
+
+    auto file = std::make_shared<MappedReplayFile>();
+    if (!file->map(source)) {
+        return false;
+    }
+    file_ = file;
+    frames_.clear();
+    timestamps_.clear();
+
+    std::string extension = utils::StringUtils::toLower(utils::FileUtils::getFileExtension(source));
+    int width = params.width;
+    int height = params.height;
+    bool indexed = false;
+    if (extension == ".mjpeg" || extension == ".mjpg") {
+        format_ = PixelFormat::MJPEG;
+        indexed = indexMjpeg(width, height);
+    } else if (extension == ".yuyv" || extension == ".yuv" || extension == ".nv12") {
+        format_ = extension == ".nv12" ? PixelFormat::NV12 : PixelFormat::YUYV;
+        if (width <= 0 || height <= 0) {
+            LOG_ERROR("原始帧文件需要指定分辨率: " + source, "ReplayCamera");
+        } else {
+            size_t pixels = static_cast<size_t>(width) * height;
+            indexed = indexRaw(format_ == PixelFormat::NV12 ? pixels * 3 / 2 : pixels * 2);
+        }
+    } else {
+        LOG_ERROR("不支持的回放文件类型: " + source, "ReplayCamera");
+    }
+
+    if (!indexed || frames_.empty()) {
+        LOG_ERROR("回放文件中没有可用的帧: " + source, "ReplayCamera");
+        closeSource();
+        return false;
+    }
+
+    loadTimestamps(source + ".ts");
+
+    width_ = width;
+    height_ = height;
+    next_index_ = 0;
+    default_interval_us_ = 1000000ULL / static_cast<uint64_t>(params.fps);
+    loop_ = utils::ConfigManager::getInstance().getBool("camera.replay_loop", true);
+
+    params.width = width;
+    params.height = height;
+    params.format = format_;
+
+    info.device_name = "Replay Camera";
+    info.description = "回放文件: " + source;
+    info.supported_resolutions = {{width, height}};
+    info.supported_fps = {params.fps};
+    info.supported_formats = {format_};
+
+    LOG_INFO("回放文件已索引: " + source + ", 帧数: " + std::to_string(frames_.size()) +
+             (timestamps_.empty() ? ", 按帧率回放" : ", 按原始时间戳回放"), "ReplayCamera");
+    return true;
+}
+
+void ReplayCamera::closeSource() {
+    // 仍被引用的帧继续持有映射
+    file_.reset();
+    frames_.clear();
+    timestamps_.clear();
+}
+
+bool ReplayCamera::nextFrame(Frame& frame, uint64_t& interval_us) {
+    if (frames_.empty() || next_index_ >= frames_.size()) {
+        return false;
+    }
+
+    size_t index = next_index_;
+    const FrameEntry& entry = frames_[index];
+    frame = Frame(width_, height_, format_, std::make_shared<ReplayFrameBuffer>(file_, entry.offset, entry.size));
+
+    // 使用原始时间间隔；缺失、乱序或到达文件末尾时使用帧率间隔
+    interval_us = default_interval_us_;
+    if (index + 1 < timestamps_.size() && timestamps_[index + 1] > timestamps_[index]) {
+        interval_us = timestamps_[index + 1] - timestamps_[index];
+    }
+
+    next_index_ = index + 1;
+    if (next_index_ >= frames_.size() && loop_) {
+        next_index_ = 0;
+    }
+    return true;
+}
+
+bool ReplayCamera::indexMjpeg(int& width, int& height) {
+    const uint8_t* data = file_->data();
+    size_t size = file_->size();
+
+    size_t pos = 0;
+    while (pos + 1 < size) {
+        // 查找SOI
+        if (data[pos] != 0xFF || data[pos + 1] != 0xD8) {
+            pos++;
+            continue;
+        }
+
+        // 查找对应的EOI
+        size_t end = pos + 2;
+        while (end + 1 < size && !(data[end] == 0xFF && data[end + 1] == 0xD9)) {
+            end++;
+        }
+        if (end + 1 >= size) {
+            break;  // 最后一帧不完整
+        }
+
+        frames_.push_back({pos, end + 2 - pos});
+        pos = end + 2;
+    }
+
+    if (frames_.empty()) {
+        return false;
+    }
+
+    if (!readJpegSize(data + frames_[0].offset, frames_[0].size, width, height)) {
+        LOG_ERROR("无法从第一帧读取分辨率", "ReplayCamera");
+        return false;
+    }
+    return true;
+}
+
+bool ReplayCamera::indexRaw(size_t frame_size) {
+    size_t count = file_->size() / frame_size;
+    if (file_->size() % frame_size != 0) {
+        LOG_WARNING("回放文件大小不是帧大小的整数倍，忽略末尾不完整的帧", "ReplayCamera");
+    }
+
+    frames_.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        frames_.push_back({i * frame_size, frame_size});
+    }
+    return count > 0;
+}
+
+void ReplayCamera::loadTimestamps(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return;
+    }
+
+    uint64_t timestamp;
+    while (file >> timestamp) {
+        timestamps_.push_back(timestamp);
+    }
+
+    if (timestamps_.size() < frames_.size()) {
+        LOG_WARNING("时间戳数量少于帧数，缺失部分按帧率回放: " + path, "ReplayCamera");
+    }
+}
+
+} // namespace camera
+} // namespace cam_server
@@ -0,0 +1,302 @@
+#include "camera/simulated_camera.h"
+#include "camera/capture_reactor.h"
+#include "monitor/logger.h"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+
+namespace cam_server {
+namespace camera {
+
+SimulatedCamera::SimulatedCamera()
+    : current_params_(),
+      is_open_(false),
+      is_capturing_(false),
+      timer_fd_(-1),
+      reactor_registration_(0),
+      next_deadline_us_(0),
+      sequence_(0) {
+}
+
+SimulatedCamera::~SimulatedCamera() {
+    // 子类析构时帧源已销毁，这里只能释放基类资源；子类应在自己的析构函数中调用close()
+    if (is_capturing_) {
+        CaptureReactor::getInstance().remove(reactor_registration_);
+    }
+    if (timer_fd_ >= 0) {
+        ::close(timer_fd_);
+    }
+}
+
+bool SimulatedCamera::open(const std::string& device_path, int width, int height, int fps) {
+    if (is_open_) {
+        close();
+    }
+
+    size_t colon = device_path.find(':');
+    std::string source = colon == std::string::npos ? std::string() : device_path.substr(colon + 1);
+
+    CameraParams params = CameraParams();
+    params.width = width;
+    params.height = height;
+    params.fps = fps > 0 ? fps : 30;
+    params.brightness = 50;
+    params.contrast = 50;
+    params.saturation = 50;
+
+    CameraDeviceInfo info;
+    info.device_path = device_path;
+    {
+        std::lock_guard<std::mutex> lock(source_mutex_);
+        if (!openSource(source, params, info)) {
+            LOG_ERROR("无法打开模拟帧源: " + device_path, "SimulatedCamera");
+            return false;
+        }
+    }
+
+    timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd_ < 0) {
+        LOG_ERROR("无法创建定时器: " + std::string(strerror(errno)), "SimulatedCamera");
+        std::lock_guard<std::mutex> lock(source_mutex_);
+        closeSource();
+        return false;
+    }
+
+    device_path_ = device_path;
+    source_ = source;
+    device_info_ = info;
+    current_params_ = params;
+    is_open_ = true;
+
+    LOG_INFO("打开模拟摄像头: " + device_path + ", 分辨率: " + std::to_string(params.width) + "x" +
+             std::to_string(params.height) + ", 帧率: " + std::to_string(params.fps), "SimulatedCamera");
+    return true;
+}
+
+bool SimulatedCamera::close() {
+    if (!is_open_) {
+        return true;
+    }
+
+    stopCapture();
+
+    if (timer_fd_ >= 0) {
+        ::close(timer_fd_);
+        timer_fd_ = -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(source_mutex_);
+        closeSource();
+    }
+
+    is_open_ = false;
+    LOG_INFO("关闭模拟摄像头: " + device_path_, "SimulatedCamera");
+    return true;
+}
+
+bool SimulatedCamera::isOpen() const {
+    return is_open_;
+}
+
+bool SimulatedCamera::startCapture() {
+    if (!is_open_) {
+        LOG_ERROR("设备未打开", "SimulatedCamera");
+        return false;
+    }
+
+    if (is_capturing_) {
+        return true;  // 已经在捕获中
+    }
+
+    is_capturing_ = true;
+    next_deadline_us_ = FrameLineage::nowUs();
+
+    reactor_registration_ = CaptureReactor::getInstance().add(
+        timer_fd_, device_path_, [this]() { return onTimer(); });
+    if (reactor_registration_ == 0 || !armTimer(next_deadline_us_)) {
+        LOG_ERROR("无法启动模拟摄像头定时器", "SimulatedCamera");
+        CaptureReactor::getInstance().remove(reactor_registration_);
+        reactor_registration_ = 0;
+        is_capturing_ = false;
+        return false;
+    }
+
+    LOG_INFO("开始捕获模拟视频帧", "SimulatedCamera");
+    return true;
+}
+
+bool SimulatedCamera::stopCapture() {
+    if (!is_capturing_) {
+        return true;
+    }
+
+    // 注销后反应器不会再调用onTimer
+    CaptureReactor::getInstance().remove(reactor_registration_);
+    reactor_registration_ = 0;
+    armTimer(0);
+
+    frame_mailbox_.clear();
+
+    is_capturing_ = false;
+    LOG_INFO("停止捕获模拟视频帧", "SimulatedCamera");
+    return true;
+}
+
+bool SimulatedCamera::isCapturing() const {
+    return is_capturing_;
+}
+
+Frame SimulatedCamera::getFrame(int timeout_ms) {
+    Frame frame;
+
+    if (!is_capturing_) {
+        LOG_ERROR("未开始捕获", "SimulatedCamera");
+        return frame;
+    }
+
+    if (!frame_mailbox_.pop(frame, timeout_ms)) {
+        LOG_WARNING("等待帧超时", "SimulatedCamera");
+    }
+
+    return frame;
+}
+
+Frame SimulatedCamera::getLatestFrame(int timeout_ms) {
+    Frame frame;
+
+    if (!is_capturing_) {
+        LOG_ERROR("未开始捕获", "SimulatedCamera");
+        return frame;
+    }
+
+    if (!frame_mailbox_.peekLatest(frame, timeout_ms)) {
+        LOG_WARNING("等待最新帧超时", "SimulatedCamera");
+    }
+
+    return frame;
+}
+
+void SimulatedCamera::setFrameQueueConfig(size_t depth, FrameDropPolicy policy) {
+    frame_mailbox_.configure(depth, policy);
+}
+
+FrameMailboxStats SimulatedCamera::getFrameQueueStats() const {
+    return frame_mailbox_.getStats();
+}
+
+void SimulatedCamera::setFrameCallback(std::function<void(const Frame&)> callback) {
+    frame_callback_ = callback;
+}
+
+void SimulatedCamera::setCameraId(const std::string& camera_id) {
+    camera_id_ = camera_id;
+}
+
+CameraDeviceInfo SimulatedCamera::getDeviceInfo() const {
+    return device_info_;
+}
+
+CameraParams SimulatedCamera::getParams() const {
+    return current_params_;
+}
+
+bool SimulatedCamera::setParams(const CameraParams& params) {
+    if (!is_open_) {
+        LOG_ERROR("设备未打开", "SimulatedCamera");
+        return false;
+    }
+
+    bool source_changed = params.width != current_params_.width ||
+                          params.height != current_params_.height ||
+                          params.fps != current_params_.fps ||
+                          params.format != current_params_.format;
+    if (source_changed) {
+        if (is_capturing_) {
+            LOG_ERROR("捕获期间不能修改模拟摄像头的分辨率、格式或帧率", "SimulatedCamera");
+            return false;
+        }
+
+        CameraParams new_params = params;
+        CameraDeviceInfo info;
+        info.device_path = device_path_;
+        std::lock_guard<std::mutex> lock(source_mutex_);
+        closeSource();
+        if (!openSource(source_, new_params, info)) {
+            LOG_ERROR("无法以新参数重新打开模拟帧源", "SimulatedCamera");
+            is_open_ = false;
+            return false;
+        }
+        device_info_ = info;
+        current_params_ = new_params;
+        return true;
+    }
+
+    current_params_ = params;
+    return true;
+}
+
+bool SimulatedCamera::onTimer() {
+    uint64_t expirations = 0;
+    if (::read(timer_fd_, &expirations, sizeof(expirations)) < 0) {
+        return errno == EAGAIN || errno == EINTR;
+    }
+
+    Frame frame;
+    uint64_t interval_us = 0;
+    bool has_frame;
+    {
+        std::lock_guard<std::mutex> lock(source_mutex_);
+        has_frame = nextFrame(frame, interval_us);
+    }
+
+    if (!has_frame) {
+        // 帧源结束，不再触发定时器
+        LOG_INFO("模拟帧源已结束: " + device_path_, "SimulatedCamera");
+        return true;
+    }
+
+    FrameMetadata metadata = frame.getMetadata();
+    metadata.timestamp = next_deadline_us_;
+    metadata.sequence = sequence_;
+    frame.setMetadata(metadata);
+    frame.setCameraId(camera_id_);
+
+    FrameLineage lineage;
+    lineage.sequence = sequence_++;
+    lineage.capture_time_us = next_deadline_us_;
+    lineage.dequeue_time_us = FrameLineage::nowUs();
+    frame.setLineage(lineage);
+
+    if (frame_callback_) {
+        frame_callback_(frame);
+    }
+    frame_mailbox_.push(std::move(frame));
+
+    // 落后超过一个帧间隔时不追赶，避免停顿后突发大量帧
+    uint64_t now = FrameLineage::nowUs();
+    next_deadline_us_ += interval_us;
+    if (next_deadline_us_ + interval_us < now) {
+        next_deadline_us_ = now;
+    }
+
+    return armTimer(next_deadline_us_);
+}
+
+bool SimulatedCamera::armTimer(uint64_t deadline_us) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    // deadline_us为0时停止定时器；已过期的时间会立即触发
+    spec.it_value.tv_sec = deadline_us / 1000000ULL;
+    spec.it_value.tv_nsec = (deadline_us % 1000000ULL) * 1000;
+
+    if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+        LOG_ERROR("无法设置定时器: " + std::string(strerror(errno)), "SimulatedCamera");
+        return false;
+    }
+    return true;
+}
+
+} // namespace camera
+} // namespace cam_server
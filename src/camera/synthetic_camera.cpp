@@ -0,0 +1,331 @@
+#include "camera/synthetic_camera.h"
+#include "monitor/logger.h"
+#include "utils/string_utils.h"
+
+#include <algorithm>
+
+namespace cam_server {
+namespace camera {
+
+namespace {
+
+// 预生成的图案帧数，移动方块在这些帧中循环
+constexpr size_t kPatternFrames = 8;
+constexpr int kDefaultWidth = 640;
+constexpr int kDefaultHeight = 480;
+
+struct Yuv {
+    uint8_t y;
+    uint8_t u;
+    uint8_t v;
+};
+
+// BT.601彩条：白、黄、青、绿、品红、红、蓝、黑
+constexpr Yuv kColorBars[] = {
+    {235, 128, 128}, {210, 16, 146}, {170, 166, 16}, {145, 54, 34},
+    {106, 202, 222}, {81, 90, 240}, {41, 240, 110}, {16, 128, 128},
+};
+constexpr int kColorBarCount = sizeof(kColorBars) / sizeof(kColorBars[0]);
+
+/**
+ * @brief 测试图案：彩条背景加一个水平移动的灰色方块
+ */
+class TestPattern {
+public:
+    TestPattern(int width, int height, size_t index)
+        : width_(width),
+          box_size_(std::max(height / 4, 8)),
+          box_y_((height - box_size_) / 2) {
+        int travel = std::max(width - box_size_, 0);
+        box_x_ = static_cast<int>(travel * index / (kPatternFrames - 1));
+    }
+
+    Yuv at(int x, int y) const {
+        if (x >= box_x_ && x < box_x_ + box_size_ && y >= box_y_ && y < box_y_ + box_size_) {
+            return {128, 128, 128};
+        }
+        int bar = std::min(x * kColorBarCount / std::max(width_, 1), kColorBarCount - 1);
+        return kColorBars[bar];
+    }
+
+private:
+    int width_;
+    int box_size_;
+    int box_x_;
+    int box_y_;
+};
+
+std::vector<uint8_t> renderYuyv(int width, int height, const TestPattern& pattern) {
+    std::vector<uint8_t> data(static_cast<size_t>(width) * height * 2);
+    uint8_t* out = data.data();
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; x += 2) {
+            Yuv p0 = pattern.at(x, y);
+            Yuv p1 = pattern.at(std::min(x + 1, width - 1), y);
+            *out++ = p0.y;
+            *out++ = p0.u;
+            *out++ = p1.y;
+            *out++ = p0.v;
+        }
+    }
+    return data;
+}
+
+std::vector<uint8_t> renderNv12(int width, int height, const TestPattern& pattern) {
+    size_t luma_size = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> data(luma_size + luma_size / 2);
+    uint8_t* luma = data.data();
+    uint8_t* chroma = data.data() + luma_size;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            Yuv p = pattern.at(x, y);
+            luma[static_cast<size_t>(y) * width + x] = p.y;
+            if ((x & 1) == 0 && (y & 1) == 0) {
+                size_t offset = static_cast<size_t>(y / 2) * width + x;
+                chroma[offset] = p.u;
+                chroma[offset + 1] = p.v;
+            }
+        }
+    }
+    return data;
+}
+
+/**
+ * @brief 只包含DC系数的基线JPEG编码器
+ *
+ * 每个8x8块取图案在块中心的颜色，AC系数全部为零。生成的是合法的YCbCr 4:4:4基线JPEG，
+ * 可被任何解码器解码，足以驱动MJPEG直通、转发和录制路径，且不依赖编码库。
+ */
+class BlockJpegWriter {
+public:
+    std::vector<uint8_t> encode(int width, int height, const TestPattern& pattern) {
+        out_.clear();
+        bit_buffer_ = 0;
+        bit_count_ = 0;
+
+        writeHeaders(width, height);
+
+        int predictors[3] = {0, 0, 0};
+        int blocks_x = (width + 7) / 8;
+        int blocks_y = (height + 7) / 8;
+        for (int by = 0; by < blocks_y; ++by) {
+            for (int bx = 0; bx < blocks_x; ++bx) {
+                Yuv p = pattern.at(std::min(bx * 8 + 4, width - 1), std::min(by * 8 + 4, height - 1));
+                const int samples[3] = {p.y, p.u, p.v};
+                for (int c = 0; c < 3; ++c) {
+                    // 量化表DC项为8时，均匀块的量化DC系数等于电平平移后的样本值
+                    int dc = samples[c] - 128;
+                    writeDc(dc - predictors[c]);
+                    predictors[c] = dc;
+                    // EOB
+                    writeBits(0, 1);
+                }
+            }
+        }
+
+        // 用1填充最后一个字节
+        if (bit_count_ > 0) {
+            writeBits((1u << (8 - bit_count_)) - 1, 8 - bit_count_);
+        }
+
+        out_.push_back(0xFF);
+        out_.push_back(0xD9);
+        return out_;
+    }
+
+private:
+    void writeMarker(uint8_t marker, uint16_t length) {
+        out_.push_back(0xFF);
+        out_.push_back(marker);
+        out_.push_back(static_cast<uint8_t>(length >> 8));
+        out_.push_back(static_cast<uint8_t>(length & 0xFF));
+    }
+
+    void writeHeaders(int width, int height) {
+        // SOI
+        out_.push_back(0xFF);
+        out_.push_back(0xD8);
+
+        // APP0 (JFIF 1.01)
+        writeMarker(0xE0, 16);
+        const uint8_t jfif[] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+        out_.insert(out_.end(), jfif, jfif + sizeof(jfif));
+
+        // DQT：DC项为8，AC项不会用到
+        writeMarker(0xDB, 67);
+        out_.push_back(0x00);
+        out_.push_back(8);
+        out_.insert(out_.end(), 63, 1);
+
+        // SOF0：3个分量，均不采样，共用量化表0
+        writeMarker(0xC0, 17);
+        out_.push_back(8);
+        out_.push_back(static_cast<uint8_t>(height >> 8));
+        out_.push_back(static_cast<uint8_t>(height & 0xFF));
+        out_.push_back(static_cast<uint8_t>(width >> 8));
+        out_.push_back(static_cast<uint8_t>(width & 0xFF));
+        out_.push_back(3);
+        for (uint8_t id = 1; id <= 3; ++id) {
+            out_.push_back(id);
+            out_.push_back(0x11);
+            out_.push_back(0x00);
+        }
+
+        // DHT：标准亮度DC表，AC表只有EOB一个符号
+        writeMarker(0xC4, 2 + 17 + 12 + 17 + 1);
+        out_.push_back(0x00);
+        out_.insert(out_.end(), std::begin(kDcBits), std::end(kDcBits));
+        for (uint8_t value = 0; value < 12; ++value) {
+            out_.push_back(value);
+        }
+        out_.push_back(0x10);
+        out_.push_back(1);
+        out_.insert(out_.end(), 15, 0);
+        out_.push_back(0x00);
+
+        // SOS
+        writeMarker(0xDA, 12);
+        out_.push_back(3);
+        for (uint8_t id = 1; id <= 3; ++id) {
+            out_.push_back(id);
+            out_.push_back(0x00);
+        }
+        out_.push_back(0);
+        out_.push_back(63);
+        out_.push_back(0);
+    }
+
+    void writeDc(int diff) {
+        int magnitude = diff < 0 ? -diff : diff;
+        int category = 0;
+        while (magnitude > 0) {
+            magnitude >>= 1;
+            category++;
+        }
+
+        // 标准亮度DC表的规范哈夫曼码
+        static const uint16_t kCodes[12] = {0x0, 0x2, 0x3, 0x4, 0x5, 0x6, 0xE, 0x1E, 0x3E, 0x7E, 0xFE, 0x1FE};
+        static const uint8_t kLengths[12] = {2, 3, 3, 3, 3, 3, 4, 5, 6, 7, 8, 9};
+        writeBits(kCodes[category], kLengths[category]);
+
+        if (category > 0) {
+            int bits = diff < 0 ? diff + (1 << category) - 1 : diff;
+            writeBits(static_cast<uint32_t>(bits), category);
+        }
+    }
+
+    void writeBits(uint32_t bits, int count) {
+        for (int i = count - 1; i >= 0; --i) {
+            bit_buffer_ = static_cast<uint8_t>((bit_buffer_ << 1) | ((bits >> i) & 1));
+            if (++bit_count_ == 8) {
+                out_.push_back(bit_buffer_);
+                // 字节填充
+                if (bit_buffer_ == 0xFF) {
+                    out_.push_back(0x00);
+                }
+                bit_buffer_ = 0;
+                bit_count_ = 0;
+            }
+        }
+    }
+
+    static constexpr uint8_t kDcBits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+
+    std::vector<uint8_t> out_;
+    uint8_t bit_buffer_ = 0;
+    int bit_count_ = 0;
+};
+
+constexpr uint8_t BlockJpegWriter::kDcBits[16];
+
+} // namespace
+
+SyntheticCamera::SyntheticCamera()
+    : next_index_(0),
+      width_(0),
+      height_(0),
+      format_(PixelFormat::YUYV),
+      interval_us_(0) {
+}
+
+SyntheticCamera::~SyntheticCamera() {
+    close();
+}
+
+bool SyntheticCamera::openSource(const std::string& source, CameraParams& params, CameraDeviceInfo& info) {
+    std::string format_name = utils::StringUtils::toLower(source);
+    PixelFormat format;
+    if (format_name.empty() || format_name == "yuyv") {
+        format = PixelFormat::YUYV;
+    } else if (format_name == "nv12") {
+        format = PixelFormat::NV12;
+    } else if (format_name == "mjpeg" || format_name == "mjpg") {
+        format = PixelFormat::MJPEG;
+    } else {
+        LOG_ERROR("不支持的合成帧格式: " + source, "SyntheticCamera");
+        return false;
+    }
+
+    // 宽高取偶数，满足YUYV和NV12的色度采样要求
+    int width = params.width > 0 ? params.width & ~1 : kDefaultWidth;
+    int height = params.height > 0 ? params.height & ~1 : kDefaultHeight;
+    if (width <= 0 || height <= 0 || width > 65535 || height > 65535) {
+        LOG_ERROR("无效的合成帧分辨率", "SyntheticCamera");
+        return false;
+    }
+
+    frames_.clear();
+    frames_.reserve(kPatternFrames);
+    BlockJpegWriter jpeg_writer;
+    for (size_t i = 0; i < kPatternFrames; ++i) {
+        TestPattern pattern(width, height, i);
+        std::vector<uint8_t> data;
+        switch (format) {
+            case PixelFormat::NV12:
+                data = renderNv12(width, height, pattern);
+                break;
+            case PixelFormat::MJPEG:
+                data = jpeg_writer.encode(width, height, pattern);
+                break;
+            default:
+                data = renderYuyv(width, height, pattern);
+                break;
+        }
+        frames_.push_back(std::make_shared<VectorFrameBuffer>(std::move(data)));
+    }
+
+    width_ = width;
+    height_ = height;
+    format_ = format;
+    next_index_ = 0;
+    interval_us_ = 1000000ULL / static_cast<uint64_t>(params.fps);
+
+    params.width = width;
+    params.height = height;
+    params.format = format;
+
+    info.device_name = "Synthetic Camera";
+    info.description = "合成测试图案 (" + (format_name.empty() ? std::string("yuyv") : format_name) + ")";
+    info.supported_resolutions = {{width, height}};
+    info.supported_fps = {params.fps};
+    info.supported_formats = {PixelFormat::YUYV, PixelFormat::NV12, PixelFormat::MJPEG};
+    return true;
+}
+
+void SyntheticCamera::closeSource() {
+    frames_.clear();
+}
+
+bool SyntheticCamera::nextFrame(Frame& frame, uint64_t& interval_us) {
+    if (frames_.empty()) {
+        return false;
+    }
+
+    frame = Frame(width_, height_, format_, frames_[next_index_]);
+    next_index_ = (next_index_ + 1) % frames_.size();
+    interval_us = interval_us_;
+    return true;
+}
+
+} // namespace camera
+} // namespace cam_server
@@ -3,15 +3,19 @@
 #include "utils/string_utils.h"
 #include "utils/file_utils.h"
 #include "camera/format_utils.h"
+#include "camera/capture_reactor.h"
+#include "camera/pipeline_stats.h"
+#include "camera/capability_cache.h"
+#include "utils/config_manager.h"
 
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
-#include <dirent.h>
 #include <string.h>
 #include <algorithm>
+#include <cstdlib>
 #include <set>
 #include <chrono>
 #include <iostream>  // 添加iostream头文件，用于std::cerr
@@ -22,70 +26,263 @@
 namespace cam_server {
 namespace camera {
 
-V4L2Camera::V4L2Camera()
-    : fd_(-1),
-      is_open_(false),
-      is_capturing_(false),
-      stop_flag_(false) {
-}
-
-V4L2Camera::~V4L2Camera() {
-    close();
-}
+namespace {
+// 驱动队列中至少保留的缓冲区数量，低于该值时退化为复制帧数据
+constexpr size_t kMinDriverBuffers = 2;
+// 最近这段时间内调用过getFrame/getLatestFrame才认为存在拉取方（微秒）
+constexpr uint64_t kPullConsumerWindowUs = 2000000;
+// 连续出现这么多次DQBUF I/O错误时停止捕获
+constexpr int kMaxConsecutiveIoErrors = 30;
+// 未配置时的缓冲区数量及自动调整范围
+constexpr unsigned int kDefaultBufferCount = 4;
+constexpr unsigned int kDefaultMinBufferCount = 3;
+constexpr unsigned int kDefaultMaxBufferCount = 12;
+// 自动调整至少需要的样本数（帧）
+constexpr uint64_t kMinTuningSamples = 60;
+} // namespace
 
-std::vector<CameraDeviceInfo> V4L2Camera::scanDevices() {
-    std::vector<CameraDeviceInfo> devices;
-
-    // 打开/dev目录
-    DIR* dir = opendir("/dev");
-    if (!dir) {
-        LOG_ERROR("无法打开/dev目录", "V4L2Camera");
-        return devices;
+/**
+ * @brief mmap缓冲区池
+ *
+ * 持有所有映射区域，并跟踪每个缓冲区是在驱动队列中还是被帧引用。
+ * 摄像头与所有共享帧共同持有该对象，最后一个持有者析构时才解除映射，
+ * 因此帧可以安全地比摄像头活得更久。
+ */
+class MmapBufferPool : public std::enable_shared_from_this<MmapBufferPool> {
+public:
+    MmapBufferPool(int fd, std::shared_ptr<LatencyHistogram> hold_time_us)
+        : fd_(fd), streaming_(false), hold_time_us_(std::move(hold_time_us)) {}
+
+    ~MmapBufferPool() {
+        for (auto& slot : slots_) {
+            if (slot.start != nullptr && slot.start != MAP_FAILED) {
+                munmap(slot.start, slot.length);
+            }
+        }
     }
 
-    // 遍历/dev目录，查找video设备
-    struct dirent* entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        std::string name = entry->d_name;
+    // 查询并映射驱动分配的缓冲区
+    bool map(unsigned int count) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots_.resize(count);
+
+        for (unsigned int i = 0; i < count; ++i) {
+            struct v4l2_buffer buf;
+            memset(&buf, 0, sizeof(buf));
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = V4L2_MEMORY_MMAP;
+            buf.index = i;
+
+            if (ioctl(fd_, VIDIOC_QUERYBUF, &buf) < 0) {
+                LOG_ERROR("查询缓冲区失败", "V4L2Camera");
+                return false;
+            }
 
-        // 检查是否为video设备
-        if (name.find("video") == 0) {
-            std::string devicePath = "/dev/" + name;
+            slots_[i].length = buf.length;
+            slots_[i].start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, buf.m.offset);
 
-            // 尝试打开设备
-            int fd = ::open(devicePath.c_str(), O_RDWR);
-            if (fd < 0) {
-                continue;  // 无法打开，跳过
+            if (slots_[i].start == MAP_FAILED) {
+                slots_[i].start = nullptr;
+                LOG_ERROR("内存映射失败", "V4L2Camera");
+                return false;
             }
+        }
 
-            // 获取设备信息
-            struct v4l2_capability cap;
-            if (ioctl(fd, VIDIOC_QUERYCAP, &cap) < 0) {
-                ::close(fd);
-                continue;  // 无法获取设备信息，跳过
-            }
+        return true;
+    }
 
-            // 检查是否为视频捕获设备
-            if (!(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE)) {
-                ::close(fd);
-                continue;  // 不是视频捕获设备，跳过
+    // 将所有未被帧引用的缓冲区加入驱动队列
+    bool queueAll() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        streaming_ = true;
+        for (unsigned int i = 0; i < slots_.size(); ++i) {
+            if (slots_[i].queued || slots_[i].held) {
+                continue;
             }
+            if (!queueLocked(i)) {
+                LOG_ERROR("无法将缓冲区加入队列", "V4L2Camera");
+                return false;
+            }
+        }
+        return true;
+    }
 
-            // 创建设备信息
-            CameraDeviceInfo deviceInfo;
-            deviceInfo.device_path = devicePath;
-            deviceInfo.device_name = reinterpret_cast<const char*>(cap.card);
-            deviceInfo.description = reinterpret_cast<const char*>(cap.driver);
+    // 停止视频流，驱动会隐式出队所有缓冲区
+    bool streamOff() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        streaming_ = false;
+        enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        bool ok = fd_ >= 0 && ioctl(fd_, VIDIOC_STREAMOFF, &type) >= 0;
+        for (auto& slot : slots_) {
+            slot.queued = false;
+        }
+        return ok;
+    }
 
-            // 查询设备支持的格式
-            queryCapabilities(fd, deviceInfo);
+    // 设备关闭后不再访问文件描述符
+    void detach() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        streaming_ = false;
+        fd_ = -1;
+    }
+
+    void markDequeued(unsigned int index) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index < slots_.size()) {
+            slots_[index].queued = false;
+            slots_[index].dequeue_us = FrameLineage::nowUs();
+        }
+    }
+
+    bool requeue(unsigned int index) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return index < slots_.size() && queueLocked(index);
+    }
+
+    size_t size() const {
+        return slots_.size();
+    }
+
+    size_t queuedCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return static_cast<size_t>(std::count_if(slots_.begin(), slots_.end(),
+                                                 [](const Slot& slot) { return slot.queued; }));
+    }
+
+    size_t heldCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return static_cast<size_t>(std::count_if(slots_.begin(), slots_.end(),
+                                                 [](const Slot& slot) { return slot.held; }));
+    }
+
+    const uint8_t* data(unsigned int index) const {
+        return static_cast<const uint8_t*>(slots_[index].start);
+    }
+
+    // 将已出队的缓冲区包装为共享帧缓冲区
+    std::shared_ptr<const FrameBuffer> acquire(unsigned int index, size_t bytesused);
+
+    // 帧缓冲区的最后一个引用释放时调用
+    void release(unsigned int index) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index >= slots_.size()) {
+            return;
+        }
+        slots_[index].held = false;
+        // 出队到最后一个帧引用释放即消费者持有缓冲区的时间
+        if (hold_time_us_ && slots_[index].dequeue_us != 0) {
+            hold_time_us_->record(FrameLineage::nowUs() - slots_[index].dequeue_us);
+        }
+        if (streaming_ && !queueLocked(index)) {
+            LOG_ERROR("无法将缓冲区放回队列: " + std::string(strerror(errno)), "V4L2Camera");
+        }
+    }
+
+private:
+    struct Slot {
+        void* start = nullptr;
+        size_t length = 0;
+        bool queued = false;  // 是否在驱动队列中
+        bool held = false;    // 是否被帧引用
+        uint64_t dequeue_us = 0;  // 最近一次出队时间
+    };
+
+    bool queueLocked(unsigned int index) {
+        if (fd_ < 0) {
+            return false;
+        }
+
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = index;
 
-            devices.push_back(deviceInfo);
-            ::close(fd);
+        if (ioctl(fd_, VIDIOC_QBUF, &buf) < 0) {
+            return false;
         }
+        slots_[index].queued = true;
+        return true;
+    }
+
+    mutable std::mutex mutex_;
+    int fd_;
+    bool streaming_;
+    std::vector<Slot> slots_;
+    std::shared_ptr<LatencyHistogram> hold_time_us_;
+};
+
+namespace {
+
+/**
+ * @brief 引用mmap缓冲区的帧缓冲区，析构时将缓冲区归还给驱动
+ */
+class MmapFrameBuffer : public FrameBuffer {
+public:
+    MmapFrameBuffer(std::shared_ptr<MmapBufferPool> pool, unsigned int index, const uint8_t* data, size_t size)
+        : pool_(std::move(pool)), index_(index), data_(data), size_(size) {}
+
+    ~MmapFrameBuffer() override {
+        pool_->release(index_);
+    }
+
+    const uint8_t* data() const override { return data_; }
+    size_t size() const override { return size_; }
+
+private:
+    std::shared_ptr<MmapBufferPool> pool_;
+    unsigned int index_;
+    const uint8_t* data_;
+    size_t size_;
+};
+
+} // namespace
+
+std::shared_ptr<const FrameBuffer> MmapBufferPool::acquire(unsigned int index, size_t bytesused) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots_[index].held = true;
+    }
+    return std::make_shared<MmapFrameBuffer>(shared_from_this(), index, data(index),
+                                             std::min(bytesused, slots_[index].length));
+}
+
+V4L2Camera::V4L2Camera()
+    : fd_(-1),
+      is_open_(false),
+      is_capturing_(false),
+      reactor_registration_(0),
+      last_sequence_(-1),
+      configured_buffer_count_(0),
+      min_buffer_count_(kDefaultMinBufferCount),
+      max_buffer_count_(kDefaultMaxBufferCount),
+      buffer_count_(kDefaultBufferCount),
+      last_dequeue_us_(0),
+      last_driver_timestamp_us_(0),
+      hold_time_us_(std::make_shared<LatencyHistogram>()),
+      starved_frames_(0),
+      last_pull_us_(0),
+      orphaned_buffers_supported_(false),
+      consecutive_io_errors_(0) {
+}
+
+V4L2Camera::~V4L2Camera() {
+    close();
+}
+
+std::vector<CameraDeviceInfo> V4L2Camera::scanDevices() {
+    std::vector<CameraDeviceInfo> devices;
+
+    // 能力缓存命中时不需要重新打开设备
+    for (const auto& capabilities : CapabilityCache::getInstance().scan()) {
+        CameraDeviceInfo deviceInfo;
+        deviceInfo.device_path = capabilities->device_path;
+        deviceInfo.device_name = capabilities->card;
+        deviceInfo.description = capabilities->driver;
+        fillDeviceInfo(*capabilities, deviceInfo);
+        devices.push_back(deviceInfo);
     }
 
-    closedir(dir);
     return devices;
 }
 
@@ -179,6 +376,7 @@ bool V4L2Camera::open(const std::string& device_path, int width, int height, int
 
     // 设置当前设备信息
     LOG_DEBUG("设置当前设备信息...", "V4L2Camera");
+    device_path_ = device_path;
     device_info_.device_path = device_path;
     device_info_.device_name = std::string(reinterpret_cast<const char*>(cap.card));
     device_info_.description = std::string(reinterpret_cast<const char*>(cap.card));
@@ -214,6 +412,21 @@ bool V4L2Camera::open(const std::string& device_path, int width, int height, int
         LOG_DEBUG("帧率设置成功", "V4L2Camera");
     }
 
+    // 缓冲区数量：配置值优先，为0时从默认值开始自动调整
+    auto& config = utils::ConfigManager::getInstance();
+    int configured = config.getInt("camera.buffer_count", 0);
+    int min_count = config.getInt("camera.buffer_count_min", kDefaultMinBufferCount);
+    int max_count = config.getInt("camera.buffer_count_max", kDefaultMaxBufferCount);
+    min_buffer_count_ = static_cast<unsigned int>(std::max(min_count, 2));
+    max_buffer_count_ = static_cast<unsigned int>(std::max(max_count, static_cast<int>(min_buffer_count_)));
+    configured_buffer_count_ = configured > 0 ? static_cast<unsigned int>(std::max(configured, 2)) : 0;
+    buffer_count_ = configured_buffer_count_ != 0
+                        ? configured_buffer_count_
+                        : std::min(std::max(kDefaultBufferCount, min_buffer_count_), max_buffer_count_);
+    dequeue_jitter_us_.reset();
+    hold_time_us_->reset();
+    starved_frames_ = 0;
+
     // 初始化设备
     LOG_DEBUG("初始化设备...", "V4L2Camera");
     if (!initDevice()) {
@@ -278,18 +491,57 @@ bool V4L2Camera::startCapture() {
         return true;  // 已经在捕获中
     }
 
+    // 自动模式下按上次捕获测得的抖动和持有时间重新分配缓冲区
+    if (configured_buffer_count_ == 0 && buffer_pool_) {
+        size_t recommended = recommendBufferCount();
+        if (recommended != 0 && recommended != buffer_pool_->size()) {
+            size_t previous = buffer_pool_->size();
+            if (releaseBuffers()) {
+                LOG_INFO("调整驱动缓冲区数量: " + std::to_string(previous) + " -> " +
+                         std::to_string(recommended), "V4L2Camera");
+                buffer_count_ = static_cast<unsigned int>(recommended);
+                if (!initMmap()) {
+                    LOG_ERROR("无法重新分配缓冲区", "V4L2Camera");
+                    return false;
+                }
+                // 新的缓冲区数量下重新测量
+                dequeue_jitter_us_.reset();
+                hold_time_us_->reset();
+                starved_frames_ = 0;
+            } else if (!buffer_pool_ && !initMmap()) {
+                LOG_ERROR("无法重新分配缓冲区", "V4L2Camera");
+                return false;
+            }
+        }
+    }
+
     // 启动视频流
     if (!startStreaming()) {
         LOG_ERROR("无法启动视频流", "V4L2Camera");
         return false;
     }
 
-    // 设置标志
-    stop_flag_ = false;
-    is_capturing_ = true;
+    // 反应器线程不能阻塞在DQBUF上
+    int flags = fcntl(fd_, F_GETFL, 0);
+    if (flags >= 0 && !(flags & O_NONBLOCK)) {
+        fcntl(fd_, F_SETFL, flags | O_NONBLOCK);
+    }
 
-    // 启动捕获线程
-    capture_thread_ = std::thread(&V4L2Camera::captureThreadFunc, this);
+    is_capturing_ = true;
+    consecutive_io_errors_ = 0;
+    last_sequence_ = -1;
+    last_dequeue_us_ = 0;
+    last_driver_timestamp_us_ = 0;
+
+    // 由捕获反应器统一等待设备可读
+    reactor_registration_ = CaptureReactor::getInstance().add(
+        fd_, device_path_, [this]() { return onCaptureReady(); });
+    if (reactor_registration_ == 0) {
+        LOG_ERROR("无法注册到捕获反应器", "V4L2Camera");
+        is_capturing_ = false;
+        stopStreaming();
+        return false;
+    }
 
     LOG_INFO("开始捕获视频帧", "V4L2Camera");
     return true;
@@ -300,17 +552,16 @@ bool V4L2Camera::stopCapture() {
         return true;
     }
 
-    // 设置停止标志
-    stop_flag_ = true;
-
-    // 等待捕获线程结束
-    if (capture_thread_.joinable()) {
-        capture_thread_.join();
-    }
+    // 注销后反应器不会再调用onCaptureReady
+    CaptureReactor::getInstance().remove(reactor_registration_);
+    reactor_registration_ = 0;
 
     // 停止视频流
     stopStreaming();
 
+    // 释放队列中的帧，避免重新开始捕获后返回过期帧
+    frame_mailbox_.clear();
+
     is_capturing_ = false;
     LOG_INFO("停止捕获视频帧", "V4L2Camera");
     return true;
@@ -328,32 +579,55 @@ Frame V4L2Camera::getFrame(int timeout_ms) {
         return frame;
     }
 
-    // 等待帧队列中有帧可用
-    std::unique_lock<std::mutex> lock(frame_queue_mutex_);
-    if (frame_queue_.empty()) {
-        auto status = frame_queue_cond_.wait_for(lock, std::chrono::milliseconds(timeout_ms));
-        if (status == std::cv_status::timeout) {
-            LOG_WARNING("等待帧超时", "V4L2Camera");
-            return frame;
-        }
+    markPullConsumer();
+    if (!frame_mailbox_.pop(frame, timeout_ms)) {
+        LOG_WARNING("等待帧超时", "V4L2Camera");
     }
 
-    if (frame_queue_.empty()) {
-        LOG_WARNING("帧队列为空", "V4L2Camera");
+    return frame;
+}
+
+Frame V4L2Camera::getLatestFrame(int timeout_ms) {
+    Frame frame;
+
+    if (!is_capturing_) {
+        LOG_ERROR("未开始捕获", "V4L2Camera");
         return frame;
     }
 
-    // 获取队列中的第一帧
-    frame = frame_queue_.front();
-    frame_queue_.pop();
+    // 之前没有拉取方时队列未更新，保留的帧已过期，等待下一帧
+    if (!markPullConsumer()) {
+        frame_mailbox_.clear();
+    }
+    if (!frame_mailbox_.peekLatest(frame, timeout_ms)) {
+        LOG_WARNING("等待帧超时", "V4L2Camera");
+    }
 
     return frame;
 }
 
+void V4L2Camera::setFrameQueueConfig(size_t depth, FrameDropPolicy policy) {
+    frame_mailbox_.configure(depth, policy);
+}
+
+FrameMailboxStats V4L2Camera::getFrameQueueStats() const {
+    return frame_mailbox_.getStats();
+}
+
+bool V4L2Camera::markPullConsumer() {
+    uint64_t now = FrameLineage::nowUs();
+    uint64_t last = last_pull_us_.exchange(now);
+    return last != 0 && now - last <= kPullConsumerWindowUs;
+}
+
 void V4L2Camera::setFrameCallback(std::function<void(const Frame&)> callback) {
     frame_callback_ = callback;
 }
 
+void V4L2Camera::setCameraId(const std::string& camera_id) {
+    camera_id_ = camera_id;
+}
+
 CameraDeviceInfo V4L2Camera::getDeviceInfo() const {
     return device_info_;
 }
@@ -374,28 +648,55 @@ bool V4L2Camera::setParams(const CameraParams& params) {
         stopCapture();
     }
 
-    // 设置视频格式
-    uint32_t v4l2_format = pixelFormatToV4L2Format(params.format);
-    if (!setVideoFormat(params.width, params.height, v4l2_format)) {
-        LOG_ERROR("无法设置视频格式", "V4L2Camera");
+    // 已分配缓冲区时驱动拒绝修改格式，先释放；仍有帧引用缓冲区而无法释放时保持原格式继续捕获
+    if (!releaseBuffers()) {
+        if (!buffer_pool_ && !initDevice()) {
+            LOG_ERROR("无法重新分配缓冲区", "V4L2Camera");
+            return false;
+        }
+        if (was_capturing && !startCapture()) {
+            LOG_ERROR("无法恢复捕获", "V4L2Camera");
+        }
         return false;
     }
 
-    // 设置帧率
-    if (!setFrameRate(params.fps)) {
+    // 设置视频格式和帧率，实际分辨率和格式由setVideoFormat更新
+    CameraParams previous = current_params_;
+    bool ok = true;
+    uint32_t v4l2_format = pixelFormatToV4L2Format(params.format);
+    if (!setVideoFormat(params.width, params.height, v4l2_format)) {
+        LOG_ERROR("无法设置视频格式", "V4L2Camera");
+        ok = false;
+    } else if (!setFrameRate(params.fps)) {
         LOG_ERROR("无法设置帧率", "V4L2Camera");
-        return false;
+        ok = false;
+    } else {
+        current_params_.fps = params.fps;
+        current_params_.brightness = params.brightness;
+        current_params_.contrast = params.contrast;
+        current_params_.saturation = params.saturation;
+        current_params_.exposure = params.exposure;
     }
 
-    // 更新当前参数
-    current_params_ = params;
+    // 无论设置是否成功都重新分配缓冲区；新格式下分配失败时恢复原格式，保证设备仍可以捕获
+    if (!initDevice()) {
+        LOG_ERROR("无法按新格式分配缓冲区，恢复原格式", "V4L2Camera");
+        ok = false;
+        if (!setVideoFormat(previous.width, previous.height, pixelFormatToV4L2Format(previous.format)) ||
+            !setFrameRate(previous.fps) || !initDevice()) {
+            LOG_ERROR("无法重新分配缓冲区", "V4L2Camera");
+            return false;
+        }
+        current_params_.fps = previous.fps;
+    }
 
     // 如果之前在捕获，重新开始捕获
-    if (was_capturing) {
-        startCapture();
+    if (was_capturing && !startCapture()) {
+        LOG_ERROR("无法恢复捕获", "V4L2Camera");
+        return false;
     }
 
-    return true;
+    return ok;
 }
 
 bool V4L2Camera::initDevice() {
@@ -411,7 +712,7 @@ bool V4L2Camera::initMmap() {
     // 请求缓冲区
     struct v4l2_requestbuffers req;
     memset(&req, 0, sizeof(req));
-    req.count = 4;  // 请求4个缓冲区
+    req.count = buffer_count_;
     req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     req.memory = V4L2_MEMORY_MMAP;
 
@@ -419,113 +720,117 @@ bool V4L2Camera::initMmap() {
         LOG_ERROR("请求缓冲区失败", "V4L2Camera");
         return false;
     }
+#ifdef V4L2_BUF_CAP_SUPPORTS_ORPHANED_BUFS
+    orphaned_buffers_supported_ = (req.capabilities & V4L2_BUF_CAP_SUPPORTS_ORPHANED_BUFS) != 0;
+#endif
 
     if (req.count < 2) {
         LOG_ERROR("缓冲区数量不足", "V4L2Camera");
         return false;
     }
 
-    // 分配缓冲区
-    buffers_.resize(req.count);
+    if (req.count != buffer_count_) {
+        LOG_DEBUG("驱动分配的缓冲区数量: " + std::to_string(req.count) + "，请求: " +
+                  std::to_string(buffer_count_), "V4L2Camera");
+    }
 
-    for (unsigned int i = 0; i < req.count; ++i) {
-        struct v4l2_buffer buf;
-        memset(&buf, 0, sizeof(buf));
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        buf.index = i;
+    // 映射缓冲区
+    buffer_pool_ = std::make_shared<MmapBufferPool>(fd_, hold_time_us_);
+    if (!buffer_pool_->map(req.count)) {
+        freeMmap();
+        return false;
+    }
 
-        if (ioctl(fd_, VIDIOC_QUERYBUF, &buf) < 0) {
-            LOG_ERROR("查询缓冲区失败", "V4L2Camera");
-            return false;
-        }
+    return true;
+}
 
-        buffers_[i].length = buf.length;
-        buffers_[i].start = mmap(
-            NULL,
-            buf.length,
-            PROT_READ | PROT_WRITE,
-            MAP_SHARED,
-            fd_,
-            buf.m.offset
-        );
-
-        if (buffers_[i].start == MAP_FAILED) {
-            LOG_ERROR("内存映射失败", "V4L2Camera");
-            return false;
-        }
+void V4L2Camera::freeMmap() {
+    // 仍被帧引用的映射区域在最后一个引用释放时才解除映射
+    if (buffer_pool_) {
+        buffer_pool_->detach();
+        buffer_pool_.reset();
+    }
+}
+
+bool V4L2Camera::releaseBuffers() {
+    // 驱动支持孤立缓冲区时，仍被帧引用的缓冲区在释放后映射继续有效；
+    // 否则存在映射时VIDIOC_REQBUFS(0)返回EBUSY，须等所有帧释放
+    if (buffer_pool_ && !orphaned_buffers_supported_ && buffer_pool_->heldCount() > 0) {
+        LOG_WARNING("仍有帧引用驱动缓冲区且驱动不支持孤立缓冲区，暂不释放", "V4L2Camera");
+        return false;
     }
 
+    freeMmap();
+
+    struct v4l2_requestbuffers req;
+    memset(&req, 0, sizeof(req));
+    req.count = 0;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(fd_, VIDIOC_REQBUFS, &req) < 0) {
+        LOG_WARNING("释放缓冲区失败: " + std::string(strerror(errno)), "V4L2Camera");
+        return false;
+    }
     return true;
 }
 
-void V4L2Camera::freeMmap() {
-    for (auto& buffer : buffers_) {
-        if (buffer.start != nullptr && buffer.start != MAP_FAILED) {
-            munmap(buffer.start, buffer.length);
-            buffer.start = nullptr;
-            buffer.length = 0;
-        }
+size_t V4L2Camera::recommendBufferCount() const {
+    auto hold = hold_time_us_->snapshot();
+    auto jitter = dequeue_jitter_us_.snapshot();
+    if (jitter.count < kMinTuningSamples) {
+        return 0;
+    }
+
+    int fps = current_params_.fps > 0 ? current_params_.fps : 30;
+    uint64_t interval_us = 1000000ULL / static_cast<uint64_t>(fps);
+    auto frames = [interval_us](uint64_t us) { return static_cast<size_t>((us + interval_us - 1) / interval_us); };
+
+    // 驱动正在填充的一个 + 等待出队的一个 + 覆盖消费者持有和出队延迟所需的数量
+    size_t count = 2 + frames(hold.p99) + frames(jitter.p99);
+    // 出现过缓冲区不足时至少比当前多一个
+    if (starved_frames_ > 0 && buffer_pool_) {
+        count = std::max(count, buffer_pool_->size() + 1);
     }
+    return std::min<size_t>(std::max<size_t>(count, min_buffer_count_), max_buffer_count_);
+}
 
-    buffers_.clear();
+CaptureBufferStats V4L2Camera::getBufferStats() const {
+    CaptureBufferStats stats;
+    stats.buffer_count = buffer_pool_ ? buffer_pool_->size() : 0;
+    stats.recommended_count = recommendBufferCount();
+    stats.starved_frames = starved_frames_;
+    stats.hold_p99_us = hold_time_us_->snapshot().p99;
+    stats.dequeue_jitter_p99_us = dequeue_jitter_us_.snapshot().p99;
+    return stats;
 }
 
 void V4L2Camera::queryCapabilities(int fd, CameraDeviceInfo& deviceInfo) {
-    // 查询支持的格式
-    struct v4l2_fmtdesc fmtdesc;
-    memset(&fmtdesc, 0, sizeof(fmtdesc));
-    fmtdesc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    auto capabilities = CapabilityCache::getInstance().get(deviceInfo.device_path, fd);
+    if (!capabilities) {
+        LOG_WARNING("无法查询设备能力: " + deviceInfo.device_path, "V4L2Camera");
+        return;
+    }
+    fillDeviceInfo(*capabilities, deviceInfo);
+}
 
+void V4L2Camera::fillDeviceInfo(const DeviceCapabilities& capabilities, CameraDeviceInfo& deviceInfo) {
     std::set<std::pair<int, int>> resolutions;
+    std::set<int> frame_rates;
     std::vector<PixelFormat> formats;
 
-    // 遍历所有支持的格式
-    while (ioctl(fd, VIDIOC_ENUM_FMT, &fmtdesc) >= 0) {
-        // 添加像素格式
-        PixelFormat format = v4l2FormatToPixelFormat(fmtdesc.pixelformat);
-        if (format != PixelFormat::UNKNOWN) {
-            formats.push_back(format);
+    for (const auto& format : capabilities.formats) {
+        if (format.format != PixelFormat::UNKNOWN) {
+            formats.push_back(format.format);
         }
-
-        // 查询该格式支持的分辨率
-        struct v4l2_frmsizeenum frmsize;
-        memset(&frmsize, 0, sizeof(frmsize));
-        frmsize.pixel_format = fmtdesc.pixelformat;
-        frmsize.index = 0;
-
-        while (ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &frmsize) >= 0) {
-            if (frmsize.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
-                // 离散分辨率
-                std::pair<int, int> res(frmsize.discrete.width, frmsize.discrete.height);
-                resolutions.insert(res);
-            } else if (frmsize.type == V4L2_FRMSIZE_TYPE_STEPWISE) {
-                // 步进分辨率，添加一些常见分辨率
-                for (uint32_t width = frmsize.stepwise.min_width;
-                     width <= frmsize.stepwise.max_width;
-                     width += frmsize.stepwise.step_width) {
-                    for (uint32_t height = frmsize.stepwise.min_height;
-                         height <= frmsize.stepwise.max_height;
-                         height += frmsize.stepwise.step_height) {
-                        std::pair<int, int> res(width, height);
-                        resolutions.insert(res);
-                    }
-                }
-            }
-
-            frmsize.index++;
+        // 步进/连续范围只列出探测过的标准分辨率
+        for (const auto& size : format.sizes) {
+            resolutions.insert({static_cast<int>(size.width), static_cast<int>(size.height)});
+            frame_rates.insert(size.fps.begin(), size.fps.end());
         }
-
-        fmtdesc.index++;
-    }
-
-    // 将分辨率集合转换为向量
-    deviceInfo.supported_resolutions.clear();
-    for (const auto& res : resolutions) {
-        deviceInfo.supported_resolutions.push_back(res);
     }
 
-    // 设置支持的格式
+    deviceInfo.supported_resolutions.assign(resolutions.begin(), resolutions.end());
+    deviceInfo.supported_fps.assign(frame_rates.begin(), frame_rates.end());
     deviceInfo.supported_formats = formats;
 }
 
@@ -615,22 +920,13 @@ bool V4L2Camera::setFrameRate(int fps) {
 }
 
 bool V4L2Camera::startStreaming() {
-    if (fd_ < 0) {
+    if (fd_ < 0 || !buffer_pool_) {
         return false;
     }
 
-    // 将缓冲区加入队列
-    for (unsigned int i = 0; i < buffers_.size(); ++i) {
-        struct v4l2_buffer buf;
-        memset(&buf, 0, sizeof(buf));
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        buf.index = i;
-
-        if (ioctl(fd_, VIDIOC_QBUF, &buf) < 0) {
-            LOG_ERROR("无法将缓冲区加入队列", "V4L2Camera");
-            return false;
-        }
+    // 将缓冲区加入队列（仍被帧引用的缓冲区在释放时自动入队）
+    if (!buffer_pool_->queueAll()) {
+        return false;
     }
 
     // 开始流
@@ -644,13 +940,12 @@ bool V4L2Camera::startStreaming() {
 }
 
 bool V4L2Camera::stopStreaming() {
-    if (fd_ < 0) {
+    if (fd_ < 0 || !buffer_pool_) {
         return false;
     }
 
     // 停止流
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if (ioctl(fd_, VIDIOC_STREAMOFF, &type) < 0) {
+    if (!buffer_pool_->streamOff()) {
         LOG_ERROR("无法停止视频流", "V4L2Camera");
         return false;
     }
@@ -658,57 +953,59 @@ bool V4L2Camera::stopStreaming() {
     return true;
 }
 
-void V4L2Camera::captureThreadFunc() {
-    while (!stop_flag_) {
-        // 从队列中取出缓冲区
+bool V4L2Camera::onCaptureReady() {
+    // 每次最多取出缓冲区总数个帧，避免单个设备占满反应器线程
+    size_t budget = std::max<size_t>(buffer_pool_ ? buffer_pool_->size() : 0, 1);
+
+    for (size_t i = 0; i < budget; ++i) {
         struct v4l2_buffer buf;
         memset(&buf, 0, sizeof(buf));
         buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
         buf.memory = V4L2_MEMORY_MMAP;
 
-        // 非阻塞模式下等待帧
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET(fd_, &fds);
-
-        struct timeval tv;
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
-
-        int r = select(fd_ + 1, &fds, NULL, NULL, &tv);
-
-        if (r == -1) {
-            if (errno == EINTR) {
-                continue;  // 被信号中断，重试
+        if (ioctl(fd_, VIDIOC_DQBUF, &buf) < 0) {
+            if (errno == EAGAIN || errno == EINTR) {
+                return true;  // 没有更多就绪的缓冲区
             }
-            LOG_ERROR("select错误: " + std::string(strerror(errno)), "V4L2Camera");
-            break;
+            // EIO通常是信号丢失等暂时性错误，跳过本帧；连续出现时才视为设备故障
+            if (errno == EIO && ++consecutive_io_errors_ < kMaxConsecutiveIoErrors) {
+                LOG_WARNING("取出缓冲区时发生I/O错误，跳过本帧", "V4L2Camera");
+                return true;
+            }
+            return stopOnCaptureError("无法从队列中取出缓冲区: " + std::string(strerror(errno)));
         }
+        consecutive_io_errors_ = 0;
 
-        if (r == 0) {
-            continue;  // 超时，重试
-        }
+        buffer_pool_->markDequeued(buf.index);
 
-        if (ioctl(fd_, VIDIOC_DQBUF, &buf) < 0) {
-            if (errno == EAGAIN) {
-                continue;  // 资源暂时不可用，重试
+        // 驱动标记为出错的帧数据可能不完整，直接放回队列
+        if (buf.flags & V4L2_BUF_FLAG_ERROR) {
+            LOG_WARNING("驱动报告帧数据错误，跳过本帧", "V4L2Camera");
+            if (!buffer_pool_->requeue(buf.index)) {
+                return stopOnCaptureError("无法将缓冲区放回队列");
             }
-            LOG_ERROR("无法从队列中取出缓冲区: " + std::string(strerror(errno)), "V4L2Camera");
-            break;
+            continue;
         }
 
-        // 处理帧
-        processFrame(buffers_[buf.index].start, buf.bytesused, buf);
-
-        // 将缓冲区放回队列
-        if (ioctl(fd_, VIDIOC_QBUF, &buf) < 0) {
-            LOG_ERROR("无法将缓冲区放回队列", "V4L2Camera");
-            break;
+        // 处理帧，缓冲区在帧释放后放回队列
+        if (!processFrame(buf)) {
+            return stopOnCaptureError("无法将缓冲区放回队列");
         }
     }
+
+    return true;
 }
 
-void V4L2Camera::processFrame(const void* data, size_t size, const v4l2_buffer& buf) {
+bool V4L2Camera::stopOnCaptureError(const std::string& reason) {
+    // 在反应器线程中停止捕获：注销后处理函数不再被调用，isCapturing()随即返回false
+    LOG_ERROR(reason + "，停止捕获: " + device_path_, "V4L2Camera");
+    stopCapture();
+    return false;
+}
+
+bool V4L2Camera::processFrame(const v4l2_buffer& buf) {
+    size_t size = buf.bytesused;
+
     std::string debug_msg = "处理新帧:\n"
               "  - 缓冲区大小: " + std::to_string(size) + " 字节\n" +
               "  - 当前格式: " + std::to_string(static_cast<int>(current_params_.format)) + "\n" +
@@ -716,19 +1013,51 @@ void V4L2Camera::processFrame(const void* data, size_t size, const v4l2_buffer&
               "  - 时间戳: " + std::to_string(buf.timestamp.tv_sec) + "." + std::to_string(buf.timestamp.tv_usec);
     LOG_DEBUG(debug_msg, "V4L2Camera");
 
-    // 创建帧对象
+    // 创建帧对象：驱动中仍有足够的缓冲区时直接引用mmap缓冲区，否则复制后立即归还
     Frame frame;
-    frame.setWidth(current_params_.width);
-    frame.setHeight(current_params_.height);
-    frame.setFormat(current_params_.format);  // 使用当前设置的格式
+    if (buffer_pool_->queuedCount() >= kMinDriverBuffers) {
+        frame = Frame(current_params_.width, current_params_.height, current_params_.format,
+                      buffer_pool_->acquire(buf.index, size));
+    } else {
+        const uint8_t* data = buffer_pool_->data(buf.index);
+        frame = Frame(current_params_.width, current_params_.height, current_params_.format,
+                      std::vector<uint8_t>(data, data + size));
+        if (!buffer_pool_->requeue(buf.index)) {
+            return false;
+        }
+        starved_frames_++;
+        LOG_DEBUG("可用缓冲区不足，复制帧数据", "V4L2Camera");
+    }
     frame.setTimestamp(buf.timestamp.tv_sec * 1000000LL + buf.timestamp.tv_usec);
+    frame.setCameraId(camera_id_);
 
-    // 复制数据
-    frame.getData().resize(size);
-    std::memcpy(frame.getData().data(), data, size);
+    // 驱动帧序号不连续说明驱动在用户态取帧前已丢帧
+    if (last_sequence_ >= 0 && buf.sequence > static_cast<uint32_t>(last_sequence_) + 1) {
+        PipelineStats::getInstance().recordDriverDrops(camera_id_, buf.sequence - last_sequence_ - 1);
+    }
+    last_sequence_ = buf.sequence;
+
+    FrameLineage lineage;
+    lineage.sequence = buf.sequence;
+    lineage.dequeue_time_us = FrameLineage::nowUs();
+    // 只有单调时钟的驱动时间戳才能与其他阶段比较
+    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+        lineage.capture_time_us = buf.timestamp.tv_sec * 1000000ULL + buf.timestamp.tv_usec;
+    }
+    frame.setLineage(lineage);
+
+    // 出队间隔与驱动时间戳间隔之差即用户态取帧的抖动，与帧率波动无关
+    uint64_t driver_timestamp_us = buf.timestamp.tv_sec * 1000000ULL + buf.timestamp.tv_usec;
+    if (last_dequeue_us_ != 0 && driver_timestamp_us > last_driver_timestamp_us_) {
+        int64_t dequeue_interval = static_cast<int64_t>(lineage.dequeue_time_us - last_dequeue_us_);
+        int64_t driver_interval = static_cast<int64_t>(driver_timestamp_us - last_driver_timestamp_us_);
+        dequeue_jitter_us_.record(static_cast<uint64_t>(std::llabs(dequeue_interval - driver_interval)));
+    }
+    last_dequeue_us_ = lineage.dequeue_time_us;
+    last_driver_timestamp_us_ = driver_timestamp_us;
 
     std::string frame_info = "帧对象创建完成:\n" +
-              std::string("  - 帧大小: ") + std::to_string(frame.getData().size()) + " 字节\n" +
+              std::string("  - 帧大小: ") + std::to_string(frame.getDataSize()) + " 字节\n" +
               "  - 帧格式: " + std::to_string(static_cast<int>(frame.getFormat())) + "\n" +
               "  - 帧分辨率: " + std::to_string(frame.getWidth()) + "x" + std::to_string(frame.getHeight());
     LOG_DEBUG(frame_info, "V4L2Camera");
@@ -739,13 +1068,17 @@ void V4L2Camera::processFrame(const void* data, size_t size, const v4l2_buffer&
         frame_callback_(frame);
     }
 
-    // 将帧添加到队列
-    {
-        std::lock_guard<std::mutex> lock(frame_queue_mutex_);
-        frame_queue_.push(std::move(frame));
-        frame_queue_cond_.notify_one();
+    // 帧队列只服务getFrame/getLatestFrame，帧总线的订阅者不经过它。没有拉取方时不入队；
+    // 入队时复制数据，队列中的帧不会占用驱动缓冲区
+    uint64_t last_pull = last_pull_us_.load();
+    if (last_pull != 0 && FrameLineage::nowUs() - last_pull <= kPullConsumerWindowUs) {
+        if (frame.isShared()) {
+            frame.getData();
+        }
+        frame_mailbox_.push(std::move(frame));
+        LOG_DEBUG("帧已添加到队列", "V4L2Camera");
     }
-    LOG_DEBUG("帧已添加到队列", "V4L2Camera");
+    return true;
 }
 
 PixelFormat V4L2Camera::v4l2FormatToPixelFormat(uint32_t v4l2_format) const {
@@ -78,7 +78,7 @@ void print_usage(const char* program_name) {
               << "  -h, --help                 显示此帮助信息\n"
               << "  -c, --config <文件>        指定配置文件路径\n"
               << "  -v, --version              显示版本信息\n"
-              << "  -d, --device <设备路径>    指定摄像头设备\n"
+              << "  -d, --device <设备路径>    指定摄像头设备 (/dev/videoN、synthetic[:yuyv|nv12|mjpeg]、replay:<文件>)\n"
               << "  -r, --resolution <宽x高>   指定分辨率\n"
               << "  -f, --fps <帧率>           指定帧率\n"
               << "  -o, --output <目录>        指定输出目录\n"
@@ -632,8 +632,8 @@ int main(int argc, char* argv[]) {
         // 停止API服务器
         api::ApiServer::getInstance().stop();
 
-        // 关闭摄像头
-        camera::CameraManager::getInstance().closeDevice();
+        // 关闭所有摄像头
+        camera::CameraManager::getInstance().closeAllCameras();
 
         LOG_INFO("摄像头服务器已关闭", "Main");
         std::cout << "服务器已关闭" << std::endl;
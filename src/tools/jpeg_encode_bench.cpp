@@ -0,0 +1,188 @@
+/**
+ * @file jpeg_encode_bench.cpp
+ * @brief JPEG编码微基准：对比每帧新建编码器与JpegEncoderPool常驻编码器的单帧编码耗时
+ *
+ * 用法: jpeg_encode_bench [宽度] [高度] [格式(YUYV/NV12/YU12/RGB3/BGR3)] [质量] [帧数] [线程数]
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "camera/format_negotiator.h"
+#include "monitor/logger.h"
+#include "video/jpeg_encoder_pool.h"
+
+using namespace cam_server;
+
+namespace {
+
+struct BenchResult {
+    double avg_us = 0.0;
+    double p50_us = 0.0;
+    double p99_us = 0.0;
+    double fps = 0.0;
+    size_t failures = 0;
+};
+
+// 生成带渐变和移动方块的测试图像，避免纯色帧的编码耗时失真
+std::vector<uint8_t> makeTestImage(int width, int height, camera::PixelFormat format, int seed) {
+    std::vector<uint8_t> data;
+    switch (format) {
+        case camera::PixelFormat::YUYV:
+            data.resize(static_cast<size_t>(width) * height * 2);
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x += 2) {
+                    size_t offset = (static_cast<size_t>(y) * width + x) * 2;
+                    bool box = ((x + seed * 8) / 64 + y / 64) % 2 == 0;
+                    data[offset] = static_cast<uint8_t>((x + y + seed) & 0xFF);
+                    data[offset + 1] = box ? 90 : 160;
+                    data[offset + 2] = static_cast<uint8_t>((x + 1 + y + seed) & 0xFF);
+                    data[offset + 3] = box ? 200 : 110;
+                }
+            }
+            break;
+        case camera::PixelFormat::NV12:
+        case camera::PixelFormat::YUV420P: {
+            size_t luma = static_cast<size_t>(width) * height;
+            data.resize(luma * 3 / 2);
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    data[static_cast<size_t>(y) * width + x] = static_cast<uint8_t>((x + y + seed) & 0xFF);
+                }
+            }
+            for (size_t i = luma; i < data.size(); i++) {
+                data[i] = static_cast<uint8_t>(((i / 64) + seed) % 2 ? 90 : 170);
+            }
+            break;
+        }
+        default:
+            data.resize(static_cast<size_t>(width) * height * 3);
+            for (size_t i = 0; i < data.size(); i++) {
+                data[i] = static_cast<uint8_t>((i / 3 + i % 3 * 85 + seed) & 0xFF);
+            }
+            break;
+    }
+    return data;
+}
+
+template <typename EncodeFn>
+BenchResult run(const std::vector<camera::Frame>& frames, int total, int threads, EncodeFn encode) {
+    std::vector<std::vector<double>> samples(threads);
+    std::atomic<int> next{0};
+    std::atomic<size_t> failures{0};
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            std::vector<uint8_t> jpeg;
+            int i;
+            while ((i = next.fetch_add(1)) < total) {
+                auto begin = std::chrono::steady_clock::now();
+                if (!encode(frames[i % frames.size()], jpeg)) {
+                    failures++;
+                }
+                auto end = std::chrono::steady_clock::now();
+                samples[t].push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    for (const auto& s : samples) {
+        all.insert(all.end(), s.begin(), s.end());
+    }
+    BenchResult result;
+    if (all.empty()) {
+        return result;
+    }
+    std::sort(all.begin(), all.end());
+    double sum = 0.0;
+    for (double v : all) {
+        sum += v;
+    }
+    result.avg_us = sum / all.size();
+    result.p50_us = all[all.size() / 2];
+    result.p99_us = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+    result.fps = elapsed_s > 0 ? all.size() / elapsed_s : 0.0;
+    result.failures = failures;
+    return result;
+}
+
+void print(const std::string& name, const BenchResult& result) {
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << result.avg_us
+              << std::setw(10) << result.p50_us
+              << std::setw(10) << result.p99_us
+              << std::setw(10) << result.fps
+              << std::setw(8) << result.failures << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 1280;
+    int height = argc > 2 ? std::atoi(argv[2]) : 720;
+    camera::PixelFormat format = camera::FormatNegotiator::parseFormatSetting(argc > 3 ? argv[3] : "YUYV");
+    int quality = argc > 4 ? std::atoi(argv[4]) : 80;
+    int total = argc > 5 ? std::atoi(argv[5]) : 300;
+    int threads = argc > 6 ? std::max(1, std::atoi(argv[6])) : 1;
+
+    if (width <= 0 || height <= 0 || total <= 0 || !video::JpegEncoder::isSupported(format)) {
+        std::cerr << "用法: " << argv[0] << " [宽度] [高度] [格式(YUYV/NV12/YU12/RGB3/BGR3)] [质量] [帧数] [线程数]"
+                  << std::endl;
+        return 1;
+    }
+
+    monitor::LogConfig log_config;
+    log_config.min_level = monitor::LogLevel::WARNING;
+    log_config.console_output = true;
+    log_config.file_output = false;
+    monitor::Logger::getInstance().initialize(log_config);
+
+    std::vector<camera::Frame> frames;
+    for (int i = 0; i < 8; i++) {
+        frames.emplace_back(width, height, format, makeTestImage(width, height, format, i));
+    }
+
+    std::cout << "JPEG编码基准: " << width << "x" << height << " " << (argc > 3 ? argv[3] : "YUYV")
+              << ", 质量 " << quality << ", " << total << " 帧, " << threads << " 线程" << std::endl;
+    std::cout << std::left << std::setw(22) << "模式" << std::right
+              << std::setw(10) << "avg_us" << std::setw(10) << "p50_us" << std::setw(10) << "p99_us"
+              << std::setw(10) << "fps" << std::setw(8) << "fail" << std::endl;
+
+    // 旧实现：每帧查找编码器、打开上下文、创建转换上下文并在编码后全部释放
+    BenchResult per_frame = run(frames, total, threads,
+        [quality](const camera::Frame& frame, std::vector<uint8_t>& jpeg) {
+            video::JpegEncoder encoder;
+            return encoder.open(frame.getWidth(), frame.getHeight(), frame.getFormat(), quality) &&
+                   encoder.encode(frame.getDataPtr(), frame.getDataSize(), jpeg);
+        });
+    print("per-frame setup", per_frame);
+
+    auto& pool = video::JpegEncoderPool::getInstance();
+    BenchResult pooled = run(frames, total, threads,
+        [&pool, quality](const camera::Frame& frame, std::vector<uint8_t>& jpeg) {
+            return pool.encode(frame, quality, jpeg);
+        });
+    print("JpegEncoderPool", pooled);
+
+    auto stats = pool.getStats();
+    std::cout << "编码器池: 新建 " << stats.encoders_created << ", 空闲 " << stats.idle
+              << ", 编码 " << stats.encodes << std::endl;
+    if (pooled.avg_us > 0) {
+        std::cout << "单帧平均耗时降低 " << std::setprecision(1)
+                  << (1.0 - pooled.avg_us / per_frame.avg_us) * 100.0 << "%" << std::endl;
+    }
+    return per_frame.failures == 0 && pooled.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file stream_envelope_bench.cpp
+ * @brief 帧信封微基准：信封编码、解析的耗时，以及信封作为前缀发送与复制负载拼接整条消息的对比
+ *
+ * 用法: stream_envelope_bench [负载字节数] [次数]
+ */
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api/stream_envelope.h"
+
+using namespace cam_server;
+
+namespace {
+
+// 防止编译器把结果优化掉
+volatile size_t g_sink = 0;
+
+template <typename Fn>
+double run(int iterations, Fn fn) {
+    // 预热一轮，排除首次分配的影响
+    fn();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+void print(const std::string& name, double ns) {
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << ns << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t payload_size = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 100 * 1024;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 100000;
+    if (payload_size == 0 || iterations <= 0) {
+        std::cerr << "用法: " << argv[0] << " [负载字节数] [次数]" << std::endl;
+        return 1;
+    }
+
+    auto payload = std::make_shared<std::vector<uint8_t>>(payload_size);
+    for (size_t i = 0; i < payload_size; i++) {
+        (*payload)[i] = static_cast<uint8_t>(i * 31);
+    }
+
+    api::StreamEnvelope envelope;
+    envelope.codec = api::StreamCodec::JPEG;
+    envelope.flags = api::StreamEnvelope::FLAG_KEYFRAME;
+    envelope.capture_time_us = 123456789;
+    envelope.payload_size = static_cast<uint32_t>(payload_size);
+    envelope.camera_id = "/dev/video0";
+    envelope.tier = "half";
+
+    std::cout << "帧信封基准: 负载 " << payload_size << " 字节, " << iterations << " 次, 信封 "
+              << envelope.size() << " 字节 (" << std::setprecision(3)
+              << 100.0 * envelope.size() / payload_size << "%)" << std::endl;
+    std::cout << std::left << std::setw(22) << "模式" << std::right << std::setw(12) << "ns/op" << std::endl;
+
+    // 实际发送方式：信封作为前缀与WebSocket帧头放在一起，负载被所有连接引用
+    double prefix_ns = run(iterations, [&]() {
+        envelope.sequence++;
+        std::string prefix;
+        envelope.appendTo(prefix);
+        g_sink = g_sink + prefix.size();
+    });
+    print("encode prefix", prefix_ns);
+
+    // 对照：把信封和负载复制成一条完整消息
+    double copy_ns = run(iterations, [&]() {
+        envelope.sequence++;
+        std::string prefix;
+        envelope.appendTo(prefix);
+        auto message = std::make_shared<std::vector<uint8_t>>(prefix.size() + payload_size);
+        std::memcpy(message->data(), prefix.data(), prefix.size());
+        std::memcpy(message->data() + prefix.size(), payload->data(), payload_size);
+        g_sink = g_sink + message->size();
+    });
+    print("encode + copy", copy_ns);
+
+    std::string prefix;
+    envelope.appendTo(prefix);
+    std::vector<uint8_t> message(prefix.begin(), prefix.end());
+    message.insert(message.end(), payload->begin(), payload->end());
+    bool parsed_ok = true;
+    double parse_ns = run(iterations, [&]() {
+        api::StreamEnvelope parsed;
+        size_t header_size = 0;
+        parsed_ok = parsed_ok && api::StreamEnvelope::parse(message.data(), message.size(), parsed, header_size);
+        g_sink = g_sink + header_size + parsed.sequence;
+    });
+    print("parse", parse_ns);
+
+    api::StreamEnvelope parsed;
+    size_t header_size = 0;
+    bool round_trip = api::StreamEnvelope::parse(message.data(), message.size(), parsed, header_size) &&
+                      header_size == prefix.size() && parsed.sequence == envelope.sequence &&
+                      parsed.capture_time_us == envelope.capture_time_us && parsed.camera_id == envelope.camera_id &&
+                      parsed.tier == envelope.tier && parsed.codec == envelope.codec &&
+                      std::memcmp(message.data() + header_size, payload->data(), payload_size) == 0;
+    std::cout << "前缀发送比复制整条消息每帧节省 " << std::setprecision(1) << copy_ns - prefix_ns << " ns"
+              << ", 往返校验" << (round_trip && parsed_ok ? "通过" : "失败") << std::endl;
+    return round_trip && parsed_ok ? 0 : 1;
+}
@@ -143,7 +143,43 @@ bool ConfigManager::loadConfigInternal(const std::string& config_file) {
     config_data_["camera.device"] = std::string("/dev/video0");
     config_data_["camera.resolution"] = std::string("640x480");
     config_data_["camera.fps"] = 30;
-    config_data_["camera.format"] = std::string("MJPG");
+    config_data_["camera.format"] = std::string("auto");  // auto表示按订阅者需求协商
+    config_data_["camera.frame_queue_depth"] = 2;
+    config_data_["camera.frame_queue_policy"] = std::string("drop_oldest");
+    config_data_["camera.capture_threads"] = 1;
+    config_data_["camera.capture_sched_policy"] = std::string("other");  // other或fifo
+    config_data_["camera.capture_priority"] = 10;
+    config_data_["camera.capture_nice"] = 0;
+    config_data_["camera.capture_cpus"] = std::string("");  // 如"4-7"，为空时不限制
+    config_data_["camera.buffer_count"] = 0;  // 0表示自动调整
+    config_data_["camera.buffer_count_min"] = 3;
+    config_data_["camera.buffer_count_max"] = 12;
+    config_data_["camera.replay_loop"] = true;
+
+    // 流配置：分辨率阶梯，"名称:缩放或宽x高:质量"，第一个为默认档位
+    config_data_["stream.ladder"] = std::string("full:1:80,half:0.5:70,quarter:0.25:60");
+    // 按客户端链路状况自动降档和抽帧，档位上限为客户端选择的档位
+    config_data_["stream.adaptive"] = true;
+    config_data_["stream.adaptive_min_fps"] = 2.0;
+    config_data_["stream.adaptive_max_latency_ms"] = 250.0;
+    // /ws/camera的H.264流：每个摄像头编码一路，编码器为空时自动选择，码率0表示按分辨率估算
+    config_data_["stream.h264"] = true;
+    config_data_["stream.h264_encoder"] = std::string("");
+    config_data_["stream.h264_bitrate"] = 0;
+    config_data_["stream.h264_gop"] = 60;
+    // /ws/camera的瓦片增量流：只发送变化的瓦片，阈值为瓦片内平均亮度差，刷新间隔0表示不定期发全帧
+    config_data_["stream.tiles"] = true;
+    config_data_["stream.tile_size"] = 64;
+    config_data_["stream.tile_quality"] = 70;
+    config_data_["stream.tile_threshold"] = 3.0;
+    config_data_["stream.tile_refresh_ms"] = 10000;
+    // 新观看者立即收到保存的最新一帧；档位无人观看后保持编码器和最新帧的时间，及期间的刷新间隔
+    config_data_["stream.warm_grace_ms"] = 30000;
+    config_data_["stream.warm_refresh_ms"] = 500;
+    // 独立端口上的epoll MJPEG推流引擎，GET /mjpeg?camera_id=&client_id=&tier=，端口0表示不启用
+    config_data_["stream.mjpeg_port"] = 8082;
+    config_data_["stream.mjpeg_threads"] = 2;
+    config_data_["stream.mjpeg_max_connections"] = 512;
 
     // 存储配置
     config_data_["storage.video_dir"] = std::string("data/videos");
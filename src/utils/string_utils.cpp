@@ -1,6 +1,7 @@
 #include "utils/string_utils.h"
 #include <random>
 #include <ctime>
+#include <cstdio>
 #include <cstdlib>
 #include <regex>
 
@@ -157,6 +158,33 @@ std::string StringUtils::toHex(const std::string& str) {
     return ss.str();
 }
 
+std::string StringUtils::escapeJson(const std::string& str) {
+    std::string result;
+    result.reserve(str.size());
+
+    for (unsigned char c : str) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\b': result += "\\b"; break;
+            case '\f': result += "\\f"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    result += buf;
+                } else {
+                    result += static_cast<char>(c);
+                }
+        }
+    }
+
+    return result;
+}
+
 std::string StringUtils::fromHex(const std::string& hex) {
     if (hex.length() % 2 != 0) {
         return "";
@@ -0,0 +1,163 @@
+#include "video/encoded_frame_cache.h"
+#include "video/jpeg_encoder_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace cam_server {
+namespace video {
+
+namespace {
+
+// 每个摄像头保留的帧数，慢一帧的使用者仍能命中
+constexpr size_t kFramesPerCamera = 2;
+
+} // namespace
+
+EncodedFrameCache& EncodedFrameCache::getInstance() {
+    static EncodedFrameCache instance;
+    return instance;
+}
+
+JpegBuffer EncodedFrameCache::getJpeg(const camera::Frame& frame, int quality, int width, int height) {
+    if (frame.isEmpty()) {
+        return nullptr;
+    }
+
+    quality = std::max(1, std::min(100, quality));
+    if (width <= 0 || height <= 0 || (width == frame.getWidth() && height == frame.getHeight())) {
+        width = 0;
+        height = 0;
+    }
+    bool decode_mjpeg = frame.getFormat() == camera::PixelFormat::MJPEG && width > 0;
+    if (frame.getFormat() == camera::PixelFormat::MJPEG && !decode_mjpeg) {
+        quality = 0;  // 原尺寸直接转发，与质量无关
+    }
+
+    const camera::FrameLineage& lineage = frame.getLineage();
+    if (lineage.sequence == 0 && lineage.capture_time_us == 0) {
+        // 没有序号信息的帧无法判断是否为同一帧
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.uncached++;
+        }
+        return encode(frame, quality, width, height);
+    }
+
+    std::promise<JpegBuffer> promise;
+    std::shared_future<JpegBuffer> pending;
+    std::promise<std::shared_ptr<const camera::Frame>> decode_promise;
+    std::shared_future<std::shared_ptr<const camera::Frame>> decoded;
+    bool decode_owner = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& frames = cameras_[frame.getCameraId()];
+
+        auto frame_it = std::find_if(frames.begin(), frames.end(), [&lineage](const CachedFrame& cached) {
+            return cached.sequence == lineage.sequence && cached.capture_time_us == lineage.capture_time_us;
+        });
+        if (frame_it == frames.end()) {
+            frames.push_back(CachedFrame{lineage.sequence, lineage.capture_time_us, {}, {}});
+            while (frames.size() > kFramesPerCamera) {
+                frames.pop_front();
+            }
+            frame_it = std::prev(frames.end());
+        }
+
+        auto variant_it = std::find_if(frame_it->variants.begin(), frame_it->variants.end(),
+                                       [&](const Variant& variant) {
+            return variant.width == width && variant.height == height && variant.quality == quality;
+        });
+        if (variant_it != frame_it->variants.end()) {
+            pending = variant_it->jpeg;
+            bool ready = pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            if (ready) {
+                stats_.hits++;
+            } else {
+                stats_.waits++;
+            }
+        } else {
+            frame_it->variants.push_back(Variant{width, height, quality, promise.get_future().share()});
+            if (decode_mjpeg) {
+                // 同一MJPEG帧的各个缩小变体只解码一次
+                if (!frame_it->decoded.valid()) {
+                    frame_it->decoded = decode_promise.get_future().share();
+                    decode_owner = true;
+                }
+                decoded = frame_it->decoded;
+            }
+        }
+    }
+
+    if (pending.valid()) {
+        return pending.get();
+    }
+
+    if (decode_owner) {
+        decode_promise.set_value(decode(frame));
+    }
+
+    // 由第一个请求者在锁外编码，结果通过future交给其他请求者
+    JpegBuffer jpeg = encode(frame, quality, width, height, decoded);
+    promise.set_value(jpeg);
+    return jpeg;
+}
+
+std::shared_ptr<const camera::Frame> EncodedFrameCache::decode(const camera::Frame& frame) {
+    auto raw = std::make_shared<camera::Frame>();
+    bool success = JpegEncoderPool::getInstance().decode(frame, *raw);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!success) {
+        stats_.failures++;
+        return nullptr;
+    }
+    stats_.decodes++;
+    return raw;
+}
+
+JpegBuffer EncodedFrameCache::encode(const camera::Frame& frame, int quality, int width, int height,
+                                     std::shared_future<std::shared_ptr<const camera::Frame>> decoded) {
+    if (frame.getFormat() == camera::PixelFormat::MJPEG && width > 0) {
+        std::shared_ptr<const camera::Frame> raw = decoded.valid() ? decoded.get() : decode(frame);
+        return raw ? encode(*raw, quality, width, height) : nullptr;
+    }
+
+    if (frame.getFormat() == camera::PixelFormat::MJPEG) {
+        auto jpeg = std::make_shared<const std::vector<uint8_t>>(frame.getDataPtr(),
+                                                                 frame.getDataPtr() + frame.getDataSize());
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.passthrough++;
+        return jpeg;
+    }
+
+    auto jpeg = std::make_shared<std::vector<uint8_t>>();
+    bool success = JpegEncoderPool::getInstance().encode(frame, quality, *jpeg, width, height);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!success || jpeg->empty()) {
+        stats_.failures++;
+        return nullptr;
+    }
+    stats_.encodes++;
+    return jpeg;
+}
+
+void EncodedFrameCache::clear(const std::string& camera_id) {
+    std::deque<CachedFrame> frames;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = cameras_.find(camera_id);
+    if (it != cameras_.end()) {
+        frames.swap(it->second);
+        cameras_.erase(it);
+    }
+}
+
+EncodedFrameCacheStats EncodedFrameCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+} // namespace video
+} // namespace cam_server
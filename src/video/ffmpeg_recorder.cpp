@@ -1,4 +1,5 @@
 #include "video/ffmpeg_recorder.h"
+#include "video/jpeg_encoder_pool.h"
 #include "utils/file_utils.h"
 #include "utils/string_utils.h"
 #include "monitor/logger.h"
@@ -11,7 +12,13 @@ extern "C" {
 #include <libswscale/swscale.h>
 }
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <limits>
 #include <thread>
 #include <filesystem>
 
@@ -20,17 +27,96 @@ namespace fs = std::filesystem;
 namespace cam_server {
 namespace video {
 
+namespace {
+
+// 编码器可能在编码期间持有帧的引用，池中保留几帧轮换使用
+constexpr size_t kFramePoolSize = 4;
+
+// 索引项的最小间隔（微秒）。MJPEG直接封装时每帧都是关键帧，每秒最多记一项，
+// 定位时最多多解码一秒的帧
+constexpr int64_t kIndexMinIntervalUs = 1000000;
+
+std::string errorString(int err) {
+    char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(err, err_buf, AV_ERROR_MAX_STRING_SIZE);
+    return err_buf;
+}
+
+AVPixelFormat toAVPixelFormat(camera::PixelFormat format) {
+    switch (format) {
+        case camera::PixelFormat::YUYV:
+            return AV_PIX_FMT_YUYV422;
+        case camera::PixelFormat::NV12:
+            return AV_PIX_FMT_NV12;
+        case camera::PixelFormat::YUV420P:
+            return AV_PIX_FMT_YUV420P;
+        case camera::PixelFormat::RGB24:
+            return AV_PIX_FMT_RGB24;
+        case camera::PixelFormat::BGR24:
+            return AV_PIX_FMT_BGR24;
+        default:
+            return AV_PIX_FMT_NONE;
+    }
+}
+
+// 编码器优先选择的像素格式
+AVPixelFormat chooseInputFormat(const AVCodec* codec) {
+    if (!codec->pix_fmts) {
+        return AV_PIX_FMT_YUV420P;
+    }
+    for (const AVPixelFormat* fmt = codec->pix_fmts; *fmt != AV_PIX_FMT_NONE; ++fmt) {
+        if (*fmt == AV_PIX_FMT_YUV420P) {
+            return *fmt;
+        }
+    }
+    return codec->pix_fmts[0];
+}
+
+// 帧的采集时间（微秒），驱动没有给出时返回0
+int64_t captureTimeUs(const camera::Frame& frame) {
+    uint64_t timestamp = frame.getLineage().capture_time_us;
+    if (timestamp == 0) {
+        timestamp = frame.getMetadata().timestamp;
+    }
+    return static_cast<int64_t>(timestamp);
+}
+
+} // namespace
+
 FFmpegRecorder::FFmpegRecorder()
     : is_initialized_(false),
       start_time_(0),
-      last_frame_timestamp_(0),
       segment_index_(0),
       format_context_(nullptr),
       codec_context_(nullptr),
       video_stream_(nullptr),
-      frame_(nullptr),
+      stream_params_(nullptr),
       packet_(nullptr),
-      sws_context_(nullptr) {
+      sws_context_(nullptr),
+      next_pool_frame_(0),
+      time_base_den_(1),
+      dropping_to_keyframe_(false),
+      start_requested_(false),
+      start_result_(0),
+      segment_running_(false),
+      prepare_index_(-1),
+      preparing_(false),
+      next_output_(nullptr),
+      next_output_index_(0),
+      pipeline_running_(false),
+      encoder_done_(true),
+      force_keyframe_(false),
+      resume_pending_(false),
+      pre_roll_armed_(false),
+      next_cut_pts_(std::numeric_limits<int64_t>::max()),
+      base_wall_us_(0),
+      base_capture_us_(-1),
+      last_pts_(-1),
+      last_capture_us_(0),
+      segment_start_pts_(-1),
+      pts_offset_(AV_NOPTS_VALUE),
+      index_after_write_(false),
+      last_index_us_(-1) {
 
     // 初始化状态
     status_.state = RecordingState::IDLE;
@@ -47,12 +133,12 @@ FFmpegRecorder::~FFmpegRecorder() {
 }
 
 bool FFmpegRecorder::initialize(const RecordingConfig& config) {
-    std::lock_guard<std::mutex> lock(status_mutex_);
+    std::lock_guard<std::mutex> control(control_mutex_);
 
     // 检查状态
-    if (status_.state != RecordingState::IDLE) {
-        stopRecording();
-    }
+    finishRecording();
+
+    std::lock_guard<std::mutex> lock(status_mutex_);
 
     // 保存配置
     config_ = config;
@@ -74,13 +160,16 @@ bool FFmpegRecorder::initialize(const RecordingConfig& config) {
         return false;
     }
 
+    status_.state = RecordingState::IDLE;
+    status_.error_message = "";
     is_initialized_ = true;
     LOG_INFO("视频录制器初始化成功", "FFmpegRecorder");
     return true;
 }
 
 bool FFmpegRecorder::startRecording() {
-    std::lock_guard<std::mutex> lock(status_mutex_);
+    std::lock_guard<std::mutex> control(control_mutex_);
+    std::unique_lock<std::mutex> lock(status_mutex_);
 
     // 检查是否已初始化
     if (!is_initialized_) {
@@ -95,181 +184,369 @@ bool FFmpegRecorder::startRecording() {
         return true;  // 已经在录制中
     }
 
-    // 生成输出文件名
-    if (config_.output_path.empty()) {
+    // 生成输出文件名，输出路径为目录时在其中生成
+    if (config_.output_path.empty() || fs::is_directory(config_.output_path)) {
         config_.output_path = generateFileName();
     }
 
-    // 创建输出格式上下文
-    if (!createOutputFormatContext()) {
-        status_.error_message = "创建输出格式上下文失败";
+    // 更新状态
+    status_.current_file = config_.output_path;
+    status_.duration = 0.0;
+    status_.frame_count = 0;
+    status_.file_size = 0;
+    status_.error_message = "";
+
+    // 记录开始时间
+    start_time_ = av_gettime();
+    segment_index_ = 0;
+    segment_base_path_ = config_.output_path;
+    std::string output_path = config_.output_path;
+
+    if (pre_roll_armed_) {
+        lock.unlock();
+
+        // 流水线已在运行，由写文件线程打开文件并先写入预录缓冲
+        bool opened = false;
+        {
+            std::unique_lock<std::mutex> write_lock(write_mutex_);
+            if (start_result_ == 0) {
+                start_requested_ = true;
+                write_cv_.notify_all();
+                start_cv_.wait(write_lock, [this]() { return start_result_ != 0; });
+                opened = start_result_ > 0;
+            }
+        }
+        if (!opened) {
+            finishRecording();
+            return false;
+        }
+
+        LOG_INFO("开始录制视频（含预录）: " + output_path, "FFmpegRecorder");
+        return true;
+    }
+
+    if (!initFFmpeg()) {
+        status_.error_message = "初始化FFmpeg失败";
         status_.state = RecordingState::ERROR;
         LOG_ERROR(status_.error_message, "FFmpegRecorder");
         return false;
     }
 
-    // 创建视频流
-    if (!createVideoStream()) {
-        status_.error_message = "创建视频流失败";
+    // 打开编码器，直通模式不需要编码器
+    if (config_.mode == RecordingMode::STREAM_COPY) {
+        time_base_den_ = 1000000;
+    } else if (openEncoder()) {
+        time_base_den_ = codec_context_->time_base.den;
+    } else {
+        status_.error_message = "打开编码器失败";
         status_.state = RecordingState::ERROR;
         LOG_ERROR(status_.error_message, "FFmpegRecorder");
         cleanupFFmpeg();
         return false;
     }
 
-    // 打开编码器
-    if (!openEncoder()) {
-        status_.error_message = "打开编码器失败";
+    // 创建视频流参数
+    if (!initStreamParams()) {
+        status_.error_message = "创建视频流失败";
         status_.state = RecordingState::ERROR;
         LOG_ERROR(status_.error_message, "FFmpegRecorder");
         cleanupFFmpeg();
         return false;
     }
 
-    // 写入文件头
-    if (!writeHeader()) {
-        status_.error_message = "写入文件头失败";
+    // 打开输出文件并写入文件头
+    format_context_ = openOutput(output_path);
+    if (!format_context_) {
+        status_.error_message = "打开录制文件失败";
         status_.state = RecordingState::ERROR;
         LOG_ERROR(status_.error_message, "FFmpegRecorder");
         cleanupFFmpeg();
         return false;
     }
+    video_stream_ = format_context_->streams[0];
 
-    // 更新状态
     status_.state = RecordingState::RECORDING;
-    status_.current_file = config_.output_path;
-    status_.duration = 0.0;
-    status_.frame_count = 0;
-    status_.file_size = 0;
-    status_.error_message = "";
+    encode_counters_ = StageCounters();
+    write_counters_ = StageCounters();
+    lock.unlock();
 
-    // 记录开始时间
-    start_time_ = av_gettime();
-    last_frame_timestamp_ = start_time_;
+    // 启动编码、写文件和分段线程，分段线程随即提前打开第二个分段
+    requestNextSegment();
+    startPipeline();
 
     // 调用状态回调
-    if (status_callback_) {
-        status_callback_(status_);
-    }
+    notifyStatus();
 
-    LOG_INFO("开始录制视频: " + config_.output_path, "FFmpegRecorder");
+    LOG_INFO("开始录制视频: " + output_path, "FFmpegRecorder");
     return true;
 }
 
-bool FFmpegRecorder::stopRecording() {
-    std::lock_guard<std::mutex> lock(status_mutex_);
+bool FFmpegRecorder::armPreRoll() {
+    std::lock_guard<std::mutex> control(control_mutex_);
+    std::unique_lock<std::mutex> lock(status_mutex_);
 
     // 检查状态
-    if (status_.state != RecordingState::RECORDING && status_.state != RecordingState::PAUSED) {
-        return true;  // 没有在录制
+    if (pre_roll_armed_) {
+        return true;  // 已经在预录中
+    }
+    if (!is_initialized_ || status_.state == RecordingState::RECORDING || status_.state == RecordingState::PAUSED) {
+        LOG_ERROR("录制器未初始化或正在录制，无法开始预录", "FFmpegRecorder");
+        return false;
+    }
+    if (config_.pre_roll_seconds <= 0 || config_.pre_roll_max_bytes == 0) {
+        LOG_ERROR("未配置预录时长或内存预算", "FFmpegRecorder");
+        return false;
     }
 
-    // 写入文件尾
-    if (format_context_) {
-        writeTrailer();
+    // 打开编码器，直通模式不需要编码器
+    if (!initFFmpeg()) {
+        return false;
+    }
+    if (config_.mode == RecordingMode::STREAM_COPY) {
+        time_base_den_ = 1000000;
+    } else if (openEncoder()) {
+        time_base_den_ = codec_context_->time_base.den;
+    } else {
+        LOG_ERROR("打开编码器失败，无法开始预录", "FFmpegRecorder");
+        cleanupFFmpeg();
+        return false;
+    }
+    if (!initStreamParams()) {
+        LOG_ERROR("创建视频流失败，无法开始预录", "FFmpegRecorder");
+        cleanupFFmpeg();
+        return false;
     }
 
-    // 清理FFmpeg资源
-    cleanupFFmpeg();
+    // 缓冲区一次分配，包索引按帧率留出一个GOP的余量
+    int fps = std::max(1, config_.fps);
+    size_t max_packets = static_cast<size_t>(config_.pre_roll_seconds) * fps + std::max(config_.gop, fps) * 2;
+    pre_roll_.configure(config_.pre_roll_max_bytes, static_cast<int64_t>(config_.pre_roll_seconds) * 1000000,
+                        max_packets);
 
     // 更新状态
     status_.state = RecordingState::IDLE;
+    status_.error_message = "";
+    status_.pre_roll_armed = true;
+    status_.pre_roll_duration = 0.0;
+    status_.pre_roll_bytes = 0;
+    encode_counters_ = StageCounters();
+    write_counters_ = StageCounters();
+    pre_roll_armed_ = true;
+    lock.unlock();
+
+    // 启动编码和写文件线程
+    startPipeline();
 
     // 调用状态回调
-    if (status_callback_) {
-        status_callback_(status_);
+    notifyStatus();
+
+    LOG_INFO("开始预录: " + std::to_string(config_.pre_roll_seconds) + "秒, 内存预算 " +
+             std::to_string(config_.pre_roll_max_bytes / 1024) + "KB", "FFmpegRecorder");
+    return true;
+}
+
+void FFmpegRecorder::startPipeline() {
+    base_capture_us_ = -1;
+    last_pts_ = -1;
+    last_capture_us_ = 0;
+    segment_start_pts_ = -1;
+    pts_offset_ = AV_NOPTS_VALUE;
+    dropping_to_keyframe_ = false;
+    start_requested_ = false;
+    start_result_ = 0;
+    force_keyframe_ = false;
+    resume_pending_ = false;
+    next_cut_pts_ = std::numeric_limits<int64_t>::max();
+    encoder_done_ = false;
+    pipeline_running_ = true;
+    {
+        std::lock_guard<std::mutex> lock(segment_mutex_);
+        segment_running_ = true;
+        preparing_ = false;
     }
+    segment_thread_ = std::thread(&FFmpegRecorder::segmentLoop, this);
+    encode_thread_ = std::thread(&FFmpegRecorder::encodeLoop, this);
+    write_thread_ = std::thread(&FFmpegRecorder::writeLoop, this);
+}
+
+bool FFmpegRecorder::stopRecording() {
+    std::lock_guard<std::mutex> control(control_mutex_);
+    return finishRecording();
+}
+
+bool FFmpegRecorder::finishRecording() {
+    RecordingState state;
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        state = status_.state;
+    }
+
+    // 检查状态，出错或预录时流水线线程可能还在运行
+    bool running = encode_thread_.joinable() || write_thread_.joinable() || segment_thread_.joinable();
+    if (state != RecordingState::RECORDING && state != RecordingState::PAUSED && !running) {
+        return true;  // 没有在录制
+    }
+
+    // 编码并写完已排队的帧，出错时直接丢弃
+    stopPipeline(state != RecordingState::ERROR);
+
+    // 先收尾之前的分段，再写入当前文件的文件尾，返回时所有文件都已落盘
+    stopSegmentThread();
+    finalizeOutput(format_context_);
+    video_stream_ = nullptr;
+    index_writer_.close();
+
+    // 清理FFmpeg资源
+    cleanupFFmpeg();
+    pre_roll_.clear();
+    pre_roll_armed_ = false;
+
+    // 更新状态，保留错误状态供调用方查询
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        if (status_.state != RecordingState::ERROR) {
+            status_.state = RecordingState::IDLE;
+        }
+        status_.pre_roll_armed = false;
+        status_.pre_roll_duration = 0.0;
+        status_.pre_roll_bytes = 0;
+    }
+
+    // 调用状态回调
+    notifyStatus();
 
     LOG_INFO("停止录制视频", "FFmpegRecorder");
     return true;
 }
 
 bool FFmpegRecorder::pauseRecording() {
-    std::lock_guard<std::mutex> lock(status_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
 
-    // 检查状态
-    if (status_.state != RecordingState::RECORDING) {
-        return false;  // 没有在录制
-    }
+        // 检查状态
+        if (status_.state != RecordingState::RECORDING) {
+            return false;  // 没有在录制
+        }
 
-    // 更新状态
-    status_.state = RecordingState::PAUSED;
+        // 更新状态
+        status_.state = RecordingState::PAUSED;
+    }
 
     // 调用状态回调
-    if (status_callback_) {
-        status_callback_(status_);
-    }
+    notifyStatus();
 
     LOG_INFO("暂停录制视频", "FFmpegRecorder");
     return true;
 }
 
 bool FFmpegRecorder::resumeRecording() {
-    std::lock_guard<std::mutex> lock(status_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
 
-    // 检查状态
-    if (status_.state != RecordingState::PAUSED) {
-        return false;  // 没有在暂停
-    }
+        // 检查状态
+        if (status_.state != RecordingState::PAUSED) {
+            return false;  // 没有在暂停
+        }
 
-    // 更新状态
-    status_.state = RecordingState::RECORDING;
+        // 暂停期间的时间不计入录像时间轴
+        resume_pending_ = true;
+        status_.state = RecordingState::RECORDING;
+    }
 
     // 调用状态回调
-    if (status_callback_) {
-        status_callback_(status_);
-    }
+    notifyStatus();
 
     LOG_INFO("恢复录制视频", "FFmpegRecorder");
     return true;
 }
 
 bool FFmpegRecorder::processFrame(const camera::Frame& frame) {
-    std::lock_guard<std::mutex> lock(status_mutex_);
-
-    // 检查状态
-    if (status_.state != RecordingState::RECORDING) {
-        return false;  // 没有在录制
-    }
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
 
-    // 检查是否需要分段
-    if (checkSegmentation()) {
-        if (!createNewSegment()) {
-            status_.error_message = "创建新分段失败";
-            status_.state = RecordingState::ERROR;
-            LOG_ERROR(status_.error_message, "FFmpegRecorder");
-            return false;
+        // 检查状态，预录时同样接收帧
+        if (status_.state != RecordingState::RECORDING && !pre_roll_armed_) {
+            return false;  // 没有在录制
         }
     }
-
-    // 编码并写入帧
-    if (!encodeAndWriteFrame(frame)) {
-        status_.error_message = "编码帧失败";
-        status_.state = RecordingState::ERROR;
-        LOG_ERROR(status_.error_message, "FFmpegRecorder");
+    if (!frame.isValid()) {
         return false;
     }
 
-    // 更新状态
-    status_.frame_count++;
-    status_.duration = (av_gettime() - start_time_) / 1000000.0;
-
-    // 更新文件大小
-    if (!status_.current_file.empty()) {
-        status_.file_size = utils::FileUtils::getFileSize(status_.current_file);
+    // 复制到回收的缓冲区：不占用驱动的mmap缓冲区，也不必每帧分配内存
+    std::vector<uint8_t> buffer;
+    {
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        if (!free_buffers_.empty()) {
+            buffer = std::move(free_buffers_.back());
+            free_buffers_.pop_back();
+        }
     }
-
-    // 调用状态回调
-    if (status_callback_) {
-        status_callback_(status_);
+    buffer.assign(frame.getDataPtr(), frame.getDataPtr() + frame.getDataSize());
+    QueuedFrame queued{camera::Frame(frame.getWidth(), frame.getHeight(), frame.getFormat(), std::move(buffer)),
+                       av_gettime_relative()};
+    queued.frame.setMetadata(frame.getMetadata());
+    queued.frame.setLineage(frame.getLineage());
+    queued.frame.setCameraId(frame.getCameraId());
+
+    // 队列满时按策略丢帧，调用线程从不等待编码
+    bool accepted = true;
+    bool dropped_oldest = false;
+    {
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        if (!pipeline_running_) {
+            return false;
+        }
+        size_t capacity = static_cast<size_t>(std::max(1, config_.input_queue_depth));
+        if (input_queue_.size() >= capacity) {
+            if (config_.drop_policy == RecordingDropPolicy::DROP_NEWEST) {
+                free_buffers_.push_back(std::move(queued.frame.getData()));
+                accepted = false;
+            } else {
+                free_buffers_.push_back(std::move(input_queue_.front().frame.getData()));
+                input_queue_.pop_front();
+                dropped_oldest = true;
+            }
+        }
+        if (accepted) {
+            input_queue_.push_back(std::move(queued));
+        }
     }
+    input_cv_.notify_one();
 
-    return true;
+    if (!accepted || dropped_oldest) {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        encode_counters_.dropped++;
+    }
+    return accepted;
 }
 
 RecordingStatus FFmpegRecorder::getStatus() const {
+    // 先分别读取队列深度，避免同时持有多把锁
+    size_t input_depth = 0;
+    size_t write_depth = 0;
+    {
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        input_depth = input_queue_.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        write_depth = write_queue_.size();
+    }
+
     std::lock_guard<std::mutex> lock(status_mutex_);
-    return status_;
+    RecordingStatus status = status_;
+    auto fill = [](RecordingStageStats& stats, const StageCounters& counters, size_t depth, int capacity) {
+        stats.queue_depth = depth;
+        stats.queue_capacity = static_cast<size_t>(std::max(1, capacity));
+        stats.processed = counters.processed;
+        stats.dropped = counters.dropped;
+        stats.avg_latency_ms = counters.processed > 0 ? counters.total_latency_ms / counters.processed : 0.0;
+        stats.max_latency_ms = counters.max_latency_ms;
+    };
+    fill(status.encode_stage, encode_counters_, input_depth, config_.input_queue_depth);
+    fill(status.write_stage, write_counters_, write_depth, config_.write_queue_depth);
+    return status;
 }
 
 void FFmpegRecorder::setStatusCallback(std::function<void(const RecordingStatus&)> callback) {
@@ -278,6 +555,7 @@ void FFmpegRecorder::setStatusCallback(std::function<void(const RecordingStatus&
 }
 
 bool FFmpegRecorder::setConfig(const RecordingConfig& config) {
+    std::lock_guard<std::mutex> control(control_mutex_);
     std::lock_guard<std::mutex> lock(status_mutex_);
 
     // 检查状态
@@ -286,6 +564,14 @@ bool FFmpegRecorder::setConfig(const RecordingConfig& config) {
         return false;
     }
 
+    // 预录中编码参数已经生效，只更新输出路径和分段设置
+    if (pre_roll_armed_) {
+        config_.output_path = config.output_path;
+        config_.max_duration = config.max_duration;
+        config_.max_size = config.max_size;
+        return true;
+    }
+
     config_ = config;
     return true;
 }
@@ -296,19 +582,13 @@ RecordingConfig FFmpegRecorder::getConfig() const {
 }
 
 bool FFmpegRecorder::initFFmpeg() {
-    // 分配AVFrame
-    frame_ = av_frame_alloc();
-    if (!frame_) {
-        LOG_ERROR("无法分配AVFrame", "FFmpegRecorder");
-        return false;
-    }
-
-    // 分配AVPacket
-    packet_ = av_packet_alloc();
+    // 分配AVPacket，编码器输出的包移交给写入队列后复用
     if (!packet_) {
-        LOG_ERROR("无法分配AVPacket", "FFmpegRecorder");
-        av_frame_free(&frame_);
-        return false;
+        packet_ = av_packet_alloc();
+        if (!packet_) {
+            LOG_ERROR("无法分配AVPacket", "FFmpegRecorder");
+            return false;
+        }
     }
 
     return true;
@@ -321,11 +601,12 @@ void FFmpegRecorder::cleanupFFmpeg() {
         sws_context_ = nullptr;
     }
 
-    // 释放AVFrame
-    if (frame_) {
-        av_frame_free(&frame_);
-        frame_ = nullptr;
+    // 释放帧池
+    for (AVFrame*& frame : frame_pool_) {
+        av_frame_free(&frame);
     }
+    frame_pool_.clear();
+    next_pool_frame_ = 0;
 
     // 释放AVPacket
     if (packet_) {
@@ -339,80 +620,50 @@ void FFmpegRecorder::cleanupFFmpeg() {
         codec_context_ = nullptr;
     }
 
-    // 关闭输出格式上下文
-    if (format_context_) {
-        if (!(format_context_->oformat->flags & AVFMT_NOFILE)) {
-            avio_closep(&format_context_->pb);
-        }
-        avformat_free_context(format_context_);
-        format_context_ = nullptr;
+    // 释放视频流参数
+    if (stream_params_) {
+        avcodec_parameters_free(&stream_params_);
+        stream_params_ = nullptr;
     }
 
+    // 关闭输出格式上下文
+    closeOutput(format_context_);
     video_stream_ = nullptr;
 }
 
-bool FFmpegRecorder::createOutputFormatContext() {
-    // 猜测输出格式
-    const char* format_name = nullptr;
-    if (!config_.container_format.empty()) {
-        format_name = config_.container_format.c_str();
+void FFmpegRecorder::closeOutput(AVFormatContext*& context) {
+    if (!context) {
+        return;
     }
-
-    // 创建输出格式上下文
-    int ret = avformat_alloc_output_context2(&format_context_, nullptr, format_name, config_.output_path.c_str());
-    if (ret < 0 || !format_context_) {
-        char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, err_buf, AV_ERROR_MAX_STRING_SIZE);
-        LOG_ERROR("无法创建输出格式上下文: " + std::string(err_buf), "FFmpegRecorder");
-        return false;
-    }
-
-    // 打开输出文件
-    if (!(format_context_->oformat->flags & AVFMT_NOFILE)) {
-        ret = avio_open(&format_context_->pb, config_.output_path.c_str(), AVIO_FLAG_WRITE);
-        if (ret < 0) {
-            char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
-            av_strerror(ret, err_buf, AV_ERROR_MAX_STRING_SIZE);
-            LOG_ERROR("无法打开输出文件: " + std::string(err_buf), "FFmpegRecorder");
-            avformat_free_context(format_context_);
-            format_context_ = nullptr;
-            return false;
-        }
+    if (!(context->oformat->flags & AVFMT_NOFILE)) {
+        avio_closep(&context->pb);
     }
-
-    return true;
+    avformat_free_context(context);
+    context = nullptr;
 }
 
-bool FFmpegRecorder::createVideoStream() {
+bool FFmpegRecorder::openEncoder() {
     // 查找编码器
     const AVCodec* codec = nullptr;
     if (!config_.encoder_name.empty()) {
         codec = avcodec_find_encoder_by_name(config_.encoder_name.c_str());
-    } else {
-        // 使用默认编码器
-        if (config_.use_hw_accel) {
-            // 尝试使用硬件加速编码器
-            codec = avcodec_find_encoder_by_name("h264_rkmpp");
-            if (!codec) {
-                codec = avcodec_find_encoder_by_name("h264_v4l2m2m");
-            }
+        if (!codec) {
+            LOG_WARNING("找不到编码器 " + config_.encoder_name + "，使用默认编码器", "FFmpegRecorder");
         }
-
-        // 如果没有找到硬件加速编码器，使用软件编码器
+    } else if (config_.use_hw_accel) {
+        // 尝试使用硬件加速编码器
+        codec = avcodec_find_encoder_by_name("h264_rkmpp");
         if (!codec) {
-            codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+            codec = avcodec_find_encoder_by_name("h264_v4l2m2m");
         }
     }
 
+    // 如果没有找到硬件加速编码器，使用软件编码器
     if (!codec) {
-        LOG_ERROR("无法找到编码器", "FFmpegRecorder");
-        return false;
+        codec = avcodec_find_encoder(AV_CODEC_ID_H264);
     }
-
-    // 创建视频流
-    video_stream_ = avformat_new_stream(format_context_, nullptr);
-    if (!video_stream_) {
-        LOG_ERROR("无法创建视频流", "FFmpegRecorder");
+    if (!codec) {
+        LOG_ERROR("无法找到编码器", "FFmpegRecorder");
         return false;
     }
 
@@ -423,201 +674,721 @@ bool FFmpegRecorder::createVideoStream() {
         return false;
     }
 
-    // 设置编码器参数
-    codec_context_->codec_id = codec->id;
-    codec_context_->codec_type = AVMEDIA_TYPE_VIDEO;
+    // 设置编码器参数，时间戳为按帧率换算的采集时间
+    int fps = std::max(1, config_.fps);
     codec_context_->width = config_.width;
     codec_context_->height = config_.height;
-    codec_context_->time_base.num = 1;
-    codec_context_->time_base.den = config_.fps;
-    codec_context_->framerate.num = config_.fps;
-    codec_context_->framerate.den = 1;
+    codec_context_->time_base = AVRational{1, fps};
+    codec_context_->framerate = AVRational{fps, 1};
     codec_context_->gop_size = config_.gop;
     codec_context_->max_b_frames = 0;  // 不使用B帧
-    codec_context_->pix_fmt = AV_PIX_FMT_YUV420P;
+    codec_context_->pix_fmt = chooseInputFormat(codec);
 
     // 设置比特率
     if (config_.bitrate > 0) {
         codec_context_->bit_rate = config_.bitrate;
     } else {
         // 根据分辨率和帧率计算合适的比特率
-        codec_context_->bit_rate = config_.width * config_.height * config_.fps * 0.1;
+        codec_context_->bit_rate = static_cast<int64_t>(config_.width * config_.height * fps * 0.1);
+    }
+
+    // MP4/MKV需要把SPS/PPS放在全局头中，编码器先于文件打开，按配置推测容器格式
+    const AVOutputFormat* oformat = av_guess_format(
+        config_.container_format.empty() ? nullptr : config_.container_format.c_str(),
+        config_.output_path.c_str(), nullptr);
+    if (!oformat || (oformat->flags & AVFMT_GLOBALHEADER)) {
+        codec_context_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
     }
 
     // 设置编码器特定选项
-    if (codec_context_->codec_id == AV_CODEC_ID_H264) {
-        // 设置H.264编码器选项
-        av_dict_set(&format_context_->metadata, "preset", "ultrafast", 0);
-        av_dict_set(&format_context_->metadata, "tune", "zerolatency", 0);
+    AVDictionary* options = nullptr;
+    if (std::string(codec->name) == "libx264") {
+        av_dict_set(&options, "preset", "ultrafast", 0);
+        av_dict_set(&options, "tune", "zerolatency", 0);
     }
 
-    // 复制编码器参数到视频流
-    int ret = avcodec_parameters_from_context(video_stream_->codecpar, codec_context_);
+    // 打开编码器
+    int ret = avcodec_open2(codec_context_, codec, &options);
+    av_dict_free(&options);
     if (ret < 0) {
-        char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, err_buf, AV_ERROR_MAX_STRING_SIZE);
-        LOG_ERROR("无法复制编码器参数到视频流: " + std::string(err_buf), "FFmpegRecorder");
+        LOG_ERROR("无法打开编码器: " + errorString(ret), "FFmpegRecorder");
         return false;
     }
 
+    LOG_INFO("录制编码器: " + std::string(codec->name), "FFmpegRecorder");
     return true;
 }
 
-bool FFmpegRecorder::openEncoder() {
-    // 打开编码器
-    int ret = avcodec_open2(codec_context_, codec_context_->codec, nullptr);
-    if (ret < 0) {
-        char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, err_buf, AV_ERROR_MAX_STRING_SIZE);
-        LOG_ERROR("无法打开编码器: " + std::string(err_buf), "FFmpegRecorder");
-        return false;
+bool FFmpegRecorder::initStreamParams() {
+    if (!stream_params_) {
+        stream_params_ = avcodec_parameters_alloc();
+        if (!stream_params_) {
+            LOG_ERROR("无法分配视频流参数", "FFmpegRecorder");
+            return false;
+        }
     }
 
-    // 设置帧参数
-    frame_->format = codec_context_->pix_fmt;
-    frame_->width = codec_context_->width;
-    frame_->height = codec_context_->height;
+    if (!codec_context_) {
+        // 直通模式：流参数直接描述摄像头的JPEG帧
+        stream_params_->codec_type = AVMEDIA_TYPE_VIDEO;
+        stream_params_->codec_id = AV_CODEC_ID_MJPEG;
+        stream_params_->width = config_.width;
+        stream_params_->height = config_.height;
+        return true;
+    }
 
-    // 分配帧缓冲区
-    ret = av_frame_get_buffer(frame_, 0);
+    // 参数来自已打开的编码器，分段时复用同一个编码器
+    int ret = avcodec_parameters_from_context(stream_params_, codec_context_);
     if (ret < 0) {
-        char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, err_buf, AV_ERROR_MAX_STRING_SIZE);
-        LOG_ERROR("无法分配帧缓冲区: " + std::string(err_buf), "FFmpegRecorder");
+        LOG_ERROR("无法复制编码器参数到视频流: " + errorString(ret), "FFmpegRecorder");
         return false;
     }
 
     return true;
 }
 
-bool FFmpegRecorder::writeHeader() {
+AVFormatContext* FFmpegRecorder::openOutput(const std::string& path) {
+    // 创建输出格式上下文
+    const char* format_name = config_.container_format.empty() ? nullptr : config_.container_format.c_str();
+    AVFormatContext* context = nullptr;
+    int ret = avformat_alloc_output_context2(&context, nullptr, format_name, path.c_str());
+    if (ret < 0 || !context) {
+        LOG_ERROR("无法创建输出格式上下文: " + errorString(ret), "FFmpegRecorder");
+        return nullptr;
+    }
+
+    // 直通模式要求容器支持MJPEG。直通的时间基为微秒，AVI会把时间基当作帧率（1000000fps），
+    // 并为跳过的每个时间单位写一个空块，因此也不接受
+    if (config_.mode == RecordingMode::STREAM_COPY &&
+        (avformat_query_codec(context->oformat, AV_CODEC_ID_MJPEG, FF_COMPLIANCE_NORMAL) != 1 ||
+         std::string(context->oformat->name) == "avi")) {
+        LOG_ERROR("容器格式 " + std::string(context->oformat->name) + " 不支持MJPEG直通，请使用mkv/mov",
+                  "FFmpegRecorder");
+        avformat_free_context(context);
+        return nullptr;
+    }
+
+    // 创建视频流
+    AVStream* stream = avformat_new_stream(context, nullptr);
+    if (!stream) {
+        LOG_ERROR("无法创建视频流", "FFmpegRecorder");
+        avformat_free_context(context);
+        return nullptr;
+    }
+    stream->time_base = AVRational{1, time_base_den_};
+    stream->avg_frame_rate = AVRational{std::max(1, config_.fps), 1};
+    ret = avcodec_parameters_copy(stream->codecpar, stream_params_);
+    if (ret < 0) {
+        LOG_ERROR("无法复制视频流参数: " + errorString(ret), "FFmpegRecorder");
+        avformat_free_context(context);
+        return nullptr;
+    }
+
+    // 打开输出文件
+    if (!(context->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open(&context->pb, path.c_str(), AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            LOG_ERROR("无法打开输出文件: " + errorString(ret), "FFmpegRecorder");
+            avformat_free_context(context);
+            return nullptr;
+        }
+    }
+
+    // 分片MP4：每个关键帧开始一个分片并立即写出，文件头不等待文件尾中的索引
+    AVDictionary* options = nullptr;
+    std::string muxer = context->oformat->name;
+    if (config_.fragmented_mp4 && (muxer == "mp4" || muxer == "mov")) {
+        av_dict_set(&options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+        av_dict_set(&options, "flush_packets", "1", 0);
+    }
+
     // 写入文件头
-    int ret = avformat_write_header(format_context_, nullptr);
+    ret = avformat_write_header(context, &options);
+    av_dict_free(&options);
     if (ret < 0) {
-        char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, err_buf, AV_ERROR_MAX_STRING_SIZE);
-        LOG_ERROR("无法写入文件头: " + std::string(err_buf), "FFmpegRecorder");
-        return false;
+        LOG_ERROR("无法写入文件头: " + errorString(ret), "FFmpegRecorder");
+        closeOutput(context);
+        return nullptr;
     }
 
-    return true;
+    return context;
 }
 
-bool FFmpegRecorder::writeTrailer() {
+bool FFmpegRecorder::finalizeOutput(AVFormatContext*& context) {
+    if (!context) {
+        return true;
+    }
+    int64_t begin_us = av_gettime_relative();
+    std::string path = context->url ? context->url : "";
+
     // 写入文件尾
-    int ret = av_write_trailer(format_context_);
+    int ret = av_write_trailer(context);
     if (ret < 0) {
-        char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, err_buf, AV_ERROR_MAX_STRING_SIZE);
-        LOG_ERROR("无法写入文件尾: " + std::string(err_buf), "FFmpegRecorder");
-        return false;
+        LOG_ERROR("无法写入文件尾: " + errorString(ret), "FFmpegRecorder");
     }
+    closeOutput(context);
 
-    return true;
+    // 关闭时只写到页缓存，fsync后断电也不会丢失已完成的分段
+    if (!path.empty()) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0 || ::fsync(fd) != 0) {
+            LOG_WARNING("无法同步录制文件到磁盘: " + path, "FFmpegRecorder");
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    LOG_INFO("录制文件已完成: " + path + ", 收尾耗时 " +
+             std::to_string((av_gettime_relative() - begin_us) / 1000) + "ms", "FFmpegRecorder");
+    return ret >= 0;
 }
 
-bool FFmpegRecorder::encodeAndWriteFrame(const camera::Frame& frame) {
-    // 确保帧可写
-    int ret = av_frame_make_writable(frame_);
-    if (ret < 0) {
-        char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, err_buf, AV_ERROR_MAX_STRING_SIZE);
-        LOG_ERROR("无法使帧可写: " + std::string(err_buf), "FFmpegRecorder");
-        return false;
+void FFmpegRecorder::stopPipeline(bool drain) {
+    pipeline_running_ = false;
+    if (!drain) {
+        // 丢弃未编码的帧，写文件线程见到encoder_done_后丢弃剩余的包
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        input_queue_.clear();
+    }
+    input_cv_.notify_all();
+    if (encode_thread_.joinable()) {
+        encode_thread_.join();
+    }
+    write_cv_.notify_all();
+    if (write_thread_.joinable()) {
+        write_thread_.join();
     }
 
-    // 根据源格式选择转换方式
-    int src_format;
-    switch (frame.getFormat()) {
-        case camera::PixelFormat::YUYV:
-            src_format = AV_PIX_FMT_YUYV422;
-            break;
-        case camera::PixelFormat::RGB24:
-            src_format = AV_PIX_FMT_RGB24;
-            break;
-        case camera::PixelFormat::BGR24:
-            src_format = AV_PIX_FMT_BGR24;
-            break;
-        case camera::PixelFormat::NV12:
-            src_format = AV_PIX_FMT_NV12;
+    // 释放没有写入的包
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    for (QueuedPacket& queued : write_queue_) {
+        av_packet_free(&queued.packet);
+    }
+    write_queue_.clear();
+}
+
+void FFmpegRecorder::encodeLoop() {
+    bool ok = true;
+    while (true) {
+        QueuedFrame queued;
+        {
+            std::unique_lock<std::mutex> lock(input_mutex_);
+            input_cv_.wait(lock, [this]() { return !input_queue_.empty() || !pipeline_running_; });
+            if (input_queue_.empty()) {
+                break;  // 停止且已排空
+            }
+            queued = std::move(input_queue_.front());
+            input_queue_.pop_front();
+        }
+
+        ok = codec_context_ ? encodeFrame(queued) : copyFrame(queued);
+
+        // 回收缓冲区供processFrame复用
+        {
+            std::lock_guard<std::mutex> lock(input_mutex_);
+            if (free_buffers_.size() <= static_cast<size_t>(std::max(1, config_.input_queue_depth))) {
+                free_buffers_.push_back(std::move(queued.frame.getData()));
+            }
+        }
+        if (!ok) {
             break;
-        default:
-            LOG_ERROR("不支持的像素格式: " + std::to_string(static_cast<int>(frame.getFormat())), "FFmpegRecorder");
-            return false;
+        }
     }
 
-    // 创建图像转换上下文
-    SwsContext* sws_context = sws_getContext(
-        frame.getWidth(), frame.getHeight(), (AVPixelFormat)src_format,
-        frame.getWidth(), frame.getHeight(), codec_context_->pix_fmt,
-        SWS_BILINEAR, nullptr, nullptr, nullptr
-    );
+    // 冲刷编码器中缓存的帧
+    if (ok && codec_context_) {
+        int ret = avcodec_send_frame(codec_context_, nullptr);
+        if (ret >= 0) {
+            drainEncoder();
+        }
+    } else if (!ok) {
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        input_queue_.clear();
+    }
 
-    // 设置源数据
-    const uint8_t* src_data[4] = {frame.getData().data(), nullptr, nullptr, nullptr};
-    int src_linesize[4] = {frame.getWidth() * 2, 0, 0, 0};  // 假设YUYV格式
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        encoder_done_ = true;
+    }
+    write_cv_.notify_all();
+}
 
-    // 执行图像转换
-    sws_scale(sws_context, src_data, src_linesize, 0, frame.getHeight(),
-              frame_->data, frame_->linesize);
+bool FFmpegRecorder::encodeFrame(const QueuedFrame& queued) {
+    const camera::Frame* input = &queued.frame;
+    if (input->getFormat() == camera::PixelFormat::MJPEG) {
+        if (!JpegEncoderPool::getInstance().decode(*input, decoded_)) {
+            LOG_WARNING("MJPEG帧解码失败，跳过", "FFmpegRecorder");
+            return true;
+        }
+        input = &decoded_;
+    }
+
+    AVPixelFormat src_format = toAVPixelFormat(input->getFormat());
+    if (src_format == AV_PIX_FMT_NONE) {
+        setError("不支持的像素格式: " + std::to_string(static_cast<int>(input->getFormat())));
+        return false;
+    }
 
-    // 设置帧时间戳
-    frame_->pts = av_rescale_q(
-        status_.frame_count,
-        av_make_q(1, config_.fps),
-        codec_context_->time_base
-    );
+    // 输入尺寸或格式变化时重建转换上下文，否则复用
+    sws_context_ = sws_getCachedContext(sws_context_, input->getWidth(), input->getHeight(), src_format,
+                                        codec_context_->width, codec_context_->height, codec_context_->pix_fmt,
+                                        SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!sws_context_) {
+        setError("无法创建图像转换上下文");
+        return false;
+    }
+
+    size_t src_size = static_cast<size_t>(
+        av_image_get_buffer_size(src_format, input->getWidth(), input->getHeight(), 1));
+    if (input->getDataSize() < src_size) {
+        LOG_WARNING("输入帧数据不完整: " + std::to_string(input->getDataSize()) + " < " + std::to_string(src_size),
+                    "FFmpegRecorder");
+        return true;
+    }
+    uint8_t* src_data[4] = {nullptr};
+    int src_linesize[4] = {0};
+    int ret = av_image_fill_arrays(src_data, src_linesize, input->getDataPtr(), src_format,
+                                   input->getWidth(), input->getHeight(), 1);
+    if (ret < 0) {
+        setError("无法解析输入图像: " + errorString(ret));
+        return false;
+    }
+
+    AVFrame* frame = acquireFrame();
+    if (!frame) {
+        setError("无法分配编码帧");
+        return false;
+    }
+    sws_scale(sws_context_, src_data, src_linesize, 0, input->getHeight(), frame->data, frame->linesize);
+
+    // 到达分段点的第一帧输出关键帧，分段正好在设定的时长处切换
+    frame->pts = framePts(queued);
+    bool keyframe = force_keyframe_.exchange(false);
+    int64_t cut_pts = next_cut_pts_;
+    if (frame->pts >= cut_pts &&
+        next_cut_pts_.compare_exchange_strong(cut_pts, std::numeric_limits<int64_t>::max())) {
+        keyframe = true;
+    }
+    frame->pict_type = keyframe ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
 
     // 编码帧
-    ret = avcodec_send_frame(codec_context_, frame_);
+    ret = avcodec_send_frame(codec_context_, frame);
     if (ret < 0) {
-        char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
-        av_strerror(ret, err_buf, AV_ERROR_MAX_STRING_SIZE);
-        LOG_ERROR("无法发送帧到编码器: " + std::string(err_buf), "FFmpegRecorder");
+        setError("无法发送帧到编码器: " + errorString(ret));
+        return false;
+    }
+    if (!drainEncoder()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(status_mutex_);
+    recordStage(encode_counters_, queued.enqueue_us);
+    return true;
+}
+
+bool FFmpegRecorder::copyFrame(const QueuedFrame& queued) {
+    const camera::Frame& frame = queued.frame;
+    const uint8_t* data = frame.getDataPtr();
+    size_t size = frame.getDataSize();
+
+    if (frame.getFormat() != camera::PixelFormat::MJPEG) {
+        // 摄像头没有输出MJPEG时只做JPEG编码，仍然省去H.264编码
+        if (!JpegEncoderPool::getInstance().encode(frame, 90, jpeg_buffer_, config_.width, config_.height)) {
+            LOG_WARNING("直通录制的JPEG编码失败，跳过", "FFmpegRecorder");
+            return true;
+        }
+        data = jpeg_buffer_.data();
+        size = jpeg_buffer_.size();
+    } else if (frame.getWidth() != config_.width || frame.getHeight() != config_.height) {
+        LOG_WARNING("MJPEG帧尺寸 " + std::to_string(frame.getWidth()) + "x" + std::to_string(frame.getHeight()) +
+                    " 与录制尺寸不一致，跳过", "FFmpegRecorder");
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        encode_counters_.dropped++;
+        return true;
+    }
+
+    AVPacket* packet = av_packet_alloc();
+    if (!packet || av_new_packet(packet, static_cast<int>(size)) < 0) {
+        av_packet_free(&packet);
+        setError("无法分配AVPacket");
         return false;
     }
+    std::memcpy(packet->data, data, size);
+    packet->pts = framePts(queued);
+    packet->dts = packet->pts;
+    packet->flags |= AV_PKT_FLAG_KEY;  // 每个JPEG都可独立解码
+    queuePacket(packet);
 
+    std::lock_guard<std::mutex> lock(status_mutex_);
+    recordStage(encode_counters_, queued.enqueue_us);
+    return true;
+}
+
+int64_t FFmpegRecorder::framePts(const QueuedFrame& queued) {
+    // 按采集时间计算时间戳，丢帧和抖动不会让录像变快，暂停的时段跳过
+    int64_t capture_us = captureTimeUs(queued.frame);
+    if (capture_us <= 0) {
+        capture_us = queued.enqueue_us;
+    }
+    if (base_capture_us_ < 0) {
+        // 采集时间为单调时钟，换算出对应的系统时间供关键帧索引使用
+        base_capture_us_ = capture_us;
+        base_wall_us_ = av_gettime() - (av_gettime_relative() - capture_us);
+    } else if (resume_pending_.exchange(false)) {
+        base_capture_us_ += capture_us - last_capture_us_;
+        base_wall_us_ += capture_us - last_capture_us_;
+    }
+    last_capture_us_ = capture_us;
+    int64_t pts = av_rescale(capture_us - base_capture_us_, time_base_den_, 1000000);
+    if (pts <= last_pts_) {
+        pts = last_pts_ + 1;
+    }
+    last_pts_ = pts;
+    return pts;
+}
+
+AVFrame* FFmpegRecorder::acquireFrame() {
+    // 编码器不再引用的帧可以直接复用
+    for (size_t i = 0; i < frame_pool_.size(); ++i) {
+        AVFrame* frame = frame_pool_[(next_pool_frame_ + i) % frame_pool_.size()];
+        if (av_frame_is_writable(frame)) {
+            next_pool_frame_ = (next_pool_frame_ + i + 1) % frame_pool_.size();
+            return frame;
+        }
+    }
+
+    // 都被编码器引用时扩充池
+    if (frame_pool_.size() < kFramePoolSize) {
+        AVFrame* frame = av_frame_alloc();
+        if (!frame) {
+            return nullptr;
+        }
+        frame->format = codec_context_->pix_fmt;
+        frame->width = codec_context_->width;
+        frame->height = codec_context_->height;
+        int ret = av_frame_get_buffer(frame, 0);
+        if (ret < 0) {
+            LOG_ERROR("无法分配帧缓冲区: " + errorString(ret), "FFmpegRecorder");
+            av_frame_free(&frame);
+            return nullptr;
+        }
+        frame_pool_.push_back(frame);
+        return frame;
+    }
+
+    // 池已满，让最旧的帧重新分配缓冲区
+    AVFrame* frame = frame_pool_[next_pool_frame_];
+    next_pool_frame_ = (next_pool_frame_ + 1) % frame_pool_.size();
+    int ret = av_frame_make_writable(frame);
+    if (ret < 0) {
+        LOG_ERROR("无法使帧可写: " + errorString(ret), "FFmpegRecorder");
+        return nullptr;
+    }
+    return frame;
+}
+
+bool FFmpegRecorder::drainEncoder() {
     // 获取编码后的包
-    while (ret >= 0) {
-        ret = avcodec_receive_packet(codec_context_, packet_);
+    while (true) {
+        int ret = avcodec_receive_packet(codec_context_, packet_);
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-            break;
+            return true;
         } else if (ret < 0) {
-            char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
-            av_strerror(ret, err_buf, AV_ERROR_MAX_STRING_SIZE);
-            LOG_ERROR("无法从编码器接收包: " + std::string(err_buf), "FFmpegRecorder");
+            setError("无法从编码器接收包: " + errorString(ret));
             return false;
         }
 
-        // 转换时间戳
-        packet_->stream_index = video_stream_->index;
-        av_packet_rescale_ts(packet_, codec_context_->time_base, video_stream_->time_base);
-
-        // 写入包
-        ret = av_interleaved_write_frame(format_context_, packet_);
-        if (ret < 0) {
-            char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
-            av_strerror(ret, err_buf, AV_ERROR_MAX_STRING_SIZE);
-            LOG_ERROR("无法写入包: " + std::string(err_buf), "FFmpegRecorder");
+        AVPacket* packet = av_packet_alloc();
+        if (!packet) {
+            av_packet_unref(packet_);
+            setError("无法分配AVPacket");
             return false;
         }
+        av_packet_move_ref(packet, packet_);
+        queuePacket(packet);
+    }
+}
+
+void FFmpegRecorder::queuePacket(AVPacket* packet) {
+    bool keyframe = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+    bool dropped = false;
+    bool overflow = false;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (dropping_to_keyframe_ && !keyframe) {
+            // 丢包后从关键帧接续，避免写入无法解码的帧
+            dropped = true;
+        } else if (write_queue_.size() >= static_cast<size_t>(std::max(1, config_.write_queue_depth))) {
+            dropped = true;
+            overflow = !dropping_to_keyframe_;
+            dropping_to_keyframe_ = true;
+        } else {
+            dropping_to_keyframe_ = false;
+            write_queue_.push_back(QueuedPacket{packet, av_gettime_relative()});
+        }
+    }
+
+    if (dropped) {
+        av_packet_free(&packet);
+        force_keyframe_ = true;
+        if (overflow) {
+            LOG_WARNING("写入队列已满，丢弃到下一个关键帧", "FFmpegRecorder");
+        }
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        write_counters_.dropped++;
+    } else {
+        write_cv_.notify_one();
+    }
+}
+
+void FFmpegRecorder::writeLoop() {
+    while (true) {
+        QueuedPacket queued{nullptr, 0};
+        bool open_requested = false;
+        {
+            std::unique_lock<std::mutex> lock(write_mutex_);
+            write_cv_.wait(lock, [this]() { return !write_queue_.empty() || encoder_done_ || start_requested_; });
+            if (start_requested_) {
+                start_requested_ = false;
+                open_requested = true;
+            } else if (write_queue_.empty()) {
+                break;  // 编码线程已退出且已写完
+            } else {
+                queued = write_queue_.front();
+                write_queue_.pop_front();
+            }
+        }
+
+        // 预录中开始录制
+        if (open_requested) {
+            bool opened = openPreRollOutput();
+            {
+                std::lock_guard<std::mutex> lock(write_mutex_);
+                start_result_ = opened ? 1 : -1;
+            }
+            start_cv_.notify_all();
+            if (!opened) {
+                break;
+            }
+            notifyStatus();
+            continue;
+        }
+
+        int64_t pts = queued.packet->pts;
+
+        // 预录中只放入缓冲
+        if (!format_context_) {
+            int64_t timestamp_us = av_rescale(pts, 1000000, time_base_den_);
+            pre_roll_.push(queued.packet->data, static_cast<size_t>(queued.packet->size), pts, timestamp_us,
+                           (queued.packet->flags & AV_PKT_FLAG_KEY) != 0);
+            av_packet_free(&queued.packet);
+            PreRollStats stats = pre_roll_.getStats();
+            std::lock_guard<std::mutex> lock(status_mutex_);
+            recordStage(write_counters_, queued.enqueue_us);
+            status_.pre_roll_duration = stats.duration_us / 1000000.0;
+            status_.pre_roll_bytes = static_cast<int64_t>(stats.bytes);
+            continue;
+        }
+
+        bool ok = writePacket(queued.packet);
+        av_packet_free(&queued.packet);
+        if (!ok) {
+            break;
+        }
+
+        // 更新状态
+        {
+            std::lock_guard<std::mutex> lock(status_mutex_);
+            recordStage(write_counters_, queued.enqueue_us);
+            status_.frame_count++;
+            if (pts != AV_NOPTS_VALUE && pts_offset_ != AV_NOPTS_VALUE) {
+                status_.duration = static_cast<double>(pts - pts_offset_) / time_base_den_;
+            }
+            if (format_context_ && format_context_->pb) {
+                status_.file_size = std::max<int64_t>(0, avio_tell(format_context_->pb));
+            }
+        }
+
+        // 调用状态回调
+        notifyStatus();
+    }
+
+    // 写文件线程退出后不能再打开文件
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        start_result_ = -1;
+    }
+    start_cv_.notify_all();
+}
+
+bool FFmpegRecorder::openPreRollOutput() {
+    segment_start_pts_ = -1;
+    pts_offset_ = AV_NOPTS_VALUE;
+    format_context_ = openOutput(segment_base_path_);
+    if (!format_context_) {
+        setError("打开录制文件失败");
+        return false;
+    }
+    video_stream_ = format_context_->streams[0];
+    requestNextSegment();
+
+    // 从最早的关键帧开始写入缓冲的包，缓冲中的数据在写入时由FFmpeg复制
+    PreRollStats stats = pre_roll_.getStats();
+    AVPacket* packet = av_packet_alloc();
+    if (!packet) {
+        setError("无法分配AVPacket");
+        return false;
+    }
+    int64_t last_pts = AV_NOPTS_VALUE;
+    bool ok = pre_roll_.flush([this, packet, &last_pts](const uint8_t* data, size_t size, int64_t pts, bool keyframe) {
+        packet->data = const_cast<uint8_t*>(data);
+        packet->size = static_cast<int>(size);
+        packet->pts = pts;
+        packet->dts = pts;
+        packet->flags = keyframe ? AV_PKT_FLAG_KEY : 0;
+        last_pts = pts;
+        return writePacket(packet);
+    });
+    av_packet_free(&packet);
+    if (!ok) {
+        return false;
+    }
+
+    // 开始录制，之后的包直接写入文件
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        status_.state = RecordingState::RECORDING;
+        status_.frame_count = stats.packets;
+        if (last_pts != AV_NOPTS_VALUE) {
+            status_.duration = static_cast<double>(last_pts - pts_offset_) / time_base_den_;
+        }
+        status_.pre_roll_armed = false;
+        status_.pre_roll_duration = 0.0;
+        status_.pre_roll_bytes = 0;
+    }
+    pre_roll_armed_ = false;
+
+    LOG_INFO("写入预录: " + std::to_string(stats.packets) + "个包, " +
+             std::to_string(stats.duration_us / 1000) + "ms", "FFmpegRecorder");
+    return true;
+}
+
+bool FFmpegRecorder::writePacket(AVPacket* packet) {
+    // 需要分段时在关键帧处切换，新文件可以独立播放；按大小分段或编码器没有响应分段点时请求关键帧
+    if (checkSegmentation(packet->pts)) {
+        if (packet->flags & AV_PKT_FLAG_KEY) {
+            if (!rotateSegment()) {
+                setError("创建新的分段文件失败");
+                return false;
+            }
+        } else {
+            force_keyframe_ = true;
+        }
+    }
+
+    // 分段的第一个包，按时长分段时告诉编码线程下一个分段点
+    if (segment_start_pts_ < 0 && packet->pts != AV_NOPTS_VALUE) {
+        segment_start_pts_ = packet->pts;
+        if (pts_offset_ == AV_NOPTS_VALUE) {
+            pts_offset_ = packet->pts;
+        }
+        if (config_.max_duration > 0) {
+            next_cut_pts_ = segment_start_pts_ + static_cast<int64_t>(config_.max_duration) * time_base_den_;
+        }
+        if (config_.write_keyframe_index && format_context_->url && index_writer_.open(format_context_->url)) {
+            // MKV和分片MP4把簇/分片缓存后整体写出，关键帧开始新的簇/分片，写入后的位置才是它的开头
+            std::string muxer = format_context_->oformat->name;
+            index_after_write_ = muxer == "matroska" || muxer == "webm" ||
+                                 (config_.fragmented_mp4 && (muxer == "mp4" || muxer == "mov"));
+            last_index_us_ = -1;
+        }
+    }
+
+    // 关键帧记入索引，偏移为解封装器从这里开始读取就能读到该关键帧的位置
+    bool index_keyframe = (packet->flags & AV_PKT_FLAG_KEY) && index_writer_.isOpen() &&
+                          packet->pts != AV_NOPTS_VALUE && format_context_->pb;
+    KeyframeEntry entry;
+    if (index_keyframe) {
+        entry.media_time_us = av_rescale(packet->pts - segment_start_pts_, 1000000, time_base_den_);
+        index_keyframe = last_index_us_ < 0 || entry.media_time_us - last_index_us_ >= kIndexMinIntervalUs;
+    }
+    if (index_keyframe) {
+        entry.byte_offset = avio_tell(format_context_->pb);
+        entry.wall_time_us = base_wall_us_ + av_rescale(packet->pts, 1000000, time_base_den_);
+    }
+
+    // 转换时间戳，每个分段从0开始
+    if (segment_start_pts_ >= 0) {
+        if (packet->pts != AV_NOPTS_VALUE) {
+            packet->pts -= segment_start_pts_;
+        }
+        if (packet->dts != AV_NOPTS_VALUE) {
+            packet->dts -= segment_start_pts_;
+        }
+    }
+    packet->stream_index = video_stream_->index;
+    av_packet_rescale_ts(packet, AVRational{1, time_base_den_}, video_stream_->time_base);
+
+    // 写入包
+    int ret = av_interleaved_write_frame(format_context_, packet);
+    if (ret < 0) {
+        setError("无法写入包: " + errorString(ret));
+        return false;
+    }
+
+    if (index_keyframe) {
+        if (index_after_write_) {
+            entry.byte_offset = avio_tell(format_context_->pb);
+        }
+        index_writer_.append(entry);
+        last_index_us_ = entry.media_time_us;
     }
 
     return true;
 }
 
-bool FFmpegRecorder::checkSegmentation() {
-    // 检查是否需要分段
-    if (config_.max_duration > 0) {
-        // 根据时长分段
-        if (status_.duration >= config_.max_duration) {
+void FFmpegRecorder::recordStage(StageCounters& counters, int64_t enqueue_us) {
+    double latency_ms = (av_gettime_relative() - enqueue_us) / 1000.0;
+    counters.processed++;
+    counters.total_latency_ms += latency_ms;
+    counters.max_latency_ms = std::max(counters.max_latency_ms, latency_ms);
+}
+
+void FFmpegRecorder::setError(const std::string& message) {
+    LOG_ERROR(message, "FFmpegRecorder");
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        status_.state = RecordingState::ERROR;
+        status_.error_message = message;
+    }
+    pipeline_running_ = false;
+    input_cv_.notify_all();
+    notifyStatus();
+}
+
+void FFmpegRecorder::notifyStatus() {
+    std::function<void(const RecordingStatus&)> callback;
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        callback = status_callback_;
+    }
+    if (callback) {
+        callback(getStatus());
+    }
+}
+
+bool FFmpegRecorder::checkSegmentation(int64_t pts) {
+    // 根据时长分段，时长按当前分段第一个包计算
+    if (config_.max_duration > 0 && pts != AV_NOPTS_VALUE && segment_start_pts_ >= 0) {
+        if (pts - segment_start_pts_ >= static_cast<int64_t>(config_.max_duration) * time_base_den_) {
             return true;
         }
     }
 
-    if (config_.max_size > 0) {
-        // 根据文件大小分段
-        if (status_.file_size >= config_.max_size) {
+    // 根据文件大小分段
+    if (config_.max_size > 0 && format_context_ && format_context_->pb) {
+        if (avio_tell(format_context_->pb) >= static_cast<int64_t>(config_.max_size)) {
             return true;
         }
     }
@@ -625,54 +1396,141 @@ bool FFmpegRecorder::checkSegmentation() {
     return false;
 }
 
-bool FFmpegRecorder::createNewSegment() {
-    // 写入当前文件尾
-    writeTrailer();
+bool FFmpegRecorder::rotateSegment() {
+    int index = segment_index_ + 1;
+    std::string path = segmentPath(index);
+
+    // 取出提前打开的分段，还在打开时等待，通常早已就绪
+    AVFormatContext* next = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(segment_mutex_);
+        segment_cv_.wait(lock, [this]() { return (prepare_index_ < 0 && !preparing_) || !segment_running_; });
+        if (next_output_ && next_output_index_ == index) {
+            next = next_output_;
+            next_output_ = nullptr;
+        }
+    }
+    if (!next) {
+        // 提前打开失败时在这里打开
+        LOG_WARNING("下一个分段没有提前打开，在写文件线程中打开: " + path, "FFmpegRecorder");
+        next = openOutput(path);
+        if (!next) {
+            return false;
+        }
+    }
 
-    // 关闭当前输出文件
-    if (format_context_ && !(format_context_->oformat->flags & AVFMT_NOFILE)) {
-        avio_closep(&format_context_->pb);
+    // 切换到新文件，旧文件交给分段线程写文件尾，新文件的索引在写入第一个包时创建
+    index_writer_.close();
+    AVFormatContext* previous = format_context_;
+    format_context_ = next;
+    video_stream_ = next->streams[0];
+    segment_index_ = index;
+    segment_start_pts_ = -1;
+    {
+        std::lock_guard<std::mutex> lock(segment_mutex_);
+        finalize_queue_.push_back(previous);
+    }
+    segment_cv_.notify_all();
+    requestNextSegment();
+
+    // 更新配置和状态
+    {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        config_.output_path = path;
+        status_.current_file = path;
+        status_.file_size = 0;
     }
 
-    // 增加分段索引
-    segment_index_++;
+    LOG_INFO("切换到新的分段文件: " + path, "FFmpegRecorder");
+    return true;
+}
 
-    // 生成新的输出文件名
-    std::string base_name = config_.output_path;
-    std::string extension = fs::path(base_name).extension().string();
-    std::string stem = fs::path(base_name).stem().string();
-    std::string new_path = fs::path(base_name).parent_path().string() + "/" +
-                          stem + "_part" + std::to_string(segment_index_) + extension;
+void FFmpegRecorder::requestNextSegment() {
+    // 不分段时不需要提前打开
+    if (config_.max_duration <= 0 && config_.max_size <= 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(segment_mutex_);
+        prepare_index_ = segment_index_ + 1;
+    }
+    segment_cv_.notify_all();
+}
 
-    // 更新配置
-    config_.output_path = new_path;
+void FFmpegRecorder::segmentLoop() {
+    std::unique_lock<std::mutex> lock(segment_mutex_);
+    while (true) {
+        segment_cv_.wait(lock, [this]() {
+            return prepare_index_ >= 0 || !finalize_queue_.empty() || !segment_running_;
+        });
+
+        // 先打开下一个分段，写文件线程切换时可能在等待
+        if (prepare_index_ >= 0 && segment_running_) {
+            int index = prepare_index_;
+            prepare_index_ = -1;
+            preparing_ = true;
+            lock.unlock();
+            AVFormatContext* context = openOutput(segmentPath(index));
+            lock.lock();
+            preparing_ = false;
+            closeOutput(next_output_);
+            next_output_ = context;
+            next_output_index_ = index;
+            segment_cv_.notify_all();
+            continue;
+        }
 
-    // 创建新的输出格式上下文
-    if (!createOutputFormatContext()) {
-        return false;
-    }
+        // 写入旧分段的文件尾并fsync
+        if (!finalize_queue_.empty()) {
+            AVFormatContext* context = finalize_queue_.front();
+            finalize_queue_.pop_front();
+            lock.unlock();
+            finalizeOutput(context);
+            lock.lock();
+            continue;
+        }
 
-    // 创建新的视频流
-    if (!createVideoStream()) {
-        return false;
+        if (!segment_running_) {
+            break;  // 已停止且旧分段都已收尾
+        }
     }
+}
 
-    // 打开编码器
-    if (!openEncoder()) {
-        return false;
+void FFmpegRecorder::stopSegmentThread() {
+    {
+        std::lock_guard<std::mutex> lock(segment_mutex_);
+        segment_running_ = false;
+        prepare_index_ = -1;
+    }
+    segment_cv_.notify_all();
+    if (segment_thread_.joinable()) {
+        segment_thread_.join();
     }
 
-    // 写入文件头
-    if (!writeHeader()) {
-        return false;
+    // 删除提前打开但没有用到的分段
+    AVFormatContext* unused = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(segment_mutex_);
+        unused = next_output_;
+        next_output_ = nullptr;
     }
+    if (unused) {
+        std::string path = unused->url ? unused->url : "";
+        closeOutput(unused);
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+}
 
-    // 更新状态
-    status_.current_file = new_path;
-    status_.file_size = 0;
+std::string FFmpegRecorder::segmentPath(int index) const {
+    if (index == 0) {
+        return segment_base_path_;
+    }
 
-    LOG_INFO("创建新的分段文件: " + new_path, "FFmpegRecorder");
-    return true;
+    // 以第一个文件为基础
+    fs::path base(segment_base_path_);
+    return (base.parent_path() / (base.stem().string() + "_part" + std::to_string(index) +
+                                  base.extension().string())).string();
 }
 
 std::string FFmpegRecorder::generateFileName() {
@@ -696,12 +1554,14 @@ std::string FFmpegRecorder::generateFileName() {
     }
 
     // 添加扩展名
-    std::string extension = ".mp4";
+    std::string extension = config_.mode == RecordingMode::STREAM_COPY ? ".mkv" : ".mp4";
     if (!config_.container_format.empty()) {
         if (config_.container_format == "matroska") {
             extension = ".mkv";
         } else if (config_.container_format == "avi") {
             extension = ".avi";
+        } else if (config_.container_format == "mov") {
+            extension = ".mov";
         }
     }
 
@@ -1,4 +1,6 @@
 #include "video/i_video_splitter.h"
+#include "video/jpeg_encoder_pool.h"
+#include "video/keyframe_index.h"
 #include "utils/file_utils.h"
 #include "utils/string_utils.h"
 #include "monitor/logger.h"
@@ -10,7 +12,9 @@ extern "C" {
 #include <libswscale/swscale.h>
 }
 
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
 #include <thread>
 #include <filesystem>
 #include <random>
@@ -23,6 +27,31 @@ namespace fs = std::filesystem;
 namespace cam_server {
 namespace video {
 
+namespace {
+
+// 按字节定位后核对关键帧时间的容差，MKV的时间戳精度为毫秒
+constexpr int64_t kSeekToleranceUs = 1000;
+
+std::string errorString(int err) {
+    char err_buf[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(err, err_buf, AV_ERROR_MAX_STRING_SIZE);
+    return err_buf;
+}
+
+// 流时间戳换算为文件内时间（微秒）
+int64_t streamTimeUs(const AVStream* stream, int64_t timestamp) {
+    int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    return av_rescale_q(timestamp - start, stream->time_base, AVRational{1, AV_TIME_BASE});
+}
+
+// 文件内时间（微秒）换算为流时间戳
+int64_t usToStreamTime(const AVStream* stream, int64_t time_us) {
+    int64_t start = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    return start + av_rescale_q(time_us, AVRational{1, AV_TIME_BASE}, stream->time_base);
+}
+
+} // namespace
+
 class FFmpegSplitter : public IVideoSplitter {
 public:
     FFmpegSplitter();
@@ -36,6 +65,10 @@ public:
     std::vector<SplitTaskStatus> getAllTaskStatus() const override;
     void setStatusCallback(std::function<void(const SplitTaskStatus&)> callback) override;
     int cleanupCompletedTasks(int keepLastN = 0) override;
+    bool extractFrameAt(const std::string& input_path, double seconds,
+                        std::vector<uint8_t>& jpeg_data, int quality = 90) override;
+    bool exportClip(const std::string& input_path, double start_seconds, double end_seconds,
+                    const std::string& output_path) override;
 
 private:
     // 分帧任务结构体
@@ -65,6 +98,18 @@ private:
                            double timestamp, int width, int height, const std::string& format, int quality);
     // 生成缩略图
     bool generateThumbnail(const std::string& imagePath, const std::string& thumbnailPath, int size);
+    // 打开输入文件并查找视频流
+    bool openInput(const std::string& path, AVFormatContext*& format_context, int& stream_index);
+    // 打开视频流的解码器
+    AVCodecContext* openDecoder(const AVStream* stream);
+    // 定位到目标时间之前的关键帧，有关键帧索引时按索引定位，否则依赖容器自身的索引
+    bool seekToKeyframe(AVFormatContext* format_context, int stream_index, const KeyframeIndex& index,
+                        int64_t target_us);
+    // 按索引中的文件偏移定位，并确认读到的第一个视频包就是该关键帧
+    bool seekToByteOffset(AVFormatContext* format_context, int stream_index, const KeyframeEntry& keyframe);
+    // 从当前位置解码到不早于目标时间的第一帧
+    bool decodeUntil(AVFormatContext* format_context, int stream_index, AVCodecContext* codec_context,
+                     int64_t target_us, AVFrame* frame);
 
     // 任务列表
     std::vector<std::shared_ptr<SplitTask>> tasks_;
@@ -567,7 +612,23 @@ void FFmpegSplitter::executeTask(std::shared_ptr<SplitTask> task) {
     int frame_count = 0;
     int image_count = 0;
 
+    // 有关键帧索引时，两次提取之间隔着完整的GOP就直接跳到下一次提取之前的关键帧
+    KeyframeIndex index;
+    bool indexed = index.load(task->config.input_path);
+    int64_t decoded_us = -1;
+    int64_t last_seek_us = -1;
+
     while (!task->cancelFlag) {
+        if (indexed && next_timestamp > 0.0) {
+            const KeyframeEntry* keyframe = index.findByMediaTime(static_cast<int64_t>(next_timestamp * 1000000));
+            if (keyframe && keyframe->media_time_us > decoded_us && keyframe->media_time_us > last_seek_us) {
+                last_seek_us = keyframe->media_time_us;
+                if (seekToKeyframe(format_context, video_stream_index, index, keyframe->media_time_us)) {
+                    avcodec_flush_buffers(codec_context);
+                }
+            }
+        }
+
         // 读取一个包
         ret = av_read_frame(format_context, packet);
         if (ret < 0) {
@@ -600,6 +661,7 @@ void FFmpegSplitter::executeTask(std::shared_ptr<SplitTask> task) {
 
             // 计算时间戳
             double timestamp = frame->pts * av_q2d(video_stream->time_base);
+            decoded_us = static_cast<int64_t>(timestamp * 1000000);
 
             // 检查是否需要提取此帧
             if (timestamp >= next_timestamp) {
@@ -642,7 +704,9 @@ void FFmpegSplitter::executeTask(std::shared_ptr<SplitTask> task) {
             // 更新进度
             task->status.processed_frames = frame_count;
             task->status.generated_images = image_count;
-            task->status.progress = static_cast<double>(frame_count) / task->status.total_frames;
+            task->status.progress = indexed && duration > 0.0
+                                        ? std::min(1.0, timestamp / duration)
+                                        : static_cast<double>(frame_count) / task->status.total_frames;
             updateTaskStatus(task->taskId, task->status);
 
             av_frame_unref(frame);
@@ -859,6 +923,331 @@ bool FFmpegSplitter::generateThumbnail(const std::string& imagePath, const std::
     return true;
 }
 
+bool FFmpegSplitter::extractFrameAt(const std::string& input_path, double seconds,
+                                    std::vector<uint8_t>& jpeg_data, int quality) {
+    auto begin = std::chrono::steady_clock::now();
+
+    AVFormatContext* format_context = nullptr;
+    int stream_index = -1;
+    if (!openInput(input_path, format_context, stream_index)) {
+        return false;
+    }
+    AVStream* stream = format_context->streams[stream_index];
+    AVCodecContext* codec_context = openDecoder(stream);
+    AVFrame* frame = av_frame_alloc();
+    if (!codec_context || !frame) {
+        av_frame_free(&frame);
+        avcodec_free_context(&codec_context);
+        avformat_close_input(&format_context);
+        return false;
+    }
+
+    // 从目标之前的关键帧开始解码到目标时间
+    KeyframeIndex index;
+    bool indexed = index.load(input_path);
+    int64_t target_us = static_cast<int64_t>(seconds * 1000000);
+    bool ok = seekToKeyframe(format_context, stream_index, index, target_us) &&
+              decodeUntil(format_context, stream_index, codec_context, target_us, frame);
+    if (!ok) {
+        LOG_ERROR("无法提取 " + std::to_string(seconds) + " 秒处的帧: " + input_path, "FFmpegSplitter");
+    }
+
+    // 转换为RGB后编码为JPEG
+    if (ok) {
+        std::vector<uint8_t> rgb(static_cast<size_t>(frame->width) * frame->height * 3);
+        SwsContext* sws_context = sws_getContext(frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                                                 frame->width, frame->height, AV_PIX_FMT_RGB24,
+                                                 SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (sws_context) {
+            uint8_t* dst_data[4] = {rgb.data(), nullptr, nullptr, nullptr};
+            int dst_linesize[4] = {frame->width * 3, 0, 0, 0};
+            sws_scale(sws_context, frame->data, frame->linesize, 0, frame->height, dst_data, dst_linesize);
+            sws_freeContext(sws_context);
+            camera::Frame image(frame->width, frame->height, camera::PixelFormat::RGB24, std::move(rgb));
+            ok = JpegEncoderPool::getInstance().encode(image, quality, jpeg_data);
+        } else {
+            LOG_ERROR("无法创建SwsContext", "FFmpegSplitter");
+            ok = false;
+        }
+    }
+
+    av_frame_free(&frame);
+    avcodec_free_context(&codec_context);
+    avformat_close_input(&format_context);
+
+    if (ok) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+        LOG_DEBUG("提取帧: " + input_path + " @" + std::to_string(seconds) + "s" +
+                  (indexed ? "（关键帧索引）" : "") + ", 耗时 " + std::to_string(elapsed.count()) + "ms",
+                  "FFmpegSplitter");
+    }
+    return ok;
+}
+
+bool FFmpegSplitter::exportClip(const std::string& input_path, double start_seconds, double end_seconds,
+                                const std::string& output_path) {
+    if (end_seconds <= start_seconds) {
+        LOG_ERROR("片段终点必须晚于起点", "FFmpegSplitter");
+        return false;
+    }
+    auto begin = std::chrono::steady_clock::now();
+
+    AVFormatContext* input_context = nullptr;
+    int stream_index = -1;
+    if (!openInput(input_path, input_context, stream_index)) {
+        return false;
+    }
+    AVStream* input_stream = input_context->streams[stream_index];
+
+    // 定位到起点之前的关键帧，片段从关键帧开始才能独立播放
+    KeyframeIndex index;
+    index.load(input_path);
+    int64_t start_us = static_cast<int64_t>(start_seconds * 1000000);
+    int64_t end_us = static_cast<int64_t>(end_seconds * 1000000);
+    if (!seekToKeyframe(input_context, stream_index, index, start_us)) {
+        avformat_close_input(&input_context);
+        return false;
+    }
+
+    // 创建输出文件，流参数直接复制
+    AVFormatContext* output_context = nullptr;
+    int ret = avformat_alloc_output_context2(&output_context, nullptr, nullptr, output_path.c_str());
+    if (ret < 0 || !output_context) {
+        LOG_ERROR("无法创建输出格式上下文: " + errorString(ret), "FFmpegSplitter");
+        avformat_close_input(&input_context);
+        return false;
+    }
+    AVStream* output_stream = avformat_new_stream(output_context, nullptr);
+    ret = output_stream ? avcodec_parameters_copy(output_stream->codecpar, input_stream->codecpar) : AVERROR(ENOMEM);
+    if (ret >= 0) {
+        output_stream->codecpar->codec_tag = 0;
+        output_stream->time_base = input_stream->time_base;
+        if (!(output_context->oformat->flags & AVFMT_NOFILE)) {
+            ret = avio_open(&output_context->pb, output_path.c_str(), AVIO_FLAG_WRITE);
+        }
+    }
+    if (ret >= 0) {
+        ret = avformat_write_header(output_context, nullptr);
+    }
+    if (ret < 0) {
+        LOG_ERROR("无法创建片段文件: " + errorString(ret), "FFmpegSplitter");
+        if (output_context->pb) {
+            avio_closep(&output_context->pb);
+        }
+        avformat_free_context(output_context);
+        avformat_close_input(&input_context);
+        return false;
+    }
+
+    // 复制压缩数据到终点，时间戳从0开始
+    AVPacket* packet = av_packet_alloc();
+    int64_t first_ts = AV_NOPTS_VALUE;
+    int packets = 0;
+    while (packet && av_read_frame(input_context, packet) >= 0) {
+        if (packet->stream_index != stream_index) {
+            av_packet_unref(packet);
+            continue;
+        }
+        int64_t ts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+        if (first_ts == AV_NOPTS_VALUE) {
+            if (ts == AV_NOPTS_VALUE || !(packet->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(packet);
+                continue;
+            }
+            first_ts = ts;
+        }
+        if (ts != AV_NOPTS_VALUE && streamTimeUs(input_stream, ts) > end_us) {
+            av_packet_unref(packet);
+            break;
+        }
+        if (packet->pts != AV_NOPTS_VALUE) {
+            packet->pts -= first_ts;
+        }
+        if (packet->dts != AV_NOPTS_VALUE) {
+            packet->dts -= first_ts;
+        }
+        packet->stream_index = output_stream->index;
+        av_packet_rescale_ts(packet, input_stream->time_base, output_stream->time_base);
+        packet->pos = -1;
+        ret = av_interleaved_write_frame(output_context, packet);
+        av_packet_unref(packet);
+        if (ret < 0) {
+            LOG_ERROR("写入片段失败: " + errorString(ret), "FFmpegSplitter");
+            break;
+        }
+        packets++;
+    }
+    av_packet_free(&packet);
+
+    bool ok = ret >= 0 && packets > 0 && av_write_trailer(output_context) >= 0;
+    if (!(output_context->oformat->flags & AVFMT_NOFILE)) {
+        avio_closep(&output_context->pb);
+    }
+    avformat_free_context(output_context);
+    avformat_close_input(&input_context);
+
+    if (!ok) {
+        LOG_ERROR("导出片段失败: " + input_path, "FFmpegSplitter");
+        std::error_code ec;
+        fs::remove(output_path, ec);
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin);
+    LOG_INFO("导出片段: " + output_path + ", " + std::to_string(packets) + "个包, 耗时 " +
+             std::to_string(elapsed.count()) + "ms", "FFmpegSplitter");
+    return true;
+}
+
+bool FFmpegSplitter::openInput(const std::string& path, AVFormatContext*& format_context, int& stream_index) {
+    format_context = nullptr;
+    int ret = avformat_open_input(&format_context, path.c_str(), nullptr, nullptr);
+    if (ret < 0) {
+        LOG_ERROR("无法打开输入文件: " + errorString(ret), "FFmpegSplitter");
+        return false;
+    }
+
+    ret = avformat_find_stream_info(format_context, nullptr);
+    if (ret < 0) {
+        LOG_ERROR("无法获取流信息: " + errorString(ret), "FFmpegSplitter");
+        avformat_close_input(&format_context);
+        return false;
+    }
+
+    stream_index = -1;
+    for (unsigned int i = 0; i < format_context->nb_streams; i++) {
+        if (format_context->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            stream_index = static_cast<int>(i);
+            break;
+        }
+    }
+    if (stream_index < 0) {
+        LOG_ERROR("未找到视频流", "FFmpegSplitter");
+        avformat_close_input(&format_context);
+        return false;
+    }
+
+    return true;
+}
+
+AVCodecContext* FFmpegSplitter::openDecoder(const AVStream* stream) {
+    const AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!codec) {
+        LOG_ERROR("未找到解码器", "FFmpegSplitter");
+        return nullptr;
+    }
+
+    AVCodecContext* codec_context = avcodec_alloc_context3(codec);
+    if (!codec_context) {
+        LOG_ERROR("无法创建解码器上下文", "FFmpegSplitter");
+        return nullptr;
+    }
+
+    int ret = avcodec_parameters_to_context(codec_context, stream->codecpar);
+    if (ret >= 0) {
+        ret = avcodec_open2(codec_context, codec, nullptr);
+    }
+    if (ret < 0) {
+        LOG_ERROR("无法打开解码器: " + errorString(ret), "FFmpegSplitter");
+        avcodec_free_context(&codec_context);
+        return nullptr;
+    }
+
+    return codec_context;
+}
+
+bool FFmpegSplitter::seekToKeyframe(AVFormatContext* format_context, int stream_index, const KeyframeIndex& index,
+                                    int64_t target_us) {
+    AVStream* stream = format_context->streams[stream_index];
+    const KeyframeEntry* keyframe = index.findByMediaTime(target_us);
+    if (keyframe) {
+        // 支持按字节定位的容器直接跳到关键帧，不依赖容器自身的索引（异常退出的MKV没有Cues）
+        if (!(format_context->iformat->flags & AVFMT_NO_BYTE_SEEK) &&
+            seekToByteOffset(format_context, stream_index, *keyframe)) {
+            return true;
+        }
+        // 否则按关键帧的准确时间定位
+        target_us = keyframe->media_time_us;
+    }
+
+    int ret = av_seek_frame(format_context, stream_index, usToStreamTime(stream, target_us), AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+        LOG_ERROR("无法定位到 " + std::to_string(target_us / 1000) + "ms: " + errorString(ret), "FFmpegSplitter");
+        return false;
+    }
+    return true;
+}
+
+bool FFmpegSplitter::seekToByteOffset(AVFormatContext* format_context, int stream_index,
+                                      const KeyframeEntry& keyframe) {
+    if (av_seek_frame(format_context, -1, keyframe.byte_offset, AVSEEK_FLAG_BYTE) < 0) {
+        return false;
+    }
+
+    // 偏移不在簇或分片开头时解封装器会跳到后面，第一个视频包不是该关键帧
+    AVStream* stream = format_context->streams[stream_index];
+    AVPacket* packet = av_packet_alloc();
+    bool landed = false;
+    while (packet && av_read_frame(format_context, packet) >= 0) {
+        if (packet->stream_index == stream_index) {
+            int64_t ts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            landed = (packet->flags & AV_PKT_FLAG_KEY) && ts != AV_NOPTS_VALUE &&
+                     std::llabs(streamTimeUs(stream, ts) - keyframe.media_time_us) <= kSeekToleranceUs;
+            av_packet_unref(packet);
+            break;
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+
+    // 回到同一位置，调用方从关键帧开始读取
+    return landed && av_seek_frame(format_context, -1, keyframe.byte_offset, AVSEEK_FLAG_BYTE) >= 0;
+}
+
+bool FFmpegSplitter::decodeUntil(AVFormatContext* format_context, int stream_index, AVCodecContext* codec_context,
+                                 int64_t target_us, AVFrame* frame) {
+    AVStream* stream = format_context->streams[stream_index];
+    AVPacket* packet = av_packet_alloc();
+    if (!packet) {
+        return false;
+    }
+
+    avcodec_flush_buffers(codec_context);
+    bool found = false;
+    bool draining = false;
+    while (!found) {
+        if (!draining) {
+            int ret = av_read_frame(format_context, packet);
+            if (ret < 0) {
+                // 文件结束，取出解码器中缓存的帧
+                draining = true;
+                avcodec_send_packet(codec_context, nullptr);
+            } else if (packet->stream_index != stream_index) {
+                av_packet_unref(packet);
+                continue;
+            } else {
+                avcodec_send_packet(codec_context, packet);
+                av_packet_unref(packet);
+            }
+        }
+
+        while (!found && avcodec_receive_frame(codec_context, frame) >= 0) {
+            int64_t ts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+            if (ts != AV_NOPTS_VALUE && streamTimeUs(stream, ts) >= target_us) {
+                found = true;
+            } else {
+                av_frame_unref(frame);
+            }
+        }
+        if (draining) {
+            break;
+        }
+    }
+
+    av_packet_free(&packet);
+    return found;
+}
+
 // 工厂函数实现
 std::shared_ptr<IVideoSplitter> createFFmpegSplitter() {
     return std::make_shared<FFmpegSplitter>();
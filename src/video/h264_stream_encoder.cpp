@@ -0,0 +1,344 @@
+#include "video/h264_stream_encoder.h"
+#include "video/jpeg_encoder_pool.h"
+#include "monitor/logger.h"
+
+#include <algorithm>
+#include <cstdio>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+namespace cam_server {
+namespace video {
+
+namespace {
+
+// H.264 NAL单元类型：序列参数集
+constexpr uint8_t kNalSps = 7;
+
+AVPixelFormat toAVPixelFormat(camera::PixelFormat format) {
+    switch (format) {
+        case camera::PixelFormat::YUYV:
+            return AV_PIX_FMT_YUYV422;
+        case camera::PixelFormat::NV12:
+            return AV_PIX_FMT_NV12;
+        case camera::PixelFormat::YUV420P:
+            return AV_PIX_FMT_YUV420P;
+        case camera::PixelFormat::RGB24:
+            return AV_PIX_FMT_RGB24;
+        case camera::PixelFormat::BGR24:
+            return AV_PIX_FMT_BGR24;
+        default:
+            return AV_PIX_FMT_NONE;
+    }
+}
+
+std::string errorString(int err) {
+    char error_buf[AV_ERROR_MAX_STRING_SIZE];
+    av_strerror(err, error_buf, AV_ERROR_MAX_STRING_SIZE);
+    return error_buf;
+}
+
+// 查找指定类型的NAL单元，返回NAL头的位置
+const uint8_t* findNal(const uint8_t* data, size_t size, uint8_t type) {
+    for (size_t i = 0; i + 3 < size; ++i) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            if ((data[i + 3] & 0x1F) == type) {
+                return data + i + 3;
+            }
+            i += 2;
+        }
+    }
+    return nullptr;
+}
+
+// 编码器优先选择的像素格式
+AVPixelFormat chooseInputFormat(const AVCodec* codec) {
+    if (!codec->pix_fmts) {
+        return AV_PIX_FMT_YUV420P;
+    }
+    for (const AVPixelFormat* fmt = codec->pix_fmts; *fmt != AV_PIX_FMT_NONE; ++fmt) {
+        if (*fmt == AV_PIX_FMT_YUV420P) {
+            return *fmt;
+        }
+    }
+    return codec->pix_fmts[0];
+}
+
+} // namespace
+
+H264StreamEncoder::H264StreamEncoder()
+    : codec_ctx_(nullptr),
+      sws_ctx_(nullptr),
+      frame_(nullptr),
+      packet_(nullptr),
+      src_width_(0),
+      src_height_(0),
+      src_format_(AV_PIX_FMT_NONE),
+      out_width_(0),
+      out_height_(0),
+      pts_(0) {
+}
+
+H264StreamEncoder::~H264StreamEncoder() {
+    close();
+}
+
+bool H264StreamEncoder::open(int width, int height, camera::PixelFormat format) {
+    close();
+
+    AVPixelFormat src_format = toAVPixelFormat(format);
+    if (src_format == AV_PIX_FMT_NONE || width < 2 || height < 2) {
+        LOG_ERROR("不支持的H.264编码输入: " + std::to_string(width) + "x" + std::to_string(height) +
+                  ", 格式: " + std::to_string(static_cast<int>(format)), "H264StreamEncoder");
+        return false;
+    }
+    // 4:2:0采样要求宽高为偶数
+    int out_width = width & ~1;
+    int out_height = height & ~1;
+    int fps = std::max(1, config_.fps);
+
+    std::vector<const AVCodec*> candidates;
+    if (!config_.encoder_name.empty()) {
+        candidates.push_back(avcodec_find_encoder_by_name(config_.encoder_name.c_str()));
+    } else {
+        for (const char* name : {"libx264", "h264_rkmpp", "h264_v4l2m2m"}) {
+            candidates.push_back(avcodec_find_encoder_by_name(name));
+        }
+        candidates.push_back(avcodec_find_encoder(AV_CODEC_ID_H264));
+    }
+
+    for (const AVCodec* codec : candidates) {
+        if (!codec) {
+            continue;
+        }
+        codec_ctx_ = avcodec_alloc_context3(codec);
+        if (!codec_ctx_) {
+            LOG_ERROR("无法创建编码器上下文", "H264StreamEncoder");
+            return false;
+        }
+        codec_ctx_->width = out_width;
+        codec_ctx_->height = out_height;
+        codec_ctx_->pix_fmt = chooseInputFormat(codec);
+        codec_ctx_->time_base = AVRational{1, fps};
+        codec_ctx_->framerate = AVRational{fps, 1};
+        codec_ctx_->gop_size = std::max(1, config_.gop);
+        codec_ctx_->max_b_frames = 0;  // B帧会增加延迟
+        codec_ctx_->flags |= AV_CODEC_FLAG_LOW_DELAY;
+        codec_ctx_->bit_rate = config_.bitrate > 0 ? config_.bitrate
+                                                   : static_cast<int64_t>(out_width) * out_height * fps / 20;
+        codec_ctx_->rc_max_rate = codec_ctx_->bit_rate;
+        codec_ctx_->rc_buffer_size = static_cast<int>(codec_ctx_->bit_rate);
+
+        AVDictionary* options = nullptr;
+        if (std::string(codec->name) == "libx264") {
+            // zerolatency关闭前瞻和帧缓冲，baseline档次所有浏览器都能解码
+            av_dict_set(&options, "preset", "ultrafast", 0);
+            av_dict_set(&options, "tune", "zerolatency", 0);
+            av_dict_set(&options, "profile", "baseline", 0);
+            av_dict_set(&options, "forced-idr", "1", 0);
+        }
+        int ret = avcodec_open2(codec_ctx_, codec, &options);
+        av_dict_free(&options);
+        if (ret < 0) {
+            LOG_WARNING("无法打开H.264编码器 " + std::string(codec->name) + ": " + errorString(ret),
+                        "H264StreamEncoder");
+            avcodec_free_context(&codec_ctx_);
+            continue;
+        }
+        encoder_name_ = codec->name;
+        break;
+    }
+    if (!codec_ctx_) {
+        LOG_ERROR("没有可用的H.264编码器", "H264StreamEncoder");
+        return false;
+    }
+
+    // 只在extradata中给出参数集的编码器，关键帧前要补上
+    extradata_.clear();
+    if (codec_ctx_->extradata && codec_ctx_->extradata_size > 4 &&
+        findNal(codec_ctx_->extradata, codec_ctx_->extradata_size, kNalSps)) {
+        extradata_.assign(codec_ctx_->extradata, codec_ctx_->extradata + codec_ctx_->extradata_size);
+    }
+
+    sws_ctx_ = sws_getContext(width, height, src_format, out_width, out_height, codec_ctx_->pix_fmt,
+                              SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+    frame_ = av_frame_alloc();
+    packet_ = av_packet_alloc();
+    if (!sws_ctx_ || !frame_ || !packet_) {
+        LOG_ERROR("无法分配H.264编码缓冲区", "H264StreamEncoder");
+        close();
+        return false;
+    }
+    frame_->width = out_width;
+    frame_->height = out_height;
+    frame_->format = codec_ctx_->pix_fmt;
+    int ret = av_frame_get_buffer(frame_, 0);
+    if (ret < 0) {
+        LOG_ERROR("无法分配H.264图像缓冲区: " + errorString(ret), "H264StreamEncoder");
+        close();
+        return false;
+    }
+
+    src_width_ = width;
+    src_height_ = height;
+    src_format_ = src_format;
+    out_width_ = out_width;
+    out_height_ = out_height;
+    pts_ = 0;
+    codec_string_.clear();
+    LOG_INFO("H.264流编码器已打开: " + encoder_name_ + " " + std::to_string(out_width) + "x" +
+             std::to_string(out_height) + "@" + std::to_string(fps) + ", 码率: " +
+             std::to_string(codec_ctx_->bit_rate), "H264StreamEncoder");
+    return true;
+}
+
+bool H264StreamEncoder::encode(const camera::Frame& frame, bool force_keyframe, std::vector<H264Packet>& packets) {
+    const camera::Frame* input = &frame;
+    if (frame.getFormat() == camera::PixelFormat::MJPEG) {
+        if (!JpegEncoderPool::getInstance().decode(frame, decoded_)) {
+            return false;
+        }
+        input = &decoded_;
+    }
+    if (input->isEmpty()) {
+        return false;
+    }
+
+    AVPixelFormat src_format = toAVPixelFormat(input->getFormat());
+    if (!codec_ctx_ || input->getWidth() != src_width_ || input->getHeight() != src_height_ ||
+        src_format != src_format_) {
+        if (!codec_ctx_ && input->getWidth() == src_width_ && input->getHeight() == src_height_ &&
+            src_format == src_format_) {
+            return false;  // 同样的输入已经打开失败过，不再每帧重试
+        }
+        if (!open(input->getWidth(), input->getHeight(), input->getFormat())) {
+            src_width_ = input->getWidth();
+            src_height_ = input->getHeight();
+            src_format_ = src_format;
+            return false;
+        }
+        force_keyframe = true;
+    }
+
+    size_t src_size = static_cast<size_t>(av_image_get_buffer_size(src_format, src_width_, src_height_, 1));
+    if (input->getDataSize() < src_size) {
+        LOG_ERROR("输入帧数据不完整: " + std::to_string(input->getDataSize()) + " < " + std::to_string(src_size),
+                  "H264StreamEncoder");
+        return false;
+    }
+
+    uint8_t* src_data[4] = {nullptr};
+    int src_linesize[4] = {0};
+    int ret = av_image_fill_arrays(src_data, src_linesize, input->getDataPtr(), src_format,
+                                   src_width_, src_height_, 1);
+    if (ret < 0) {
+        LOG_ERROR("无法解析输入图像: " + errorString(ret), "H264StreamEncoder");
+        return false;
+    }
+    ret = av_frame_make_writable(frame_);
+    if (ret < 0) {
+        LOG_ERROR("编码输入帧不可写: " + errorString(ret), "H264StreamEncoder");
+        return false;
+    }
+    sws_scale(sws_ctx_, src_data, src_linesize, 0, src_height_, frame_->data, frame_->linesize);
+    frame_->pts = pts_++;
+    frame_->pict_type = force_keyframe ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+
+    ret = avcodec_send_frame(codec_ctx_, frame_);
+    if (ret < 0) {
+        LOG_ERROR("发送帧到H.264编码器失败: " + errorString(ret), "H264StreamEncoder");
+        return false;
+    }
+
+    uint64_t timestamp_us = frame.getLineage().capture_time_us;
+    if (timestamp_us == 0) {
+        timestamp_us = frame.getMetadata().timestamp;
+    }
+    while (true) {
+        ret = avcodec_receive_packet(codec_ctx_, packet_);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            break;
+        }
+        if (ret < 0) {
+            LOG_ERROR("从H.264编码器接收数据失败: " + errorString(ret), "H264StreamEncoder");
+            return false;
+        }
+
+        H264Packet packet;
+        packet.keyframe = (packet_->flags & AV_PKT_FLAG_KEY) != 0;
+        packet.timestamp_us = timestamp_us;
+        auto data = std::make_shared<std::vector<uint8_t>>();
+        bool prepend = packet.keyframe && !extradata_.empty() && !findNal(packet_->data, packet_->size, kNalSps);
+        data->reserve(packet_->size + (prepend ? extradata_.size() : 0));
+        if (prepend) {
+            data->insert(data->end(), extradata_.begin(), extradata_.end());
+        }
+        data->insert(data->end(), packet_->data, packet_->data + packet_->size);
+        av_packet_unref(packet_);
+
+        if (packet.keyframe && codec_string_.empty()) {
+            codec_string_ = codecStringFromAnnexB(data->data(), data->size());
+        }
+        packet.data = std::move(data);
+        packets.push_back(std::move(packet));
+    }
+    return true;
+}
+
+void H264StreamEncoder::close() {
+    if (packet_) {
+        av_packet_free(&packet_);
+    }
+    if (frame_) {
+        av_frame_free(&frame_);
+    }
+    if (sws_ctx_) {
+        sws_freeContext(sws_ctx_);
+        sws_ctx_ = nullptr;
+    }
+    if (codec_ctx_) {
+        avcodec_free_context(&codec_ctx_);
+    }
+    extradata_.clear();
+    src_width_ = 0;
+    src_height_ = 0;
+    src_format_ = AV_PIX_FMT_NONE;
+    out_width_ = 0;
+    out_height_ = 0;
+}
+
+std::string H264StreamEncoder::codecStringFromAnnexB(const uint8_t* data, size_t size) {
+    const uint8_t* sps = findNal(data, size, kNalSps);
+    if (!sps || sps + 4 > data + size) {
+        return "";
+    }
+    // SPS头之后依次为profile_idc、约束标志和level_idc
+    char codec[16];
+    std::snprintf(codec, sizeof(codec), "avc1.%02x%02x%02x", sps[1], sps[2], sps[3]);
+    return codec;
+}
+
+H264GopCache::H264GopCache(size_t max_packets)
+    : max_packets_(std::max<size_t>(1, max_packets)) {
+}
+
+void H264GopCache::push(const H264Packet& packet) {
+    if (packet.keyframe) {
+        packets_.clear();
+    } else if (packets_.empty()) {
+        return;  // 没有关键帧的P帧无法单独解码
+    }
+    if (packets_.size() >= max_packets_) {
+        // GOP过长，缓存到下一个关键帧为止都不可用
+        packets_.clear();
+        return;
+    }
+    packets_.push_back(packet);
+}
+
+} // namespace video
+} // namespace cam_server
@@ -0,0 +1,476 @@
+#include "video/jpeg_encoder_pool.h"
+#include "monitor/logger.h"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+namespace cam_server {
+namespace video {
+
+namespace {
+
+// 默认空闲编码器上限，覆盖几路摄像头各自的分辨率和质量组合
+constexpr size_t kDefaultMaxIdle = 8;
+
+AVPixelFormat toAVPixelFormat(camera::PixelFormat format) {
+    switch (format) {
+        case camera::PixelFormat::YUYV:
+            return AV_PIX_FMT_YUYV422;
+        case camera::PixelFormat::NV12:
+            return AV_PIX_FMT_NV12;
+        case camera::PixelFormat::YUV420P:
+            return AV_PIX_FMT_YUV420P;
+        case camera::PixelFormat::RGB24:
+            return AV_PIX_FMT_RGB24;
+        case camera::PixelFormat::BGR24:
+            return AV_PIX_FMT_BGR24;
+        default:
+            return AV_PIX_FMT_NONE;
+    }
+}
+
+std::string errorString(int err) {
+    char error_buf[AV_ERROR_MAX_STRING_SIZE];
+    av_strerror(err, error_buf, AV_ERROR_MAX_STRING_SIZE);
+    return error_buf;
+}
+
+} // namespace
+
+JpegEncoder::JpegEncoder()
+    : codec_ctx_(nullptr),
+      sws_ctx_(nullptr),
+      frame_(nullptr),
+      packet_(nullptr),
+      width_(0),
+      height_(0),
+      src_format_(AV_PIX_FMT_NONE),
+      src_size_(0),
+      pts_(0) {
+}
+
+JpegEncoder::~JpegEncoder() {
+    close();
+}
+
+bool JpegEncoder::isSupported(camera::PixelFormat format) {
+    return toAVPixelFormat(format) != AV_PIX_FMT_NONE;
+}
+
+int JpegEncoder::qualityToQscale(int quality) {
+    quality = std::max(1, std::min(100, quality));
+    return 2 + (100 - quality) * 29 / 99;
+}
+
+bool JpegEncoder::open(int width, int height, camera::PixelFormat format, int quality,
+                       int out_width, int out_height) {
+    close();
+
+    if (out_width <= 0 || out_height <= 0) {
+        out_width = width;
+        out_height = height;
+    }
+
+    AVPixelFormat src_format = toAVPixelFormat(format);
+    if (src_format == AV_PIX_FMT_NONE || width <= 0 || height <= 0) {
+        LOG_ERROR("不支持的JPEG编码输入: " + std::to_string(width) + "x" + std::to_string(height) +
+                  ", 格式: " + std::to_string(static_cast<int>(format)), "JpegEncoder");
+        return false;
+    }
+    // YUYV保持4:2:2采样，其他格式编码为4:2:0
+    AVPixelFormat dst_format = format == camera::PixelFormat::YUYV ? AV_PIX_FMT_YUVJ422P : AV_PIX_FMT_YUVJ420P;
+
+    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    if (!codec) {
+        LOG_ERROR("找不到MJPEG编码器", "JpegEncoder");
+        return false;
+    }
+
+    codec_ctx_ = avcodec_alloc_context3(codec);
+    if (!codec_ctx_) {
+        LOG_ERROR("无法创建编码器上下文", "JpegEncoder");
+        return false;
+    }
+    codec_ctx_->width = out_width;
+    codec_ctx_->height = out_height;
+    codec_ctx_->time_base = AVRational{1, 25};
+    codec_ctx_->pix_fmt = dst_format;
+    codec_ctx_->flags |= AV_CODEC_FLAG_QSCALE;
+    codec_ctx_->global_quality = FF_QP2LAMBDA * qualityToQscale(quality);
+    // 并行由池中的多个编码器提供，单个编码器不再开线程
+    codec_ctx_->thread_count = 1;
+
+    int ret = avcodec_open2(codec_ctx_, codec, nullptr);
+    if (ret < 0) {
+        LOG_ERROR("无法打开编码器: " + errorString(ret), "JpegEncoder");
+        close();
+        return false;
+    }
+
+    sws_ctx_ = sws_getContext(width, height, src_format, out_width, out_height, dst_format,
+                              SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+    if (!sws_ctx_) {
+        LOG_ERROR("无法创建图像转换上下文", "JpegEncoder");
+        close();
+        return false;
+    }
+
+    frame_ = av_frame_alloc();
+    packet_ = av_packet_alloc();
+    if (!frame_ || !packet_) {
+        LOG_ERROR("无法分配帧缓冲区", "JpegEncoder");
+        close();
+        return false;
+    }
+    frame_->width = out_width;
+    frame_->height = out_height;
+    frame_->format = dst_format;
+    ret = av_frame_get_buffer(frame_, 0);
+    if (ret < 0) {
+        LOG_ERROR("无法分配JPEG图像缓冲区: " + errorString(ret), "JpegEncoder");
+        close();
+        return false;
+    }
+
+    width_ = width;
+    height_ = height;
+    src_format_ = src_format;
+    src_size_ = static_cast<size_t>(av_image_get_buffer_size(src_format, width, height, 1));
+    pts_ = 0;
+    return true;
+}
+
+bool JpegEncoder::encode(const uint8_t* data, size_t size, std::vector<uint8_t>& jpeg_data) {
+    if (!codec_ctx_ || !data) {
+        return false;
+    }
+    if (size < src_size_) {
+        LOG_ERROR("输入帧数据不完整: " + std::to_string(size) + " < " + std::to_string(src_size_), "JpegEncoder");
+        return false;
+    }
+
+    // 直接引用输入数据，不再复制到中间缓冲区
+    uint8_t* src_data[4] = {nullptr};
+    int src_linesize[4] = {0};
+    int ret = av_image_fill_arrays(src_data, src_linesize, data, static_cast<AVPixelFormat>(src_format_),
+                                   width_, height_, 1);
+    if (ret < 0) {
+        LOG_ERROR("无法解析输入图像: " + errorString(ret), "JpegEncoder");
+        return false;
+    }
+
+    ret = av_frame_make_writable(frame_);
+    if (ret < 0) {
+        LOG_ERROR("编码输入帧不可写: " + errorString(ret), "JpegEncoder");
+        return false;
+    }
+    if (sws_scale(sws_ctx_, src_data, src_linesize, 0, height_, frame_->data, frame_->linesize) <= 0) {
+        LOG_ERROR("颜色空间转换失败", "JpegEncoder");
+        return false;
+    }
+    frame_->pts = pts_++;
+    frame_->quality = codec_ctx_->global_quality;
+
+    ret = avcodec_send_frame(codec_ctx_, frame_);
+    if (ret < 0) {
+        LOG_ERROR("发送帧到编码器失败: " + errorString(ret), "JpegEncoder");
+        return false;
+    }
+    ret = avcodec_receive_packet(codec_ctx_, packet_);
+    if (ret < 0) {
+        LOG_ERROR("从编码器接收数据失败: " + errorString(ret), "JpegEncoder");
+        return false;
+    }
+
+    jpeg_data.assign(packet_->data, packet_->data + packet_->size);
+    av_packet_unref(packet_);
+    return !jpeg_data.empty();
+}
+
+void JpegEncoder::close() {
+    if (packet_) {
+        av_packet_free(&packet_);
+    }
+    if (frame_) {
+        av_frame_free(&frame_);
+    }
+    if (sws_ctx_) {
+        sws_freeContext(sws_ctx_);
+        sws_ctx_ = nullptr;
+    }
+    if (codec_ctx_) {
+        avcodec_free_context(&codec_ctx_);
+    }
+    src_size_ = 0;
+}
+
+JpegDecoder::JpegDecoder()
+    : codec_ctx_(nullptr),
+      sws_ctx_(nullptr),
+      frame_(nullptr),
+      packet_(nullptr),
+      sws_width_(0),
+      sws_height_(0),
+      sws_format_(AV_PIX_FMT_NONE) {
+}
+
+JpegDecoder::~JpegDecoder() {
+    close();
+}
+
+bool JpegDecoder::open() {
+    const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+    if (!codec) {
+        LOG_ERROR("找不到MJPEG解码器", "JpegDecoder");
+        return false;
+    }
+    codec_ctx_ = avcodec_alloc_context3(codec);
+    frame_ = av_frame_alloc();
+    packet_ = av_packet_alloc();
+    if (!codec_ctx_ || !frame_ || !packet_) {
+        LOG_ERROR("无法分配解码器资源", "JpegDecoder");
+        close();
+        return false;
+    }
+    codec_ctx_->thread_count = 1;
+    int ret = avcodec_open2(codec_ctx_, codec, nullptr);
+    if (ret < 0) {
+        LOG_ERROR("无法打开解码器: " + errorString(ret), "JpegDecoder");
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool JpegDecoder::decode(const uint8_t* data, size_t size, camera::Frame& frame) {
+    if (!data || size == 0) {
+        return false;
+    }
+    if (!codec_ctx_ && !open()) {
+        return false;
+    }
+
+    // 包直接引用输入数据，不复制
+    packet_->data = const_cast<uint8_t*>(data);
+    packet_->size = static_cast<int>(size);
+    int ret = avcodec_send_packet(codec_ctx_, packet_);
+    packet_->data = nullptr;
+    packet_->size = 0;
+    if (ret < 0) {
+        LOG_ERROR("发送JPEG数据到解码器失败: " + errorString(ret), "JpegDecoder");
+        return false;
+    }
+    ret = avcodec_receive_frame(codec_ctx_, frame_);
+    if (ret < 0) {
+        LOG_ERROR("从解码器接收图像失败: " + errorString(ret), "JpegDecoder");
+        return false;
+    }
+
+    int width = frame_->width;
+    int height = frame_->height;
+    if (!sws_ctx_ || width != sws_width_ || height != sws_height_ || frame_->format != sws_format_) {
+        if (sws_ctx_) {
+            sws_freeContext(sws_ctx_);
+        }
+        sws_ctx_ = sws_getContext(width, height, static_cast<AVPixelFormat>(frame_->format),
+                                  width, height, AV_PIX_FMT_YUV420P,
+                                  SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+        if (!sws_ctx_) {
+            LOG_ERROR("无法创建图像转换上下文", "JpegDecoder");
+            av_frame_unref(frame_);
+            return false;
+        }
+        sws_width_ = width;
+        sws_height_ = height;
+        sws_format_ = frame_->format;
+    }
+
+    std::vector<uint8_t> yuv(static_cast<size_t>(av_image_get_buffer_size(AV_PIX_FMT_YUV420P, width, height, 1)));
+    uint8_t* dst_data[4] = {nullptr};
+    int dst_linesize[4] = {0};
+    av_image_fill_arrays(dst_data, dst_linesize, yuv.data(), AV_PIX_FMT_YUV420P, width, height, 1);
+    ret = sws_scale(sws_ctx_, frame_->data, frame_->linesize, 0, height, dst_data, dst_linesize);
+    av_frame_unref(frame_);
+    if (ret <= 0) {
+        LOG_ERROR("颜色空间转换失败", "JpegDecoder");
+        return false;
+    }
+
+    frame = camera::Frame(width, height, camera::PixelFormat::YUV420P, std::move(yuv));
+    return true;
+}
+
+void JpegDecoder::close() {
+    if (packet_) {
+        av_packet_free(&packet_);
+    }
+    if (frame_) {
+        av_frame_free(&frame_);
+    }
+    if (sws_ctx_) {
+        sws_freeContext(sws_ctx_);
+        sws_ctx_ = nullptr;
+    }
+    if (codec_ctx_) {
+        avcodec_free_context(&codec_ctx_);
+    }
+}
+
+JpegEncoderPool& JpegEncoderPool::getInstance() {
+    static JpegEncoderPool instance;
+    return instance;
+}
+
+JpegEncoderPool::JpegEncoderPool()
+    : max_idle_(kDefaultMaxIdle) {
+}
+
+bool JpegEncoderPool::encode(const camera::Frame& frame, int quality, std::vector<uint8_t>& jpeg_data,
+                             int out_width, int out_height) {
+    if (frame.isEmpty() || !JpegEncoder::isSupported(frame.getFormat())) {
+        return false;
+    }
+    if (out_width <= 0 || out_height <= 0) {
+        out_width = frame.getWidth();
+        out_height = frame.getHeight();
+    }
+
+    Key key{frame.getWidth(), frame.getHeight(), out_width, out_height, frame.getFormat(),
+            std::max(1, std::min(100, quality))};
+    std::unique_ptr<JpegEncoder> encoder = acquire(key);
+    if (!encoder) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.failures++;
+        return false;
+    }
+
+    bool success = encoder->encode(frame.getDataPtr(), frame.getDataSize(), jpeg_data);
+    if (success) {
+        release(key, std::move(encoder));
+    } else {
+        // 出错的编码器可能处于异常状态，直接丢弃
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.busy--;
+        stats_.failures++;
+    }
+    return success;
+}
+
+std::unique_ptr<JpegEncoder> JpegEncoderPool::acquire(const Key& key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(idle_.begin(), idle_.end(),
+                               [&key](const IdleEncoder& idle) { return idle.key == key; });
+        if (it != idle_.end()) {
+            std::unique_ptr<JpegEncoder> encoder = std::move(it->encoder);
+            idle_.erase(it);
+            stats_.busy++;
+            return encoder;
+        }
+    }
+
+    // 打开编码器较慢，在锁外进行
+    auto encoder = std::make_unique<JpegEncoder>();
+    if (!encoder->open(key.width, key.height, key.format, key.quality, key.out_width, key.out_height)) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.encoders_created++;
+    stats_.busy++;
+    LOG_DEBUG("新建JPEG编码器: " + std::to_string(key.width) + "x" + std::to_string(key.height) +
+              " -> " + std::to_string(key.out_width) + "x" + std::to_string(key.out_height) +
+              ", 格式: " + std::to_string(static_cast<int>(key.format)) +
+              ", 质量: " + std::to_string(key.quality), "JpegEncoderPool");
+    return encoder;
+}
+
+void JpegEncoderPool::release(const Key& key, std::unique_ptr<JpegEncoder> encoder) {
+    std::unique_ptr<JpegEncoder> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.busy--;
+        stats_.encodes++;
+        idle_.push_front(IdleEncoder{key, std::move(encoder)});
+        if (idle_.size() > max_idle_) {
+            evicted = std::move(idle_.back().encoder);
+            idle_.pop_back();
+            stats_.encoders_evicted++;
+        }
+    }
+    // evicted在锁外析构
+}
+
+bool JpegEncoderPool::decode(const camera::Frame& jpeg, camera::Frame& frame) {
+    if (jpeg.isEmpty() || jpeg.getFormat() != camera::PixelFormat::MJPEG) {
+        return false;
+    }
+
+    std::unique_ptr<JpegDecoder> decoder;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_decoders_.empty()) {
+            decoder = std::move(idle_decoders_.back());
+            idle_decoders_.pop_back();
+        }
+    }
+    if (!decoder) {
+        decoder = std::make_unique<JpegDecoder>();
+    }
+
+    bool success = decoder->decode(jpeg.getDataPtr(), jpeg.getDataSize(), frame);
+    if (success) {
+        frame.setCameraId(jpeg.getCameraId());
+        frame.setMetadata(jpeg.getMetadata());
+        frame.setLineage(jpeg.getLineage());
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (success) {
+        stats_.decodes++;
+        if (idle_decoders_.size() < max_idle_) {
+            idle_decoders_.push_back(std::move(decoder));
+        }
+    } else {
+        // 出错的解码器可能处于异常状态，直接丢弃
+        stats_.failures++;
+    }
+    return success;
+}
+
+void JpegEncoderPool::setMaxIdle(size_t max_idle) {
+    std::list<IdleEncoder> evicted;
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_idle_ = max_idle;
+    while (idle_.size() > max_idle_) {
+        evicted.splice(evicted.begin(), idle_, std::prev(idle_.end()));
+        stats_.encoders_evicted++;
+    }
+}
+
+void JpegEncoderPool::clear() {
+    std::list<IdleEncoder> idle;
+    std::vector<std::unique_ptr<JpegDecoder>> idle_decoders;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle.swap(idle_);
+        idle_decoders.swap(idle_decoders_);
+    }
+}
+
+JpegEncoderPoolStats JpegEncoderPool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    JpegEncoderPoolStats stats = stats_;
+    stats.idle = idle_.size();
+    return stats;
+}
+
+} // namespace video
+} // namespace cam_server
@@ -0,0 +1,180 @@
+#include "video/keyframe_index.h"
+#include "monitor/logger.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace cam_server {
+namespace video {
+
+namespace {
+
+void writeBigEndian(char* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out[i] = static_cast<char>(value >> (8 * (bytes - 1 - i)));
+    }
+}
+
+uint64_t readBigEndian(const uint8_t* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+bool checkHeader(const uint8_t* header, size_t size) {
+    return size >= KeyframeIndex::HEADER_SIZE && header[0] == 'C' && header[1] == 'S' && header[2] == 'K' &&
+           header[3] == 'I' && header[4] != 0 && header[5] >= KeyframeIndex::ENTRY_SIZE;
+}
+
+KeyframeEntry readEntry(const uint8_t* item) {
+    KeyframeEntry entry;
+    entry.media_time_us = static_cast<int64_t>(readBigEndian(item, 8));
+    entry.byte_offset = static_cast<int64_t>(readBigEndian(item + 8, 8));
+    entry.wall_time_us = static_cast<int64_t>(readBigEndian(item + 16, 8));
+    return entry;
+}
+
+} // namespace
+
+std::string KeyframeIndex::sidecarPath(const std::string& video_path) {
+    return video_path + ".kfi";
+}
+
+bool KeyframeIndex::load(const std::string& video_path) {
+    entries_.clear();
+    max_interval_us_ = 0;
+
+    std::ifstream file(sidecarPath(video_path), std::ios::in | std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (!checkHeader(data.data(), data.size())) {
+        LOG_WARNING("关键帧索引格式不正确: " + sidecarPath(video_path), "KeyframeIndex");
+        return false;
+    }
+
+    // 末尾不完整的一项是录制中断时留下的，忽略
+    size_t entry_size = data[5];
+    size_t count = (data.size() - HEADER_SIZE) / entry_size;
+    entries_.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        KeyframeEntry entry = readEntry(data.data() + HEADER_SIZE + i * entry_size);
+        if (!entries_.empty()) {
+            max_interval_us_ = std::max(max_interval_us_, entry.media_time_us - entries_.back().media_time_us);
+        }
+        entries_.push_back(entry);
+    }
+    return !entries_.empty();
+}
+
+bool KeyframeIndex::readRange(const std::string& video_path, KeyframeEntry& first, KeyframeEntry& last) {
+    std::ifstream file(sidecarPath(video_path), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    std::streamoff file_size = file.tellg();
+    uint8_t header[HEADER_SIZE];
+    file.seekg(0);
+    if (file_size < static_cast<std::streamoff>(HEADER_SIZE) ||
+        !file.read(reinterpret_cast<char*>(header), sizeof(header)) || !checkHeader(header, sizeof(header))) {
+        return false;
+    }
+
+    size_t entry_size = header[5];
+    size_t count = static_cast<size_t>(file_size - HEADER_SIZE) / entry_size;
+    if (count == 0) {
+        return false;
+    }
+    uint8_t item[ENTRY_SIZE];
+    if (!file.read(reinterpret_cast<char*>(item), sizeof(item))) {
+        return false;
+    }
+    first = readEntry(item);
+    file.seekg(static_cast<std::streamoff>(HEADER_SIZE + (count - 1) * entry_size));
+    if (!file.read(reinterpret_cast<char*>(item), sizeof(item))) {
+        return false;
+    }
+    last = readEntry(item);
+    return true;
+}
+
+const KeyframeEntry* KeyframeIndex::findByMediaTime(int64_t media_time_us) const {
+    if (entries_.empty()) {
+        return nullptr;
+    }
+    auto it = std::upper_bound(entries_.begin(), entries_.end(), media_time_us,
+                               [](int64_t time, const KeyframeEntry& entry) { return time < entry.media_time_us; });
+    return it == entries_.begin() ? &entries_.front() : &*(it - 1);
+}
+
+const KeyframeEntry* KeyframeIndex::findByWallTime(int64_t wall_time_us) const {
+    // 最后一个GOP按最大关键帧间隔估计结束时间
+    if (entries_.empty() || wall_time_us < entries_.front().wall_time_us ||
+        wall_time_us > entries_.back().wall_time_us + max_interval_us_) {
+        return nullptr;
+    }
+    auto it = std::upper_bound(entries_.begin(), entries_.end(), wall_time_us,
+                               [](int64_t time, const KeyframeEntry& entry) { return time < entry.wall_time_us; });
+    return &*(it - 1);
+}
+
+bool KeyframeIndex::wallToMediaTime(int64_t wall_time_us, int64_t& media_time_us) const {
+    const KeyframeEntry* entry = findByWallTime(wall_time_us);
+    if (!entry) {
+        return false;
+    }
+    media_time_us = entry->media_time_us + (wall_time_us - entry->wall_time_us);
+    return true;
+}
+
+KeyframeIndexWriter::~KeyframeIndexWriter() {
+    close();
+}
+
+bool KeyframeIndexWriter::open(const std::string& video_path) {
+    close();
+    path_ = KeyframeIndex::sidecarPath(video_path);
+    file_.open(path_, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file_) {
+        LOG_WARNING("无法创建关键帧索引: " + path_, "KeyframeIndex");
+        return false;
+    }
+
+    char header[KeyframeIndex::HEADER_SIZE] = {'C', 'S', 'K', 'I', static_cast<char>(KeyframeIndex::VERSION),
+                                               static_cast<char>(KeyframeIndex::ENTRY_SIZE), 0, 0};
+    file_.write(header, sizeof(header));
+    file_.flush();
+    return static_cast<bool>(file_);
+}
+
+bool KeyframeIndexWriter::append(const KeyframeEntry& entry) {
+    if (!file_.is_open()) {
+        return false;
+    }
+    char item[KeyframeIndex::ENTRY_SIZE];
+    writeBigEndian(item, static_cast<uint64_t>(entry.media_time_us), 8);
+    writeBigEndian(item + 8, static_cast<uint64_t>(entry.byte_offset), 8);
+    writeBigEndian(item + 16, static_cast<uint64_t>(entry.wall_time_us), 8);
+    file_.write(item, sizeof(item));
+    file_.flush();
+    if (!file_) {
+        LOG_WARNING("写入关键帧索引失败，停止索引: " + path_, "KeyframeIndex");
+        file_.close();
+        return false;
+    }
+    count_++;
+    return true;
+}
+
+void KeyframeIndexWriter::close() {
+    if (file_.is_open()) {
+        file_.close();
+    }
+    count_ = 0;
+}
+
+} // namespace video
+} // namespace cam_server
@@ -0,0 +1,116 @@
+#include "video/pre_roll_buffer.h"
+
+#include <cstring>
+
+namespace cam_server {
+namespace video {
+
+void PreRollBuffer::configure(size_t max_bytes, int64_t max_duration_us, size_t max_packets) {
+    data_.assign(max_bytes, 0);
+    entries_.assign(max_packets, Entry{0, 0, 0, 0, false});
+    max_duration_us_ = max_duration_us;
+    evicted_ = 0;
+    rejected_ = 0;
+    clear();
+}
+
+bool PreRollBuffer::push(const uint8_t* data, size_t size, int64_t pts, int64_t timestamp_us, bool keyframe) {
+    if (entries_.empty() || size == 0 || size > data_.size()) {
+        rejected_++;
+        return false;
+    }
+
+    // 包连续存放，尾部放不下时回到开头，尾部剩余的空间本轮不再使用
+    size_t pos = write_offset_;
+    bool wrap = pos + size > data_.size();
+    if (wrap) {
+        pos = 0;
+    }
+
+    // 淘汰占用目标区域的包，最旧的包总是紧跟在写入位置之后
+    while (count_ > 0) {
+        const Entry& oldest = front();
+        bool in_tail = wrap && oldest.offset >= write_offset_;
+        bool overlaps = oldest.offset < pos + size && pos < oldest.offset + oldest.size;
+        if (!in_tail && !overlaps) {
+            break;
+        }
+        popFront();
+    }
+    if (count_ == entries_.size()) {
+        popFront();
+    }
+
+    std::memcpy(data_.data() + pos, data, size);
+    entries_[(head_ + count_) % entries_.size()] = Entry{pos, size, pts, timestamp_us, keyframe};
+    count_++;
+    bytes_ += size;
+    if (keyframe) {
+        keyframes_++;
+    }
+    write_offset_ = pos + size;
+
+    // 去掉最旧的GOP后仍不短于预录时长时才淘汰它，最新的GOP总是保留
+    while (keyframes_ > 1) {
+        size_t next = 1;
+        while (!entries_[(head_ + next) % entries_.size()].keyframe) {
+            next++;
+        }
+        if (back().timestamp_us - entries_[(head_ + next) % entries_.size()].timestamp_us < max_duration_us_) {
+            break;
+        }
+        popFront();
+        trimToKeyframe();
+    }
+    trimToKeyframe();
+    return true;
+}
+
+bool PreRollBuffer::flush(const std::function<bool(const uint8_t*, size_t, int64_t, bool)>& fn) {
+    bool ok = true;
+    for (size_t i = 0; i < count_ && ok; ++i) {
+        const Entry& entry = entries_[(head_ + i) % entries_.size()];
+        ok = fn(data_.data() + entry.offset, entry.size, entry.pts, entry.keyframe);
+    }
+    clear();
+    return ok;
+}
+
+void PreRollBuffer::clear() {
+    head_ = 0;
+    count_ = 0;
+    keyframes_ = 0;
+    write_offset_ = 0;
+    bytes_ = 0;
+}
+
+PreRollStats PreRollBuffer::getStats() const {
+    PreRollStats stats;
+    stats.packets = count_;
+    stats.bytes = bytes_;
+    stats.capacity_bytes = data_.size();
+    stats.duration_us = count_ > 0 ? back().timestamp_us - front().timestamp_us : 0;
+    stats.evicted = evicted_;
+    stats.rejected = rejected_;
+    return stats;
+}
+
+void PreRollBuffer::popFront() {
+    const Entry& oldest = front();
+    bytes_ -= oldest.size;
+    if (oldest.keyframe) {
+        keyframes_--;
+    }
+    head_ = (head_ + 1) % entries_.size();
+    count_--;
+    evicted_++;
+}
+
+void PreRollBuffer::trimToKeyframe() {
+    while (count_ > 0 && !front().keyframe) {
+        popFront();
+    }
+}
+
+} // namespace video
+} // namespace cam_server
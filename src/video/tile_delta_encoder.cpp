@@ -0,0 +1,300 @@
+#include "video/tile_delta_encoder.h"
+#include "video/jpeg_encoder_pool.h"
+#include "monitor/logger.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) && defined(__x86_64__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace cam_server {
+namespace video {
+
+TileDeltaEncoder::TileDeltaEncoder(const TileDeltaConfig& config)
+    : config_(config),
+      width_(0),
+      height_(0),
+      need_full_(true),
+      last_full_size_(0) {
+    // 瓦片按JPEG宏块对齐，避免瓦片边缘出现额外的块效应
+    config_.tile_size = std::max(16, (config_.tile_size + 15) / 16 * 16);
+    config_.quality = std::max(1, std::min(100, config_.quality));
+    config_.threshold = std::max(0.0, config_.threshold);
+}
+
+bool TileDeltaEncoder::isSupported(camera::PixelFormat format) {
+    switch (format) {
+        case camera::PixelFormat::MJPEG:
+        case camera::PixelFormat::YUYV:
+        case camera::PixelFormat::NV12:
+        case camera::PixelFormat::YUV420P:
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint64_t TileDeltaEncoder::sumAbsDiff(const uint8_t* a, const uint8_t* b, size_t size) {
+    uint64_t sum = 0;
+    size_t i = 0;
+#if defined(__SSE2__) && defined(__x86_64__)
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+    }
+    sum = static_cast<uint64_t>(_mm_cvtsi128_si64(acc)) +
+          static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc)));
+#elif defined(__ARM_NEON)
+    // 每次调用只比较一行，32位累加不会溢出
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        acc = vpadalq_u16(acc, vpaddlq_u8(diff));
+    }
+    sum = static_cast<uint64_t>(vgetq_lane_u32(acc, 0)) + vgetq_lane_u32(acc, 1) +
+          vgetq_lane_u32(acc, 2) + vgetq_lane_u32(acc, 3);
+#endif
+    for (; i < size; ++i) {
+        sum += static_cast<uint64_t>(std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i])));
+    }
+    return sum;
+}
+
+bool TileDeltaEncoder::encode(const camera::Frame& frame, bool force_full, TileDeltaUpdate& update) {
+    auto start = Clock::now();
+    update = TileDeltaUpdate();
+
+    // MJPEG先解码，全帧刷新时仍直接转发原始JPEG
+    const camera::Frame* input = &frame;
+    if (frame.getFormat() == camera::PixelFormat::MJPEG) {
+        if (!JpegEncoderPool::getInstance().decode(frame, decoded_)) {
+            LOG_ERROR("MJPEG解码失败", "TileDeltaEncoder");
+            return false;
+        }
+        input = &decoded_;
+    }
+    if (!isSupported(input->getFormat()) || input->getFormat() == camera::PixelFormat::MJPEG) {
+        LOG_ERROR("瓦片增量编码不支持的输入格式: " + std::to_string(static_cast<int>(input->getFormat())),
+                  "TileDeltaEncoder");
+        return false;
+    }
+
+    int width = input->getWidth();
+    int height = input->getHeight();
+    const uint8_t* luma = loadLuma(*input);
+    if (!luma) {
+        LOG_ERROR("帧数据不完整: " + std::to_string(input->getDataSize()) + " 字节, " +
+                  std::to_string(width) + "x" + std::to_string(height), "TileDeltaEncoder");
+        return false;
+    }
+
+    update.width = width;
+    update.height = height;
+    update.timestamp_us = frame.getLineage().capture_time_us;
+    if (update.timestamp_us == 0) {
+        update.timestamp_us = frame.getMetadata().timestamp;
+    }
+
+    auto now = start;
+    bool full = force_full || need_full_ || width != width_ || height != height_ ||
+                (config_.refresh_interval_ms > 0 &&
+                 now - last_full_ >= std::chrono::milliseconds(config_.refresh_interval_ms));
+
+    if (!full) {
+        // 逐块比较，记录变化的瓦片
+        std::vector<TileDeltaTile> changed;
+        int tile_count = 0;
+        for (int y = 0; y < height; y += config_.tile_size) {
+            for (int x = 0; x < width; x += config_.tile_size) {
+                int tile_width = std::min(config_.tile_size, width - x) & ~1;
+                int tile_height = std::min(config_.tile_size, height - y) & ~1;
+                if (tile_width <= 0 || tile_height <= 0) {
+                    continue;
+                }
+                tile_count++;
+                if (tileChanged(luma, x, y, tile_width, tile_height)) {
+                    TileDeltaTile tile;
+                    tile.x = x;
+                    tile.y = y;
+                    tile.width = tile_width;
+                    tile.height = tile_height;
+                    changed.push_back(tile);
+                }
+            }
+        }
+
+        if (changed.size() > static_cast<size_t>(tile_count * config_.max_changed_ratio)) {
+            full = true;
+        } else {
+            for (auto& tile : changed) {
+                tile.jpeg = encodeTile(*input, tile.x, tile.y, tile.width, tile.height);
+                if (!tile.jpeg) {
+                    // 编码失败的瓦片不更新参考，下一帧会再次检测到变化
+                    continue;
+                }
+                updateReference(luma, tile.x, tile.y, tile.width, tile.height);
+                stats_.bytes_sent += tile.jpeg->size();
+                stats_.tiles_sent++;
+                update.tiles.push_back(std::move(tile));
+            }
+        }
+    }
+
+    if (full) {
+        // 与其他流共用同一帧的整帧JPEG
+        JpegBuffer jpeg = EncodedFrameCache::getInstance().getJpeg(frame, config_.quality);
+        if (!jpeg) {
+            LOG_ERROR("全帧JPEG编码失败", "TileDeltaEncoder");
+            return false;
+        }
+        TileDeltaTile tile;
+        tile.width = width;
+        tile.height = height;
+        tile.jpeg = jpeg;
+        update.full = true;
+        update.tiles.push_back(std::move(tile));
+
+        reference_.assign(luma, luma + static_cast<size_t>(width) * height);
+        width_ = width;
+        height_ = height;
+        need_full_ = false;
+        last_full_ = now;
+        last_full_size_ = jpeg->size();
+        stats_.bytes_sent += jpeg->size();
+        stats_.full_frames++;
+    }
+
+    stats_.frames++;
+    if (update.empty()) {
+        stats_.skipped_frames++;
+    }
+    stats_.mjpeg_bytes += frame.getFormat() == camera::PixelFormat::MJPEG ? frame.getDataSize() : last_full_size_;
+    uint64_t elapsed = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+    stats_.process_us += elapsed;
+    if (update.full) {
+        stats_.full_us += elapsed;
+    }
+    return true;
+}
+
+const uint8_t* TileDeltaEncoder::loadLuma(const camera::Frame& frame) {
+    size_t width = static_cast<size_t>(frame.getWidth());
+    size_t height = static_cast<size_t>(frame.getHeight());
+    size_t chroma_size = ((width + 1) / 2) * ((height + 1) / 2);
+    const uint8_t* data = frame.getDataPtr();
+    if (!data || width == 0 || height == 0) {
+        return nullptr;
+    }
+
+    switch (frame.getFormat()) {
+        case camera::PixelFormat::YUV420P:
+            return frame.getDataSize() >= width * height + 2 * chroma_size ? data : nullptr;
+        case camera::PixelFormat::NV12:
+            return frame.getDataSize() >= width * height + 2 * chroma_size ? data : nullptr;
+        case camera::PixelFormat::YUYV: {
+            if (frame.getDataSize() < width * height * 2) {
+                return nullptr;
+            }
+            luma_.resize(width * height);
+            uint8_t* out = luma_.data();
+            for (size_t i = 0; i < width * height; ++i) {
+                out[i] = data[i * 2];
+            }
+            return luma_.data();
+        }
+        default:
+            return nullptr;
+    }
+}
+
+bool TileDeltaEncoder::tileChanged(const uint8_t* luma, int x, int y, int width, int height) const {
+    // 超过阈值即可停止，大面积变化时不必比较完整个瓦片
+    uint64_t limit = static_cast<uint64_t>(config_.threshold * width * height);
+    uint64_t sum = 0;
+    for (int row = y; row < y + height; ++row) {
+        size_t offset = static_cast<size_t>(row) * width_ + x;
+        sum += sumAbsDiff(luma + offset, reference_.data() + offset, static_cast<size_t>(width));
+        if (sum > limit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TileDeltaEncoder::updateReference(const uint8_t* luma, int x, int y, int width, int height) {
+    for (int row = y; row < y + height; ++row) {
+        size_t offset = static_cast<size_t>(row) * width_ + x;
+        std::memcpy(reference_.data() + offset, luma + offset, static_cast<size_t>(width));
+    }
+}
+
+JpegBuffer TileDeltaEncoder::encodeTile(const camera::Frame& frame, int x, int y, int width, int height) {
+    // 按源格式裁剪出紧凑排列的瓦片，x、y、宽、高均为偶数
+    size_t frame_width = static_cast<size_t>(frame.getWidth());
+    size_t frame_height = static_cast<size_t>(frame.getHeight());
+    size_t chroma_width = (frame_width + 1) / 2;
+    size_t chroma_height = (frame_height + 1) / 2;
+    size_t tile_width = static_cast<size_t>(width);
+    size_t tile_height = static_cast<size_t>(height);
+    const uint8_t* data = frame.getDataPtr();
+
+    switch (frame.getFormat()) {
+        case camera::PixelFormat::YUV420P: {
+            tile_buffer_.resize(tile_width * tile_height * 3 / 2);
+            uint8_t* out = tile_buffer_.data();
+            for (size_t row = 0; row < tile_height; ++row, out += tile_width) {
+                std::memcpy(out, data + (y + row) * frame_width + x, tile_width);
+            }
+            const uint8_t* planes[2] = {data + frame_width * frame_height,
+                                        data + frame_width * frame_height + chroma_width * chroma_height};
+            for (const uint8_t* plane : planes) {
+                for (size_t row = 0; row < tile_height / 2; ++row, out += tile_width / 2) {
+                    std::memcpy(out, plane + (y / 2 + row) * chroma_width + x / 2, tile_width / 2);
+                }
+            }
+            break;
+        }
+        case camera::PixelFormat::NV12: {
+            tile_buffer_.resize(tile_width * tile_height * 3 / 2);
+            uint8_t* out = tile_buffer_.data();
+            for (size_t row = 0; row < tile_height; ++row, out += tile_width) {
+                std::memcpy(out, data + (y + row) * frame_width + x, tile_width);
+            }
+            const uint8_t* uv = data + frame_width * frame_height;
+            for (size_t row = 0; row < tile_height / 2; ++row, out += tile_width) {
+                std::memcpy(out, uv + (y / 2 + row) * chroma_width * 2 + x, tile_width);
+            }
+            break;
+        }
+        case camera::PixelFormat::YUYV: {
+            tile_buffer_.resize(tile_width * tile_height * 2);
+            uint8_t* out = tile_buffer_.data();
+            for (size_t row = 0; row < tile_height; ++row, out += tile_width * 2) {
+                std::memcpy(out, data + ((y + row) * frame_width + x) * 2, tile_width * 2);
+            }
+            break;
+        }
+        default:
+            return nullptr;
+    }
+
+    // 同尺寸的瓦片复用池中的常驻编码器
+    camera::Frame tile(width, height, frame.getFormat(), tile_buffer_);
+    auto jpeg = std::make_shared<std::vector<uint8_t>>();
+    if (!JpegEncoderPool::getInstance().encode(tile, config_.quality, *jpeg)) {
+        LOG_ERROR("瓦片JPEG编码失败", "TileDeltaEncoder");
+        return nullptr;
+    }
+    return jpeg;
+}
+
+} // namespace video
+} // namespace cam_server
@@ -1,6 +1,6 @@
 #include "web/system_routes.h"
 #include "system/system_monitor.h"
-#include <filesystem>
+#include "camera/capability_cache.h"
 #include <sstream>
 
 namespace cam_server {
@@ -121,27 +121,28 @@ void SystemRoutes::setupCameraInfoRoute(crow::SimpleApp& app) {
         try {
             std::string response = "{\"success\":true,\"cameras\":[";
 
-            // 扫描可能的摄像头设备 - Linux下通常是/dev/videoN
-            // 为什么扫描0-9：大多数系统不会有超过10个摄像头设备
+            // 从能力缓存获取视频捕获设备 - 只列出真正的捕获节点（排除元数据节点等）
+            // 为什么用缓存：设备能力在热插拔前不变，重复请求不需要重新打开和枚举设备
             bool first = true;
-            for (int i = 0; i < 10; ++i) {
-                std::string device_path = "/dev/video" + std::to_string(i);
-
-                // 检查设备文件是否存在
-                // 为什么这样检查：设备文件存在通常意味着设备可用
-                if (std::filesystem::exists(device_path)) {
-                    if (!first) response += ",";
-                    first = false;
-
-                    // 构建设备信息 - 包含设备路径、名称、状态
-                    // 为什么包含这些信息：前端需要显示给用户选择
-                    response += "{"
-                        "\"device\":\"" + device_path + "\","
-                        "\"name\":\"摄像头 " + std::to_string(i) + "\","
-                        "\"status\":\"可用\","
-                        "\"index\":" + std::to_string(i) + ""
-                        "}";
+            for (const auto& capabilities : cam_server::camera::CapabilityCache::getInstance().scan()) {
+                const std::string& device_path = capabilities->device_path;
+                if (!first) response += ",";
+                first = false;
+
+                // 构建设备信息 - 包含设备路径、名称、状态和支持的格式
+                // 为什么包含这些信息：前端需要显示给用户选择
+                response += "{"
+                    "\"device\":\"" + device_path + "\","
+                    "\"name\":\"" + capabilities->card + "\","
+                    "\"bus_info\":\"" + capabilities->bus_info + "\","
+                    "\"status\":\"可用\","
+                    "\"index\":" + device_path.substr(10) + ","
+                    "\"formats\":[";
+                for (size_t i = 0; i < capabilities->formats.size(); ++i) {
+                    if (i > 0) response += ",";
+                    response += "\"" + capabilities->formats[i].name + "\"";
                 }
+                response += "]}";
             }
 
             response += "]}";
@@ -1,12 +1,88 @@
 #include "web/websocket_handler.h"
 #include "camera/camera_manager.h"
+#include "camera/pipeline_stats.h"
 #include "monitor/logger.h"
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 
 namespace cam_server {
 namespace web {
 
+namespace {
+// 当前WebSocket视频流的帧订阅ID
+std::atomic<camera::FrameBus::SubscriptionId> g_frame_subscription{0};
+
+// 每个设备最近转发的一帧，新客户端连接或启动正在采集的设备时立即发出，不用等下一帧。
+// 采集中直接引用转发的共享帧，不复制；只有新客户端要发出它时才复制数据并释放对驱动缓冲区的引用，
+// 过时（设备已停止）或设备停止时删除，避免停止采集后仍占用缓冲区
+struct LastFrame {
+    std::shared_ptr<const camera::Frame> frame;  // 引用驱动缓冲区的帧，已复制时为空
+    crow::websocket::shared_message message;
+    std::chrono::steady_clock::time_point time;
+};
+std::mutex g_last_frame_mutex;
+std::unordered_map<std::string, LastFrame> g_last_frames;
+// 超过该时间没有新帧说明设备已停止，保存的帧不再发出
+constexpr auto kLastFrameMaxAge = std::chrono::seconds(2);
+
+// 删除过时的帧，调用者须持有g_last_frame_mutex
+void dropStaleLastFramesLocked(std::chrono::steady_clock::time_point now) {
+    for (auto it = g_last_frames.begin(); it != g_last_frames.end();) {
+        if (now - it->second.time > kLastFrameMaxAge) {
+            it = g_last_frames.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// 发出设备最近的一帧，设备为空时取所有设备中最新的一帧
+bool sendLastFrame(crow::websocket::connection& conn, const std::string& device_path) {
+    crow::websocket::shared_message message;
+    {
+        std::lock_guard<std::mutex> lock(g_last_frame_mutex);
+        dropStaleLastFramesLocked(std::chrono::steady_clock::now());
+        LastFrame* latest = nullptr;
+        for (auto& pair : g_last_frames) {
+            if ((device_path.empty() || pair.first == device_path) && (!latest || pair.second.time > latest->time)) {
+                latest = &pair.second;
+            }
+        }
+        if (!latest) {
+            return false;
+        }
+        // 写队列可能持有消息到采集停止之后，发出前复制数据，同一帧只复制一次
+        if (latest->frame && latest->frame->isShared()) {
+            auto copy = std::make_shared<const std::vector<uint8_t>>(
+                latest->frame->getDataPtr(), latest->frame->getDataPtr() + latest->frame->getDataSize());
+            latest->message = crow::websocket::shared_message::make(
+                0x2, copy, reinterpret_cast<const char*>(copy->data()), copy->size());
+            latest->message.latest_only = true;
+        }
+        latest->frame.reset();
+        message = latest->message;
+    }
+    conn.send_shared(std::move(message));
+    return true;
+}
+
+// 删除设备保存的最近一帧，设备为空时删除所有设备的
+void clearLastFrame(const std::string& device_path) {
+    std::lock_guard<std::mutex> lock(g_last_frame_mutex);
+    if (device_path.empty()) {
+        g_last_frames.clear();
+    } else {
+        g_last_frames.erase(device_path);
+    }
+}
+} // namespace
+
 void WebSocketHandler::setupRoutes(crow::SimpleApp& app, VideoServer* server) {
     // 设置WebSocket视频流路由 - 直接从原始实现复制
     // 为什么使用WebSocket：支持双向通信，低延迟，适合实时视频流
@@ -27,10 +103,12 @@ void WebSocketHandler::setupRoutes(crow::SimpleApp& app, VideoServer* server) {
         // 发送欢迎消息
         conn.send_text("{\"type\":\"welcome\",\"client_id\":\"" + client_id + "\",\"message\":\"视频流连接成功\"}");
 
-        // 测试：发送一个小的二进制数据
-        std::string test_data = "TEST_BINARY_DATA_123456789";
-        conn.send_binary(test_data);
-        std::cout << "🧪 发送测试二进制数据，大小: " << test_data.size() << " 字节" << std::endl;
+        // 摄像头正在采集时立即发出最近的一帧，页面不用等启动命令和下一帧
+        if (!camera::CameraManager::getInstance().isCapturing()) {
+            clearLastFrame("");  // 设备可能已由其他接口停止，释放保存的帧
+        } else if (sendLastFrame(conn, "")) {
+            std::cout << "🖼️ 已向新客户端发送最近一帧: " << client_id << std::endl;
+        }
     })
     .onclose([server](crow::websocket::connection& conn, const std::string& reason, uint16_t code) {
         std::cout << "📱 视频流客户端断开连接，原因: " << reason << ", 代码: " << code << std::endl;
@@ -119,6 +197,14 @@ void WebSocketHandler::onOpen(crow::websocket::connection& conn, VideoServer* se
 
     conn.send_text(welcome_msg);
 
+    // 摄像头正在采集时立即发出最近的一帧
+    // 为什么这样做：新客户端不用等启动命令和下一帧采集，首帧延迟只有一次往返
+    if (camera::CameraManager::getInstance().isCapturing()) {
+        sendLastFrame(conn, "");
+    } else {
+        clearLastFrame("");
+    }
+
     // 记录连接事件 - 便于调试和监控
     std::cout << "📱 新客户端连接: " + client_id << std::endl;
 }
@@ -216,6 +302,7 @@ void WebSocketHandler::onClose(crow::websocket::connection& conn, const std::str
                     auto& camera_manager = camera::CameraManager::getInstance();
                     camera_manager.stopCapture();
                     camera_manager.closeDevice();
+                    clearLastFrame(device);
                     std::cout << "🔌 客户端断开时自动停止摄像头: " << device << std::endl;
                 } catch (const std::exception& e) {
                     std::cout << "⚠️ 停止摄像头时出错: " << e.what() << std::endl;
@@ -255,11 +342,30 @@ void WebSocketHandler::handleStartCamera(crow::websocket::connection& conn, cons
             return;
         }
 
+        // 该设备已在采集并持续有帧时直接加入，不重新打开设备，先发出最近的一帧
+        if (camera_manager.isDeviceOpen() && camera_manager.isCapturing() && g_frame_subscription.load() != 0) {
+            {
+                std::lock_guard<std::mutex> lock(server->getClientsMutex());
+                for (auto& [client_id, client_info] : server->getClients()) {
+                    if (client_info.conn == &conn) {
+                        client_info.current_device = device_path;
+                        break;
+                    }
+                }
+            }
+            if (sendLastFrame(conn, device_path)) {
+                conn.send_text("{\"type\":\"success\",\"message\":\"摄像头已启动，视频流开始传输\"}");
+                std::cout << "✅ 设备已在采集，客户端直接加入: " << device_path << std::endl;
+                return;
+            }
+        }
+
         // 如果当前设备已打开，先关闭
         if (camera_manager.isDeviceOpen()) {
             camera_manager.stopCapture();
             camera_manager.closeDevice();
         }
+        clearLastFrame("");
 
         // 打开指定的摄像头设备
         if (!camera_manager.openDevice(device_path, 640, 480, 30)) {
@@ -279,10 +385,16 @@ void WebSocketHandler::handleStartCamera(crow::websocket::connection& conn, cons
             }
         }
 
-        // 设置帧回调，将帧数据发送给对应的WebSocket客户端
-        camera_manager.setFrameCallback([server, device_path](const camera::Frame& frame) {
+        // 订阅帧，在独立线程中发送给对应的WebSocket客户端（替换之前的订阅）
+        camera::FrameSubscriberOptions options;
+        options.queue_depth = 1;
+        options.drop_policy = camera::FrameDropPolicy::KEEP_LATEST;
+        options.camera_id = device_path;  // openDevice以设备路径作为摄像头ID
+        options.consumer = camera::FrameConsumerKind::JPEG;  // 浏览器直接显示收到的JPEG数据
+        auto subscription = camera_manager.subscribeFrames("websocket_handler", [server, device_path](const camera::Frame& frame) {
             handleFrame(frame, device_path, server);
-        });
+        }, options);
+        camera_manager.unsubscribeFrames(g_frame_subscription.exchange(subscription));
 
         // 启动捕获
         if (!camera_manager.startCapture()) {
@@ -322,7 +434,9 @@ void WebSocketHandler::handleStopCamera(crow::websocket::connection& conn, Video
         }
 
         if (!device_path.empty()) {
+            camera_manager.unsubscribeFrames(g_frame_subscription.exchange(0));
             camera_manager.stopCapture();
+            clearLastFrame(device_path);
             std::cout << "✅ 摄像头停止成功，设备: " << device_path << std::endl;
         }
 
@@ -383,6 +497,22 @@ void WebSocketHandler::handleGetInfo(crow::websocket::connection& conn, VideoSer
 void WebSocketHandler::handleFrame(const camera::Frame& frame, const std::string& device_path, VideoServer* server) {
     // 处理摄像头帧数据 - 发送给所有连接的客户端
     try {
+        // 帧头只构造一次，各连接引用同一帧的数据（共享帧只增加引用计数），不为每个客户端复制
+        auto owner = std::make_shared<const camera::Frame>(frame);
+        auto message = crow::websocket::shared_message::make(
+            0x2, owner, reinterpret_cast<const char*>(owner->getDataPtr()), owner->getDataSize());
+        // 慢客户端写队列中尚未开始写的旧帧被新帧替换，不会堆积也不影响其他客户端
+        message.latest_only = true;
+
+        // 保存为最近一帧只增加引用计数，下一帧到来时释放；顺带删除其他已停止设备的帧
+        {
+            std::lock_guard<std::mutex> lock(g_last_frame_mutex);
+            auto now = std::chrono::steady_clock::now();
+            dropStaleLastFramesLocked(now);
+            g_last_frames[device_path] = LastFrame{owner, message, now};
+        }
+
+        // 锁内只投递到各连接的发送队列，实际写socket在IO线程中进行
         std::lock_guard<std::mutex> lock(server->getClientsMutex());
         auto& clients = server->getClients();
 
@@ -394,14 +524,18 @@ void WebSocketHandler::handleFrame(const camera::Frame& frame, const std::string
             if (client_info.current_device == device_path && client_info.conn) {
                 try {
                     // 发送二进制帧数据
-                    const auto& frame_data = frame.getData();
-                    client_info.conn->send_binary(std::string(frame_data.begin(), frame_data.end()));
+                    client_info.conn->send_shared(message);
                 } catch (const std::exception& e) {
                     std::cout << "⚠️ 发送帧数据失败: " << e.what() << std::endl;
                 }
             }
         }
 
+        // 直接转发驱动数据，没有编码阶段
+        camera::FrameLineage lineage = frame.getLineage();
+        lineage.send_time_us = camera::FrameLineage::nowUs();
+        camera::PipelineStats::getInstance().recordLineage(lineage);
+
     } catch (const std::exception& e) {
         std::cout << "❌ 处理帧数据时发生错误: " << e.what() << std::endl;
     }
@@ -1001,6 +1001,17 @@ document.addEventListener('DOMContentLoaded', function() {
     let mjpegImage = null;
     let streamRetryCount = 0;
     const MAX_RETRY_COUNT = 3;
+    let mjpegEnginePort = 0;
+
+    // 查询独立端口的MJPEG引擎，未启用或查询失败时使用/api/camera/mjpeg
+    fetch('/api/stream/tiers')
+    .then(response => response.json())
+    .then(data => {
+        if (data.mjpeg_engine && data.mjpeg_engine.enabled) {
+            mjpegEnginePort = data.mjpeg_engine.port;
+        }
+    })
+    .catch(error => console.warn('获取MJPEG引擎信息失败:', error));
 
     function startMjpegStream() {
         const preview = document.getElementById('preview');
@@ -1023,7 +1034,11 @@ document.addEventListener('DOMContentLoaded', function() {
 
         const clientId = generateClientId();
         const timestamp = new Date().getTime();
-        const streamUrl = `/api/camera/mjpeg?camera_id=${encodeURIComponent(selectedCamera)}&client_id=${clientId}&t=${timestamp}`;
+        const query = `camera_id=${encodeURIComponent(selectedCamera)}&client_id=${clientId}&t=${timestamp}`;
+        // 引擎只提供HTTP，HTTPS页面仍走/api/camera/mjpeg，避免混合内容被拦截
+        const streamUrl = mjpegEnginePort && window.location.protocol === 'http:'
+            ? `http://${window.location.hostname}:${mjpegEnginePort}/mjpeg?${query}`
+            : `/api/camera/mjpeg?${query}`;
         
         console.log('开始MJPEG流，URL:', streamUrl);
         showStatus('正在连接MJPEG流...');
@@ -0,0 +1,126 @@
+/**
+ * 帧信封解码
+ * /ws/camera订阅时带envelope: 1，每条二进制媒体消息前都有帧信封，之后为原有格式的负载
+ *
+ * 信封格式（大端）：
+ *   0  2字节魔数 "CS"
+ *   2  1字节版本（1）
+ *   3  1字节编码：1 jpeg，2 h264，3 tiles
+ *   4  2字节信封长度，负载从该偏移开始
+ *   6  1字节标志，bit0为关键帧/全帧，bit1为缓存重发
+ *   7  1字节摄像头ID长度，8 1字节档位名长度，9 3字节保留
+ *   12 4字节序号
+ *   16 8字节采集时间（微秒），24 8字节发送时间（微秒），均为服务器单调时钟
+ *   32 4字节负载长度
+ *   36 摄像头ID，档位名（UTF-8）
+ */
+class StreamEnvelope {
+    static FIXED_SIZE = 36;
+    static FLAG_KEYFRAME = 0x01;
+    static FLAG_CACHED = 0x02;
+    static CODECS = ['unknown', 'jpeg', 'h264', 'tiles'];
+    static decoder = new TextDecoder();
+
+    /**
+     * 解析一条消息
+     * @param {ArrayBuffer} buffer - 二进制消息
+     * @returns {object|null} 信封和负载，格式不对时返回null
+     */
+    static parse(buffer) {
+        const view = new DataView(buffer);
+        if (buffer.byteLength < StreamEnvelope.FIXED_SIZE ||
+            view.getUint8(0) !== 0x43 || view.getUint8(1) !== 0x53 || view.getUint8(2) === 0) {
+            return null;
+        }
+        const headerSize = view.getUint16(4);
+        const cameraSize = view.getUint8(7);
+        const tierSize = view.getUint8(8);
+        const payloadSize = view.getUint32(32);
+        if (headerSize < StreamEnvelope.FIXED_SIZE + cameraSize + tierSize ||
+            headerSize + payloadSize !== buffer.byteLength) {
+            return null;
+        }
+        const flags = view.getUint8(6);
+        const fields = StreamEnvelope.FIXED_SIZE;
+        return {
+            version: view.getUint8(2),
+            codec: StreamEnvelope.CODECS[view.getUint8(3)] || 'unknown',
+            keyframe: (flags & StreamEnvelope.FLAG_KEYFRAME) !== 0,
+            cached: (flags & StreamEnvelope.FLAG_CACHED) !== 0,
+            sequence: view.getUint32(12),
+            captureTimeUs: Number(view.getBigUint64(16)),
+            sendTimeUs: Number(view.getBigUint64(24)),
+            cameraId: StreamEnvelope.decoder.decode(new Uint8Array(buffer, fields, cameraSize)),
+            tier: StreamEnvelope.decoder.decode(new Uint8Array(buffer, fields + cameraSize, tierSize)),
+            // 负载为原消息的视图，瓦片消息需要独立的ArrayBuffer时用payload.slice().buffer
+            payload: new Uint8Array(buffer, headerSize, payloadSize)
+        };
+    }
+}
+
+/**
+ * 按信封统计各流的丢帧和延迟
+ */
+class StreamEnvelopeTracker {
+    constructor() {
+        // 服务器时钟 - 本地时钟（微秒），收到clock_us前为null
+        this.clockOffsetUs = null;
+        this.bestRttUs = Infinity;
+        this.streams = new Map();
+    }
+
+    /**
+     * 用订阅回复或time命令回复中的clock_us校准时钟，取往返时间最短的一次
+     * @param {number} clockUs - 服务器时钟
+     * @param {number} rttUs - 命令往返时间，未知时为0
+     */
+    onClock(clockUs, rttUs = 0) {
+        if (rttUs > this.bestRttUs) {
+            return;
+        }
+        this.bestRttUs = rttUs;
+        this.clockOffsetUs = clockUs + rttUs / 2 - StreamEnvelopeTracker.nowUs();
+    }
+
+    /**
+     * 记录一条消息
+     * @param {object} envelope - StreamEnvelope.parse的结果
+     * @returns {{lost: number, serverMs: number, endToEndMs: number|null}} 本条之前丢失的消息数和延迟
+     */
+    onEnvelope(envelope) {
+        // JPEG序号按连接递增，切换档位不重新计数，因此不按档位区分
+        const key = `${envelope.cameraId}\n${envelope.codec}`;
+        let stream = this.streams.get(key);
+        if (!stream) {
+            stream = { lastSequence: null, received: 0, lost: 0, cached: 0 };
+            this.streams.set(key, stream);
+        }
+
+        // 缓存重发的消息序号不连续，不参与丢帧统计
+        let lost = 0;
+        if (envelope.cached) {
+            stream.cached++;
+        } else {
+            if (stream.lastSequence !== null && envelope.sequence > stream.lastSequence + 1) {
+                lost = envelope.sequence - stream.lastSequence - 1;
+                stream.lost += lost;
+            }
+            stream.lastSequence = envelope.sequence;
+            stream.received++;
+        }
+
+        const serverMs = (envelope.sendTimeUs - envelope.captureTimeUs) / 1000;
+        const endToEndMs = this.clockOffsetUs === null ? null :
+            (StreamEnvelopeTracker.nowUs() + this.clockOffsetUs - envelope.captureTimeUs) / 1000;
+        return { lost, serverMs, endToEndMs };
+    }
+
+    static nowUs() {
+        return performance.now() * 1000;
+    }
+}
+
+// 导出给其他模块使用
+if (typeof module !== 'undefined' && module.exports) {
+    module.exports = { StreamEnvelope, StreamEnvelopeTracker };
+}
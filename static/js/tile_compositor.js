@@ -0,0 +1,154 @@
+/**
+ * 瓦片增量流合成器
+ * 接收/ws/camera上codec为tiles的二进制消息，把全帧和变化的瓦片按顺序绘制到canvas上
+ *
+ * 消息格式（大端）：
+ *   0  2字节魔数 "TD"
+ *   2  1字节版本（1）
+ *   3  1字节标志，bit0为全帧
+ *   4  2字节宽，6 2字节高
+ *   8  2字节瓦片数，10 2字节保留
+ *   12 8字节采集时间（微秒）
+ *   20 起每个瓦片：2字节x、2字节y、2字节宽、2字节高、4字节JPEG长度、JPEG数据
+ */
+class TileCompositor {
+    static HEADER_SIZE = 20;
+    static TILE_HEADER_SIZE = 12;
+    static FLAG_FULL = 0x01;
+
+    /**
+     * @param {HTMLCanvasElement} canvas - 绘制目标
+     */
+    constructor(canvas) {
+        this.canvas = canvas;
+        this.context = canvas.getContext('2d');
+        this.synced = false;
+        // 消息按到达顺序依次解码绘制，后面的瓦片要覆盖在前面的画面上
+        this.chain = Promise.resolve();
+        this.stats = {
+            messages: 0,
+            fullFrames: 0,
+            tiles: 0,
+            bytes: 0,
+            lastCaptureTimeUs: 0
+        };
+    }
+
+    /**
+     * 解析一条消息
+     * @param {ArrayBuffer} buffer - 二进制消息
+     * @returns {object|null} 解析结果，格式不对时返回null
+     */
+    static parse(buffer) {
+        const view = new DataView(buffer);
+        if (buffer.byteLength < TileCompositor.HEADER_SIZE ||
+            view.getUint8(0) !== 0x54 || view.getUint8(1) !== 0x44 || view.getUint8(2) !== 1) {
+            return null;
+        }
+        const update = {
+            full: (view.getUint8(3) & TileCompositor.FLAG_FULL) !== 0,
+            width: view.getUint16(4),
+            height: view.getUint16(6),
+            timestampUs: Number(view.getBigUint64(12)),
+            tiles: []
+        };
+        const count = view.getUint16(8);
+        let offset = TileCompositor.HEADER_SIZE;
+        for (let i = 0; i < count; i++) {
+            if (offset + TileCompositor.TILE_HEADER_SIZE > buffer.byteLength) {
+                return null;
+            }
+            const length = view.getUint32(offset + 8);
+            const start = offset + TileCompositor.TILE_HEADER_SIZE;
+            if (start + length > buffer.byteLength) {
+                return null;
+            }
+            update.tiles.push({
+                x: view.getUint16(offset),
+                y: view.getUint16(offset + 2),
+                width: view.getUint16(offset + 4),
+                height: view.getUint16(offset + 6),
+                jpeg: new Uint8Array(buffer, start, length)
+            });
+            offset = start + length;
+        }
+        return update;
+    }
+
+    /**
+     * 处理一条二进制消息
+     * @param {ArrayBuffer} buffer - 二进制消息
+     * @returns {Promise} 绘制完成后resolve
+     */
+    push(buffer) {
+        const update = TileCompositor.parse(buffer);
+        if (!update) {
+            console.warn('无效的瓦片消息，长度:', buffer.byteLength);
+            return this.chain;
+        }
+        this.stats.messages++;
+        this.stats.bytes += buffer.byteLength;
+        this.chain = this.chain.then(() => this.apply(update)).catch(error => {
+            // 画面已经不完整，等服务器下一次全帧刷新
+            console.error('瓦片解码失败:', error);
+            this.synced = false;
+        });
+        return this.chain;
+    }
+
+    async apply(update) {
+        if (update.full) {
+            if (this.canvas.width !== update.width || this.canvas.height !== update.height) {
+                this.canvas.width = update.width;
+                this.canvas.height = update.height;
+            }
+            this.synced = true;
+            this.stats.fullFrames++;
+        } else if (!this.synced) {
+            return;
+        }
+
+        // 同一条消息的瓦片并行解码，再一次性绘制
+        const bitmaps = await Promise.all(update.tiles.map(tile =>
+            createImageBitmap(new Blob([tile.jpeg], { type: 'image/jpeg' }))));
+        update.tiles.forEach((tile, i) => {
+            this.context.drawImage(bitmaps[i], tile.x, tile.y, tile.width, tile.height);
+            bitmaps[i].close();
+        });
+        this.stats.tiles += update.full ? 0 : update.tiles.length;
+        this.stats.lastCaptureTimeUs = update.timestampUs;
+    }
+}
+
+/**
+ * 打开/ws/camera并订阅瓦片增量流
+ * @param {HTMLCanvasElement} canvas - 绘制目标
+ * @param {string} cameraId - 摄像头ID
+ * @returns {{socket: WebSocket, compositor: TileCompositor}}
+ */
+function connectTileStream(canvas, cameraId) {
+    const protocol = window.location.protocol === 'https:' ? 'wss:' : 'ws:';
+    const socket = new WebSocket(`${protocol}//${window.location.host}/ws/camera`);
+    socket.binaryType = 'arraybuffer';
+    const compositor = new TileCompositor(canvas);
+
+    socket.onopen = () => {
+        socket.send(JSON.stringify({ action: 'subscribe', camera_id: cameraId, codec: 'tiles' }));
+    };
+    socket.onmessage = event => {
+        if (typeof event.data === 'string') {
+            const reply = JSON.parse(event.data);
+            if (reply.status === 'error') {
+                console.error('瓦片流订阅失败:', reply.message);
+            }
+            return;
+        }
+        compositor.push(event.data);
+    };
+    return { socket, compositor };
+}
+
+// 导出给其他模块使用
+if (typeof module !== 'undefined' && module.exports) {
+    module.exports = { TileCompositor, connectTileStream };
+}
@@ -0,0 +1,146 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "api/stream_envelope.h"
+
+using namespace cam_server::api;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if (!(cond)) {                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << " 检查失败: " #cond << std::endl; \
+            ++failures;                                                                 \
+        }                                                                               \
+    } while (0)
+
+const uint8_t* bytes(const std::string& message) {
+    return reinterpret_cast<const uint8_t*>(message.data());
+}
+
+StreamEnvelope makeEnvelope(const std::string& payload) {
+    StreamEnvelope envelope;
+    envelope.codec = StreamCodec::JPEG;
+    envelope.flags = StreamEnvelope::FLAG_KEYFRAME | StreamEnvelope::FLAG_CACHED;
+    envelope.sequence = 0x01020304;
+    envelope.capture_time_us = 0x1122334455667788ULL;
+    envelope.send_time_us = 0x1122334455667799ULL;
+    envelope.payload_size = static_cast<uint32_t>(payload.size());
+    envelope.camera_id = "/dev/video0";
+    envelope.tier = "half";
+    return envelope;
+}
+
+// 编码后再解析得到相同的字段，负载从信封长度处开始
+void testRoundTrip() {
+    std::string payload = "\xff\xd8jpeg\xff\xd9";
+    StreamEnvelope envelope = makeEnvelope(payload);
+    std::string message;
+    envelope.appendTo(message);
+    CHECK(message.size() == envelope.size());
+    CHECK(envelope.size() == StreamEnvelope::FIXED_SIZE + envelope.camera_id.size() + envelope.tier.size());
+    message += payload;
+
+    StreamEnvelope parsed;
+    size_t header_size = 0;
+    CHECK(StreamEnvelope::parse(bytes(message), message.size(), parsed, header_size));
+    CHECK(header_size == envelope.size());
+    CHECK(parsed.codec == StreamCodec::JPEG);
+    CHECK(parsed.flags == envelope.flags);
+    CHECK(parsed.sequence == envelope.sequence);
+    CHECK(parsed.capture_time_us == envelope.capture_time_us);
+    CHECK(parsed.send_time_us == envelope.send_time_us);
+    CHECK(parsed.payload_size == payload.size());
+    CHECK(parsed.camera_id == envelope.camera_id);
+    CHECK(parsed.tier == envelope.tier);
+    CHECK(message.compare(header_size, std::string::npos, payload) == 0);
+}
+
+// 超过255字节的摄像头ID被截断
+void testLongCameraId() {
+    StreamEnvelope envelope = makeEnvelope("");
+    envelope.camera_id.assign(300, 'c');
+    envelope.tier.clear();
+    std::string message;
+    envelope.appendTo(message);
+    CHECK(message.size() == StreamEnvelope::FIXED_SIZE + 255);
+
+    StreamEnvelope parsed;
+    size_t header_size = 0;
+    CHECK(StreamEnvelope::parse(bytes(message), message.size(), parsed, header_size));
+    CHECK(parsed.camera_id == std::string(255, 'c'));
+    CHECK(parsed.tier.empty());
+}
+
+// 截断、魔数错误和负载长度不一致的消息被拒绝
+void testInvalid() {
+    std::string payload = "payload";
+    std::string message;
+    makeEnvelope(payload).appendTo(message);
+    message += payload;
+
+    StreamEnvelope parsed;
+    size_t header_size = 0;
+    CHECK(!StreamEnvelope::parse(nullptr, 0, parsed, header_size));
+    CHECK(!StreamEnvelope::parse(bytes(message), StreamEnvelope::FIXED_SIZE - 1, parsed, header_size));
+    CHECK(!StreamEnvelope::parse(bytes(message), message.size() - 1, parsed, header_size));
+
+    std::string extra = message + "x";
+    CHECK(!StreamEnvelope::parse(bytes(extra), extra.size(), parsed, header_size));
+
+    std::string bad_magic = message;
+    bad_magic[0] = 'X';
+    CHECK(!StreamEnvelope::parse(bytes(bad_magic), bad_magic.size(), parsed, header_size));
+
+    std::string bad_version = message;
+    bad_version[2] = 0;
+    CHECK(!StreamEnvelope::parse(bytes(bad_version), bad_version.size(), parsed, header_size));
+}
+
+// 新版本在固定字段后追加的内容按信封长度跳过
+void testLongerHeader() {
+    std::string payload = "data";
+    StreamEnvelope envelope = makeEnvelope(payload);
+    std::string message;
+    envelope.appendTo(message);
+    size_t header_size = message.size() + 4;
+    message[4] = static_cast<char>(header_size >> 8);
+    message[5] = static_cast<char>(header_size & 0xff);
+    message += std::string(4, '\0');
+    message += payload;
+
+    StreamEnvelope parsed;
+    size_t parsed_size = 0;
+    CHECK(StreamEnvelope::parse(bytes(message), message.size(), parsed, parsed_size));
+    CHECK(parsed_size == header_size);
+    CHECK(parsed.camera_id == envelope.camera_id);
+    CHECK(parsed.tier == envelope.tier);
+}
+
+void testCodecFromString() {
+    CHECK(StreamEnvelope::codecFromString("jpeg") == StreamCodec::JPEG);
+    CHECK(StreamEnvelope::codecFromString("h264") == StreamCodec::H264);
+    CHECK(StreamEnvelope::codecFromString("tiles") == StreamCodec::TILES);
+    CHECK(StreamEnvelope::codecFromString("vp8") == StreamCodec::UNKNOWN);
+}
+
+} // namespace
+
+int main() {
+    testRoundTrip();
+    testLongCameraId();
+    testInvalid();
+    testLongerHeader();
+    testCodecFromString();
+
+    if (failures > 0) {
+        std::cerr << "StreamEnvelope测试失败: " << failures << " 项" << std::endl;
+        return 1;
+    }
+    std::cout << "StreamEnvelope测试通过" << std::endl;
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "api/stream_ladder.h"
+
+using namespace cam_server::api;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if (!(cond)) {                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << " 检查失败: " #cond << std::endl; \
+            ++failures;                                                                 \
+        }                                                                               \
+    } while (0)
+
+// 缩放比例和质量，质量省略时使用默认值
+void testParseScale() {
+    auto tiers = StreamLadder::parse("full:1:80, half:0.5:70 ,quarter:0.25", 60);
+    CHECK(tiers.size() == 3);
+    if (tiers.size() != 3) {
+        return;
+    }
+    CHECK(tiers[0].name == "full");
+    CHECK(tiers[0].scale == 1.0);
+    CHECK(tiers[0].quality == 80);
+    CHECK(tiers[1].name == "half");
+    CHECK(tiers[1].scale == 0.5);
+    CHECK(tiers[1].quality == 70);
+    CHECK(tiers[2].name == "quarter");
+    CHECK(tiers[2].scale == 0.25);
+    CHECK(tiers[2].quality == 60);
+}
+
+// 固定尺寸的档位不使用缩放比例
+void testParseFixedSize() {
+    auto tiers = StreamLadder::parse("thumb:320x180:50", 80);
+    CHECK(tiers.size() == 1);
+    if (tiers.empty()) {
+        return;
+    }
+    CHECK(tiers[0].width == 320);
+    CHECK(tiers[0].height == 180);
+    CHECK(tiers[0].scale == 0.0);
+    CHECK(tiers[0].quality == 50);
+}
+
+// 格式错误的项被忽略，质量限制在1-100
+void testParseInvalid() {
+    auto tiers = StreamLadder::parse("bad,,too:1:2:3,low:0.5:0,high:0.5:500", 80);
+    CHECK(tiers.size() == 2);
+    if (tiers.size() != 2) {
+        return;
+    }
+    CHECK(tiers[0].name == "low");
+    CHECK(tiers[0].quality == 1);
+    CHECK(tiers[1].name == "high");
+    CHECK(tiers[1].quality == 100);
+
+    CHECK(StreamLadder::parse("", 80).empty());
+}
+
+// 名称重复和缩放比例无效的档位不进入阶梯，第一个档位为默认档位
+void testLadder() {
+    StreamLadder ladder(StreamLadder::parse("full:1,half:0.5,full:0.25,zero:0,big:2", 80));
+    CHECK(ladder.getTiers().size() == 2);
+    CHECK(ladder.find("half") != nullptr);
+    CHECK(ladder.find("zero") == nullptr);
+    CHECK(ladder.find("big") == nullptr);
+    CHECK(ladder.resolve("half") == "half");
+    CHECK(ladder.resolve("") == "full");
+    CHECK(ladder.resolve("missing") == "full");
+    CHECK(StreamLadder().resolve("full").empty());
+}
+
+// 缩放后的尺寸取偶数，与源相同时输出0
+void testOutputSize() {
+    int width = -1;
+    int height = -1;
+    StreamTier tier;
+    tier.scale = 0.5;
+    StreamLadder::getOutputSize(tier, 1281, 722, width, height);
+    CHECK(width == 640);
+    CHECK(height == 360);
+
+    tier.scale = 1.0;
+    StreamLadder::getOutputSize(tier, 1280, 720, width, height);
+    CHECK(width == 0 && height == 0);
+
+    tier.width = 1280;
+    tier.height = 720;
+    StreamLadder::getOutputSize(tier, 1280, 720, width, height);
+    CHECK(width == 0 && height == 0);
+
+    tier.width = 320;
+    tier.height = 180;
+    StreamLadder::getOutputSize(tier, 1280, 720, width, height);
+    CHECK(width == 320 && height == 180);
+}
+
+} // namespace
+
+int main() {
+    testParseScale();
+    testParseFixedSize();
+    testParseInvalid();
+    testLadder();
+    testOutputSize();
+
+    if (failures > 0) {
+        std::cerr << "StreamLadder测试失败: " << failures << " 项" << std::endl;
+        return 1;
+    }
+    std::cout << "StreamLadder测试通过" << std::endl;
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "video/keyframe_index.h"
+
+using namespace cam_server::video;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if (!(cond)) {                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << " 检查失败: " #cond << std::endl; \
+            ++failures;                                                                 \
+        }                                                                               \
+    } while (0)
+
+constexpr int64_t kSecond = 1000000;
+constexpr int64_t kWallStart = 1700000000LL * kSecond;
+
+// 索引文件放在临时目录，录像文件本身不需要存在
+std::string videoPath(const std::string& name) {
+    auto dir = std::filesystem::temp_directory_path();
+    return (dir / ("keyframe_index_test_" + std::to_string(getpid()) + "_" + name + ".mp4")).string();
+}
+
+KeyframeEntry makeEntry(int64_t media_time_us, int64_t byte_offset) {
+    KeyframeEntry entry;
+    entry.media_time_us = media_time_us;
+    entry.byte_offset = byte_offset;
+    entry.wall_time_us = kWallStart + media_time_us;
+    return entry;
+}
+
+// 关键帧间隔2秒、最后一个间隔3秒的索引
+std::vector<KeyframeEntry> writeIndex(const std::string& video_path) {
+    std::vector<KeyframeEntry> entries = {
+        makeEntry(0, 48),
+        makeEntry(2 * kSecond, 100000),
+        makeEntry(4 * kSecond, 200000),
+        makeEntry(7 * kSecond, 350000),
+    };
+    KeyframeIndexWriter writer;
+    CHECK(writer.open(video_path));
+    for (const auto& entry : entries) {
+        CHECK(writer.append(entry));
+    }
+    CHECK(writer.count() == entries.size());
+    writer.close();
+    return entries;
+}
+
+bool sameEntry(const KeyframeEntry& a, const KeyframeEntry& b) {
+    return a.media_time_us == b.media_time_us && a.byte_offset == b.byte_offset && a.wall_time_us == b.wall_time_us;
+}
+
+void appendBytes(const std::string& path, const std::vector<char>& bytes) {
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::app);
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// 写入后加载得到相同的索引项
+void testRoundTrip() {
+    std::string video = videoPath("round_trip");
+    auto written = writeIndex(video);
+
+    KeyframeIndex index;
+    CHECK(index.load(video));
+    CHECK(index.entries().size() == written.size());
+    for (size_t i = 0; i < written.size() && i < index.entries().size(); ++i) {
+        CHECK(sameEntry(index.entries()[i], written[i]));
+    }
+    std::filesystem::remove(KeyframeIndex::sidecarPath(video));
+}
+
+// 录制中断留下的不完整末项被忽略
+void testTruncatedTrailingEntry() {
+    std::string video = videoPath("truncated");
+    auto written = writeIndex(video);
+    appendBytes(KeyframeIndex::sidecarPath(video), std::vector<char>(KeyframeIndex::ENTRY_SIZE - 1, '\x7f'));
+
+    KeyframeIndex index;
+    CHECK(index.load(video));
+    CHECK(index.entries().size() == written.size());
+
+    KeyframeEntry first;
+    KeyframeEntry last;
+    CHECK(KeyframeIndex::readRange(video, first, last));
+    CHECK(sameEntry(first, written.front()));
+    CHECK(sameEntry(last, written.back()));
+    std::filesystem::remove(KeyframeIndex::sidecarPath(video));
+}
+
+// 只有文件头、魔数错误或文件不存在时加载失败
+void testInvalidIndex() {
+    std::string video = videoPath("invalid");
+    KeyframeIndex index;
+    KeyframeEntry first;
+    KeyframeEntry last;
+    CHECK(!index.load(video));
+    CHECK(!KeyframeIndex::readRange(video, first, last));
+
+    KeyframeIndexWriter writer;
+    CHECK(writer.open(video));
+    writer.close();
+    CHECK(!index.load(video));
+    CHECK(index.empty());
+    CHECK(!KeyframeIndex::readRange(video, first, last));
+
+    writeIndex(video);
+    {
+        std::fstream file(KeyframeIndex::sidecarPath(video), std::ios::in | std::ios::out | std::ios::binary);
+        file.write("XXXX", 4);
+    }
+    CHECK(!index.load(video));
+    CHECK(!KeyframeIndex::readRange(video, first, last));
+    std::filesystem::remove(KeyframeIndex::sidecarPath(video));
+}
+
+// 新版本在每项末尾追加的字段按文件头中的项长度跳过
+void testLongerEntries() {
+    std::string video = videoPath("longer");
+    std::vector<char> data = {'C', 'S', 'K', 'I', 2, 32, 0, 0};
+    for (int64_t i = 0; i < 3; ++i) {
+        KeyframeEntry entry = makeEntry(i * kSecond, i * 1000);
+        for (int64_t value : {entry.media_time_us, entry.byte_offset, entry.wall_time_us}) {
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                data.push_back(static_cast<char>(static_cast<uint64_t>(value) >> shift));
+            }
+        }
+        data.insert(data.end(), 8, '\x55');
+    }
+    std::filesystem::remove(KeyframeIndex::sidecarPath(video));
+    appendBytes(KeyframeIndex::sidecarPath(video), data);
+
+    KeyframeIndex index;
+    CHECK(index.load(video));
+    CHECK(index.entries().size() == 3);
+    CHECK(index.entries().size() == 3 && sameEntry(index.entries()[2], makeEntry(2 * kSecond, 2000)));
+    KeyframeEntry first;
+    KeyframeEntry last;
+    CHECK(KeyframeIndex::readRange(video, first, last));
+    CHECK(sameEntry(last, makeEntry(2 * kSecond, 2000)));
+    std::filesystem::remove(KeyframeIndex::sidecarPath(video));
+}
+
+void testFindByMediaTime() {
+    std::string video = videoPath("media_time");
+    writeIndex(video);
+    KeyframeIndex index;
+    CHECK(index.load(video));
+
+    const KeyframeEntry* entry = index.findByMediaTime(-kSecond);
+    CHECK(entry && entry->media_time_us == 0);
+    entry = index.findByMediaTime(2 * kSecond);
+    CHECK(entry && entry->media_time_us == 2 * kSecond);
+    entry = index.findByMediaTime(4 * kSecond - 1);
+    CHECK(entry && entry->media_time_us == 2 * kSecond);
+    entry = index.findByMediaTime(60 * kSecond);
+    CHECK(entry && entry->media_time_us == 7 * kSecond);
+
+    CHECK(KeyframeIndex().findByMediaTime(0) == nullptr);
+    std::filesystem::remove(KeyframeIndex::sidecarPath(video));
+}
+
+// 最后一个GOP按最大关键帧间隔（3秒）估计结束时间
+void testFindByWallTime() {
+    std::string video = videoPath("wall_time");
+    writeIndex(video);
+    KeyframeIndex index;
+    CHECK(index.load(video));
+
+    CHECK(index.findByWallTime(kWallStart - 1) == nullptr);
+    const KeyframeEntry* entry = index.findByWallTime(kWallStart);
+    CHECK(entry && entry->media_time_us == 0);
+    entry = index.findByWallTime(kWallStart + 5 * kSecond);
+    CHECK(entry && entry->media_time_us == 4 * kSecond);
+    entry = index.findByWallTime(kWallStart + 10 * kSecond);
+    CHECK(entry && entry->media_time_us == 7 * kSecond);
+    CHECK(index.findByWallTime(kWallStart + 10 * kSecond + 1) == nullptr);
+
+    int64_t media_time_us = -1;
+    CHECK(index.wallToMediaTime(kWallStart + 5 * kSecond + 250000, media_time_us));
+    CHECK(media_time_us == 5 * kSecond + 250000);
+    CHECK(!index.wallToMediaTime(kWallStart - kSecond, media_time_us));
+    std::filesystem::remove(KeyframeIndex::sidecarPath(video));
+}
+
+} // namespace
+
+int main() {
+    testRoundTrip();
+    testTruncatedTrailingEntry();
+    testInvalidIndex();
+    testLongerEntries();
+    testFindByMediaTime();
+    testFindByWallTime();
+
+    if (failures > 0) {
+        std::cerr << "KeyframeIndex测试失败: " << failures << " 项" << std::endl;
+        return 1;
+    }
+    std::cout << "KeyframeIndex测试通过" << std::endl;
+    return 0;
+}
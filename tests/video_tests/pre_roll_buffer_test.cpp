@@ -0,0 +1,216 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "video/pre_roll_buffer.h"
+
+using namespace cam_server::video;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                     \
+    do {                                                                                \
+        if (!(cond)) {                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << " 检查失败: " #cond << std::endl; \
+            ++failures;                                                                 \
+        }                                                                               \
+    } while (0)
+
+constexpr int64_t kMs = 1000;
+
+struct Packet {
+    int64_t pts;
+    size_t size;
+    bool keyframe;
+    bool intact;  // 数据是否与写入时一致
+};
+
+// 包数据按pts填充，取出时据此检查环形数据区没有被覆盖
+bool push(PreRollBuffer& buffer, int64_t pts, size_t size, bool keyframe) {
+    std::vector<uint8_t> data(size, static_cast<uint8_t>(pts));
+    return buffer.push(data.data(), data.size(), pts, pts * kMs, keyframe);
+}
+
+std::vector<Packet> flush(PreRollBuffer& buffer) {
+    std::vector<Packet> packets;
+    buffer.flush([&packets](const uint8_t* data, size_t size, int64_t pts, bool keyframe) {
+        bool intact = true;
+        for (size_t i = 0; i < size; ++i) {
+            intact = intact && data[i] == static_cast<uint8_t>(pts);
+        }
+        packets.push_back(Packet{pts, size, keyframe, intact});
+        return true;
+    });
+    return packets;
+}
+
+std::vector<int64_t> ptsOf(const std::vector<Packet>& packets) {
+    std::vector<int64_t> pts;
+    for (const auto& packet : packets) {
+        pts.push_back(packet.pts);
+    }
+    return pts;
+}
+
+bool allIntact(const std::vector<Packet>& packets) {
+    for (const auto& packet : packets) {
+        if (!packet.intact) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 按写入顺序取出，取出后清空
+void testFlushInOrder() {
+    PreRollBuffer buffer;
+    buffer.configure(1000, 10000 * kMs, 16);
+    CHECK(push(buffer, 0, 10, true));
+    CHECK(push(buffer, 1, 20, false));
+    CHECK(push(buffer, 2, 30, false));
+    CHECK(buffer.getStats().packets == 3);
+    CHECK(buffer.getStats().bytes == 60);
+    CHECK(buffer.getStats().duration_us == 2 * kMs);
+
+    auto packets = flush(buffer);
+    CHECK((ptsOf(packets) == std::vector<int64_t>{0, 1, 2}));
+    CHECK(packets.size() == 3 && packets[0].keyframe && !packets[1].keyframe && packets[2].size == 30);
+    CHECK(allIntact(packets));
+    CHECK(buffer.getStats().packets == 0);
+    CHECK(buffer.getStats().bytes == 0);
+}
+
+// 缓冲总是从关键帧开始
+void testStartsWithKeyframe() {
+    PreRollBuffer buffer;
+    buffer.configure(1000, 10000 * kMs, 16);
+    push(buffer, 0, 10, false);
+    push(buffer, 1, 10, false);
+    CHECK(buffer.getStats().packets == 0);
+    push(buffer, 2, 10, true);
+    push(buffer, 3, 10, false);
+    CHECK((ptsOf(flush(buffer)) == std::vector<int64_t>{2, 3}));
+}
+
+// 尾部放不下时回到开头，按先进先出淘汰被覆盖的包
+void testWrap() {
+    PreRollBuffer buffer;
+    buffer.configure(100, 10000 * kMs, 16);
+    push(buffer, 0, 30, true);   // [0,30)
+    push(buffer, 1, 30, true);   // [30,60)
+    push(buffer, 2, 30, true);   // [60,90)
+    push(buffer, 3, 30, true);   // 回到开头[0,30)，淘汰0
+    push(buffer, 4, 30, true);   // [30,60)，淘汰1
+    CHECK(buffer.getStats().evicted == 2);
+    CHECK(buffer.getStats().bytes == 90);
+    auto packets = flush(buffer);
+    CHECK((ptsOf(packets) == std::vector<int64_t>{2, 3, 4}));
+    CHECK(allIntact(packets));
+}
+
+// 回到开头时，写入位置之后的旧包比开头的包更旧，即使不重叠也要先淘汰
+void testWrapEvictsTail() {
+    PreRollBuffer buffer;
+    buffer.configure(100, 10000 * kMs, 16);
+    push(buffer, 0, 10, true);   // [0,10)
+    push(buffer, 1, 60, true);   // [10,70)
+    push(buffer, 2, 20, true);   // [70,90)
+    push(buffer, 3, 50, true);   // 回到开头[0,50)，淘汰0和1
+    {
+        PreRollBuffer copy = buffer;
+        auto packets = flush(copy);
+        CHECK((ptsOf(packets) == std::vector<int64_t>{2, 3}));
+        CHECK(allIntact(packets));
+    }
+    push(buffer, 4, 60, true);   // 回到开头[0,60)，尾部的2和开头的3都被淘汰
+    auto packets = flush(buffer);
+    CHECK((ptsOf(packets) == std::vector<int64_t>{4}));
+    CHECK(allIntact(packets));
+}
+
+// 淘汰了GOP开头的关键帧后，剩余的非关键帧一并丢弃
+void testEvictionTrimsToKeyframe() {
+    PreRollBuffer buffer;
+    buffer.configure(100, 10000 * kMs, 16);
+    push(buffer, 0, 30, true);
+    push(buffer, 1, 30, false);
+    push(buffer, 2, 20, true);
+    push(buffer, 3, 20, false);  // [80,100)
+    push(buffer, 4, 30, false);  // 回到开头，淘汰0，随后1不是关键帧也被淘汰
+    auto packets = flush(buffer);
+    CHECK((ptsOf(packets) == std::vector<int64_t>{2, 3, 4}));
+    CHECK(packets.size() == 3 && packets[0].keyframe);
+    CHECK(allIntact(packets));
+}
+
+// 包数达到上限时淘汰最旧的包
+void testPacketLimit() {
+    PreRollBuffer buffer;
+    buffer.configure(1000, 10000 * kMs, 3);
+    for (int64_t pts = 0; pts < 5; ++pts) {
+        push(buffer, pts, 10, true);
+    }
+    CHECK(buffer.getStats().packets == 3);
+    CHECK((ptsOf(flush(buffer)) == std::vector<int64_t>{2, 3, 4}));
+}
+
+// 单包超过预算时拒绝，不影响已缓冲的包
+void testRejectOversize() {
+    PreRollBuffer buffer;
+    buffer.configure(100, 10000 * kMs, 16);
+    push(buffer, 0, 50, true);
+    CHECK(!push(buffer, 1, 101, true));
+    CHECK(buffer.getStats().rejected == 1);
+    CHECK(buffer.getStats().packets == 1);
+}
+
+// 去掉最旧的GOP后仍不短于预录时长时才淘汰它
+void testDurationByGop() {
+    PreRollBuffer buffer;
+    buffer.configure(100000, 1000 * kMs, 64);
+    // 每100毫秒一个包，每500毫秒一个关键帧
+    for (int64_t pts = 0; pts <= 1400; pts += 100) {
+        push(buffer, pts, 10, pts % 500 == 0);
+    }
+    CHECK(buffer.getStats().duration_us == 1400 * kMs);
+
+    push(buffer, 1500, 10, true);
+    auto packets = flush(buffer);
+    CHECK(!packets.empty() && packets.front().pts == 500 && packets.front().keyframe);
+    CHECK(packets.size() == 11);
+}
+
+// 只有一个GOP时即使超过预录时长也保留
+void testLatestGopKept() {
+    PreRollBuffer buffer;
+    buffer.configure(100000, 100 * kMs, 64);
+    push(buffer, 0, 10, true);
+    for (int64_t pts = 100; pts <= 2000; pts += 100) {
+        push(buffer, pts, 10, false);
+    }
+    CHECK(buffer.getStats().packets == 21);
+    CHECK(buffer.getStats().duration_us == 2000 * kMs);
+}
+
+} // namespace
+
+int main() {
+    testFlushInOrder();
+    testStartsWithKeyframe();
+    testWrap();
+    testWrapEvictsTail();
+    testEvictionTrimsToKeyframe();
+    testPacketLimit();
+    testRejectOversize();
+    testDurationByGop();
+    testLatestGopKept();
+
+    if (failures > 0) {
+        std::cerr << "PreRollBuffer测试失败: " << failures << " 项" << std::endl;
+        return 1;
+    }
+    std::cout << "PreRollBuffer测试通过" << std::endl;
+    return 0;
+}
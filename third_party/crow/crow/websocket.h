@@ -1,5 +1,7 @@
 #pragma once
 #include <array>
+#include <functional>
+#include <memory>
 #include "crow/logging.h"
 #include "crow/socket_adaptors.h"
 #include "crow/http_request.h"
@@ -57,6 +59,55 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             EndStatusCodes = 4999,
         };
 
+        /// Generate the websocket frame header for an unmasked server message.
+        inline std::string build_frame_header(int opcode, size_t size)
+        {
+            char buf[2 + 8] = "\x80\x00";
+            buf[0] += opcode;
+            if (size < 126)
+            {
+                buf[1] += static_cast<char>(size);
+                return {buf, buf + 2};
+            }
+            else if (size < 0x10000)
+            {
+                buf[1] += 126;
+                *(uint16_t*)(buf + 2) = htons(static_cast<uint16_t>(size));
+                return {buf, buf + 4};
+            }
+            else
+            {
+                buf[1] += 127;
+                *reinterpret_cast<uint64_t*>(buf + 2) = ((1 == htonl(1)) ? static_cast<uint64_t>(size) : (static_cast<uint64_t>(htonl((size)&0xFFFFFFFF)) << 32) | htonl(static_cast<uint64_t>(size) >> 32));
+                return {buf, buf + 10};
+            }
+        }
+
+        /// A ref-counted message whose header and payload can be queued on many connections without copying.
+        struct shared_message
+        {
+            std::shared_ptr<const std::string> header;
+            std::shared_ptr<const void> owner; ///< Keeps the payload alive until every connection has written it.
+            const char* data = nullptr;
+            size_t size = 0;
+            /// Only the newest latest-only message waits in a connection's queue; an older one that has not started
+            /// sending is dropped when a new one arrives, so a slow peer never accumulates a backlog.
+            bool latest_only = false;
+            /// Called on the connection's io thread with true once written, or false if dropped or the write failed.
+            std::function<void(bool)> on_complete;
+
+            /// Build the frame header once for a payload owned by \p owner.
+            static shared_message make(int opcode, std::shared_ptr<const void> owner, const char* data, size_t size)
+            {
+                shared_message msg;
+                msg.header = std::make_shared<const std::string>(build_frame_header(opcode, size));
+                msg.owner = std::move(owner);
+                msg.data = data;
+                msg.size = size;
+                return msg;
+            }
+        };
+
         /// A base class for websocket connection.
         struct connection
         {
@@ -64,6 +115,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             virtual void send_text(std::string msg) = 0;
             virtual void send_ping(std::string msg) = 0;
             virtual void send_pong(std::string msg) = 0;
+            virtual void send_shared(shared_message msg) = 0;
             virtual void close(std::string const& msg = "quit", uint16_t status_code = CloseStatusCode::NormalClosure) = 0;
             virtual std::string get_remote_ip() = 0;
             virtual std::string get_subprotocol() const = 0;
@@ -252,6 +304,33 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 send_data(0x1, std::move(msg));
             }
 
+            /// Send a prebuilt message shared with other connections; the payload is referenced, not copied.
+            void send_shared(shared_message msg) override
+            {
+                post([this, msg = std::move(msg)]() mutable {
+                    if (msg.latest_only)
+                    {
+                        // Replace a queued latest-only message that has not started sending yet.
+                        for (auto it = write_buffers_.begin(); it != write_buffers_.end(); ++it)
+                        {
+                            if (it->latest_only)
+                            {
+                                auto replaced = std::move(it->on_complete);
+                                write_buffers_.erase(it - 1, it + 1); // The header precedes the payload.
+                                if (replaced)
+                                    replaced(false);
+                                break;
+                            }
+                        }
+                    }
+                    write_buffers_.emplace_back(msg.header, msg.header->data(), msg.header->size());
+                    write_buffers_.emplace_back(std::move(msg.owner), msg.data, msg.size);
+                    write_buffers_.back().latest_only = msg.latest_only;
+                    write_buffers_.back().on_complete = std::move(msg.on_complete);
+                    do_write();
+                });
+            }
+
             /// Send a close signal.
 
             ///
@@ -297,25 +376,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             /// Generate the websocket headers using an opcode and the message size (in bytes).
             std::string build_header(int opcode, size_t size)
             {
-                char buf[2 + 8] = "\x80\x00";
-                buf[0] += opcode;
-                if (size < 126)
-                {
-                    buf[1] += static_cast<char>(size);
-                    return {buf, buf + 2};
-                }
-                else if (size < 0x10000)
-                {
-                    buf[1] += 126;
-                    *(uint16_t*)(buf + 2) = htons(static_cast<uint16_t>(size));
-                    return {buf, buf + 4};
-                }
-                else
-                {
-                    buf[1] += 127;
-                    *reinterpret_cast<uint64_t*>(buf + 2) = ((1 == htonl(1)) ? static_cast<uint64_t>(size) : (static_cast<uint64_t>(htonl((size)&0xFFFFFFFF)) << 32) | htonl(static_cast<uint64_t>(size) >> 32));
-                    return {buf, buf + 10};
-                }
+                return build_frame_header(opcode, size);
             }
 
             /// Send the HTTP upgrade response.
@@ -724,7 +785,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                     buffers.reserve(sending_buffers_.size());
                     for (auto& s : sending_buffers_)
                     {
-                        buffers.emplace_back(asio::buffer(s));
+                        buffers.emplace_back(s.buffer());
                     }
                     auto watch = std::weak_ptr<void>{anchor_};
                     asio::async_write(
@@ -732,6 +793,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                       [&, watch](const error_code& ec, std::size_t /*bytes_transferred*/) {
                           if (!ec && !close_connection_)
                           {
+                              complete_buffers(true);
                               sending_buffers_.clear();
                               if (!write_buffers_.empty())
                                   do_write();
@@ -743,6 +805,7 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                               auto anchor = watch.lock();
                               if (anchor == nullptr) { return; }
 
+                              complete_buffers(false);
                               sending_buffers_.clear();
                               close_connection_ = true;
                               check_destroy();
@@ -751,6 +814,16 @@ namespace crow // NOTE: Already documented in "crow/app.h"
                 }
             }
 
+            /// Notify the owners of shared messages in the batch that was just sent.
+            void complete_buffers(bool written)
+            {
+                for (auto& b : sending_buffers_)
+                {
+                    if (b.on_complete)
+                        b.on_complete(written);
+                }
+            }
+
             /// Destroy the Connection.
             void check_destroy(websocket::CloseStatusCode code = CloseStatusCode::ClosedAbnormally)
             {
@@ -799,8 +872,31 @@ namespace crow // NOTE: Already documented in "crow/app.h"
             Adaptor adaptor_;
             Handler* handler_;
 
-            std::vector<std::string> sending_buffers_;
-            std::vector<std::string> write_buffers_;
+            /// Either an owned string or a view into a shared_message payload.
+            struct write_buffer
+            {
+                write_buffer(std::string s):
+                  owned(std::move(s))
+                {}
+                write_buffer(std::shared_ptr<const void> o, const char* d, size_t n):
+                  owner(std::move(o)), data(d), size(n)
+                {}
+
+                asio::const_buffer buffer() const
+                {
+                    return owner ? asio::buffer(data, size) : asio::buffer(owned);
+                }
+
+                std::string owned;
+                std::shared_ptr<const void> owner;
+                const char* data = nullptr;
+                size_t size = 0;
+                bool latest_only = false;
+                std::function<void(bool)> on_complete;
+            };
+
+            std::vector<write_buffer> sending_buffers_;
+            std::vector<write_buffer> write_buffers_;
 
             std::array<char, 4096> buffer_;
             bool is_binary_;
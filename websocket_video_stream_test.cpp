@@ -288,10 +288,11 @@ private:
                 }
             }
 
-            // 设置帧回调，将帧数据发送给对应的WebSocket客户端
-            camera_manager.setFrameCallback([this, device_path](const camera::Frame& frame) {
+            // 订阅帧，将帧数据发送给对应的WebSocket客户端（替换之前的订阅）
+            auto subscription = camera_manager.subscribeFrames("websocket_video_test", [this, device_path](const camera::Frame& frame) {
                 handleFrame(frame, device_path);
             });
+            camera_manager.unsubscribeFrames(frame_subscription_.exchange(subscription));
 
             // 启动捕获
             if (!camera_manager.startCapture()) {
@@ -327,6 +328,7 @@ private:
 
             if (!device_path.empty()) {
                 auto& camera_manager = camera::CameraManager::getInstance();
+                camera_manager.unsubscribeFrames(frame_subscription_.exchange(0));
                 camera_manager.stopCapture();
                 std::cout << "✅ 摄像头停止成功，设备: " << device_path << std::endl;
             }
@@ -452,15 +454,16 @@ private:
         }
 
         // 获取MJPEG数据
-        const auto& frame_data = frame.getData();
-        if (frame_data.empty()) {
+        const uint8_t* frame_data = frame.getDataPtr();
+        const size_t frame_size = frame.getDataSize();
+        if (frame_size == 0) {
             std::cout << "⚠️ 收到空帧数据，设备: " << device_path << std::endl;
             return;
         }
 
         // 调试信息：确认帧数据大小
         if (frame_count_ % 50 == 1) {
-            std::cout << "📊 帧数据大小: " << frame_data.size() << " 字节，设备: " << device_path << std::endl;
+            std::cout << "📊 帧数据大小: " << frame_size << " 字节，设备: " << device_path << std::endl;
         }
 
         // 直接发送MJPEG帧数据给所有匹配的客户端
@@ -477,14 +480,14 @@ private:
                 try {
                     // 尝试不同的发送方式
                     // 方式1：直接从vector构造string
-                    std::string binary_data(reinterpret_cast<const char*>(frame_data.data()), frame_data.size());
+                    std::string binary_data(reinterpret_cast<const char*>(frame_data), frame_size);
                     client_info.conn->send_binary(binary_data);
 
                     // 调试信息：确认发送的数据大小和前几个字节
                     if (frame_count_ % 50 == 1) {
                         std::cout << "📤 发送帧数据到客户端 " << client_id
-                                 << "，大小: " << frame_data.size() << " 字节";
-                        if (frame_data.size() >= 4) {
+                                 << "，大小: " << frame_size << " 字节";
+                        if (frame_size >= 4) {
                             std::cout << "，前4字节: "
                                      << std::hex << (int)frame_data[0] << " "
                                      << (int)frame_data[1] << " "
@@ -504,7 +507,7 @@ private:
         // 每100帧输出一次统计信息
         if (frame_count_ % 100 == 0) {
             std::cout << "📊 已处理 " << frame_count_ << " 帧，设备: " << device_path
-                     << "，原始帧大小: " << frame_data.size() << " 字节" << std::endl;
+                     << "，原始帧大小: " << frame_size << " 字节" << std::endl;
         }
     }
 
@@ -518,6 +521,7 @@ private:
     std::thread server_thread_;
     std::atomic<bool> is_running_;
     std::atomic<uint64_t> frame_count_;
+    std::atomic<camera::FrameBus::SubscriptionId> frame_subscription_{0};
 
     // 客户端连接管理
     std::mutex clients_mutex_;